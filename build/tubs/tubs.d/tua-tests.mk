@@ -11,6 +11,7 @@
 # Target variables:
 #     <target>_librarie       : list of libraries that the test needs to run
 #     <target>_includes       : list of header only dependencies or addition -I to add to test
+#     <target>_defines        : additional -D to add when compiling the test
 #
 
 _TUBS_LOADED_SUB_MAKES += tua-tests
@@ -85,6 +86,7 @@ $(call _tubs_log,$(call _target_to_makefile,$(_target)): Adding test '$(call _tu
 
 $(if $($(call _tua_makefile_var,$(1))_libraries),$(eval $(call _tua_test_target,$(1))_libraries := $($(call _tua_makefile_var,$(1))_libraries)))
 $(if $($(call _tua_makefile_var,$(1))_includes),$(eval $(call _tua_test_target,$(1))_includes := $($(call _tua_makefile_var,$(1))_includes)))
+$(if $($(call _tua_makefile_var,$(1))_defines),$(eval $(call _tua_test_target,$(1))_defines := $($(call _tua_makefile_var,$(1))_defines)))
 
 $(eval $(call resolve_libraries,$(call _tua_test_target,$(1))))
 $(eval $(call resolve_includes,$(call _tua_test_target,$(1))))
@@ -193,8 +193,9 @@ struct log_line
     {
     }
 
+    // compiled out lines never reach a sink, don't pay for a clock read
     log_line(log_level level, const std::source_location &location = std::source_location::current())
-    : timestamp_(std::chrono::steady_clock::now()),
+    : timestamp_(level == log_level::nolog ? timestamp_type{} : std::chrono::steady_clock::now()),
       timestamp_us_(std::chrono::duration_cast<std::chrono::microseconds>(timestamp_.time_since_epoch()).count()),
       level_(level),
       file_(location.file_name()),
@@ -376,10 +377,16 @@ void log_sink_stdout::log(const struct log_line_dispatcher &dispatcher, const lo
     fwrite(buffer, 1, len, stdout);
 }
 
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL debug
+#endif
+
 /**
  * @brief Global minimal log level. Messages below this level will be eliminated at compile time.
+ *
+ * Can be raised per target with e.g. -DLOG_MIN_LEVEL=warn.
  */
-inline constexpr log_level GLOBAL_MIN_LOG_LEVEL = log_level::debug;
+inline constexpr log_level GLOBAL_MIN_LOG_LEVEL = log_level::LOG_MIN_LEVEL;
 
 /**
  * @brief Creates a log line with specified level and automatic source location.
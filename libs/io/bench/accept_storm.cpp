@@ -0,0 +1,248 @@
+#include <io/io.hpp>
+#include <net/listener.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Connect storm on loopback: a client thread opens bursts of non-blocking connections as fast as it can and resets
+ * them once the server took them, the server accepts on one or more loops, each on a thread of its own, and starts a
+ * task per connection that closes it.
+ *
+ * single: io::accept, one connection per wakeup. batch: io::accept_batch, draining the queue per wakeup. Both run on a
+ * listener_set in reuse_port and exclusive mode. The CPU time is the sum of the server threads'. Overflows are the
+ * connections the kernel turned away because the accept queue was full (TcpExt ListenOverflows), their clients would
+ * retry a second later.
+ *
+ * usage: bench_accept_storm [--connections N] [--burst N] [--backlog N] [--loops N] [single|batch ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t connections = 100000;
+    size_t burst       = 512;
+    int backlog        = 128;
+    size_t loops       = 1;
+    std::vector<std::string> tests;
+};
+
+double thread_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief TcpExt ListenOverflows, or 0 if it can't be read.
+size_t listen_overflows()
+{
+    std::ifstream netstat("/proc/net/netstat");
+    std::string names, values;
+    while (std::getline(netstat, names) && std::getline(netstat, values))
+    {
+        if (names.rfind("TcpExt:", 0) != 0) { continue; }
+
+        std::istringstream n(names), v(values);
+        std::string name, value;
+        while (n >> name && v >> value)
+        {
+            if (name == "ListenOverflows") { return strtoull(value.c_str(), nullptr, 10); }
+        }
+    }
+    return 0;
+}
+
+struct server_stats
+{
+    std::atomic<size_t> accepted{0};
+    std::atomic<size_t> awaits{0}; //!< accept operations the acceptors waited for
+    std::atomic<bool> done{false};
+};
+
+void run_server(listener_set &listeners, size_t index, bool batched, server_stats &stats, double &cpu)
+{
+    io_loop loop;
+    loop.init();
+
+    auto connection = [](int fd) -> io_task
+    {
+        close(fd);
+        co_return;
+    };
+
+    auto acceptor = [&]() -> io_task
+    {
+        int fd = listeners.fd(index);
+        std::vector<accepted_connection> connections;
+        while (true)
+        {
+            if (batched)
+            {
+                if (co_await accept_batch(loop, fd, connections, DEFAULT_ACCEPT_BATCH, listeners.exclusive()) !=
+                    io_result::done)
+                {
+                    break;
+                }
+                for (const auto &c : connections) { (void)loop.schedule(connection(c.fd), "connection"); }
+                stats.accepted += connections.size();
+            }
+            else
+            {
+                int remote_fd = -1;
+                struct sock_addr remote;
+                if (co_await accept(loop, fd, remote_fd, remote) != io_result::done) { break; }
+                if (remote_fd == -1) { continue; }
+                (void)loop.schedule(connection(remote_fd), "connection");
+                ++stats.accepted;
+            }
+            ++stats.awaits;
+        }
+    };
+
+    // the client thread says when it's done
+    auto watcher = [&]() -> io_task
+    {
+        while (!stats.done) { co_await io::sleep(loop, std::chrono::milliseconds(1)); }
+        loop.shutdown(loop.now() + std::chrono::milliseconds(100));
+    };
+
+    (void)loop.schedule(acceptor(), "acceptor");
+    (void)loop.schedule(watcher(), "watcher");
+
+    auto start = thread_cpu_seconds();
+    loop.run();
+    cpu = thread_cpu_seconds() - start;
+}
+
+/**
+ * @brief Opens @p opts.connections connections in bursts, each burst reset once the server took it or went quiet.
+ */
+void run_client(const options &opts, const struct sock_addr &addr, server_stats &stats)
+{
+    struct linger reset = {1, 0};
+    std::vector<int> fds;
+
+    for (size_t issued = 0; issued < opts.connections;)
+    {
+        size_t burst = std::min(opts.burst, opts.connections - issued);
+        for (size_t i = 0; i < burst; ++i)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd == -1) { break; }
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            (void)::connect(fd, addr.sockaddr(), addr.len());
+            fds.push_back(fd);
+        }
+        issued += burst;
+
+        // connections turned away are not coming, give up on them after a quiet 10 ms
+        auto last     = stats.accepted.load();
+        auto progress = std::chrono::steady_clock::now();
+        while (stats.accepted < issued && std::chrono::steady_clock::now() - progress < std::chrono::milliseconds(10))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            if (stats.accepted != last)
+            {
+                last     = stats.accepted;
+                progress = std::chrono::steady_clock::now();
+            }
+        }
+
+        for (int fd : fds) { close(fd); }
+        fds.clear();
+    }
+
+    stats.done = true;
+}
+
+bool run(const options &opts, bool batched, listen_mode mode)
+{
+    listener_set listeners;
+    listen_options listen;
+    listen.mode    = mode;
+    listen.backlog = opts.backlog;
+    if (auto error = listeners.open(sock_addr("127.0.0.1:0", AF_INET), opts.loops, listen))
+    {
+        fprintf(stderr, "listen: %s\n", error.message().c_str());
+        return false;
+    }
+
+    server_stats stats;
+    std::vector<double> cpu(opts.loops, 0);
+    auto overflows_start = listen_overflows();
+    auto wall_start      = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> servers;
+    for (size_t i = 0; i < opts.loops; ++i)
+    {
+        servers.emplace_back([&, i]() { run_server(listeners, i, batched, stats, cpu[i]); });
+    }
+    run_client(opts, listeners.address(), stats);
+    for (auto &server : servers) { server.join(); }
+
+    auto wall      = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto overflows = listen_overflows() - overflows_start;
+    double cpu_sum = 0;
+    for (double c : cpu) { cpu_sum += c; }
+
+    size_t accepted = stats.accepted;
+    printf("%-6s %-10s  loops %zu  burst %4zu  backlog %4d  accepted %7zu  overflows %6zu  wall: %6.3fs  %8.0f conn/s  "
+           "server cpu: %5.2f us/conn  accept ops: %5.3f/conn\n",
+           batched ? "batch" : "single", mode == listen_mode::reuse_port ? "reuse_port" : "exclusive", opts.loops,
+           opts.burst, opts.backlog, accepted, overflows, wall, accepted / wall,
+           accepted ? cpu_sum * 1e6 / accepted : 0.0, accepted ? double(stats.awaits) / accepted : 0.0);
+    return accepted > 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--connections" && i + 1 < argc) { opts.connections = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--burst" && i + 1 < argc) { opts.burst = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--backlog" && i + 1 < argc) { opts.backlog = atoi(argv[++i]); }
+        else if (arg == "--loops" && i + 1 < argc) { opts.loops = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "single" || arg == "batch") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--connections N] [--burst N] [--backlog N] [--loops N] [single|batch ...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.connections == 0 || opts.burst == 0 || opts.loops == 0) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"single", "batch"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests)
+    {
+        for (auto mode : {listen_mode::reuse_port, listen_mode::exclusive}) { ok = run(opts, test == "batch", mode) && ok; }
+    }
+
+    return ok ? 0 : 1;
+}
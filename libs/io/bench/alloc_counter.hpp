@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Heap allocation counting for the benchmarks that report allocations per operation.
+ *
+ * alloc_counter.cpp replaces the global operator new, add it to the sources of such a benchmark. Every allocation
+ * of the process is counted, the loop's, the promises' and the tasks' alike.
+ */
+
+/// @brief Allocations through operator new since the start of the process.
+uint64_t allocation_count() noexcept;
@@ -0,0 +1,209 @@
+#include <net/connection_table.hpp>
+#include <net/sockaddr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A UDP session table keyed by socket_tuple: connection_table (flat, open addressing) against std::unordered_map with
+ * the same hash, and std::hash<sock_addr> on its own.
+ *
+ * The sessions all have one local address and port, the peers are random IPv4 or IPv6 addresses and ports. The run
+ * inserts every session, looks each one up in random order, looks up as many that aren't there, then erases half
+ * and adds as many new ones, the churn of a table that expires sessions.
+ *
+ * usage: bench_conn_table [--sessions N] [v4|v6 ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    std::vector<size_t> sessions;
+    std::vector<std::string> families;
+};
+
+struct session
+{
+    uint64_t last_seen = 0;
+    uint32_t packets   = 0;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+sock_addr random_peer(std::mt19937_64 &rng, bool v6)
+{
+    uint64_t bits = rng();
+    if (!v6)
+    {
+        struct sockaddr_in sin = {};
+        sin.sin_family         = AF_INET;
+        sin.sin_addr.s_addr    = static_cast<uint32_t>(bits);
+        sin.sin_port           = static_cast<uint16_t>(bits >> 32);
+        return sock_addr(sin);
+    }
+
+    struct sockaddr_in6 sin6 = {};
+    sin6.sin6_family          = AF_INET6;
+    sin6.sin6_port            = static_cast<uint16_t>(bits >> 48);
+    sin6.sin6_addr.s6_addr[0] = 0x20;
+    sin6.sin6_addr.s6_addr[1] = 0x01;
+    uint64_t low              = rng();
+    memcpy(sin6.sin6_addr.s6_addr + 4, &bits, 4);
+    memcpy(sin6.sin6_addr.s6_addr + 8, &low, 8);
+    return sock_addr(sin6);
+}
+
+struct result
+{
+    double insert = 0, hit = 0, miss = 0, churn = 0; //!< ns per operation
+    size_t found  = 0;
+};
+
+template <typename Map, typename Insert, typename Find, typename Erase>
+result measure(Map &map, const std::vector<socket_tuple> &keys, const std::vector<socket_tuple> &others,
+               const std::vector<uint32_t> &order, Insert &&insert, Find &&find, Erase &&erase)
+{
+    result r;
+    size_t n = keys.size();
+
+    auto start = clock_type::now();
+    for (const auto &key : keys) { insert(map, key); }
+    r.insert = seconds_since(start) * 1e9 / n;
+
+    start = clock_type::now();
+    for (uint32_t i : order) { r.found += find(map, keys[i]); }
+    r.hit = seconds_since(start) * 1e9 / n;
+
+    start = clock_type::now();
+    for (const auto &key : others) { r.found += find(map, key); }
+    r.miss = seconds_since(start) * 1e9 / n;
+
+    start = clock_type::now();
+    for (size_t i = 0; i < n / 2; ++i)
+    {
+        erase(map, keys[order[i]]);
+        insert(map, others[i]);
+    }
+    r.churn = seconds_since(start) * 1e9 / n;
+
+    return r;
+}
+
+void print(const char *name, const result &r, size_t memory)
+{
+    printf("  %-16s insert: %6.1f ns  hit: %6.1f ns  miss: %6.1f ns  erase+insert: %6.1f ns  memory: %7.1f MiB\n", name,
+           r.insert, r.hit, r.miss, r.churn * 2, memory / 1048576.0);
+}
+
+bool run(const std::string &family, size_t count)
+{
+    bool v6 = family == "v6";
+    std::mt19937_64 rng(count);
+    sock_addr local(v6 ? "[2001:db8::53]:53" : "192.0.2.53:53");
+
+    std::vector<socket_tuple> keys, others;
+    std::vector<sock_addr> peers;
+    keys.reserve(count);
+    others.reserve(count);
+    peers.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        peers.push_back(random_peer(rng, v6));
+        keys.emplace_back(local, peers.back());
+        others.emplace_back(local, random_peer(rng, v6));
+    }
+
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; ++i) { order[i] = i; }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    printf("%s  sessions: %zu\n", family.c_str(), count);
+
+    auto start   = clock_type::now();
+    size_t mixed = 0;
+    for (uint32_t i : order) { mixed ^= std::hash<sock_addr>{}(peers[i]); }
+    double hashed = seconds_since(start) * 1e9 / count;
+    printf("  %-16s %6.1f ns  (%016zx)\n", "hash<sock_addr>", hashed, mixed);
+
+    result flat, node;
+    size_t flat_memory = 0;
+    {
+        connection_table<session> table;
+        flat = measure(
+            table, keys, others, order, [](auto &m, const socket_tuple &k) { m.try_emplace(k).first->value.packets++; },
+            [](auto &m, const socket_tuple &k) { return m.find(k) != nullptr; },
+            [](auto &m, const socket_tuple &k) { m.erase(k); });
+        flat_memory = table.memory();
+    }
+    {
+        std::unordered_map<socket_tuple, session> table;
+        node = measure(
+            table, keys, others, order, [](auto &m, const socket_tuple &k) { m[k].packets++; },
+            [](auto &m, const socket_tuple &k) { return m.find(k) != m.end(); },
+            [](auto &m, const socket_tuple &k) { m.erase(k); });
+    }
+
+    // nodes hold the key, the value and the next pointer, malloc rounds them up to 16 bytes with 8 bytes overhead
+    size_t node_size   = (sizeof(socket_tuple) + sizeof(session) + sizeof(void *) + 8 + 15) / 16 * 16;
+    size_t node_memory = count * node_size + count * sizeof(void *);
+
+    print("connection_table", flat, flat_memory);
+    print("unordered_map", node, node_memory);
+
+    if (flat.found != node.found)
+    {
+        printf("  MISMATCH found %zu vs %zu\n", flat.found, node.found);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--sessions" && i + 1 < argc) { opts.sessions.push_back(strtoull(argv[++i], nullptr, 10)); }
+        else if (arg == "v4" || arg == "v6") { opts.families.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--sessions N] [v4|v6 ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.sessions.empty()) { opts.sessions = {100000, 1000000, 4000000}; }
+    if (opts.families.empty()) { opts.families = {"v4", "v6"}; }
+
+    bool ok = true;
+    for (const auto &family : opts.families)
+    {
+        for (size_t count : opts.sessions)
+        {
+            if (count == 0) { return 1; }
+            ok = run(family, count) && ok;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include <io/io.hpp>
+#include <net/connection_pool.hpp>
+#include <net/listener.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Request/response over loopback: a backend on a thread of its own answers every byte it gets with a byte, a client
+ * loop sends requests from a number of concurrent tasks.
+ *
+ * connect: a new connection per request, closed after the response. pool: connections checked out of a
+ * connection_pool and released after the response.
+ *
+ * usage: bench_connection_pool [--requests N] [--concurrency N] [connect|pool ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t requests    = 20000;
+    size_t concurrency = 8;
+    std::vector<std::string> tests;
+};
+
+void run_backend(listener_set &listeners, std::atomic<bool> &done)
+{
+    io_loop loop;
+    loop.init();
+
+    auto handler = [&](int fd, struct sock_addr) -> io_task
+    {
+        char byte     = 0;
+        ssize_t bytes = 0;
+        size_t sent   = 0;
+        while (co_await recv(loop, fd, &byte, 1, bytes) == io_result::done && bytes == 1)
+        {
+            if (co_await send(loop, fd, &byte, 1, sent) != io_result::done) { break; }
+        }
+        close(fd);
+    };
+
+    auto watcher = [&]() -> io_task
+    {
+        while (!done) { co_await io::sleep(loop, std::chrono::milliseconds(1)); }
+        loop.shutdown(loop.now() + std::chrono::milliseconds(100));
+    };
+
+    (void)loop.schedule(serve(loop, listeners.fd(0), handler), "acceptor");
+    (void)loop.schedule(watcher(), "watcher");
+    loop.run();
+}
+
+bool run(const options &opts, bool pooled)
+{
+    listener_set listeners;
+    if (auto error = listeners.open(sock_addr("127.0.0.1:0", AF_INET), 1))
+    {
+        fprintf(stderr, "listen: %s\n", error.message().c_str());
+        return false;
+    }
+
+    std::atomic<bool> done{false};
+    std::thread backend([&]() { run_backend(listeners, done); });
+
+    io_loop loop;
+    loop.init();
+    connection_pool_options pool_options;
+    pool_options.max_idle   = opts.concurrency;
+    pool_options.max_in_use = opts.concurrency;
+    connection_pool pool{loop, pool_options};
+
+    // one byte there, one back
+    auto exchange = [&](int fd) -> io_func<bool>
+    {
+        char byte     = 'x';
+        size_t sent   = 0;
+        ssize_t bytes = 0;
+        if (co_await send(loop, fd, &byte, 1, sent) != io_result::done) { co_return false; }
+        if (co_await recv(loop, fd, &byte, 1, bytes) != io_result::done) { co_return false; }
+        co_return bytes == 1;
+    };
+
+    size_t issued = 0, completed = 0, failed = 0, running = opts.concurrency;
+    auto client   = [&]() -> io_task
+    {
+        while (issued < opts.requests)
+        {
+            ++issued;
+
+            if (pooled)
+            {
+                auto conn = co_await pool.acquire(listeners.address());
+                if (conn && co_await exchange(conn.fd()))
+                {
+                    conn.release();
+                    ++completed;
+                }
+                else { ++failed; }
+            }
+            else
+            {
+                int fd      = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                auto result = co_await connect(loop, fd, listeners.address());
+                if (result == io_result::done && co_await exchange(fd)) { ++completed; }
+                else { ++failed; }
+                close(fd);
+            }
+        }
+
+        // the idle connections would keep the loop running
+        if (--running == 0) { pool.clear(); }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opts.concurrency; ++i) { (void)loop.schedule(client(), "client"); }
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    done = true;
+    backend.join();
+
+    const auto &stats = pool.stats();
+    printf("%-8s concurrency %3zu  requests %7zu  failed %5zu  wall: %6.3fs  %9.0f req/s  %6.2f us/req",
+           pooled ? "pool" : "connect", opts.concurrency, completed, failed, wall, completed / wall,
+           wall * 1e6 / (completed ? completed : 1));
+    if (pooled)
+    {
+        printf("  hits %zu  misses %zu  waits %zu  max wait %.1f us", stats.hits, stats.misses, stats.waits,
+               std::chrono::duration<double, std::micro>(stats.max_wait_time).count());
+    }
+    printf("\n");
+    return failed == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--requests" && i + 1 < argc) { opts.requests = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--concurrency" && i + 1 < argc) { opts.concurrency = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "connect" || arg == "pool") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--requests N] [--concurrency N] [connect|pool ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.requests == 0 || opts.concurrency == 0) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"connect", "pool"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests) { ok = run(opts, test == "pool") && ok; }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/ops.hpp>
+#include <common/json.hpp>
+
+#include "alloc_counter.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * End-to-end benchmarks for the loop and the socket operations.
+ *
+ * Every benchmark reports its throughput, the p50/p99/p999 latency of a single operation and the number of heap
+ * allocations per operation. The global operator new is replaced to count the allocations, they are counted from the
+ * moment the measured tasks are scheduled until the loop returns.
+ *
+ * - resume:    a task yielding to the loop, one operation is one suspend/resume round trip
+ * - timers:    timers with deadlines spread over 10ms, the latency is how late a timer fired
+ * - socketpair: ping-pong over an AF_UNIX socketpair, one operation is a round trip
+ * - tcp_echo:  N connections over loopback to an echo server on the same loop, one operation is a round trip
+ * - mbox:      ping-pong between two tasks over two io_mbox, one operation is a round trip
+ *
+ * usage: bench_io [--ops N] [--timers N] [--connections N] [--json FILE] [benchmark ...]
+ *
+ * The results are printed as a table and written as JSON to FILE, or to stdout without --json.
+ */
+
+using namespace io;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+
+constexpr size_t msg_size = 64;
+
+struct options
+{
+    size_t ops         = 100000;
+    size_t timers      = 5000;
+    size_t connections = 16;
+    std::string json_file;
+    std::vector<std::string> only;
+};
+
+struct result
+{
+    std::string name;
+    size_t ops = 0;
+    double seconds = 0;
+    uint64_t allocations = 0;
+    std::vector<int64_t> latencies_ns; //!< signed, a timer can fire up to a millisecond early
+
+    [[nodiscard]] int64_t percentile(double p) const
+    {
+        if (latencies_ns.empty()) { return 0; }
+        auto idx = std::min(latencies_ns.size() - 1, static_cast<size_t>(p * latencies_ns.size()));
+        return latencies_ns[idx];
+    }
+};
+
+int64_t elapsed_ns(clock_type::time_point from, clock_type::time_point to = clock_type::now())
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+/**
+ * Schedules the tasks, runs the loop until all of them finished and fills in the time, allocation count and sorted
+ * latencies. Scheduling is part of the measurement.
+ */
+void measure(io_loop &loop, result &res, const std::function<void()> &schedule)
+{
+    auto allocations_before = allocation_count();
+    auto start              = clock_type::now();
+
+    schedule();
+    loop.run();
+
+    res.seconds     = std::chrono::duration<double>(clock_type::now() - start).count();
+    res.allocations = allocation_count() - allocations_before;
+    std::ranges::sort(res.latencies_ns);
+}
+
+result bench_resume(const options &opt)
+{
+    result res{"resume", opt.ops};
+    res.latencies_ns.reserve(opt.ops);
+
+    io_loop loop;
+    loop.init();
+
+    auto task = [&]() -> io_task
+    {
+        for (size_t i = 0; i < opt.ops; ++i)
+        {
+            auto start = clock_type::now();
+            co_await yield(loop);
+            res.latencies_ns.push_back(elapsed_ns(start));
+        }
+    };
+
+    measure(loop, res, [&]() { (void)loop.schedule(task(), "resume"); });
+    return res;
+}
+
+result bench_timers(const options &opt)
+{
+    result res{"timers", opt.timers};
+    res.latencies_ns.reserve(opt.timers);
+
+    io_loop loop;
+    loop.init();
+
+    // the deadline is set when the timer task first runs, scheduling thousands of tasks takes a while
+    auto timer = [&](std::chrono::microseconds delay) -> io_task
+    {
+        auto deadline = time_now() + delay;
+        auto p        = detail::io_promise{loop, deadline};
+        co_await p;
+        res.latencies_ns.push_back(elapsed_ns(deadline));
+    };
+
+    measure(loop, res,
+            [&]()
+            {
+                for (size_t i = 0; i < opt.timers; ++i)
+                {
+                    (void)loop.schedule(timer(std::chrono::microseconds((i * 10) % 10000)), "timer");
+                }
+            });
+    return res;
+}
+
+result bench_socketpair(const options &opt)
+{
+    result res{"socketpair", opt.ops};
+    res.latencies_ns.reserve(opt.ops);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == -1)
+    {
+        perror("socketpair");
+        return res;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    auto server = [&]() -> io_task
+    {
+        char buf[msg_size];
+        while (true)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            if (co_await recv(loop, fds[1], buf, sizeof(buf), received) != io_result::done) { break; }
+            if (co_await send(loop, fds[1], buf, received, sent) != io_result::done) { break; }
+        }
+    };
+
+    auto client = [&]() -> io_task
+    {
+        char buf[msg_size] = {};
+        for (size_t i = 0; i < opt.ops; ++i)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            auto start       = clock_type::now();
+            if (co_await send(loop, fds[0], buf, sizeof(buf), sent) != io_result::done) { break; }
+            if (co_await recv(loop, fds[0], buf, sizeof(buf), received) != io_result::done) { break; }
+            res.latencies_ns.push_back(elapsed_ns(start));
+        }
+        shutdown(fds[0], SHUT_WR);
+    };
+
+    measure(loop, res,
+            [&]()
+            {
+                (void)loop.schedule(server(), "server");
+                (void)loop.schedule(client(), "client");
+            });
+
+    close(fds[0]);
+    close(fds[1]);
+    return res;
+}
+
+result bench_tcp_echo(const options &opt)
+{
+    const size_t per_connection = std::max<size_t>(1, opt.ops / opt.connections);
+    result res{"tcp_echo", per_connection * opt.connections};
+    res.latencies_ns.reserve(res.ops);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sock_addr addr("127.0.0.1:0", AF_INET);
+    socklen_t len = addr.len();
+
+    if (listen_fd == -1 || bind(listen_fd, addr.sockaddr(), addr.len()) == -1 ||
+        getsockname(listen_fd, addr.sockaddr(), &len) == -1 || listen(listen_fd, SOMAXCONN) == -1)
+    {
+        perror("tcp listener");
+        if (listen_fd != -1) { close(listen_fd); }
+        return res;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    auto echo = [&](int fd) -> io_task
+    {
+        char buf[msg_size];
+        while (true)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            if (co_await recv(loop, fd, buf, sizeof(buf), received) != io_result::done) { break; }
+            if (co_await send(loop, fd, buf, received, sent) != io_result::done) { break; }
+        }
+        close(fd);
+    };
+
+    auto acceptor = [&]() -> io_task
+    {
+        for (size_t i = 0; i < opt.connections; ++i)
+        {
+            int remote_fd = -1;
+            struct sock_addr remote;
+            if (co_await accept(loop, listen_fd, remote_fd, remote) != io_result::done) { break; }
+            socket_config{}.apply(remote_fd);
+            (void)loop.schedule(echo(remote_fd), "echo");
+        }
+    };
+
+    auto client = [&]() -> io_task
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (co_await connect(loop, fd, addr) != io_result::done)
+        {
+            close(fd);
+            co_return;
+        }
+
+        char buf[msg_size] = {};
+        size_t filled      = 0;
+        for (size_t i = 0; i < per_connection; ++i)
+        {
+            size_t sent = 0;
+            auto start  = clock_type::now();
+            if (co_await send(loop, fd, buf, sizeof(buf), sent) != io_result::done) { break; }
+
+            // TCP is free to split the reply
+            for (filled = 0; filled < sizeof(buf);)
+            {
+                ssize_t received = 0;
+                if (co_await recv(loop, fd, buf + filled, sizeof(buf) - filled, received) != io_result::done) { break; }
+                filled += received;
+            }
+            if (filled < sizeof(buf)) { break; }
+            res.latencies_ns.push_back(elapsed_ns(start));
+        }
+        close(fd);
+    };
+
+    measure(loop, res,
+            [&]()
+            {
+                (void)loop.schedule(acceptor(), "acceptor");
+                for (size_t i = 0; i < opt.connections; ++i) { (void)loop.schedule(client(), "client"); }
+            });
+
+    close(listen_fd);
+    return res;
+}
+
+result bench_mbox(const options &opt)
+{
+    result res{"mbox", opt.ops};
+    res.latencies_ns.reserve(opt.ops);
+
+    io_loop loop;
+    loop.init();
+
+    io_mbox<size_t> ping{loop};
+    io_mbox<size_t> pong{loop};
+
+    auto responder = [&]() -> io_task
+    {
+        for (size_t i = 0; i < opt.ops; ++i)
+        {
+            auto reader = ping.read();
+            auto msg    = co_await reader;
+            if (!msg) { break; }
+            pong.send(*msg);
+        }
+    };
+
+    auto requester = [&]() -> io_task
+    {
+        for (size_t i = 0; i < opt.ops; ++i)
+        {
+            auto start = clock_type::now();
+            ping.send(i);
+            auto reader = pong.read();
+            auto msg    = co_await reader;
+            if (!msg) { break; }
+            res.latencies_ns.push_back(elapsed_ns(start));
+        }
+    };
+
+    measure(loop, res,
+            [&]()
+            {
+                (void)loop.schedule(responder(), "responder");
+                (void)loop.schedule(requester(), "requester");
+            });
+    return res;
+}
+
+void print(const result &res)
+{
+    printf("%-12s %10zu ops %8.3fs %12.0f ops/s  p50 %8lld ns  p99 %8lld ns  p999 %8lld ns  %6.2f allocs/op\n",
+           res.name.c_str(), res.ops, res.seconds, res.ops / res.seconds, static_cast<long long>(res.percentile(0.50)),
+           static_cast<long long>(res.percentile(0.99)), static_cast<long long>(res.percentile(0.999)),
+           static_cast<double>(res.allocations) / res.ops);
+}
+
+nlohmann::json to_json(const result &res)
+{
+    return {
+        {"name", res.name},
+        {"ops", res.ops},
+        {"completed", res.latencies_ns.size()},
+        {"seconds", res.seconds},
+        {"ops_per_sec", res.ops / res.seconds},
+        {"allocs_per_op", static_cast<double>(res.allocations) / res.ops},
+        {"latency_ns",
+         {
+             {"p50", res.percentile(0.50)},
+             {"p99", res.percentile(0.99)},
+             {"p999", res.percentile(0.999)},
+             {"max", res.latencies_ns.empty() ? int64_t{0} : res.latencies_ns.back()},
+         }},
+    };
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opt;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto value      = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--ops") { opt.ops = strtoul(value(), nullptr, 10); }
+        else if (arg == "--timers") { opt.timers = strtoul(value(), nullptr, 10); }
+        else if (arg == "--connections") { opt.connections = strtoul(value(), nullptr, 10); }
+        else if (arg == "--json") { opt.json_file = value(); }
+        else { opt.only.push_back(arg); }
+    }
+
+    if (opt.ops == 0 || opt.timers == 0 || opt.connections == 0)
+    {
+        fprintf(stderr, "usage: %s [--ops N] [--timers N] [--connections N] [--json FILE] [benchmark ...]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<std::pair<std::string, std::function<result(const options &)>>> benchmarks = {
+        {"resume", bench_resume},         {"timers", bench_timers}, {"socketpair", bench_socketpair},
+        {"tcp_echo", bench_tcp_echo},     {"mbox", bench_mbox},
+    };
+
+    nlohmann::json report = {
+        {"config", {{"ops", opt.ops}, {"timers", opt.timers}, {"connections", opt.connections}, {"msg_size", msg_size}}},
+        {"benchmarks", nlohmann::json::array()},
+    };
+
+    for (const auto &[name, run] : benchmarks)
+    {
+        if (!opt.only.empty() && std::ranges::find(opt.only, name) == opt.only.end()) { continue; }
+
+        auto res = run(opt);
+        print(res);
+        report["benchmarks"].push_back(to_json(res));
+    }
+
+    if (opt.json_file.empty()) { printf("%s\n", report.dump(2).c_str()); }
+    else
+    {
+        std::ofstream out(opt.json_file);
+        out << report.dump(2) << '\n';
+        if (!out)
+        {
+            fprintf(stderr, "failed to write %s\n", opt.json_file.c_str());
+            return 1;
+        }
+    }
+
+    return 0;
+}
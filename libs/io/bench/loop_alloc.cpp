@@ -0,0 +1,90 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/ops.hpp>
+
+#include "alloc_counter.hpp"
+
+#include <sys/socket.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Counts heap allocations per request for a socketpair ping-pong running on the io_loop.
+ *
+ * The global operator new is replaced so every allocation made by the loop, the promises and the tasks is counted.
+ * The client waits on its recv and a sleep with io_wait_for_any so the parent waiter path is measured as well.
+ * The first requests warm up the loop's pool and vectors and are not counted.
+ */
+
+using namespace io;
+
+int main(int argc, char **argv)
+{
+    const size_t requests = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    constexpr size_t warmup   = 1000;
+    constexpr size_t msg_size = 64;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == -1)
+    {
+        perror("socketpair");
+        return 1;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    uint64_t allocations_before = 0;
+
+    auto server = [&]() -> io_task
+    {
+        char buf[msg_size];
+        for (size_t i = 0; i < warmup + requests; ++i)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            auto deadline    = loop.now() + std::chrono::seconds(1);
+
+            if (co_await recv(loop, fds[1], buf, sizeof(buf), received, 0, deadline) != io_result::done) { break; }
+            if (co_await send(loop, fds[1], buf, received, sent, 0, deadline) != io_result::done) { break; }
+        }
+    };
+
+    auto client = [&]() -> io_task
+    {
+        char buf[msg_size] = {};
+        for (size_t i = 0; i < warmup + requests; ++i)
+        {
+            if (i == warmup) { allocations_before = allocation_count(); }
+
+            ssize_t received = 0;
+            size_t sent      = 0;
+            auto deadline    = loop.now() + std::chrono::seconds(1);
+
+            if (co_await send(loop, fds[0], buf, sizeof(buf), sent, 0, deadline) != io_result::done) { break; }
+
+            auto reply = recv(loop, fds[0], buf, sizeof(buf), received, 0, deadline);
+            auto nap   = sleep(loop, std::chrono::seconds(1));
+            detail::io_wait_for_any_promise any{loop, deadline, {&reply, &nap}};
+            auto ready = co_await any;
+            if (ready.empty() || ready.front() != &reply) { break; }
+        }
+    };
+
+    (void)loop.schedule(server(), "server");
+    (void)loop.schedule(client(), "client");
+
+    loop.run();
+
+    auto counted = allocation_count() - allocations_before;
+
+    printf("requests:              %zu\n", requests);
+    printf("allocations:           %llu\n", static_cast<unsigned long long>(counted));
+    printf("allocations per request: %.3f\n", static_cast<double>(counted) / requests);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    return 0;
+}
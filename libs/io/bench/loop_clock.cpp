@@ -0,0 +1,96 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/ops.hpp>
+
+#include <dlfcn.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Counts clock reads per request for a socketpair ping-pong running on the io_loop.
+ *
+ * clock_gettime() is interposed so every steady_clock::now() made by the loop, the promises and the logging is
+ * counted, no matter where it comes from.
+ */
+
+static std::atomic<uint64_t> clock_reads{0};
+
+extern "C" int clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    using clock_gettime_t = int (*)(clockid_t, struct timespec *);
+    static auto real = reinterpret_cast<clock_gettime_t>(dlsym(RTLD_NEXT, "clock_gettime"));
+
+    clock_reads.fetch_add(1, std::memory_order_relaxed);
+    return real(clk, ts);
+}
+
+using namespace io;
+
+int main(int argc, char **argv)
+{
+    const size_t requests = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    constexpr size_t msg_size = 64;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == -1)
+    {
+        perror("socketpair");
+        return 1;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    auto server = [&]() -> io_task
+    {
+        char buf[msg_size];
+        for (size_t i = 0; i < requests; ++i)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            auto deadline    = loop.now() + std::chrono::seconds(1);
+
+            if (co_await recv(loop, fds[1], buf, sizeof(buf), received, 0, deadline) != io_result::done) { break; }
+            if (co_await send(loop, fds[1], buf, received, sent, 0, deadline) != io_result::done) { break; }
+        }
+    };
+
+    auto client = [&]() -> io_task
+    {
+        char buf[msg_size] = {};
+        for (size_t i = 0; i < requests; ++i)
+        {
+            ssize_t received = 0;
+            size_t sent      = 0;
+            auto deadline    = loop.now() + std::chrono::seconds(1);
+
+            if (co_await send(loop, fds[0], buf, sizeof(buf), sent, 0, deadline) != io_result::done) { break; }
+            if (co_await recv(loop, fds[0], buf, sizeof(buf), received, 0, deadline) != io_result::done) { break; }
+        }
+    };
+
+    (void)loop.schedule(server(), "server");
+    (void)loop.schedule(client(), "client");
+
+    auto start        = std::chrono::steady_clock::now();
+    auto reads_before = clock_reads.load();
+
+    loop.run();
+
+    auto reads   = clock_reads.load() - reads_before;
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("requests:          %zu\n", requests);
+    printf("clock reads:       %llu\n", static_cast<unsigned long long>(reads));
+    printf("reads per request: %.2f\n", static_cast<double>(reads) / requests);
+    printf("requests per sec:  %.0f\n", requests / elapsed);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    return 0;
+}
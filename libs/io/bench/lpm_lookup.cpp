@@ -0,0 +1,219 @@
+#include <net/network_range_set.hpp>
+#include <net/sockaddr.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Longest prefix match with network_range_set at 1k, 100k and 1M prefixes, against a linear scan of
+ * network_range::contains() where that finishes in reasonable time.
+ *
+ * IPv4 prefixes follow the shape of a routing table (mostly /24, then /17-/23, a few shorter and a few longer
+ * ones), IPv6 prefixes are /32-/64 below a few thousand /32 allocations, mostly /48. Half of the looked up
+ * addresses fall into one of the prefixes, the other half are random.
+ *
+ * usage: bench_lpm_lookup [--lookups N] [--linear-max N] [v4|v6 ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t lookups    = 2000000;
+    size_t linear_max = 100000; //!< largest table the linear scan runs on
+    std::vector<std::string> families;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+sock_addr v4_addr(uint32_t addr, uint8_t prefix = 0)
+{
+    struct sockaddr_in sin = {};
+    sin.sin_family         = AF_INET;
+    sin.sin_addr.s_addr    = htonl(addr);
+    return sock_addr(sin, prefix);
+}
+
+sock_addr v6_addr(const uint8_t *bytes, uint8_t prefix = 0)
+{
+    struct sockaddr_in6 sin6 = {};
+    sin6.sin6_family         = AF_INET6;
+    memcpy(sin6.sin6_addr.s6_addr, bytes, 16);
+    return sock_addr(sin6, prefix);
+}
+
+uint8_t v4_length(std::mt19937 &rng)
+{
+    unsigned pick = rng() % 100;
+    if (pick < 55) { return 24; }
+    if (pick < 85) { return static_cast<uint8_t>(17 + rng() % 7); }
+    if (pick < 95) { return static_cast<uint8_t>(8 + rng() % 9); }
+    return static_cast<uint8_t>(25 + rng() % 8);
+}
+
+uint8_t v6_length(std::mt19937 &rng)
+{
+    unsigned pick = rng() % 100;
+    if (pick < 60) { return 48; }
+    if (pick < 80) { return static_cast<uint8_t>(33 + rng() % 15); }
+    return static_cast<uint8_t>(49 + rng() % 16);
+}
+
+void make_v4(size_t count, std::mt19937 &rng, std::vector<network_range> &ranges, std::vector<sock_addr> &addrs,
+             size_t lookups)
+{
+    for (size_t i = 0; i < count; ++i) { ranges.emplace_back(v4_addr(rng(), v4_length(rng))); }
+
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        if (i % 2) { addrs.push_back(v4_addr(rng())); }
+        else
+        {
+            const auto &range = ranges[rng() % ranges.size()];
+            uint32_t base     = ntohl(reinterpret_cast<const sockaddr_in *>(range.network().sockaddr())->sin_addr.s_addr);
+            uint32_t host     = range.prefix() == 32 ? 0 : rng() & (0xffffffffu >> range.prefix());
+            addrs.push_back(v4_addr(base | host));
+        }
+    }
+}
+
+void make_v6(size_t count, std::mt19937 &rng, std::vector<network_range> &ranges, std::vector<sock_addr> &addrs,
+             size_t lookups)
+{
+    std::vector<std::array<uint8_t, 4>> allocations(std::max<size_t>(count / 250, 16));
+    for (auto &a : allocations)
+    {
+        uint32_t value = 0x20000000u | (rng() & 0x0fffffffu);
+        a              = {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)};
+    }
+
+    uint8_t bytes[16];
+    auto random_below = [&](const std::array<uint8_t, 4> &allocation)
+    {
+        memcpy(bytes, allocation.data(), 4);
+        for (int b = 4; b < 16; ++b) { bytes[b] = static_cast<uint8_t>(rng()); }
+    };
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        random_below(allocations[rng() % allocations.size()]);
+        ranges.emplace_back(v6_addr(bytes, v6_length(rng)));
+    }
+
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        if (i % 2)
+        {
+            for (auto &b : bytes) { b = static_cast<uint8_t>(rng()); }
+        }
+        else
+        {
+            const auto &range = ranges[rng() % ranges.size()];
+            memcpy(bytes, &reinterpret_cast<const sockaddr_in6 *>(range.network().sockaddr())->sin6_addr, 16);
+            for (int bit = range.prefix(); bit < 128; ++bit)
+            {
+                if (rng() & 1) { bytes[bit / 8] |= uint8_t(0x80 >> (bit % 8)); }
+            }
+        }
+        addrs.push_back(v6_addr(bytes));
+    }
+}
+
+bool run(const options &opts, const std::string &family, size_t count)
+{
+    std::mt19937 rng(static_cast<unsigned>(count));
+    std::vector<network_range> ranges;
+    std::vector<sock_addr> addrs;
+    ranges.reserve(count);
+    addrs.reserve(opts.lookups);
+
+    if (family == "v4") { make_v4(count, rng, ranges, addrs, opts.lookups); }
+    else { make_v6(count, rng, ranges, addrs, opts.lookups); }
+
+    auto build_start = clock_type::now();
+    network_range_set<> set(ranges);
+    auto build = seconds_since(build_start);
+
+    size_t matched    = 0;
+    auto lookup_start = clock_type::now();
+    for (const auto &addr : addrs) { matched += set.contains(addr); }
+    auto lookup = seconds_since(lookup_start);
+
+    printf("%s  prefixes: %8zu  unique: %8zu  build: %7.3fs  tables: %8.1f MiB  lookup: %7.1f ns  matched: %4.1f%%",
+           family.c_str(), count, set.size(), build, set.table_memory() / 1048576.0, lookup * 1e9 / addrs.size(),
+           100.0 * matched / addrs.size());
+
+    bool ok = true;
+    if (count <= opts.linear_max)
+    {
+        // enough lookups for a stable number, the scan is O(prefixes) per address
+        size_t sample   = std::max<size_t>(1000, 20000000 / count);
+        sample          = std::min(sample, addrs.size());
+        size_t agree    = 0;
+        auto scan_start = clock_type::now();
+        for (size_t i = 0; i < sample; ++i)
+        {
+            uint8_t best = 0;
+            bool found   = false;
+            for (const auto &range : ranges)
+            {
+                if (range.contains(addrs[i]) && (!found || range.prefix() > best))
+                {
+                    best  = range.prefix();
+                    found = true;
+                }
+            }
+            const auto *e = set.match(addrs[i]);
+            agree += found == (e != nullptr) && (!found || e->range.prefix() == best);
+        }
+        printf("  linear: %10.1f ns", seconds_since(scan_start) * 1e9 / sample);
+        ok = agree == sample;
+        if (!ok) { printf("  MISMATCH %zu of %zu", sample - agree, sample); }
+    }
+    printf("\n");
+
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--lookups" && i + 1 < argc) { opts.lookups = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--linear-max" && i + 1 < argc) { opts.linear_max = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "v4" || arg == "v6") { opts.families.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--lookups N] [--linear-max N] [v4|v6 ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.lookups == 0) { return 1; }
+    if (opts.families.empty()) { opts.families = {"v4", "v6"}; }
+
+    bool ok = true;
+    for (const auto &family : opts.families)
+    {
+        for (size_t count : {1000, 100000, 1000000}) { ok = run(opts, family, count) && ok; }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Sending responses made of several pieces over a loopback TCP connection: copied into one buffer and sent with
+ * io::send, gathered with io::sendv, or one io::send per piece.
+ *
+ * The shapes are a small HTTP response (header, JSON body, trailer), a 16 KiB body behind a header, and a batch of
+ * 32 small HTTP/2 style frames (9 byte frame header + payload each). A sink on the same loop discards the data with
+ * MSG_TRUNC, so the CPU time per response covers the sending side plus a constant cost for the sink.
+ *
+ * usage: bench_sendv [--responses N] [copy|sendv|separate ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t responses = 200000;
+    std::vector<std::string> modes;
+};
+
+struct shape
+{
+    const char *name;
+    std::vector<std::string> pieces;
+};
+
+bool tcp_pair(int &client_fd, int &server_fd)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sock_addr addr("127.0.0.1:0", AF_INET);
+    socklen_t len = addr.len();
+
+    bool ok = listen_fd != -1 && bind(listen_fd, addr.sockaddr(), addr.len()) == 0 &&
+              getsockname(listen_fd, addr.sockaddr(), &len) == 0 && listen(listen_fd, 1) == 0;
+
+    client_fd = ok ? socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+    ok        = ok && client_fd != -1 && connect(client_fd, addr.sockaddr(), addr.len()) == 0;
+    server_fd = ok ? accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) : -1;
+    ok        = ok && server_fd != -1 && fcntl(client_fd, F_SETFL, O_NONBLOCK) == 0;
+
+    // every send is its own segment, like a server that flushes each response
+    int one = 1;
+    ok      = ok && setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0;
+
+    if (listen_fd != -1) { close(listen_fd); }
+    return ok;
+}
+
+double cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+std::vector<shape> make_shapes()
+{
+    std::vector<shape> shapes;
+
+    shapes.push_back({"small", {std::string(180, 'h'), std::string(600, 'j'), "0\r\n\r\n"}});
+    shapes.push_back({"16k-body", {std::string(250, 'h'), std::string(16384, 'b'), "0\r\n\r\n"}});
+
+    shape frames{"32-frames", {}};
+    for (int i = 0; i < 32; ++i)
+    {
+        frames.pieces.push_back(std::string(9, 'f'));
+        frames.pieces.push_back(std::string(64 + (i * 37) % 200, 'd'));
+    }
+    shapes.push_back(std::move(frames));
+
+    return shapes;
+}
+
+/// @brief Sends all of @p data, however many calls that takes.
+io_func<bool> send_all(io_loop &loop, int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t sent = 0;
+        if (co_await send(loop, fd, data, len, sent) != io_result::done) { co_return false; }
+        data += sent;
+        len -= sent;
+    }
+    co_return true;
+}
+
+bool run(const options &opts, const shape &s, const std::string &mode)
+{
+    int sender_fd, sink_fd;
+    if (!tcp_pair(sender_fd, sink_fd))
+    {
+        perror("tcp pair");
+        return false;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    size_t response_size = 0;
+    std::vector<struct iovec> iov;
+    for (const auto &p : s.pieces)
+    {
+        iov.push_back({const_cast<char *>(p.data()), p.size()});
+        response_size += p.size();
+    }
+
+    size_t expected = response_size * opts.responses;
+    size_t consumed = 0;
+    size_t syscalls = 0;
+
+    auto sender = [&]() -> io_task
+    {
+        std::vector<char> buf(response_size);
+        for (size_t r = 0; r < opts.responses; ++r)
+        {
+            if (mode == "copy")
+            {
+                // what a server without gather writes does: assemble the response, then send it
+                char *out = buf.data();
+                for (const auto &p : s.pieces)
+                {
+                    memcpy(out, p.data(), p.size());
+                    out += p.size();
+                }
+                if (!co_await send_all(loop, sender_fd, buf.data(), buf.size())) { break; }
+                ++syscalls;
+            }
+            else if (mode == "sendv")
+            {
+                size_t sent = 0;
+                if (co_await sendv(loop, sender_fd, iov, sent) != io_result::done) { break; }
+                ++syscalls;
+            }
+            else
+            {
+                bool ok = true;
+                for (const auto &p : s.pieces)
+                {
+                    ok = ok && co_await send_all(loop, sender_fd, p.data(), p.size());
+                    ++syscalls;
+                }
+                if (!ok) { break; }
+            }
+        }
+        close(sender_fd);
+    };
+
+    auto sink = [&]() -> io_task
+    {
+        while (true)
+        {
+            ssize_t received = 0;
+            auto op          = recv(loop, sink_fd, nullptr, 1 << 20, received, MSG_TRUNC);
+            if (co_await op != io_result::done) { break; }
+            consumed += received;
+        }
+    };
+
+    (void)loop.schedule(sender(), "sender");
+    (void)loop.schedule(sink(), "sink");
+
+    auto cpu_start  = cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = cpu_seconds() - cpu_start;
+
+    close(sink_fd);
+
+    printf("%-10s %-9s  %6zu bytes x %2zu pieces  wall: %6.3fs  %8.0f responses/s  cpu: %6.2f us/response  "
+           "ops: %5.1f/response\n",
+           s.name, mode.c_str(), response_size, s.pieces.size(), wall, opts.responses / wall,
+           cpu * 1e6 / opts.responses, double(syscalls) / opts.responses);
+
+    return consumed == expected;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--responses" && i + 1 < argc) { opts.responses = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "copy" || arg == "sendv" || arg == "separate") { opts.modes.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--responses N] [copy|sendv|separate ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.responses == 0) { return 1; }
+    if (opts.modes.empty()) { opts.modes = {"copy", "sendv", "separate"}; }
+
+    bool ok = true;
+    for (const auto &s : make_shapes())
+    {
+        for (const auto &mode : opts.modes) { ok = run(opts, s, mode) && ok; }
+    }
+
+    return ok ? 0 : 1;
+}
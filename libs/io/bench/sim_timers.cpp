@@ -0,0 +1,58 @@
+#include <io/io.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * Timer scalability on the simulated poller.
+ *
+ * Built with IO_LOOP_POLLER=sim_poller, so the loop never sleeps: it jumps from one deadline to the next and the
+ * wall-clock time measured is the loop's own cost of keeping and firing the timers. Every timer gets its own
+ * deadline, one millisecond apart, the worst case for the loop's deadline handling.
+ *
+ * usage: bench_sim_timers [timers ...]
+ */
+
+using namespace io;
+
+static bool run_timers(size_t timers)
+{
+    io_loop loop;
+    loop.init();
+
+    size_t fired = 0;
+    auto start   = loop.now();
+
+    auto timer = [&](size_t i) -> io_task
+    {
+        auto nap = io::sleep(loop, std::chrono::milliseconds(i + 1));
+        if (co_await nap == io_result::timeout) { ++fired; }
+    };
+
+    for (size_t i = 0; i < timers; ++i) { (void)loop.schedule(timer(i), "timer"); }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    auto simulated = std::chrono::duration<double>(loop.now() - start).count();
+
+    printf("timers: %8zu  fired: %8zu  simulated: %10.1fs  wall: %8.3fs  per timer: %8.0fns\n", timers, fired,
+           simulated, wall, wall * 1e9 / timers);
+
+    return fired == timers;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) { sizes.push_back(strtoul(argv[i], nullptr, 10)); }
+    if (sizes.empty()) { sizes = {1000, 10000}; }
+
+    bool ok = true;
+    for (auto timers : sizes) { ok = run_timers(timers) && ok; }
+
+    return ok ? 0 : 1;
+}
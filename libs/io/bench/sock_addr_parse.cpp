@@ -0,0 +1,150 @@
+#include <net/sockaddr.hpp>
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Throughput of parsing numeric peer addresses the way config and ACL files list them.
+ *
+ * Parses a mix of "a.b.c.d:port", "a.b.c.d/len", "[v6]:port" and "[v6]/len" strings with sock_addr and, for
+ * reference, runs getaddrinfo(AI_NUMERICHOST | AI_NUMERICSERV) on the same host and port, which is what sock_addr
+ * used to do for every address.
+ *
+ * usage: bench_sock_addr_parse [--count N] [--rounds N]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t count = 100000;
+    int rounds   = 5;
+};
+
+struct sample
+{
+    std::string text; //!< what sock_addr parses
+    std::string host; //!< host part for getaddrinfo
+    std::string port; //!< port part for getaddrinfo, empty if none
+};
+
+std::vector<sample> make_samples(size_t count)
+{
+    std::mt19937 engine(42);
+    auto rng = [&engine]() { return static_cast<unsigned>(engine()); };
+
+    std::vector<sample> samples;
+    samples.reserve(count);
+
+    char buf[96];
+    for (size_t i = 0; i < count; ++i)
+    {
+        sample s;
+        unsigned port = 1024 + rng() % 60000;
+
+        if (i % 2 == 0)
+        {
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u", rng() % 256, rng() % 256, rng() % 256, rng() % 256);
+            s.host = buf;
+            s.text = s.host;
+            if (i % 4 == 0)
+            {
+                s.port = std::to_string(port);
+                s.text += ":" + s.port;
+            }
+            else { s.text += "/" + std::to_string(8 + rng() % 25); }
+        }
+        else
+        {
+            snprintf(buf, sizeof(buf), "2001:db8:%x:%x::%x:%x", rng() % 0x10000, rng() % 0x10000, rng() % 0x10000,
+                     rng() % 0x10000);
+            s.host = buf;
+            s.text = "[" + s.host + "]";
+            if (i % 4 == 1)
+            {
+                s.port = std::to_string(port);
+                s.text += ":" + s.port;
+            }
+            else { s.text += "/" + std::to_string(32 + rng() % 97); }
+        }
+
+        samples.push_back(std::move(s));
+    }
+
+    return samples;
+}
+
+template <typename F> double measure(const options &opts, const std::vector<sample> &samples, F &&parse)
+{
+    double best = 0;
+    for (int round = 0; round < opts.rounds; ++round)
+    {
+        size_t ok  = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto &s : samples) { ok += parse(s); }
+        auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (ok != samples.size())
+        {
+            fprintf(stderr, "only %zu of %zu addresses parsed\n", ok, samples.size());
+            exit(1);
+        }
+        best = std::max(best, samples.size() / secs);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) { opts.count = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--rounds" && i + 1 < argc) { opts.rounds = atoi(argv[++i]); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--count N] [--rounds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.count == 0 || opts.rounds <= 0) { return 1; }
+
+    auto samples = make_samples(opts.count);
+
+    auto parsed = measure(opts, samples, [](const sample &s) { return sock_addr(s.text).len() != 0; });
+
+    auto resolved = measure(opts, samples,
+                            [](const sample &s)
+                            {
+                                struct addrinfo hints = {}, *res = nullptr;
+                                hints.ai_socktype     = SOCK_STREAM;
+                                hints.ai_flags        = AI_NUMERICHOST | AI_NUMERICSERV;
+                                if (getaddrinfo(s.host.c_str(), s.port.empty() ? nullptr : s.port.c_str(), &hints, &res) != 0)
+                                {
+                                    return false;
+                                }
+                                freeaddrinfo(res);
+                                return true;
+                            });
+
+    printf("sock_addr:   %10.0f addresses/s  %7.1f ns/address\n", parsed, 1e9 / parsed);
+    printf("getaddrinfo: %10.0f addresses/s  %7.1f ns/address\n", resolved, 1e9 / resolved);
+    printf("speedup:     %10.1fx\n", parsed / resolved);
+
+    return 0;
+}
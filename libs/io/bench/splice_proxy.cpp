@@ -0,0 +1,181 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/ops.hpp>
+#include <net/splice.hpp>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * CPU cost of forwarding data between two loopback TCP connections, the hot path of a proxy.
+ *
+ * A producer streams data into the first connection, the proxy forwards it from the other end of that connection to
+ * a second connection and a sink discards it (MSG_TRUNC, no copy to user space). The proxy either copies through a
+ * user space buffer with recv/send or moves the data with io::splice. Everything runs on one loop in one thread, so
+ * the process CPU time (user + system) per GB covers the producer and the sink too, they cost the same in both modes.
+ *
+ * usage: bench_splice_proxy [--size MiB] [--chunk KiB] [copy|splice ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t size  = 2048ull << 20;
+    size_t chunk = 64 << 10;
+    std::vector<std::string> modes;
+};
+
+bool tcp_pair(int &client_fd, int &server_fd)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sock_addr addr("127.0.0.1:0", AF_INET);
+    socklen_t len = addr.len();
+
+    bool ok = listen_fd != -1 && bind(listen_fd, addr.sockaddr(), addr.len()) == 0 &&
+              getsockname(listen_fd, addr.sockaddr(), &len) == 0 && listen(listen_fd, 1) == 0;
+
+    client_fd = ok ? socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+    ok        = ok && client_fd != -1 && connect(client_fd, addr.sockaddr(), addr.len()) == 0;
+    server_fd = ok ? accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) : -1;
+    ok        = ok && server_fd != -1 && fcntl(client_fd, F_SETFL, O_NONBLOCK) == 0;
+
+    if (listen_fd != -1) { close(listen_fd); }
+    return ok;
+}
+
+double cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+bool run(const options &opts, const std::string &mode)
+{
+    int producer_fd, proxy_in_fd, proxy_out_fd, sink_fd;
+    if (!tcp_pair(producer_fd, proxy_in_fd) || !tcp_pair(proxy_out_fd, sink_fd))
+    {
+        perror("tcp pair");
+        return false;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    std::vector<char> payload(opts.chunk, 'x');
+    size_t produced  = 0;
+    size_t forwarded = 0;
+    size_t consumed  = 0;
+
+    auto producer = [&]() -> io_task
+    {
+        while (produced < opts.size)
+        {
+            size_t sent = 0;
+            auto op     = send(loop, producer_fd, payload.data(), std::min(payload.size(), opts.size - produced), sent);
+            if (co_await op != io_result::done) { break; }
+            produced += sent;
+        }
+        close(producer_fd);
+    };
+
+    auto copy_proxy = [&]() -> io_task
+    {
+        std::vector<char> buf(opts.chunk);
+        while (true)
+        {
+            ssize_t received = 0;
+            auto in          = recv(loop, proxy_in_fd, buf.data(), buf.size(), received);
+            if (co_await in != io_result::done) { break; }
+
+            for (size_t offset = 0; offset < static_cast<size_t>(received);)
+            {
+                size_t sent = 0;
+                auto out    = send(loop, proxy_out_fd, buf.data() + offset, received - offset, sent);
+                if (co_await out != io_result::done) { co_return; }
+                offset += sent;
+            }
+            forwarded += received;
+        }
+        close(proxy_out_fd);
+    };
+
+    auto splice_proxy = [&]() -> io_task
+    {
+        auto op = io::splice(loop, proxy_in_fd, proxy_out_fd, std::numeric_limits<size_t>::max(), forwarded);
+        (void)co_await op;
+        close(proxy_out_fd);
+    };
+
+    auto sink = [&]() -> io_task
+    {
+        while (true)
+        {
+            ssize_t received = 0;
+            auto op          = recv(loop, sink_fd, nullptr, 1 << 20, received, MSG_TRUNC);
+            if (co_await op != io_result::done) { break; }
+            consumed += received;
+        }
+    };
+
+    (void)loop.schedule(producer(), "producer");
+    (void)loop.schedule(mode == "splice" ? splice_proxy() : copy_proxy(), "proxy");
+    (void)loop.schedule(sink(), "sink");
+
+    auto cpu_start  = cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = cpu_seconds() - cpu_start;
+
+    close(proxy_in_fd);
+    close(sink_fd);
+
+    auto gb = consumed / 1e9;
+    printf("mode: %-7s  forwarded: %8.1f MiB  wall: %7.3fs  %6.2f GB/s  cpu: %7.3fs  %6.3f cpu-s/GB\n", mode.c_str(),
+           forwarded / 1048576.0, wall, gb / wall, cpu, cpu / gb);
+
+    return consumed == opts.size && forwarded == opts.size;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10) << 20; }
+        else if (arg == "--chunk" && i + 1 < argc) { opts.chunk = strtoull(argv[++i], nullptr, 10) << 10; }
+        else if (arg == "copy" || arg == "splice") { opts.modes.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--size MiB] [--chunk KiB] [copy|splice ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.chunk == 0) { return 1; }
+    if (opts.modes.empty()) { opts.modes = {"copy", "splice"}; }
+
+    bool ok = true;
+    for (const auto &mode : opts.modes) { ok = run(opts, mode) && ok; }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/tls.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Bulk TLS transfer over loopback on one loop: the client writes --size MB in --chunk KB writes, the server reads it.
+ *
+ * bio: OpenSSL on a BIO pair, the stream moves the records. socket: OpenSSL on the socket with kTLS enabled, the
+ * kernel does the record layer if it has the tls module, otherwise OpenSSL does. The handshake isn't timed.
+ *
+ * usage: bench_tls_throughput [--size MB] [--chunk KB] [bio|socket ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t size  = 256;
+    size_t chunk = 64;
+    std::vector<std::string> tests;
+};
+
+double process_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::pair<std::string, std::string> self_signed()
+{
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert    = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("bench"), -1, -1,
+                               0);
+    X509_set_issuer_name(cert, subject);
+    X509_sign(cert, key, EVP_sha256());
+
+    auto pem = [](auto write)
+    {
+        BIO *bio = BIO_new(BIO_s_mem());
+        write(bio);
+        char *data = nullptr;
+        long len   = BIO_get_mem_data(bio, &data);
+        std::string out(data, static_cast<size_t>(len));
+        BIO_free(bio);
+        return out;
+    };
+
+    auto cert_pem = pem([&](BIO *bio) { PEM_write_bio_X509(bio, cert); });
+    auto key_pem  = pem([&](BIO *bio) { PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr); });
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return {cert_pem, key_pem};
+}
+
+bool tcp_pair(int &client, int &server)
+{
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    if (bind(listener, addr.sockaddr(), addr.len()) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, addr.sockaddr(), &addr.len_ref()) != 0)
+    {
+        close(listener);
+        return false;
+    }
+
+    client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = ::connect(client, addr.sockaddr(), addr.len()) == 0;
+    server  = ok ? accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK) : -1;
+    close(listener);
+    return server != -1 && fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+bool run(const options &opts, const std::pair<std::string, std::string> &cert, bool ktls)
+{
+    tls_context server_ctx{tls_role::server};
+    tls_context client_ctx{tls_role::client};
+    if (server_ctx.use_certificate(cert.first, cert.second)) { return false; }
+    server_ctx.enable_ktls(ktls);
+    client_ctx.enable_ktls(ktls);
+
+    int client_fd = -1, server_fd = -1;
+    if (!tcp_pair(client_fd, server_fd)) { return false; }
+
+    io_loop loop;
+    loop.init();
+    tls_stream server{loop, server_ctx, server_fd};
+    tls_stream client{loop, client_ctx, client_fd};
+
+    size_t total = opts.size * 1024 * 1024, received = 0;
+    std::vector<char> out(opts.chunk * 1024, 'x');
+    std::chrono::steady_clock::time_point start, end;
+    double cpu_start = 0, cpu_end = 0;
+
+    auto reader = [&]() -> io_task
+    {
+        if (co_await server.handshake() != io_result::done) { co_return; }
+        std::vector<char> buf(64 * 1024);
+        while (received < total)
+        {
+            size_t len = 0;
+            if (co_await server.read(buf.data(), buf.size(), len) != io_result::done) { break; }
+            received += len;
+        }
+        end     = std::chrono::steady_clock::now();
+        cpu_end = process_cpu_seconds();
+    };
+
+    auto writer = [&]() -> io_task
+    {
+        if (co_await client.handshake() != io_result::done) { co_return; }
+        start     = std::chrono::steady_clock::now();
+        cpu_start = process_cpu_seconds();
+        for (size_t sent = 0; sent < total;)
+        {
+            size_t written = 0;
+            size_t len     = std::min(out.size(), total - sent);
+            if (co_await client.write(out.data(), len, written) != io_result::done) { break; }
+            sent += written;
+        }
+    };
+
+    (void)loop.schedule(reader(), "reader");
+    (void)loop.schedule(writer(), "writer");
+    loop.run();
+
+    auto wall = std::chrono::duration<double>(end - start).count();
+    printf("%-6s  chunk %4zu KB  %6zu MB  wall: %6.3fs  %8.1f MB/s  cpu: %6.3fs  kTLS send %d recv %d\n",
+           ktls ? "socket" : "bio", opts.chunk, received / (1024 * 1024), wall, received / wall / (1024 * 1024),
+           cpu_end - cpu_start, client.ktls_send(), server.ktls_recv());
+    return received == total;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--chunk" && i + 1 < argc) { opts.chunk = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "bio" || arg == "socket") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--size MB] [--chunk KB] [bio|socket ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.size == 0 || opts.chunk == 0) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"bio", "socket"}; }
+
+    auto cert = self_signed();
+    bool ok   = true;
+    for (const auto &test : opts.tests) { ok = run(opts, cert, test == "socket") && ok; }
+
+    return ok ? 0 : 1;
+}
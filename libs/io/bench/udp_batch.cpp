@@ -0,0 +1,249 @@
+#include <io/io.hpp>
+#include <net/datagram.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * Small UDP datagrams over loopback, one system call per datagram (recvfrom/sendto) against batches
+ * (recv_batch/send_batch with recvmmsg/sendmmsg).
+ *
+ * recv: the receiver queues a round of datagrams on its socket with sendmmsg() and then drains them, the time spent
+ * queuing is taken out, so the CPU time is what a receiver that always finds datagrams waiting spends per datagram,
+ * wall time includes the queuing. send: the loop sends to a socket nobody reads, the kernel drops what doesn't fit.
+ *
+ * usage: bench_udp_batch [--datagrams N] [--size BYTES] [--batch N] [recv|send ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t datagrams = 2000000;
+    size_t size      = 120;
+    size_t batch     = 64;
+    std::vector<std::string> tests;
+};
+
+/// @brief Datagrams queued on the receiving socket per round, few enough that none get dropped.
+constexpr size_t ROUND = 256;
+
+double thread_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int udp_socket(struct sock_addr &addr)
+{
+    addr   = sock_addr("127.0.0.1:0", AF_INET, SOCK_DGRAM);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1 || bind(fd, addr.sockaddr(), addr.len()) != 0 || getsockname(fd, addr.sockaddr(), &addr.len_ref()) != 0)
+    {
+        perror("udp socket");
+        exit(1);
+    }
+
+    // beyond net.core.rmem_max if we may
+    int size = 4 * 1024 * 1024;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    return fd;
+}
+
+void report(const char *test, const char *mode, const options &opts, size_t done, size_t syscalls, double cpu,
+            double wall)
+{
+    printf("%-4s %-6s  %4zu bytes  batch %3zu  %9zu datagrams  wall: %6.3fs  %9.0f datagrams/s  cpu: %6.3f us/datagram  "
+           "syscalls: %5.3f/datagram\n",
+           test, mode, opts.size, mode[0] == 'b' ? opts.batch : 1, done, wall, done / wall, cpu * 1e6 / done,
+           double(syscalls) / done);
+}
+
+/**
+ * @brief Queues @p count datagrams on the socket of @p to with sendmmsg().
+ */
+void refill(int fd, const struct sock_addr &to, const std::string &payload, size_t count)
+{
+    std::vector<struct iovec> iov(count, {const_cast<char *>(payload.data()), payload.size()});
+    std::vector<struct mmsghdr> msgs(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        msgs[i].msg_hdr.msg_iov     = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen  = 1;
+        msgs[i].msg_hdr.msg_name    = const_cast<struct sockaddr *>(to.sockaddr());
+        msgs[i].msg_hdr.msg_namelen = to.len();
+    }
+
+    for (size_t sent = 0; sent < count;)
+    {
+        int ret = sendmmsg(fd, msgs.data() + sent, static_cast<unsigned>(count - sent), 0);
+        if (ret > 0) { sent += static_cast<size_t>(ret); }
+    }
+}
+
+bool run_recv(const options &opts, bool batched)
+{
+    struct sock_addr in_addr, out_addr;
+    int in_fd  = udp_socket(in_addr);
+    int out_fd = udp_socket(out_addr);
+
+    io_loop loop;
+    loop.init();
+
+    std::string payload(opts.size, 'd');
+    size_t received   = 0;
+    size_t syscalls   = 0;
+    double refill_cpu = 0;
+    datagram_batch batch{opts.batch, 2048};
+
+    // the receiver queues a round of datagrams for itself, the time that takes doesn't count
+    auto receiver = [&]() -> io_task
+    {
+        std::vector<char> buf(2048);
+        struct sock_addr peer;
+        while (received < opts.datagrams)
+        {
+            auto round_end = std::min(received + ROUND, opts.datagrams);
+            auto start     = thread_cpu_seconds();
+            refill(out_fd, in_addr, payload, round_end - received);
+            refill_cpu += thread_cpu_seconds() - start;
+
+            while (received < round_end)
+            {
+                auto deadline = loop.now() + std::chrono::seconds(1);
+                if (batched)
+                {
+                    if (co_await recv_batch(loop, in_fd, batch, 0, deadline) != io_result::done) { co_return; }
+                    received += batch.size();
+                }
+                else
+                {
+                    ssize_t len = 0;
+                    auto op     = recvfrom(loop, in_fd, buf.data(), buf.size(), peer, len, 0, deadline);
+                    if (co_await op != io_result::done) { co_return; }
+                    ++received;
+                }
+                ++syscalls;
+            }
+        }
+    };
+
+    (void)loop.schedule(receiver(), "receiver");
+
+    auto cpu_start  = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = thread_cpu_seconds() - cpu_start - refill_cpu;
+
+    close(in_fd);
+    close(out_fd);
+
+    report("recv", batched ? "batch" : "single", opts, received, syscalls, cpu, wall);
+    return received == opts.datagrams;
+}
+
+bool run_send(const options &opts, bool batched)
+{
+    struct sock_addr sink_addr, out_addr;
+    int sink_fd = udp_socket(sink_addr);
+    int out_fd  = udp_socket(out_addr);
+
+    io_loop loop;
+    loop.init();
+
+    std::string payload(opts.size, 'd');
+    size_t done     = 0;
+    size_t syscalls = 0;
+    datagram_batch batch{opts.batch, std::max<size_t>(opts.size, 1)};
+
+    auto sender = [&]() -> io_task
+    {
+        while (done < opts.datagrams)
+        {
+            size_t sent = 0;
+            if (batched)
+            {
+                batch.clear();
+                while (done + batch.size() < opts.datagrams && batch.add(payload, sink_addr)) {}
+                if (co_await send_batch(loop, out_fd, batch, sent) != io_result::done) { break; }
+                syscalls += (sent + datagram_batch::MAX_BATCH - 1) / datagram_batch::MAX_BATCH;
+            }
+            else
+            {
+                if (co_await sendto(loop, out_fd, payload.data(), payload.size(), sink_addr, sent) != io_result::done)
+                {
+                    break;
+                }
+                sent = 1;
+                ++syscalls;
+            }
+            done += sent;
+        }
+    };
+
+    (void)loop.schedule(sender(), "sender");
+
+    auto cpu_start  = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = thread_cpu_seconds() - cpu_start;
+
+    close(sink_fd);
+    close(out_fd);
+
+    report("send", batched ? "batch" : "single", opts, done, syscalls, cpu, wall);
+    return done == opts.datagrams;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--datagrams" && i + 1 < argc) { opts.datagrams = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--batch" && i + 1 < argc) { opts.batch = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "recv" || arg == "send") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--datagrams N] [--size BYTES] [--batch N] [recv|send ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.datagrams == 0 || opts.size > 2048 || opts.batch == 0 || opts.batch > datagram_batch::MAX_BATCH) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"recv", "send"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests)
+    {
+        for (bool batched : {false, true})
+        {
+            ok = (test == "recv" ? run_recv(opts, batched) : run_send(opts, batched)) && ok;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
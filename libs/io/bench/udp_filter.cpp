@@ -0,0 +1,131 @@
+#include <io/io.hpp>
+#include <net/socket_filter.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * UDP receiver cost with and without a socket filter: the sender sends --count datagrams of --size bytes in bursts
+ * of --burst, of which --wanted percent start with the byte the receiver wants, the receiver drains the socket after
+ * each burst. Only the receiver's time is counted, the filter itself runs in the sender's send on loopback.
+ *
+ * none: everything is received and the unwanted datagrams are dropped after recv(). bpf: first_byte() drops them in
+ * the kernel.
+ *
+ * usage: bench_udp_filter [--count N] [--size B] [--burst N] [--wanted PERCENT] [none|bpf ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t count  = 1000000;
+    size_t size   = 200;
+    size_t burst  = 64;
+    size_t wanted = 10;
+    std::vector<std::string> tests;
+};
+
+double thread_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool run(const options &opts, bool filtered)
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int receiver = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sender   = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    int rcvbuf   = 8 * 1024 * 1024;
+    setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (filtered && attach_filter(receiver, socket_filter_builder{}.first_byte('w').build())) { return false; }
+    if (bind(receiver, addr.sockaddr(), addr.len()) != 0 ||
+        getsockname(receiver, addr.sockaddr(), &addr.len_ref()) != 0 ||
+        ::connect(sender, addr.sockaddr(), addr.len()) != 0)
+    {
+        return false;
+    }
+
+    std::string wanted(opts.size, 'w'), unwanted(opts.size, 'u');
+    std::vector<char> buf(65536);
+    size_t received = 0, kept = 0, syscalls = 0, expected = 0;
+    double cpu      = 0;
+    auto wall       = std::chrono::steady_clock::duration{};
+
+    for (size_t sent = 0; sent < opts.count;)
+    {
+        for (size_t i = 0; i < opts.burst && sent < opts.count; ++i, ++sent)
+        {
+            bool want = sent % 100 < opts.wanted;
+            expected += want;
+            const auto &payload = want ? wanted : unwanted;
+            (void)::send(sender, payload.data(), payload.size(), 0);
+        }
+
+        auto start     = std::chrono::steady_clock::now();
+        double started = thread_cpu_seconds();
+        while (true)
+        {
+            ++syscalls;
+            auto n = ::recv(receiver, buf.data(), buf.size(), 0);
+            if (n < 0) { break; }
+            ++received;
+            if (n > 0 && buf[0] == 'w') { ++kept; }
+        }
+        cpu += thread_cpu_seconds() - started;
+        wall += std::chrono::steady_clock::now() - start;
+    }
+
+    printf("%-4s  %zu datagrams, %zu%% wanted  received: %8zu  kept: %7zu  recv calls: %8zu  receiver wall: %6.3fs "
+           "cpu: %6.3fs\n",
+           filtered ? "bpf" : "none", opts.count, opts.wanted, received, kept, syscalls,
+           std::chrono::duration<double>(wall).count(), cpu);
+
+    close(sender);
+    close(receiver);
+    return kept == expected;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) { opts.count = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--burst" && i + 1 < argc) { opts.burst = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--wanted" && i + 1 < argc) { opts.wanted = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "none" || arg == "bpf") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--count N] [--size B] [--burst N] [--wanted PERCENT] [none|bpf ...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.count == 0 || opts.size == 0 || opts.burst == 0 || opts.wanted > 100) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"none", "bpf"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests) { ok = run(opts, test == "bpf") && ok; }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include <io/io.hpp>
+#include <net/datagram.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * Bulk UDP of equal-sized datagrams to one peer over loopback, with and without segmentation offload.
+ *
+ * send: the loop sends to a socket nobody reads with sendto, send_batch (sendmmsg) or send_segmented (UDP_SEGMENT),
+ * the kernel drops what doesn't fit. recv: the receiver queues a round of datagrams on its socket with
+ * send_segmented() and then drains them with recv_batch, with UDP_GRO on or off. The time spent queuing is taken out.
+ * The CPU time is that of the loop's thread, datagrams per CPU second is the rate one core would reach.
+ *
+ * usage: bench_udp_gso [--datagrams N] [--size BYTES] [send|recv ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t datagrams = 1000000;
+    size_t size      = 1200;
+    std::vector<std::string> tests;
+};
+
+constexpr size_t BATCH = 64;
+
+/// @brief Datagrams queued on the receiving socket per round, few enough that none get dropped.
+constexpr size_t ROUND = 512;
+
+double thread_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int udp_socket(struct sock_addr &addr)
+{
+    addr   = sock_addr("127.0.0.1:0", AF_INET, SOCK_DGRAM);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1 || bind(fd, addr.sockaddr(), addr.len()) != 0 || getsockname(fd, addr.sockaddr(), &addr.len_ref()) != 0)
+    {
+        perror("udp socket");
+        exit(1);
+    }
+
+    // beyond net.core.rmem_max if we may
+    int size = 8 * 1024 * 1024;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    return fd;
+}
+
+void report(const char *test, const char *mode, const options &opts, size_t done, size_t syscalls, double cpu,
+            double wall)
+{
+    printf("%-4s %-10s  %5zu bytes  %8zu datagrams  wall: %6.3fs  cpu: %6.3f us/datagram  %9.0f datagrams/cpu-s  "
+           "syscalls: %5.3f/datagram\n",
+           test, mode, opts.size, done, wall, cpu * 1e6 / done, done / cpu, double(syscalls) / done);
+}
+
+/// @brief Segment sends it takes for @p len bytes, as io::send_segmented splits them.
+size_t segmented_sends(size_t len, size_t segment)
+{
+    size_t per_send = segment * std::min(detail::io_send_segmented::MAX_SEGMENTS,
+                                         detail::io_send_segmented::MAX_SEND / segment);
+    return (len + per_send - 1) / per_send;
+}
+
+bool run_send(const options &opts, const std::string &mode)
+{
+    struct sock_addr sink_addr, out_addr;
+    int sink_fd = udp_socket(sink_addr);
+    int out_fd  = udp_socket(out_addr);
+
+    io_loop loop;
+    loop.init();
+
+    std::string payload(opts.size, 'd');
+    std::string bulk(opts.size * BATCH, 'd');
+    datagram_batch batch{BATCH, opts.size};
+    size_t done     = 0;
+    size_t syscalls = 0;
+
+    auto sender = [&]() -> io_task
+    {
+        while (done < opts.datagrams)
+        {
+            size_t count = std::min(BATCH, opts.datagrams - done);
+            size_t sent  = 0;
+            if (mode == "sendto")
+            {
+                auto op = sendto(loop, out_fd, payload.data(), payload.size(), sink_addr, sent);
+                if (co_await op != io_result::done) { break; }
+                count = 1;
+                ++syscalls;
+            }
+            else if (mode == "send_batch")
+            {
+                batch.clear();
+                for (size_t i = 0; i < count; ++i) { (void)batch.add(payload, sink_addr); }
+                if (co_await send_batch(loop, out_fd, batch, sent) != io_result::done) { break; }
+                ++syscalls;
+            }
+            else
+            {
+                auto len = count * opts.size;
+                auto op  = send_segmented(loop, out_fd, bulk.data(), len, opts.size, sink_addr, sent);
+                if (co_await op != io_result::done) { break; }
+                syscalls += segmented_sends(len, opts.size);
+            }
+            done += count;
+        }
+    };
+
+    (void)loop.schedule(sender(), "sender");
+
+    auto cpu_start  = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = thread_cpu_seconds() - cpu_start;
+
+    close(sink_fd);
+    close(out_fd);
+
+    report("send", mode.c_str(), opts, done, syscalls, cpu, wall);
+    return done == opts.datagrams;
+}
+
+/**
+ * @brief Queues @p count datagrams on the socket of @p to, in segmented sends.
+ */
+void refill(int fd, const struct sock_addr &to, const std::string &bulk, size_t size, size_t count)
+{
+    for (size_t sent = 0; sent < count;)
+    {
+        size_t n = std::min(count - sent, bulk.size() / size);
+
+        struct iovec iov  = {const_cast<char *>(bulk.data()), n * size};
+        struct msghdr msg = {};
+        msg.msg_iov       = &iov;
+        msg.msg_iovlen    = 1;
+        msg.msg_name      = const_cast<struct sockaddr *>(to.sockaddr());
+        msg.msg_namelen   = to.len();
+
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+        uint16_t segment   = static_cast<uint16_t>(size);
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        auto *cmsg         = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level   = SOL_UDP;
+        cmsg->cmsg_type    = UDP_SEGMENT;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+        if (sendmsg(fd, &msg, 0) > 0) { sent += n; }
+    }
+}
+
+bool run_recv(const options &opts, bool gro)
+{
+    struct sock_addr in_addr, out_addr;
+    int in_fd  = udp_socket(in_addr);
+    int out_fd = udp_socket(out_addr);
+    if (gro && enable_udp_gro(in_fd))
+    {
+        perror("UDP_GRO");
+        return false;
+    }
+
+    io_loop loop;
+    loop.init();
+
+    std::string bulk(opts.size * std::min(BATCH, detail::io_send_segmented::MAX_SEND / opts.size), 'd');
+    datagram_batch batch{16, gro ? size_t(65536) : size_t(2048)};
+    size_t received   = 0;
+    size_t syscalls   = 0;
+    double refill_cpu = 0;
+
+    auto receiver = [&]() -> io_task
+    {
+        while (received < opts.datagrams)
+        {
+            auto round_end = std::min(received + ROUND, opts.datagrams);
+            auto start     = thread_cpu_seconds();
+            refill(out_fd, in_addr, bulk, opts.size, round_end - received);
+            refill_cpu += thread_cpu_seconds() - start;
+
+            while (received < round_end)
+            {
+                auto deadline = loop.now() + std::chrono::seconds(1);
+                if (co_await recv_batch(loop, in_fd, batch, 0, deadline) != io_result::done) { co_return; }
+                for (size_t i = 0; i < batch.size(); ++i) { received += batch.segments(i); }
+                ++syscalls;
+            }
+        }
+    };
+
+    (void)loop.schedule(receiver(), "receiver");
+
+    auto cpu_start  = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = thread_cpu_seconds() - cpu_start - refill_cpu;
+
+    close(in_fd);
+    close(out_fd);
+
+    report("recv", gro ? "gro" : "no-gro", opts, received, syscalls, cpu, wall);
+    return received == opts.datagrams;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--datagrams" && i + 1 < argc) { opts.datagrams = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "send" || arg == "recv") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--datagrams N] [--size BYTES] [send|recv ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.datagrams == 0 || opts.size == 0 || opts.size > 2048) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"send", "recv"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests)
+    {
+        if (test == "send")
+        {
+            for (const char *mode : {"sendto", "send_batch", "segmented"}) { ok = run_send(opts, mode) && ok; }
+        }
+        else
+        {
+            for (bool gro : {false, true}) { ok = run_recv(opts, gro) && ok; }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/output_queue.hpp>
+#include <net/sockaddr.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ * Responses written in small pieces over loopback on one loop: --responses responses of --pieces writes of --size
+ * bytes each, the reader drains them.
+ *
+ * send: a send() per piece. queue: the pieces go into an output_queue that sends each response in one sendmsg()
+ * when the writer waits for the next request (here: the next loop turn). cork: the same with TCP_CORK.
+ *
+ * usage: bench_write_coalescing [--responses N] [--pieces N] [--size B] [send|queue|cork ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t responses = 100000;
+    size_t pieces    = 8;
+    size_t size      = 64;
+    std::vector<std::string> tests;
+};
+
+bool tcp_pair(int &client, int &server)
+{
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    if (bind(listener, addr.sockaddr(), addr.len()) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, addr.sockaddr(), &addr.len_ref()) != 0)
+    {
+        close(listener);
+        return false;
+    }
+
+    client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = ::connect(client, addr.sockaddr(), addr.len()) == 0;
+    server  = ok ? accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK) : -1;
+    close(listener);
+    return server != -1 && fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+bool run(const options &opts, const std::string &test)
+{
+    int writer_fd = -1, reader_fd = -1;
+    if (!tcp_pair(writer_fd, reader_fd)) { return false; }
+
+    io_loop loop;
+    loop.init();
+
+    output_queue_options queue_options;
+    queue_options.cork = test == "cork";
+    output_queue out{loop, writer_fd, queue_options};
+
+    std::string piece(opts.size, 'p');
+    size_t total = opts.responses * opts.pieces * opts.size, received = 0, syscalls = 0;
+
+    auto reader = [&]() -> io_task
+    {
+        std::vector<char> buf(256 * 1024);
+        while (received < total)
+        {
+            ssize_t n   = 0;
+            auto result = co_await recv(loop, reader_fd, buf.data(), buf.size(), n);
+            if (result != io_result::done || n <= 0) { break; }
+            received += static_cast<size_t>(n);
+        }
+    };
+
+    auto writer = [&]() -> io_task
+    {
+        for (size_t r = 0; r < opts.responses; ++r)
+        {
+            for (size_t p = 0; p < opts.pieces; ++p)
+            {
+                if (test == "send")
+                {
+                    size_t sent = 0;
+                    auto result = co_await send(loop, writer_fd, piece.data(), piece.size(), sent);
+                    if (result != io_result::done) { co_return; }
+                    ++syscalls;
+                    continue;
+                }
+                auto result = co_await out.write(piece);
+                if (result != io_result::done) { co_return; }
+            }
+            // waiting for the next request
+            (void)co_await io::yield(loop);
+        }
+        if (test != "send") { (void)co_await out.flush(); }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    (void)loop.schedule(reader(), "reader");
+    (void)loop.schedule(writer(), "writer");
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (test != "send") { syscalls = out.stats().sends; }
+    printf("%-5s  %zu x %zu B pieces  wall: %6.3fs  %9.0f responses/s  %9zu send syscalls\n", test.c_str(),
+           opts.pieces, opts.size, wall, opts.responses / wall, syscalls);
+
+    close(writer_fd);
+    close(reader_fd);
+    return received == total;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--responses" && i + 1 < argc) { opts.responses = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--pieces" && i + 1 < argc) { opts.pieces = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "--size" && i + 1 < argc) { opts.size = strtoull(argv[++i], nullptr, 10); }
+        else if (arg == "send" || arg == "queue" || arg == "cork") { opts.tests.push_back(arg); }
+        else
+        {
+            fprintf(stderr, "usage: %s [--responses N] [--pieces N] [--size B] [send|queue|cork ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.responses == 0 || opts.pieces == 0 || opts.size == 0) { return 1; }
+    if (opts.tests.empty()) { opts.tests = {"send", "queue", "cork"}; }
+
+    bool ok = true;
+    for (const auto &test : opts.tests) { ok = run(opts, test) && ok; }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+#include <net/zerocopy.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Bulk TCP over loopback from one io_buf per payload size, sent with zerocopy_sender with the threshold above the
+ * payload (copy) or the default one (MSG_ZEROCOPY). A thread drains the other end with blocking recv() calls. The CPU
+ * time is that of the sending loop's thread, so it includes waiting for and reaping completions but not the receiver.
+ *
+ * The payload is never changed, so the buffer is sent again while the kernel may still be sending it.
+ *
+ * On loopback the kernel copies a zero-copy send when it delivers it to the local socket, the completions report
+ * that as copied, so the numbers here show the cost of the page pinning and the completions rather than the saving a
+ * send to a network device would see.
+ *
+ * usage: bench_zerocopy [--bytes N] [PAYLOAD_SIZE ...]
+ */
+
+using namespace io;
+
+namespace
+{
+
+struct options
+{
+    size_t bytes = size_t(4) << 30;
+    std::vector<size_t> sizes;
+};
+
+double thread_cpu_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief Connects a TCP socket to a loopback listener, @p fds[0] is the sending end and non-blocking.
+bool tcp_pair(int fds[2])
+{
+    struct sock_addr addr("127.0.0.1:0", AF_INET, SOCK_STREAM);
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1 || bind(listener, addr.sockaddr(), addr.len()) != 0 ||
+        getsockname(listener, addr.sockaddr(), &addr.len_ref()) != 0 || listen(listener, 1) != 0)
+    {
+        perror("listen");
+        return false;
+    }
+
+    fds[0] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fds[0] == -1 || connect(fds[0], addr.sockaddr(), addr.len()) != 0)
+    {
+        perror("connect");
+        return false;
+    }
+    fds[1] = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    close(listener);
+
+    return fds[1] != -1 && fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) == 0;
+}
+
+bool run(const options &opts, size_t size, bool zerocopy)
+{
+    int fds[2] = {-1, -1};
+    if (!tcp_pair(fds)) { return false; }
+
+    size_t sends = (opts.bytes + size - 1) / size;
+    size_t total = sends * size;
+
+    std::thread receiver(
+        [&]()
+        {
+            std::vector<char> buf(1024 * 1024);
+            for (size_t received = 0; received < total;)
+            {
+                auto n = ::recv(fds[1], buf.data(), buf.size(), 0);
+                if (n <= 0) { break; }
+                received += static_cast<size_t>(n);
+            }
+        });
+
+    io_loop loop;
+    loop.init();
+
+    zerocopy_sender sender{loop, fds[0], zerocopy ? std::min(size, zerocopy_sender::DEFAULT_THRESHOLD) : size + 1};
+    io_buf payload{size};
+    payload.write(std::string(size, 'z'));
+
+    size_t sent_total = 0;
+    auto send_task    = [&]() -> io_task
+    {
+        for (size_t i = 0; i < sends; ++i)
+        {
+            payload.reset();
+            payload.advance_write_ptr(size);
+
+            size_t sent = 0;
+            if (co_await sender.send(payload, sent) != io_result::done) { break; }
+            sent_total += sent;
+        }
+    };
+
+    (void)loop.schedule(send_task(), "sender");
+
+    auto cpu_start  = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    loop.run();
+    auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    auto cpu  = thread_cpu_seconds() - cpu_start;
+
+    receiver.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    const auto &stats = sender.stats();
+    double gb         = sent_total / double(1 << 30);
+    printf("%-8s  %7zu bytes  %6.2f GB  wall: %6.3fs  %6.2f GB/s  cpu: %6.3f s/GB  sends: %zu copy %zu zero-copy "
+           "(%zu copied by the kernel)\n",
+           zerocopy ? "zerocopy" : "copy", size, gb, wall, gb / wall, cpu / gb, stats.copy_sends,
+           stats.zerocopy_sends, stats.copied);
+
+    if (zerocopy && !sender.enabled()) { printf("SO_ZEROCOPY not supported, all sends copied\n"); }
+    return sent_total == total && sender.pending() == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bytes" && i + 1 < argc) { opts.bytes = strtoull(argv[++i], nullptr, 10); }
+        else if (!arg.empty() && isdigit(static_cast<unsigned char>(arg[0])))
+        {
+            opts.sizes.push_back(strtoull(arg.c_str(), nullptr, 10));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--bytes N] [PAYLOAD_SIZE ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.sizes.empty()) { opts.sizes = {64 * 1024, 256 * 1024, 1024 * 1024}; }
+
+    bool ok = true;
+    for (size_t size : opts.sizes)
+    {
+        if (size == 0) { return 1; }
+        for (bool zerocopy : {false, true}) { ok = run(opts, size, zerocopy) && ok; }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -8,11 +8,22 @@ namespace detail
 {
 
 class epoll_poller;
+class sim_poller;
 template <typename poller_type> class io_loop_basic;
 
 } // namespace detail
 
-using io_loop = io::detail::io_loop_basic<io::detail::epoll_poller>;
+/**
+ * The poller behind io_loop. Everything built on the loop (promises, operations, mailboxes) uses io_loop, so a
+ * binary that wants to run all of it on the simulated poller defines IO_LOOP_POLLER=sim_poller for the whole
+ * translation unit. libio.so is built for the epoll_poller, such a binary doesn't link it and gets the definitions
+ * of the impl headers from io/io.hpp instead.
+ */
+#ifndef IO_LOOP_POLLER
+#define IO_LOOP_POLLER epoll_poller
+#endif
+
+using io_loop = io::detail::io_loop_basic<io::detail::IO_LOOP_POLLER>;
 
 using time_ticks_t = std::chrono::duration<int64_t, std::micro>;
 using time_point_t = std::chrono::time_point<std::chrono::steady_clock>;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <system_error>
+#include <vector>
+
+namespace io
+{
+
+/**
+ * @brief Pins the calling thread, typically one running an io_loop, to @p cpu.
+ */
+[[nodiscard]] inline std::error_code pin_thread(int cpu) noexcept
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) { return std::make_error_code(std::errc::invalid_argument); }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); error != 0)
+    {
+        return std::error_code(error, std::system_category());
+    }
+    return {};
+}
+
+/**
+ * @brief The CPU the calling thread runs on right now, -1 if unknown.
+ *
+ * Only stable for a pinned thread.
+ */
+[[nodiscard]] inline int current_cpu() noexcept { return sched_getcpu(); }
+
+/**
+ * @brief The CPUs the calling thread may run on, in ascending order.
+ */
+[[nodiscard]] inline std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) { return cpus; }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+    }
+    return cpus;
+}
+
+} // namespace io
@@ -25,6 +25,7 @@ public:
             case 1: return "Operation aborted";
             case 2: return "I/O descriptor closed";
             case 3: return "Operation timeout";
+            case 4: return "I/O loop shutting down";
             // Add more specific I/O error codes as needed
             default: return "Unknown I/O error";
         }
@@ -37,7 +38,8 @@ public:
 enum class io_errc {
     operation_aborted = 1,
     descriptor_closed = 2,
-    operation_timeout = 3
+    operation_timeout = 3,
+    loop_shutdown = 4
 };
 
 /**
@@ -70,6 +72,8 @@ inline std::error_code result_to_error(io_result result) {
             return make_error_code(io_errc::descriptor_closed);
         case io_result::cancelled:
             return make_error_code(io_errc::operation_aborted);
+        case io_result::shutdown:
+            return make_error_code(io_errc::loop_shutdown);
         case io_result::error:
             return system_error(); // Default to current system error
         default:
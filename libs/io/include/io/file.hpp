@@ -0,0 +1,5 @@
+#pragma once
+
+#include <io/io.hpp>
+#include <io/file_def.hpp>
+#include <io/impl/file.hpp>
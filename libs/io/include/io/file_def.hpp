@@ -0,0 +1,246 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/io_loop.hpp>
+#include <io/waiter.hpp>
+#include <io/iobuf.hpp>
+#include <io/file_descriptor.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace io
+{
+
+/**
+ * @brief How the file operations are carried out.
+ */
+enum class file_backend_type
+{
+    automatic,   //!< io_uring when the kernel allows it, otherwise the thread pool
+    uring,       //!< io_uring, falls back to the thread pool when it can't be set up
+    thread_pool, //!< blocking calls on a shared pool of I/O threads
+};
+
+[[nodiscard]] constexpr std::string_view to_string(file_backend_type type)
+{
+    switch (type)
+    {
+    case file_backend_type::automatic: return "automatic";
+    case file_backend_type::uring: return "uring";
+    case file_backend_type::thread_pool: return "thread_pool";
+    }
+
+    return "unknown";
+}
+
+class file;
+
+namespace detail
+{
+
+enum class file_op_type
+{
+    read,
+    write,
+    fsync,
+    fdatasync,
+};
+
+struct file_backend;
+
+/**
+ * @brief Awaitable for a single operation on a regular file.
+ *
+ * The operation is handed to the file's backend in await_ready() and completed by the backend on the loop's thread.
+ * It isn't registered with the loop: the file operations have no deadline and aren't cancelled by a shutdown, the
+ * kernel or an I/O thread may be using the buffer until the operation finishes. If the awaiting coroutine is
+ * destroyed while the operation is in flight, the destructor blocks until it finished.
+ */
+struct io_file_op : public io_promise
+{
+    io_file_op()                   = delete;
+    io_file_op(const io_file_op &) = delete;
+
+    io_file_op(io::file &file, file_op_type type, char *buffer, size_t size, off_t offset, size_t &bytes) noexcept;
+    io_file_op(io::file &file, file_op_type type, io_buf &buf, off_t offset, size_t &bytes) noexcept;
+    ~io_file_op() override;
+
+    [[nodiscard]] bool await_ready() noexcept override;
+    void await_suspend(std::coroutine_handle<> awaiting_coroutine) noexcept override;
+    [[nodiscard]] io_result await_resume() noexcept;
+
+    /**
+     * @brief Called by the backend with the outcome, bytes transferred or a negative errno.
+     */
+    void finish(int64_t result) noexcept;
+
+    file_backend *backend_;
+    file_op_type type_;
+    int fd_;
+    struct iovec iov_;
+    off_t offset_;
+    size_t &bytes_;
+    io_buf *buf_{nullptr}; //!< advanced when the operation completes
+    uint32_t slot_{0};
+    bool submitted_{false};
+    bool finished_{false};
+};
+
+/**
+ * @brief Carries out the file operations of one file.
+ *
+ * The backends signal completions through an eventfd. While operations are in flight the backend keeps a waiter for
+ * the eventfd in the loop, which also keeps run() from returning, and completes the finished operations from the
+ * waiter's callback.
+ *
+ * Operations are tracked in slots, a slot index is what travels through the kernel or the I/O threads, so an
+ * operation can go away without the backend ever touching a dangling pointer.
+ */
+struct file_backend
+{
+    explicit file_backend(io_loop &loop) noexcept;
+    virtual ~file_backend() = default;
+
+    file_backend(const file_backend &)            = delete;
+    file_backend &operator=(const file_backend &) = delete;
+
+    [[nodiscard]] virtual file_backend_type type() const noexcept = 0;
+
+    /**
+     * @brief Start the operation. On failure the operation is finished with the error before returning.
+     */
+    void submit(io_file_op &op) noexcept;
+
+    /**
+     * @brief Blocks until @p op finished, completing whatever else finishes in the meantime.
+     */
+    void wait(io_file_op &op) noexcept;
+
+    /**
+     * @brief Blocks until no operation is in flight.
+     */
+    void drain() noexcept;
+
+    [[nodiscard]] size_t in_flight() const noexcept { return in_flight_; }
+
+  protected:
+    [[nodiscard]] virtual bool start(io_file_op &op) noexcept = 0;
+    /**
+     * @brief Completes the finished operations, blocking until there is at least one if @p block is set.
+     */
+    virtual void reap(bool block) noexcept = 0;
+
+    bool init_event_fd() noexcept;
+    void finished(uint32_t slot, int64_t result) noexcept;
+
+    io_loop &loop_;
+    file_descriptor event_fd_;
+
+  private:
+    static void on_ready(io_result result, io_waiter *waiter);
+
+    io_waiter reaper_;
+    std::vector<io_file_op *> slots_;
+    std::vector<uint32_t> free_slots_;
+    size_t in_flight_{0};
+};
+
+} // namespace detail
+
+/**
+ * @brief A regular file with asynchronous positional reads and writes.
+ *
+ * epoll can't wait for regular files, they are always "ready" and the actual read blocks. The operations of an
+ * io::file run on io_uring, or on a shared pool of I/O threads when io_uring isn't available, and the awaiting
+ * coroutine is resumed by the loop once they finished.
+ *
+ * @code
+ * io::file f{loop};
+ * if (auto ec = f.open("/var/log/app.log", O_RDONLY)) { ... }
+ * f.advise(0, 0, POSIX_FADV_SEQUENTIAL);
+ *
+ * io_buf buf{64 * 1024};
+ * size_t bytes = 0;
+ * if (co_await f.read_at(buf, 0, bytes) == io_result::done) { ... }
+ * @endcode
+ *
+ * Reads return io_result::done with fewer bytes than asked for at the end of the file, and with 0 bytes past it.
+ * Failures return io_result::error with the errno in error(). The buffers have to stay valid until the operation
+ * finished, and destroying the file blocks until all of its operations finished.
+ */
+class file
+{
+  public:
+    explicit file(io_loop &loop, file_backend_type backend = file_backend_type::automatic);
+    ~file();
+
+    file(const file &)            = delete;
+    file &operator=(const file &) = delete;
+
+    /**
+     * @brief Opens @p path, O_CLOEXEC is always added to @p flags.
+     */
+    [[nodiscard]] std::error_code open(const std::string &path, int flags, mode_t mode = 0644) noexcept;
+
+    /**
+     * @brief Waits for the operations in flight and closes the file.
+     */
+    void close() noexcept;
+
+    [[nodiscard]] bool is_open() const noexcept { return fd_.get() != -1; }
+    [[nodiscard]] int fd() const noexcept { return fd_.get(); }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+    [[nodiscard]] file_backend_type backend() const noexcept { return backend_->type(); }
+    [[nodiscard]] size_t in_flight() const noexcept { return backend_->in_flight(); }
+
+    /**
+     * @brief Access pattern hint for the kernel, see posix_fadvise(). E.g. POSIX_FADV_SEQUENTIAL to get a larger
+     * readahead window or POSIX_FADV_WILLNEED to start reading a range in the background.
+     */
+    std::error_code advise(off_t offset, off_t len, int advice) noexcept;
+
+    /**
+     * @brief Reads up to @p size bytes at @p offset into @p buffer.
+     */
+    [[nodiscard]] detail::io_file_op read_at(char *buffer, size_t size, off_t offset, size_t &bytes_read) noexcept;
+
+    /**
+     * @brief Reads at @p offset straight into the writable space of @p buf and advances its write pointer.
+     */
+    [[nodiscard]] detail::io_file_op read_at(io_buf &buf, off_t offset, size_t &bytes_read) noexcept;
+
+    /**
+     * @brief Writes up to @p size bytes from @p buffer at @p offset.
+     */
+    [[nodiscard]] detail::io_file_op write_at(const char *buffer, size_t size, off_t offset,
+                                              size_t &bytes_written) noexcept;
+
+    /**
+     * @brief Writes the readable bytes of @p buf at @p offset and advances its read pointer.
+     */
+    [[nodiscard]] detail::io_file_op write_at(io_buf &buf, off_t offset, size_t &bytes_written) noexcept;
+
+    /**
+     * @brief Flushes the file to the storage device, only the data and the metadata needed to read it back when
+     * @p data_only is set (fdatasync).
+     */
+    [[nodiscard]] detail::io_file_op fsync(bool data_only = false) noexcept;
+
+  private:
+    friend struct detail::io_file_op;
+
+    io_loop &loop_;
+    detail::file_descriptor fd_;
+    std::unique_ptr<detail::file_backend> backend_;
+    size_t no_bytes_{0}; //!< byte count for the operations that don't transfer any
+};
+
+} // namespace io
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace io
+{
+
+/**
+ * @brief Open addressing hash map for large tables of small keys (connections, sessions, flows).
+ *
+ * Entries live in one array, inserts and lookups don't allocate per entry and a lookup touches the home slot of the
+ * key and the few that follow it. Collisions are resolved with linear probing in Robin Hood order: every slot keeps
+ * the distance of its entry from the entry's home slot, an insert takes the slot of any entry closer to home than
+ * itself. That keeps probe sequences short at high load and lets a lookup for a missing key stop as soon as it meets
+ * an entry closer to home than the key would be. Erase shifts the entries after it back by one, so there are no
+ * tombstones and a table with a lot of churn doesn't degrade.
+ *
+ * The table grows by doubling when it's 7/8 full. Entries move on growth and on erase of another entry: pointers
+ * and iterators stay valid only until the next insert or erase.
+ *
+ * The hash is mixed once more before taking the slot index, weak hashes such as the identity std::hash of integers
+ * work too. It still has to tell the keys apart: a probe sequence is at most 255 slots long, more keys than that with
+ * one hash value make the table grow until it runs out of memory.
+ *
+ * @code
+ * flat_map<uint64_t, session> sessions;
+ * auto [e, added] = sessions.try_emplace(id, ...);
+ * if (auto *s = sessions.find(id)) { ... }
+ * sessions.erase_if([&](auto &e) { return e.value.expired(now); });
+ * @endcode
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class flat_map
+{
+    union slot;
+
+  public:
+    /// @brief An entry of the map, the key must not be changed in place.
+    struct entry
+    {
+        Key key;
+        T value;
+    };
+
+    template <bool Const> class iterator_base
+    {
+      public:
+        using value_type        = entry;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = std::conditional_t<Const, const entry &, entry &>;
+        using pointer           = std::conditional_t<Const, const entry *, entry *>;
+        using iterator_category = std::forward_iterator_tag;
+
+        iterator_base() = default;
+
+        reference operator*() const noexcept { return slots_[index_].e; }
+        pointer operator->() const noexcept { return &slots_[index_].e; }
+
+        iterator_base &operator++() noexcept
+        {
+            ++index_;
+            skip();
+            return *this;
+        }
+
+        iterator_base operator++(int) noexcept
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+
+        bool operator==(const iterator_base &other) const noexcept { return index_ == other.index_; }
+
+      private:
+        friend class flat_map;
+
+        using slot_ptr = std::conditional_t<Const, const slot *, slot *>;
+
+        iterator_base(slot_ptr slots, const uint8_t *dist, size_t index, size_t capacity) noexcept
+        : slots_(slots), dist_(dist), index_(index), capacity_(capacity)
+        {
+            skip();
+        }
+
+        void skip() noexcept
+        {
+            while (index_ < capacity_ && dist_[index_] == 0) { ++index_; }
+        }
+
+        slot_ptr slots_      = nullptr;
+        const uint8_t *dist_ = nullptr;
+        size_t index_        = 0;
+        size_t capacity_     = 0;
+    };
+
+    using iterator       = iterator_base<false>;
+    using const_iterator = iterator_base<true>;
+
+    flat_map() = default;
+
+    explicit flat_map(size_t expected) { reserve(expected); }
+
+    flat_map(flat_map &&other) noexcept { swap(other); }
+
+    flat_map &operator=(flat_map &&other) noexcept
+    {
+        if (this != &other)
+        {
+            flat_map tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    flat_map(const flat_map &)            = delete;
+    flat_map &operator=(const flat_map &) = delete;
+
+    ~flat_map() { destroy_all(); }
+
+    /**
+     * @brief The entry with @p key, nullptr if there is none.
+     */
+    [[nodiscard]] entry *find(const Key &key) noexcept
+    {
+        size_t index = locate(key);
+        return index == NPOS ? nullptr : &slots_[index].e;
+    }
+
+    [[nodiscard]] const entry *find(const Key &key) const noexcept
+    {
+        size_t index = locate(key);
+        return index == NPOS ? nullptr : &slots_[index].e;
+    }
+
+    [[nodiscard]] bool contains(const Key &key) const noexcept { return locate(key) != NPOS; }
+
+    /**
+     * @brief Adds an entry for @p key with a value made from @p args, unless the map has one already.
+     * @return The entry for @p key and whether it was added.
+     */
+    template <typename... Args> std::pair<entry *, bool> try_emplace(const Key &key, Args &&...args)
+    {
+        if (size_ >= max_load_) { grow(); }
+
+        uint64_t h  = hash_(key);
+        size_t i    = home(h);
+        uint8_t d   = 1;
+        for (;; i = (i + 1) & mask_, ++d)
+        {
+            if (dist_[i] < d) { break; }
+            if (dist_[i] == d && eq_(slots_[i].e.key, key)) { return {&slots_[i].e, false}; }
+            if (d == MAX_DIST)
+            {
+                // only a very bad hash gets here
+                grow();
+                return try_emplace(key, std::forward<Args>(args)...);
+            }
+        }
+
+        return {place(i, d, entry{key, T(std::forward<Args>(args)...)}), true};
+    }
+
+    /**
+     * @brief Adds an entry for @p key, or replaces the value of the one the map has.
+     * @return The entry for @p key and whether it was added.
+     */
+    template <typename V> std::pair<entry *, bool> insert_or_assign(const Key &key, V &&value)
+    {
+        auto res = try_emplace(key, std::forward<V>(value));
+        if (!res.second) { res.first->value = std::forward<V>(value); }
+        return res;
+    }
+
+    /// @brief The value for @p key, a default constructed one is added if the map has none.
+    T &operator[](const Key &key) { return try_emplace(key).first->value; }
+
+    /**
+     * @brief Removes the entry for @p key.
+     * @return false if there was none.
+     */
+    bool erase(const Key &key) noexcept
+    {
+        size_t index = locate(key);
+        if (index == NPOS) { return false; }
+        remove(index);
+        return true;
+    }
+
+    /**
+     * @brief Removes every entry @p pred returns true for, the way to expire entries while walking the table.
+     * @return The number of removed entries.
+     */
+    template <typename Pred> size_t erase_if(Pred &&pred)
+    {
+        size_t removed = 0;
+        for (size_t i = 0; i < capacity_;)
+        {
+            // after a remove the slot holds the next entry of the probe sequence, look at it again
+            if (dist_[i] != 0 && pred(slots_[i].e))
+            {
+                remove(i);
+                ++removed;
+            }
+            else { ++i; }
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Makes room for @p count entries without growing.
+     */
+    void reserve(size_t count)
+    {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity - capacity / 8 < count) { capacity *= 2; }
+        if (capacity > capacity_) { rehash(capacity); }
+    }
+
+    void clear() noexcept
+    {
+        destroy_all();
+        size_ = 0;
+    }
+
+    void swap(flat_map &other) noexcept
+    {
+        std::swap(slots_, other.slots_);
+        std::swap(dist_, other.dist_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(mask_, other.mask_);
+        std::swap(shift_, other.shift_);
+        std::swap(size_, other.size_);
+        std::swap(max_load_, other.max_load_);
+        std::swap(hash_, other.hash_);
+        std::swap(eq_, other.eq_);
+    }
+
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+    [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] size_t capacity() const noexcept { return capacity_; }
+
+    /// @brief Memory held by the table, in bytes.
+    [[nodiscard]] size_t memory() const noexcept { return capacity_ * (sizeof(slot) + sizeof(uint8_t)); }
+
+    iterator begin() noexcept { return iterator(slots_.get(), dist_.get(), 0, capacity_); }
+    iterator end() noexcept { return iterator(slots_.get(), dist_.get(), capacity_, capacity_); }
+    const_iterator begin() const noexcept { return const_iterator(slots_.get(), dist_.get(), 0, capacity_); }
+    const_iterator end() const noexcept { return const_iterator(slots_.get(), dist_.get(), capacity_, capacity_); }
+
+  private:
+    union slot
+    {
+        slot() noexcept {}
+        ~slot() {}
+        entry e;
+    };
+
+    static constexpr size_t NPOS         = ~size_t(0);
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr uint8_t MAX_DIST    = 255;
+
+    /// @brief Slot an entry with hash @p h starts probing at, taken from the high bits of a Fibonacci multiply.
+    size_t home(uint64_t h) const noexcept { return static_cast<size_t>((h * 0x9e3779b97f4a7c15ull) >> shift_); }
+
+    size_t locate(const Key &key) const noexcept
+    {
+        if (size_ == 0) { return NPOS; }
+
+        size_t i  = home(hash_(key));
+        uint8_t d = 1;
+        for (;; i = (i + 1) & mask_, ++d)
+        {
+            // an entry closer to its home than the key would be means the key isn't there
+            if (dist_[i] < d) { return NPOS; }
+            if (dist_[i] == d && eq_(slots_[i].e.key, key)) { return i; }
+            if (d == MAX_DIST) { return NPOS; }
+        }
+    }
+
+    /**
+     * @brief Puts @p e, which isn't in the map, into slot @p i at distance @p d, moving richer entries along.
+     * @return Where @p e ended up.
+     */
+    entry *place(size_t i, uint8_t d, entry &&e)
+    {
+        entry *placed = nullptr;
+        entry carry(std::move(e));
+
+        for (;; i = (i + 1) & mask_, ++d)
+        {
+            if (dist_[i] == 0)
+            {
+                new (&slots_[i].e) entry(std::move(carry));
+                dist_[i] = d;
+                ++size_;
+                return placed ? placed : &slots_[i].e;
+            }
+
+            if (dist_[i] < d)
+            {
+                std::swap(carry, slots_[i].e);
+                std::swap(d, dist_[i]);
+                if (!placed) { placed = &slots_[i].e; }
+            }
+
+            if (d == MAX_DIST)
+            {
+                // the displaced entry can't go any further, grow and insert it again
+                Key key = placed ? placed->key : carry.key;
+                grow();
+                insert_unique(std::move(carry));
+                return &slots_[locate(key)].e;
+            }
+        }
+    }
+
+    void remove(size_t i) noexcept
+    {
+        slots_[i].e.~entry();
+        size_t next = (i + 1) & mask_;
+        while (dist_[next] > 1)
+        {
+            new (&slots_[i].e) entry(std::move(slots_[next].e));
+            slots_[next].e.~entry();
+            dist_[i] = dist_[next] - 1;
+            i        = next;
+            next     = (next + 1) & mask_;
+        }
+        dist_[i] = 0;
+        --size_;
+    }
+
+    void insert_unique(entry &&e)
+    {
+        size_t i = home(hash_(e.key));
+        uint8_t d = 1;
+        while (dist_[i] >= d)
+        {
+            i = (i + 1) & mask_;
+            ++d;
+        }
+        place(i, d, std::move(e));
+    }
+
+    void grow() { rehash(capacity_ ? capacity_ * 2 : MIN_CAPACITY); }
+
+    void rehash(size_t capacity)
+    {
+        auto old_slots    = std::move(slots_);
+        auto old_dist     = std::move(dist_);
+        size_t old_capacity = capacity_;
+
+        slots_    = std::make_unique<slot[]>(capacity);
+        dist_     = std::make_unique<uint8_t[]>(capacity);
+        capacity_ = capacity;
+        mask_     = capacity - 1;
+        shift_    = 64 - static_cast<unsigned>(__builtin_ctzll(capacity));
+        max_load_ = capacity - capacity / 8;
+        size_     = 0;
+
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old_dist[i] == 0) { continue; }
+            insert_unique(std::move(old_slots[i].e));
+            old_slots[i].e.~entry();
+        }
+    }
+
+    void destroy_all() noexcept
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            if (dist_[i] != 0)
+            {
+                slots_[i].e.~entry();
+                dist_[i] = 0;
+            }
+        }
+    }
+
+    std::unique_ptr<slot[]> slots_;
+    std::unique_ptr<uint8_t[]> dist_; //!< distance of each slot's entry from its home slot + 1, 0 for a free slot
+    size_t capacity_ = 0;
+    size_t mask_     = 0;
+    unsigned shift_  = 64;
+    size_t size_     = 0;
+    size_t max_load_ = 0;
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] KeyEqual eq_;
+};
+
+} // namespace io
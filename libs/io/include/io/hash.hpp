@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace io
+{
+
+namespace detail
+{
+
+/**
+ * Word at a time hashing for short fixed size keys (addresses, ports, connection tuples), in the style of wyhash:
+ * every step multiplies two 64 bit words to 128 bits and folds the halves, which mixes all input bits into all
+ * output bits in one multiply instead of a round per byte.
+ */
+inline constexpr uint64_t HASH_K0 = 0xa0761d6478bd642full;
+inline constexpr uint64_t HASH_K1 = 0xe7037ed1a0b428dbull;
+inline constexpr uint64_t HASH_K2 = 0x8ebc6af09c88c6e3ull;
+inline constexpr uint64_t HASH_K3 = 0x589965cc75374cc3ull;
+
+/// @brief 64x64 to 128 bit multiply, high and low half xor-ed together.
+inline uint64_t hash_mum(uint64_t a, uint64_t b) noexcept
+{
+    unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+/// @brief Hash of two words, @p seed separates keys of different kinds or lengths.
+inline uint64_t hash_words(uint64_t a, uint64_t b, uint64_t seed = 0) noexcept
+{
+    return hash_mum(hash_mum(a ^ HASH_K0, b ^ seed ^ HASH_K1) ^ HASH_K2, seed ^ HASH_K3);
+}
+
+inline uint64_t hash_load64(const void *p) noexcept
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t hash_load32(const void *p) noexcept
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// @brief Hash of @p len bytes at @p data, 16 bytes per step.
+inline uint64_t hash_bytes(const void *data, size_t len, uint64_t seed = 0) noexcept
+{
+    const auto *p = static_cast<const uint8_t *>(data);
+    uint64_t h    = seed ^ HASH_K0;
+    uint64_t a = 0, b = 0;
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            // two overlapping loads from each end cover 4 to 16 bytes
+            a = hash_load32(p) << 32 | hash_load32(p + ((len >> 3) << 2));
+            b = hash_load32(p + len - 4) << 32 | hash_load32(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0) { a = uint64_t(p[0]) << 16 | uint64_t(p[len >> 1]) << 8 | p[len - 1]; }
+    }
+    else
+    {
+        size_t left = len;
+        while (left > 16)
+        {
+            h = hash_mum(hash_load64(p) ^ HASH_K1, hash_load64(p + 8) ^ h);
+            p += 16;
+            left -= 16;
+        }
+        a = hash_load64(p + left - 16);
+        b = hash_load64(p + left - 8);
+    }
+
+    return hash_mum(HASH_K1 ^ len, hash_mum(a ^ HASH_K1, b ^ h));
+}
+
+} // namespace detail
+
+} // namespace io
@@ -6,7 +6,9 @@
 #include <unistd.h>
 #include <io/io_loop.hpp>
 #include <io/waiter.hpp>
+#include <algorithm>
 #include <array>
+#include <vector>
 
 namespace io
 {
@@ -35,13 +37,40 @@ struct epoll_poller
 
     void init() noexcept;
 
+    [[nodiscard]] time_point_t now() const noexcept { return time_now(); }
+
 private:
     bool _init();
 
+    /**
+     * @brief The waiters of one descriptor, which epoll only takes once.
+     *
+     * The descriptor is registered for what any of its waiters wants, an event is handed to each waiter it concerns.
+     */
+    struct registration
+    {
+        uint32_t events{0};
+        bool registered{false};
+        std::vector<io_waiter *> waiters;
+    };
+
+    /**
+     * @brief Updates the epoll registration of @p fd to what its waiters want.
+     *
+     * @p added re-registers even if that didn't change: the descriptor may have been closed and its number reused
+     * since, and epoll forgot the closed one.
+     */
+    void update(int fd, registration &reg, bool added);
+
+    /// @brief What an event with @p events means for @p waiter, io_result::waiting if it doesn't concern it.
+    [[nodiscard]] static io_result wake_result(const io_waiter *waiter, uint32_t events) noexcept;
+
 private:
     bool init_ = false;
     file_descriptor epoll_fd_;
     file_descriptor event_fd_;
+    std::vector<registration> registrations_; //!< indexed by descriptor
+    std::vector<io_waiter *> woken_;          //!< scratch, completions may add and remove waiters of the descriptor
 };
 
 void epoll_poller::init() noexcept
@@ -74,22 +103,28 @@ epoll_poller::~epoll_poller() = default;
         return poll_result::timeout;
     }
 
-    // Process events...
     for (int i = 0; i < num_events; ++i) {
-        if (auto *w = static_cast<io_waiter *>(events[i].data.ptr))
-        {
-            if (events[i].events & EPOLLIN) {
-                LOG(trace) << "EPOLLIN";
-                w->complete(io_result::done);
-            }
-            else if (events[i].events & EPOLLOUT) {
-                LOG(trace) << "EPOLLOUT";
-                w->complete(io_result::done);
-            }
-            else {
-                LOG(error) << "Unknown event: ";
-                w->complete(io_result::error);
+        int fd = events[i].data.fd;
+        if (fd == event_fd_.get()) {
+            uint64_t val;
+            [[maybe_unused]] auto drained = read(fd, &val, sizeof(val));
+            continue;
+        }
+        if (fd < 0 || static_cast<size_t>(fd) >= registrations_.size()) { continue; }
+
+        woken_.clear();
+        for (auto *w : registrations_[static_cast<size_t>(fd)].waiters) {
+            if (w->result() == io_result::waiting && wake_result(w, events[i].events) != io_result::waiting) {
+                woken_.push_back(w);
             }
+        }
+
+        LOG(trace) << "epoll events " << events[i].events << " on " << fd << " for " << woken_.size() << " waiters";
+        for (auto *w : woken_) {
+            // registrations_ may grow meanwhile, look it up again
+            const auto &waiters = registrations_[static_cast<size_t>(fd)].waiters;
+            if (std::ranges::find(waiters, w) == waiters.end()) { continue; }
+            w->complete(wake_result(w, events[i].events));
             ready_waiters.push_back(w);
         }
     }
@@ -97,6 +132,24 @@ epoll_poller::~epoll_poller() = default;
     return poll_result::success;
 }
 
+io_result epoll_poller::wake_result(const io_waiter *waiter, uint32_t events) noexcept
+{
+    uint32_t ready = 0;
+    switch (waiter->type())
+    {
+    case io_desc_type::read:
+    case io_desc_type::read_exclusive: ready = EPOLLIN; break;
+    case io_desc_type::write: ready = EPOLLOUT; break;
+    case io_desc_type::both: ready = EPOLLIN | EPOLLOUT; break;
+    // what an error waiter asked for, anyone else learns what it was from the next system call
+    case io_desc_type::error: return events & EPOLLERR ? io_result::done : io_result::waiting;
+    }
+
+    // an error condition wakes readers and writers too, the next system call reports it or finds nothing and the
+    // operation waits again, zero-copy completions on the error queue raise EPOLLERR for everybody
+    return events & (ready | EPOLLERR | EPOLLHUP) ? io_result::done : io_result::waiting;
+}
+
 void epoll_poller::add_waiter(io_waiter *waiter)
 {
     if (epoll_fd_.get() == -1)
@@ -110,15 +163,12 @@ void epoll_poller::add_waiter(io_waiter *waiter)
         return;
     }
 
-    struct epoll_event ev;
-    ev.events = EPOLLIN;
+    auto fd = static_cast<size_t>(waiter->fd());
+    if (fd >= registrations_.size()) { registrations_.resize(std::max(fd + 1, registrations_.size() * 2)); }
 
-    ev.data.ptr = waiter;
-    if (waiter->type() == io_desc_type::read) { ev.events = EPOLLIN; }
-    else if (waiter->type() == io_desc_type::write) { ev.events = EPOLLOUT; }
-    else if (waiter->type() == io_desc_type::both) { ev.events = EPOLLIN | EPOLLOUT; }
-
-    if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, waiter->fd(), &ev) == -1) { LOG(error) << "Failed to add waiter to epoll"; }
+    auto &reg = registrations_[fd];
+    reg.waiters.push_back(waiter);
+    update(waiter->fd(), reg, true);
 }
 
 void epoll_poller::remove_waiter(io_waiter *waiter)
@@ -129,12 +179,58 @@ void epoll_poller::remove_waiter(io_waiter *waiter)
         return;
     }
 
-    if (waiter->fd() == -1)
+    if (waiter->fd() == -1 || static_cast<size_t>(waiter->fd()) >= registrations_.size())
     {
         return;
     }
 
-    epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, waiter->fd(), nullptr);
+    auto &reg = registrations_[static_cast<size_t>(waiter->fd())];
+    auto it   = std::ranges::find(reg.waiters, waiter);
+    if (it == reg.waiters.end()) { return; }
+    reg.waiters.erase(it);
+    update(waiter->fd(), reg, false);
+}
+
+void epoll_poller::update(int fd, registration &reg, bool added)
+{
+    // EPOLLERR and EPOLLHUP are always reported, a descriptor with only error waiters is registered for nothing else
+    uint32_t events = 0;
+    for (const auto *w : reg.waiters)
+    {
+        if (w->type() == io_desc_type::read) { events |= EPOLLIN; }
+        else if (w->type() == io_desc_type::write) { events |= EPOLLOUT; }
+        else if (w->type() == io_desc_type::both) { events |= EPOLLIN | EPOLLOUT; }
+        else if (w->type() == io_desc_type::read_exclusive) { events |= EPOLLIN | EPOLLEXCLUSIVE; }
+    }
+
+    if (reg.waiters.empty())
+    {
+        // the descriptor may be closed already, which took it out of the epoll set
+        if (reg.registered) { epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr); }
+        reg = registration{0, false, std::move(reg.waiters)};
+        return;
+    }
+
+    if (reg.registered && events == reg.events && !added) { return; }
+
+    struct epoll_event ev = {};
+    ev.events  = events;
+    ev.data.fd = fd;
+
+    if (reg.registered)
+    {
+        // an exclusive registration can't be modified, and MOD fails with ENOENT once the descriptor was closed
+        if (!(reg.events & EPOLLEXCLUSIVE) && epoll_ctl(epoll_fd_.get(), EPOLL_CTL_MOD, fd, &ev) == 0)
+        {
+            reg.events = events;
+            return;
+        }
+        epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    reg.registered = epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd, &ev) == 0;
+    reg.events     = events;
+    if (!reg.registered) { LOG(error) << "Failed to add waiter to epoll"; }
 }
 
 bool epoll_poller::_init()
@@ -158,7 +254,7 @@ bool epoll_poller::_init()
             return false;
         }
 
-        struct epoll_event ev;
+        struct epoll_event ev = {};
         ev.events  = EPOLLIN;
         ev.data.fd = event_fd_.get();
 
@@ -0,0 +1,497 @@
+#pragma once
+
+#include <common/log.hpp>
+#include <io/file_def.hpp>
+#include <io/impl/uring.hpp>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace io
+{
+
+namespace detail
+{
+
+/**
+ * @brief Carries out one operation with the blocking system calls.
+ * @return Bytes transferred or -errno.
+ */
+inline int64_t file_op_execute(file_op_type type, int fd, const struct iovec &iov, off_t offset) noexcept
+{
+    ssize_t ret;
+    do {
+        switch (type)
+        {
+        case file_op_type::read: ret = ::pread(fd, iov.iov_base, iov.iov_len, offset); break;
+        case file_op_type::write: ret = ::pwrite(fd, iov.iov_base, iov.iov_len, offset); break;
+        case file_op_type::fsync: ret = ::fsync(fd); break;
+        case file_op_type::fdatasync: ret = ::fdatasync(fd); break;
+        default: errno = EINVAL; ret = -1; break;
+        }
+    } while (ret == -1 && errno == EINTR);
+
+    return ret == -1 ? -errno : ret;
+}
+
+/**
+ * @brief Backend that runs the operations on io_uring.
+ */
+struct uring_file_backend : public file_backend
+{
+    static constexpr unsigned RING_ENTRIES = 256;
+
+    explicit uring_file_backend(io_loop &loop) noexcept : file_backend{loop}
+    {
+        if (int err = ring_.init(RING_ENTRIES); err != 0)
+        {
+            LOG(info) << "io_uring not available: " << std::strerror(err);
+            return;
+        }
+
+        if (!init_event_fd()) { return; }
+
+        if (int err = ring_.register_eventfd(event_fd_.get()); err != 0)
+        {
+            LOG(warn) << "Failed to register eventfd with io_uring: " << std::strerror(err);
+            return;
+        }
+
+        ok_ = true;
+    }
+
+    [[nodiscard]] bool ok() const noexcept { return ok_; }
+    [[nodiscard]] file_backend_type type() const noexcept override { return file_backend_type::uring; }
+
+  protected:
+    bool start(io_file_op &op) noexcept override
+    {
+        io_uring_sqe *sqe = ring_.get_sqe();
+        if (!sqe)
+        {
+            // everything gets submitted right away, so the kernel still has to pick the previous entries up
+            ring_.submit();
+            if (!(sqe = ring_.get_sqe())) { return false; }
+        }
+
+        sqe->fd        = op.fd_;
+        sqe->user_data = op.slot_;
+
+        switch (op.type_)
+        {
+        case file_op_type::read:
+        case file_op_type::write:
+            sqe->opcode = op.type_ == file_op_type::read ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr   = reinterpret_cast<uint64_t>(&op.iov_);
+            sqe->len    = 1;
+            sqe->off    = static_cast<uint64_t>(op.offset_);
+            break;
+        case file_op_type::fsync:
+        case file_op_type::fdatasync:
+            sqe->opcode      = IORING_OP_FSYNC;
+            sqe->fsync_flags = op.type_ == file_op_type::fdatasync ? IORING_FSYNC_DATASYNC : 0;
+            break;
+        }
+
+        return ring_.submit() >= 0;
+    }
+
+    void reap(bool block) noexcept override
+    {
+        uint64_t count;
+        while (::read(event_fd_.get(), &count, sizeof(count)) > 0) {}
+
+        unsigned reaped = ring_.for_each_cqe([this](const io_uring_cqe &cqe)
+                                             { finished(static_cast<uint32_t>(cqe.user_data), cqe.res); });
+
+        if (block && reaped == 0)
+        {
+            ring_.wait();
+            ring_.for_each_cqe([this](const io_uring_cqe &cqe)
+                               { finished(static_cast<uint32_t>(cqe.user_data), cqe.res); });
+        }
+    }
+
+  private:
+    uring ring_;
+    bool ok_{false};
+};
+
+struct thread_pool_file_backend;
+
+/**
+ * @brief The I/O threads shared by all thread pool backends in the process.
+ */
+class file_thread_pool
+{
+  public:
+    static constexpr size_t THREADS = 4;
+
+    struct job
+    {
+        thread_pool_file_backend *owner;
+        uint32_t slot;
+        file_op_type type;
+        int fd;
+        struct iovec iov;
+        off_t offset;
+    };
+
+    static file_thread_pool &instance()
+    {
+        static file_thread_pool pool{THREADS};
+        return pool;
+    }
+
+    ~file_thread_pool()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto &t : threads_) { t.join(); }
+    }
+
+    void post(const job &j)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            jobs_.push_back(j);
+        }
+        cv_.notify_one();
+    }
+
+  private:
+    explicit file_thread_pool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i) { threads_.emplace_back([this]() { worker(); }); }
+    }
+
+    void worker();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<job> jobs_;
+    std::vector<std::thread> threads_;
+    bool stop_{false};
+};
+
+/**
+ * @brief Backend that runs the operations on the shared I/O threads.
+ */
+struct thread_pool_file_backend : public file_backend
+{
+    explicit thread_pool_file_backend(io_loop &loop) noexcept : file_backend{loop} { init_event_fd(); }
+
+    [[nodiscard]] file_backend_type type() const noexcept override { return file_backend_type::thread_pool; }
+
+    /**
+     * @brief Called on an I/O thread once an operation finished.
+     */
+    void complete(uint32_t slot, int64_t result) noexcept
+    {
+        // signal while holding the lock, once the loop's thread saw the completion the backend may go away
+        std::lock_guard lock{mutex_};
+        done_.push_back({slot, result});
+        cv_.notify_one();
+
+        uint64_t one = 1;
+        if (::write(event_fd_.get(), &one, sizeof(one)) == -1) { LOG(error) << "Failed to write to eventfd"; }
+    }
+
+  protected:
+    bool start(io_file_op &op) noexcept override
+    {
+        if (event_fd_.get() == -1) { return false; }
+
+        file_thread_pool::instance().post({this, op.slot_, op.type_, op.fd_, op.iov_, op.offset_});
+        return true;
+    }
+
+    void reap(bool block) noexcept override
+    {
+        // clear the eventfd first, a completion posted after the swap below signals it again
+        uint64_t count;
+        while (::read(event_fd_.get(), &count, sizeof(count)) > 0) {}
+
+        reaped_.clear();
+        {
+            std::unique_lock lock{mutex_};
+            if (block) { cv_.wait(lock, [this]() { return !done_.empty(); }); }
+            std::swap(done_, reaped_);
+        }
+
+        for (const auto &[slot, result] : reaped_) { finished(slot, result); }
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::pair<uint32_t, int64_t>> done_;
+    std::vector<std::pair<uint32_t, int64_t>> reaped_; //!< swapped with done_ by reap()
+};
+
+void file_thread_pool::worker()
+{
+    while (true)
+    {
+        job j;
+        {
+            std::unique_lock lock{mutex_};
+            cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty()) { return; }
+
+            j = jobs_.front();
+            jobs_.pop_front();
+        }
+
+        j.owner->complete(j.slot, file_op_execute(j.type, j.fd, j.iov, j.offset));
+    }
+}
+
+file_backend::file_backend(io_loop &loop) noexcept
+: loop_{loop},
+  reaper_{loop, &file_backend::on_ready, nullptr}
+{
+    reaper_.data_ = this;
+}
+
+bool file_backend::init_event_fd() noexcept
+{
+    event_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (event_fd_.get() == -1)
+    {
+        LOG(error) << "Failed to create eventfd";
+        return false;
+    }
+
+    reaper_.set_descriptor(event_fd_.get(), io_desc_type::read);
+    return true;
+}
+
+void file_backend::submit(io_file_op &op) noexcept
+{
+    uint32_t slot;
+    if (!free_slots_.empty())
+    {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.push_back(nullptr);
+    }
+
+    slots_[slot] = &op;
+    op.slot_     = slot;
+
+    if (!start(op))
+    {
+        slots_[slot] = nullptr;
+        free_slots_.push_back(slot);
+        op.finish(-EAGAIN);
+        return;
+    }
+
+    op.submitted_ = true;
+
+    // the reaper keeps the loop running while anything is in flight
+    if (in_flight_++ == 0)
+    {
+        reaper_.result_ = io_result::waiting;
+        reaper_.add();
+    }
+}
+
+void file_backend::finished(uint32_t slot, int64_t result) noexcept
+{
+    if (slot >= slots_.size())
+    {
+        LOG(error) << "Completion for unknown file operation slot " << slot;
+        return;
+    }
+
+    auto *op      = slots_[slot];
+    slots_[slot]  = nullptr;
+    free_slots_.push_back(slot);
+    --in_flight_;
+
+    if (op) { op->finish(result); }
+}
+
+void file_backend::wait(io_file_op &op) noexcept
+{
+    while (!op.finished_) { reap(true); }
+    if (in_flight_ == 0) { reaper_.remove(); }
+}
+
+void file_backend::drain() noexcept
+{
+    while (in_flight_ > 0) { reap(true); }
+    reaper_.remove();
+}
+
+void file_backend::on_ready(io_result result, io_waiter *waiter)
+{
+    auto *self = static_cast<file_backend *>(waiter->data_);
+
+    self->reap(false);
+
+    // stay armed while there is something in flight, a shutdown notice doesn't change that
+    if (self->in_flight_ > 0) { waiter->result_ = io_result::waiting; }
+    else { waiter->remove(); }
+}
+
+io_file_op::io_file_op(io::file &file, file_op_type type, char *buffer, size_t size, off_t offset,
+                       size_t &bytes) noexcept
+: io_promise{file.loop(), time_point_t::max()},
+  backend_{file.backend_.get()},
+  type_{type},
+  fd_{file.fd()},
+  iov_{buffer, size},
+  offset_{offset},
+  bytes_{bytes}
+{
+    bytes_ = 0;
+}
+
+io_file_op::io_file_op(io::file &file, file_op_type type, io_buf &buf, off_t offset, size_t &bytes) noexcept
+: io_file_op{file,
+             type,
+             type == file_op_type::read ? buf.write_ptr() : buf.read_ptr(),
+             type == file_op_type::read ? buf.writable() : buf.readable(),
+             offset,
+             bytes}
+{
+    buf_ = &buf;
+}
+
+io_file_op::~io_file_op()
+{
+    if (submitted_ && !finished_)
+    {
+        // the coroutine is going away, don't schedule it, but the buffer is in use until the operation finished
+        waiter_.awaiting_coroutine_ = nullptr;
+        backend_->wait(*this);
+    }
+}
+
+bool io_file_op::await_ready() noexcept
+{
+    // may be called more than once, e.g. by io_wait_for_any_promise, the operation only starts the first time
+    if (submitted_ || finished_) { return finished_; }
+
+    if (fd_ == -1)
+    {
+        finish(-EBADF);
+        return true;
+    }
+
+    backend_->submit(*this);
+    return finished_;
+}
+
+void io_file_op::await_suspend(std::coroutine_handle<> awaiting_coroutine) noexcept
+{
+    waiter_.awaiting_coroutine_ = awaiting_coroutine;
+}
+
+io_result io_file_op::await_resume() noexcept { return waiter_.result(); }
+
+void io_file_op::finish(int64_t result) noexcept
+{
+    finished_ = true;
+
+    if (result < 0)
+    {
+        waiter_.complete(io_result::error, std::error_code(static_cast<int>(-result), std::system_category()));
+        return;
+    }
+
+    bytes_ = static_cast<size_t>(result);
+    if (buf_)
+    {
+        if (type_ == file_op_type::read) { buf_->advance_write_ptr(bytes_); }
+        else if (type_ == file_op_type::write) { buf_->advance_read_ptr(bytes_); }
+    }
+
+    waiter_.complete(io_result::done);
+}
+
+} // namespace detail
+
+file::file(io_loop &loop, file_backend_type backend) : loop_{loop}
+{
+    if (backend != file_backend_type::thread_pool)
+    {
+        auto ring_backend = std::make_unique<detail::uring_file_backend>(loop);
+        if (ring_backend->ok()) { backend_ = std::move(ring_backend); }
+        else if (backend == file_backend_type::uring) { LOG(warn) << "io_uring requested, using the I/O threads"; }
+    }
+
+    if (!backend_) { backend_ = std::make_unique<detail::thread_pool_file_backend>(loop); }
+}
+
+file::~file() { close(); }
+
+std::error_code file::open(const std::string &path, int flags, mode_t mode) noexcept
+{
+    close();
+
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, mode);
+    if (fd == -1) { return std::error_code(errno, std::system_category()); }
+
+    fd_.reset(fd);
+    return {};
+}
+
+void file::close() noexcept
+{
+    backend_->drain();
+    fd_.reset();
+}
+
+std::error_code file::advise(off_t offset, off_t len, int advice) noexcept
+{
+    int err = posix_fadvise(fd_.get(), offset, len, advice);
+    return err == 0 ? std::error_code{} : std::error_code(err, std::system_category());
+}
+
+detail::io_file_op file::read_at(char *buffer, size_t size, off_t offset, size_t &bytes_read) noexcept
+{
+    return detail::io_file_op{*this, detail::file_op_type::read, buffer, size, offset, bytes_read};
+}
+
+detail::io_file_op file::read_at(io_buf &buf, off_t offset, size_t &bytes_read) noexcept
+{
+    return detail::io_file_op{*this, detail::file_op_type::read, buf, offset, bytes_read};
+}
+
+detail::io_file_op file::write_at(const char *buffer, size_t size, off_t offset, size_t &bytes_written) noexcept
+{
+    // the iovec isn't const, the buffer is only read from
+    return detail::io_file_op{
+        *this, detail::file_op_type::write, const_cast<char *>(buffer), size, offset, bytes_written};
+}
+
+detail::io_file_op file::write_at(io_buf &buf, off_t offset, size_t &bytes_written) noexcept
+{
+    return detail::io_file_op{*this, detail::file_op_type::write, buf, offset, bytes_written};
+}
+
+detail::io_file_op file::fsync(bool data_only) noexcept
+{
+    return detail::io_file_op{
+        *this, data_only ? detail::file_op_type::fdatasync : detail::file_op_type::fsync, nullptr, 0, 0, no_bytes_};
+}
+
+} // namespace io
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <ranges>
+#include <utility>
 
 #include <common/log.hpp>
 #include <io/io_loop.hpp>
@@ -26,24 +28,21 @@ bool io_loop_basic<poller_type>::schedule(std::coroutine_handle<> &coro)
 template <typename poller_type>
 bool io_loop_basic<poller_type>::schedule(io_task &&task, std::string id)
 {
-    auto handle = task.handle();
-    auto it = std::ranges::find_if(tasks_, [&handle](const auto &t) { return t.handle() == handle; });
-    bool found = (it != tasks_.end());
-
-    if (!found)
+    if (state_ == io_loop_state::shutting_down || state_ == io_loop_state::shutdown)
     {
-        task.set_task_id(id);
-        tasks_.emplace_back(std::move(task));
-        handle = tasks_.back().handle();
-
-        LOG(debug) << "Scheduled new task " << id << " with handle " << handle.address();
+        LOG(warn) << "io_loop is " << ::to_string(state_) << ", not accepting task " << id;
+        return false;
     }
 
-    // check if the task is already scheduled
-    for (auto it = scheduled_.begin(); it != scheduled_.end(); ++it)
-    {
-        if (*it == handle) { return false; }
-    }
+    auto handle = task.handle();
+    if (!handle) { return false; }
+
+    // the task is the only owner of its coroutine, so the loop can't have it already
+    handle.promise().finished_list_ = &finished_;
+    handle.promise().task_slot_     = tasks_.size();
+    task.set_task_id(id);
+    tasks_.emplace_back(std::move(task));
+    LOG(debug) << "Scheduled new task " << id << " with handle " << handle.address();
 
     scheduled_.emplace_back(handle);
 
@@ -54,8 +53,7 @@ template <typename poller_type>
 int io_loop_basic<poller_type>::step()
 {
     int count = 0;
-    std::vector<std::coroutine_handle<>> scheduled;
-    std::vector<std::coroutine_handle<>> finished;
+    auto &scheduled = scheduled_scratch_;
 
     // keep running tasks until there are no more scheduled tasks
     while(!scheduled_.empty())
@@ -66,56 +64,51 @@ int io_loop_basic<poller_type>::step()
         for (auto handle : scheduled)
         {
             if (!handle) continue;
-            
+
+            // Don't look at the handle after resuming it. A nested coroutine that runs to completion transfers to
+            // its parent, which is free to destroy the nested frame before resume() returns.
             if (!handle.done())
             {
                 handle.resume();
                 ++count;
-                
-                // Only mark as finished if done
-                if (handle.done()) {
-                    finished.emplace_back(handle);
-                }
-            }
-            else {
-                finished.emplace_back(handle);
             }
         }
     }
 
-    // Process finished tasks in order they completed
-    if (!finished.empty()) {
-        LOG(debug) << "Cleaning up " << finished.size() << " finished tasks";
-        
-        for (auto handle : finished) {
-            if (!handle) continue;
-            
-            // Find and remove from tasks_ vector if present
-            for (auto it = tasks_.begin(); it != tasks_.end(); ++it) {
-                if (it->handle() == handle) {
-                    LOG(debug) << "Destroying task " << it->task_id() 
-                              << " with handle " << handle.address();
-                    tasks_.erase(it);
-                    break;
-                }
-            }
+    // the tasks that finished put themselves on the list, the last task takes the place of each
+    size_t removed = 0;
+    while (finished_ != nullptr)
+    {
+        auto *promise = std::exchange(finished_, finished_->next_finished_);
+        size_t slot   = promise->task_slot_;
+        LOG(debug) << "Destroying task " << tasks_[slot].task_id() << " with handle "
+                   << tasks_[slot].handle().address();
+
+        if (slot + 1 != tasks_.size())
+        {
+            tasks_[slot] = std::move(tasks_.back());
+            tasks_[slot].handle().promise().task_slot_ = slot;
         }
+        tasks_.pop_back();
+        ++removed;
     }
+    if (removed > 0) { LOG(debug) << "Cleaned up " << removed << " finished tasks"; }
 
     return count;
 }
 
 template <typename poller_type>
 constexpr time_point_t io_loop_basic<poller_type>::next_timeout() const {
-    time_point_t next = time_point_t::max();
-    
-    for (const auto* waiter : waiters_) {
-        if (waiter->result_ == io_result::waiting && 
-            waiter->complete_by_ != time_point_t::max()) {
-            next = std::min(next, waiter->complete_by_);
-        }
+    time_point_t next = state_ == io_loop_state::shutting_down ? shutdown_deadline_ : time_point_t::max();
+
+    // the earliest deadline might belong to a waiter that completed meanwhile, that only wakes the poller early once
+    if (!deadlines_.empty()) { next = std::min(next, deadlines_.front().at); }
+
+    for (const auto *waiter : overdue_)
+    {
+        if (waiter->result_ == io_result::waiting) { next = std::min(next, waiter->complete_by_); }
     }
-    
+
     return next;
 }
 
@@ -126,7 +119,7 @@ constexpr time_ticks_t io_loop_basic<poller_type>::next_timeout_ticks() const
 
     if (next_to == time_point_t::max()) { return time_ticks_t::max(); }
 
-    auto duration = next_to - time_now();
+    auto duration = next_to - now_;
     
     // If timeout is in the past, return 0 (immediate timeout)
     if (duration.count() < 0) {
@@ -141,7 +134,7 @@ template <typename poller_type> void io_loop_basic<poller_type>::init() { poller
 template <typename poller_type>
 void io_loop_basic<poller_type>::run()
 {
-    std::vector<io_waiter *> ready_waiters;
+    auto &ready_waiters = ready_waiters_;
 
     if (state_ == io_loop_state::shutdown)
     {
@@ -150,22 +143,48 @@ void io_loop_basic<poller_type>::run()
     }
 
     poller_.init();
-    state_ = io_loop_state::running;
+    if (state_ != io_loop_state::shutting_down) { state_ = io_loop_state::running; }
+    now_precise();
 
     while (state_ == io_loop_state::running || state_ == io_loop_state::shutting_down)
     {
-        step();
+        // resumed coroutines may have run for a while, don't compute the poll timeout from a stale time
+        if (step() > 0) { now_precise(); }
         
         // Check if we're done - all tasks completed AND no more waiters
         if (tasks_.empty() && scheduled_.empty() && waiters_.empty())
         {
             LOG(debug) << "No tasks, scheduled, or waiters, stopping loop";
-            state_ = io_loop_state::stop;
+            state_ = state_ == io_loop_state::shutting_down ? io_loop_state::shutdown : io_loop_state::stop;
             break;
         }
-        
 
-        time_ticks_t timeout = next_timeout_ticks();
+        if (state_ == io_loop_state::shutting_down)
+        {
+            // waiters without a task have nobody left to drain them
+            if (tasks_.empty() && scheduled_.empty())
+            {
+                LOG(info) << "io_loop drained";
+                state_ = io_loop_state::shutdown;
+                break;
+            }
+
+            // same slack as the timeout sweep, the poller can't sleep for less than a millisecond
+            if (shutdown_deadline_ - now_ < std::chrono::milliseconds(1))
+            {
+                LOG(warn) << "io_loop shutdown deadline passed, cancelling " << tasks_.size() << " tasks";
+                state_ = io_loop_state::shutdown;
+
+                // tasks only get destroyed while suspended, give them a chance to react to the cancellation first
+                complete_waiting(io_result::cancelled);
+                process_ready_waiters(ready_waiters);
+                (void)step();
+                break;
+            }
+        }
+
+        // waiters completed by shutdown() are already waiting to be processed
+        time_ticks_t timeout = ready_waiters.empty() ? next_timeout_ticks() : time_ticks_t(0);
 
         if (timeout == time_ticks_t::max())
         {
@@ -175,23 +194,14 @@ void io_loop_basic<poller_type>::run()
         {
             LOG(debug) << "Next timeout: " << timeout.count() << "us";
         }
-        poller_.poll(timeout, ready_waiters);
-
-        // check for timeouts - handle immediate timeouts for all waiters that are past their deadline
-        auto now = time_now();
-        for (auto it = waiters_.begin(); it != waiters_.end(); ++it)
+        if (poller_.poll(timeout, ready_waiters) == poll_result::stalled)
         {
-            if ((*it)->result_ != io_result::waiting) { continue; }
-
-            // If waiter has a timeout and it's already passed or less than 1ms remains
-            if ((*it)->complete_by_ != time_point_t::max() && ((*it)->complete_by_ - now < std::chrono::milliseconds(1)))
-            {
-                (*it)->result_ = io_result::timeout;
-                ready_waiters.emplace_back(*it);
-                LOG(trace) << "waiter timeout";
-            }
+            LOG(error) << "io_loop stalled, " << tasks_.size() << " tasks wait for something that can never happen";
+            state_ = io_loop_state::stalled;
+            break;
         }
 
+        expire(now_precise(), ready_waiters);
         process_ready_waiters(ready_waiters);
     }
     
@@ -200,6 +210,7 @@ void io_loop_basic<poller_type>::run()
         LOG(debug) << "Cleaning up " << tasks_.size() << " remaining tasks";
         tasks_.clear();
     }
+    finished_ = nullptr;
 }
 
 template <typename poller_type> void io_loop_basic<poller_type>::stop()
@@ -207,6 +218,35 @@ template <typename poller_type> void io_loop_basic<poller_type>::stop()
     if (state_ == io_loop_state::running) { state_ = io_loop_state::stop; }
 }
 
+template <typename poller_type> void io_loop_basic<poller_type>::shutdown(time_point_t deadline)
+{
+    if (state_ == io_loop_state::shutdown) { return; }
+
+    if (state_ == io_loop_state::shutting_down)
+    {
+        shutdown_deadline_ = std::min(shutdown_deadline_, deadline);
+        return;
+    }
+
+    LOG(info) << "io_loop shutting down, " << tasks_.size() << " tasks in flight";
+    state_             = io_loop_state::shutting_down;
+    shutdown_deadline_ = deadline;
+
+    complete_waiting(io_result::shutdown);
+}
+
+template <typename poller_type> void io_loop_basic<poller_type>::complete_waiting(io_result result)
+{
+    // the completions are processed by run(), a waiter completed now might not have its coroutine set yet
+    for (auto *waiter : waiters_)
+    {
+        if (waiter->result_ != io_result::waiting) { continue; }
+
+        waiter->result_ = result;
+        ready_waiters_.emplace_back(waiter);
+    }
+}
+
 template <typename poller_type>
 poll_result io_loop_basic<poller_type>::poll(time_ticks_t timeout, std::vector<io_waiter *> &ready_waiters)
 {
@@ -215,7 +255,9 @@ poll_result io_loop_basic<poller_type>::poll(time_ticks_t timeout, std::vector<i
 
 template <typename poller_type> void io_loop_basic<poller_type>::add_waiter(io_waiter *waiter)
 {
+    waiter->loop_slot_ = waiters_.size();
     waiters_.emplace_back(waiter);
+    if (waiter->complete_by_ != time_point_t::max()) { push_deadline(waiter); }
     poller_.add_waiter(waiter);
 }
 
@@ -233,17 +275,122 @@ template <typename poller_type> void io_loop_basic<poller_type>::remove_waiter(i
         }
     }
 
-    // now remove the waiter from the list
-    for (auto it = waiters_.begin(); it != waiters_.end(); ++it)
+    // a waiter completed by shutdown() can go away before run() gets to it, don't shift the entries, the list may be
+    // in the middle of being processed
+    std::ranges::replace(ready_waiters_, waiter, nullptr);
+
+    erase_deadline(waiter);
+
+    // now remove the waiter from the list, the last one takes its place
+    size_t slot = std::exchange(waiter->loop_slot_, io_waiter::NO_SLOT);
+    if (slot >= waiters_.size() || waiters_[slot] != waiter) { return; }
+    waiters_[slot]             = waiters_.back();
+    waiters_[slot]->loop_slot_ = slot;
+    waiters_.pop_back();
+}
+
+template <typename poller_type> void io_loop_basic<poller_type>::update_deadline(io_waiter *waiter)
+{
+    erase_deadline(waiter);
+    if (waiter->complete_by_ != time_point_t::max()) { push_deadline(waiter); }
+}
+
+template <typename poller_type>
+void io_loop_basic<poller_type>::expire(time_point_t now, std::vector<io_waiter *> &ready_waiters)
+{
+    auto time_out = [&](io_waiter *waiter)
+    {
+        waiter->result_ = io_result::timeout;
+        ready_waiters.emplace_back(waiter);
+        LOG(trace) << "waiter timeout";
+    };
+
+    // back to waiting after their deadline passed, e.g. an operation that found nothing to do on a wakeup
+    std::erase_if(overdue_,
+                  [&](io_waiter *waiter)
+                  {
+                      if (waiter->result_ != io_result::waiting) { return false; }
+                      waiter->deadline_slot_ = io_waiter::NO_SLOT;
+                      time_out(waiter);
+                      return true;
+                  });
+
+    // the deadlines that passed or are less than 1ms away, the poller can't sleep for less
+    while (!deadlines_.empty() && deadlines_.front().at - now < std::chrono::milliseconds(1))
     {
-        if (*it == waiter)
+        auto *waiter = deadlines_.front().waiter;
+        erase_deadline(waiter);
+
+        if (waiter->result_ == io_result::waiting) { time_out(waiter); }
+        else
         {
-            waiters_.erase(it);
-            return;
+            waiter->deadline_slot_ = io_waiter::OVERDUE_SLOT;
+            overdue_.emplace_back(waiter);
         }
     }
 }
 
+template <typename poller_type> void io_loop_basic<poller_type>::push_deadline(io_waiter *waiter)
+{
+    deadlines_.push_back({waiter->complete_by_, deadline_order_++, waiter});
+    sift_up(deadlines_.size() - 1);
+}
+
+template <typename poller_type> void io_loop_basic<poller_type>::erase_deadline(io_waiter *waiter)
+{
+    size_t slot = std::exchange(waiter->deadline_slot_, io_waiter::NO_SLOT);
+    if (slot == io_waiter::OVERDUE_SLOT)
+    {
+        std::erase(overdue_, waiter);
+        return;
+    }
+    if (slot >= deadlines_.size() || deadlines_[slot].waiter != waiter) { return; }
+
+    auto last = deadlines_.back();
+    deadlines_.pop_back();
+    if (slot == deadlines_.size()) { return; }
+
+    // the last one takes the place, it can be earlier than the parent or later than the children
+    place(slot, last);
+    sift_up(slot);
+    sift_down(last.waiter->deadline_slot_);
+}
+
+template <typename poller_type> void io_loop_basic<poller_type>::sift_up(size_t slot) noexcept
+{
+    auto entry = deadlines_[slot];
+    while (slot > 0)
+    {
+        size_t parent = (slot - 1) / 2;
+        if (!(entry < deadlines_[parent])) { break; }
+        place(slot, deadlines_[parent]);
+        slot = parent;
+    }
+    place(slot, entry);
+}
+
+template <typename poller_type> void io_loop_basic<poller_type>::sift_down(size_t slot) noexcept
+{
+    auto entry = deadlines_[slot];
+    while (true)
+    {
+        size_t child = 2 * slot + 1;
+        if (child >= deadlines_.size()) { break; }
+        if (child + 1 < deadlines_.size() && deadlines_[child + 1] < deadlines_[child]) { ++child; }
+        if (!(deadlines_[child] < entry)) { break; }
+        place(slot, deadlines_[child]);
+        slot = child;
+    }
+    place(slot, entry);
+}
+
+template <typename poller_type>
+void io_loop_basic<poller_type>::place(size_t slot, const deadline &entry) noexcept
+{
+    deadlines_[slot]             = entry;
+    entry.waiter->deadline_slot_ = slot;
+}
+
 template <typename poller_type>
 bool io_loop_basic<poller_type>::process_ready_waiters(std::vector<io_waiter *> &ready_waiters)
 {
@@ -251,7 +398,7 @@ bool io_loop_basic<poller_type>::process_ready_waiters(std::vector<io_waiter *>
     {
         io_waiter *waiter = *it;
 
-        if (waiter->result() == io_result::waiting) { continue; }
+        if (!waiter || waiter->result() == io_result::waiting) { continue; }
         waiter->complete(waiter->result());
     }
 
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <io/io_loop.hpp>
+#include <io/waiter.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace io
+{
+
+namespace detail
+{
+
+/**
+ * @brief A poller that simulates time and I/O readiness instead of asking the kernel.
+ *
+ * The poller keeps a virtual clock. A poll that has nothing to deliver doesn't sleep, it moves the clock forward to
+ * the loop's next deadline or the next scripted event, whichever comes first. Timers therefore fire in the order and
+ * at the virtual times they would have with a real clock, without the wall-clock wait.
+ *
+ * Readiness comes from a script of events set up with ready_at(). An event makes a descriptor readable or writable
+ * at a virtual time and is consumed by the first poll that finds a waiter for it. Until then it stays pending, like
+ * a level triggered descriptor.
+ *
+ * A poll with neither a deadline nor a scripted event ahead returns poll_result::stalled, run() then stops with the
+ * loop in io_loop_state::stalled instead of waiting forever.
+ *
+ * Descriptors are only numbers to the poller, operations that do the actual I/O (recv, send, ...) still talk to the
+ * kernel. To run the loop on it, build with IO_LOOP_POLLER=sim_poller.
+ */
+struct sim_poller
+{
+    sim_poller() = default;
+    ~sim_poller() = default;
+
+    sim_poller(const sim_poller &) = delete;
+    sim_poller(sim_poller &&) = delete;
+
+    sim_poller &operator=(const sim_poller &) = delete;
+    sim_poller &operator=(sim_poller &&) = delete;
+
+    [[nodiscard]] poll_result poll(time_ticks_t timeout, std::vector<io_waiter *> &ready_waiters);
+    void add_waiter(class io_waiter *waiter);
+    void remove_waiter(class io_waiter *waiter);
+
+    void wake() noexcept {}
+
+    void init() noexcept {}
+
+    /**
+     * @brief The virtual time. Starts at the real time the poller was created.
+     */
+    [[nodiscard]] time_point_t now() const noexcept { return now_; }
+
+    /**
+     * @brief Moves the virtual clock forward.
+     * @param duration How far to move it.
+     */
+    void advance(time_ticks_t duration) noexcept { now_ += duration; }
+
+    /**
+     * @brief Script a readiness event.
+     * @param at The virtual time at which the descriptor becomes ready.
+     * @param fd The descriptor.
+     * @param type What the descriptor becomes ready for.
+     */
+    void ready_at(time_point_t at, int fd, io_desc_type type);
+
+    /**
+     * @brief Number of scripted events not delivered yet.
+     */
+    [[nodiscard]] size_t pending_events() const noexcept { return events_.size(); }
+
+private:
+    struct event
+    {
+        time_point_t at;
+        int fd;
+        io_desc_type type;
+    };
+
+    size_t deliver(std::vector<io_waiter *> &ready_waiters);
+
+private:
+    time_point_t now_ = time_now();
+    std::vector<event> events_;
+    std::vector<io_waiter *> desc_waiters_; //!< waiters with a descriptor, timers only need the loop's deadlines
+};
+
+void sim_poller::ready_at(time_point_t at, int fd, io_desc_type type)
+{
+    // keep the script sorted, events at the same time are delivered in the order they were added
+    auto it = std::ranges::upper_bound(events_, at, {}, &event::at);
+    events_.insert(it, event{at, fd, type});
+}
+
+size_t sim_poller::deliver(std::vector<io_waiter *> &ready_waiters)
+{
+    size_t delivered = 0;
+
+    for (auto it = events_.begin(); it != events_.end() && it->at <= now_;)
+    {
+        bool consumed = false;
+
+        for (auto *w : desc_waiters_)
+        {
+            if (w->fd() != it->fd || w->result() != io_result::waiting) { continue; }
+            if ((static_cast<int>(w->type()) & static_cast<int>(it->type)) == 0) { continue; }
+
+            w->complete(io_result::done);
+            ready_waiters.push_back(w);
+            consumed = true;
+            ++delivered;
+        }
+
+        it = consumed ? events_.erase(it) : it + 1;
+    }
+
+    return delivered;
+}
+
+[[nodiscard]] poll_result sim_poller::poll(time_ticks_t timeout, std::vector<io_waiter *> &ready_waiters)
+{
+    if (deliver(ready_waiters) > 0) { return poll_result::success; }
+
+    time_point_t until = timeout == time_ticks_t::max() ? time_point_t::max() : now_ + timeout;
+
+    // events that are due but have nobody waiting for them don't end the wait
+    for (const auto &ev : events_)
+    {
+        if (ev.at > now_)
+        {
+            until = std::min(until, ev.at);
+            break;
+        }
+    }
+
+    // no deadline and no scripted event, a real poller would sleep forever
+    if (until == time_point_t::max()) { return poll_result::stalled; }
+
+    now_ = std::max(now_, until);
+
+    return deliver(ready_waiters) > 0 ? poll_result::success : poll_result::timeout;
+}
+
+void sim_poller::add_waiter(io_waiter *waiter)
+{
+    if (waiter->fd() == -1) { return; }
+
+    desc_waiters_.push_back(waiter);
+}
+
+void sim_poller::remove_waiter(io_waiter *waiter)
+{
+    if (waiter->fd() == -1) { return; }
+
+    std::erase(desc_waiters_, waiter);
+}
+
+} // namespace detail
+} // namespace io
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <common/log.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace io
+{
+
+namespace detail
+{
+
+/**
+ * @brief A minimal io_uring, set up with the raw system calls so there is no dependency on liburing.
+ *
+ * Single producer and single consumer: only the thread that owns it submits and reaps.
+ */
+class uring
+{
+  public:
+    uring() = default;
+    ~uring();
+
+    uring(const uring &)            = delete;
+    uring &operator=(const uring &) = delete;
+
+    /**
+     * @brief Sets the ring up.
+     * @return 0 or the errno, ENOSYS or EPERM when the kernel doesn't allow io_uring.
+     */
+    [[nodiscard]] int init(unsigned entries) noexcept;
+
+    [[nodiscard]] unsigned sq_entries() const noexcept { return sq_entries_; }
+
+    /**
+     * @brief Next free submission entry, zeroed, or nullptr when the submission queue is full.
+     */
+    [[nodiscard]] io_uring_sqe *get_sqe() noexcept;
+
+    /**
+     * @brief Submits the entries queued since the last call.
+     * @return Number of entries submitted or -errno.
+     */
+    int submit() noexcept;
+
+    /**
+     * @brief Blocks until at least one completion is available.
+     */
+    int wait() noexcept;
+
+    /**
+     * @brief Calls @p fn with every available completion and consumes them.
+     */
+    template <typename fn_type> unsigned for_each_cqe(fn_type &&fn) noexcept
+    {
+        unsigned head  = *cq_head_;
+        unsigned tail  = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        unsigned count = 0;
+
+        for (; head != tail; ++head, ++count) { fn(cqes_[head & *cq_mask_]); }
+
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Makes the kernel signal @p fd whenever a completion is posted.
+     */
+    int register_eventfd(int fd) noexcept;
+
+  private:
+    int fd_{-1};
+
+    void *sq_ptr_{MAP_FAILED};
+    size_t sq_len_{0};
+    void *cq_ptr_{MAP_FAILED};
+    size_t cq_len_{0};
+    io_uring_sqe *sqes_{static_cast<io_uring_sqe *>(MAP_FAILED)};
+    size_t sqes_len_{0};
+
+    unsigned *sq_head_{nullptr};
+    unsigned *sq_tail_{nullptr};
+    unsigned *sq_mask_{nullptr};
+    unsigned *sq_array_{nullptr};
+    unsigned sq_entries_{0};
+    unsigned sq_pending_{0}; //!< queued with get_sqe() but not submitted yet
+
+    unsigned *cq_head_{nullptr};
+    unsigned *cq_tail_{nullptr};
+    unsigned *cq_mask_{nullptr};
+    io_uring_cqe *cqes_{nullptr};
+};
+
+uring::~uring()
+{
+    if (sqes_ != MAP_FAILED) { munmap(sqes_, sqes_len_); }
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) { munmap(cq_ptr_, cq_len_); }
+    if (sq_ptr_ != MAP_FAILED) { munmap(sq_ptr_, sq_len_); }
+    if (fd_ != -1) { ::close(fd_); }
+}
+
+int uring::init(unsigned entries) noexcept
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ == -1) { return errno; }
+
+    sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) { sq_len_ = cq_len_ = std::max(sq_len_, cq_len_); }
+
+    sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) { return errno; }
+
+    cq_ptr_ = single_mmap ? sq_ptr_
+                          : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                                 IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) { return errno; }
+
+    sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_     = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) { return errno; }
+
+    auto *sq = static_cast<char *>(sq_ptr_);
+    sq_head_    = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_    = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_    = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_   = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    auto *cq = static_cast<char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_    = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+io_uring_sqe *uring::get_sqe() noexcept
+{
+    unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+    unsigned tail = *sq_tail_ + sq_pending_;
+
+    if (tail - head >= sq_entries_) { return nullptr; }
+
+    unsigned idx   = tail & *sq_mask_;
+    sq_array_[idx] = idx;
+    ++sq_pending_;
+
+    memset(&sqes_[idx], 0, sizeof(io_uring_sqe));
+    return &sqes_[idx];
+}
+
+int uring::submit() noexcept
+{
+    if (sq_pending_ == 0) { return 0; }
+
+    unsigned to_submit = sq_pending_;
+    std::atomic_ref<unsigned>(*sq_tail_).store(*sq_tail_ + to_submit, std::memory_order_release);
+    sq_pending_ = 0;
+
+    int ret;
+    do {
+        ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit, 0, 0, nullptr, 0));
+    } while (ret == -1 && errno == EINTR);
+
+    return ret == -1 ? -errno : ret;
+}
+
+int uring::wait() noexcept
+{
+    int ret;
+    do {
+        ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+    } while (ret == -1 && errno == EINTR);
+
+    return ret == -1 ? -errno : ret;
+}
+
+int uring::register_eventfd(int fd) noexcept
+{
+    int ret = static_cast<int>(syscall(__NR_io_uring_register, fd_, IORING_REGISTER_EVENTFD, &fd, 1));
+    return ret == -1 ? errno : 0;
+}
+
+} // namespace detail
+} // namespace io
@@ -7,7 +7,9 @@
 namespace io {
 namespace detail {
 
-bool io_waiter::complete(io_result result, std::error_code ec) noexcept
+inline std::pmr::memory_resource *loop_memory_resource(io_loop &loop) noexcept { return loop.memory_resource(); }
+
+inline bool io_waiter::complete(io_result result, std::error_code ec) noexcept
 {
     // Only create error codes when absolutely necessary
     const bool is_error_result = (result != io_result::done && result != io_result::waiting);
@@ -30,6 +32,9 @@ bool io_waiter::complete(io_result result, std::error_code ec) noexcept
     // Execute callback if set
     if (callback_) { callback_(result, this); }
 
+    // the callback went back to waiting, e.g. a transfer that needs the descriptor to become ready again
+    if (result != io_result::waiting && result_ == io_result::waiting) { return false; }
+
     // Handle parent waiter
     if (awaiting_waiter_)
     {
@@ -83,7 +88,7 @@ bool io_waiter::complete(io_result result, std::error_code ec) noexcept
     return should_remove_from_loop;
 }
 
-void io_waiter::add(io_waiter *awaiting_waiter) noexcept
+inline void io_waiter::add(io_waiter *awaiting_waiter) noexcept
 {
     if (added_) {
         LOG(debug) << "Waiter " << this << " already added, skipping";
@@ -93,8 +98,6 @@ void io_waiter::add(io_waiter *awaiting_waiter) noexcept
     if (awaiting_waiter)
     {
         awaiting_waiter_ = awaiting_waiter;
-        // Reserve space to avoid reallocation
-        awaiting_waiter_->waiters_.reserve(awaiting_waiter_->waiters_.size() + 1);
         awaiting_waiter_->waiters_.push_back(this);
     }
 
@@ -102,7 +105,7 @@ void io_waiter::add(io_waiter *awaiting_waiter) noexcept
     added_ = true;
 }
 
-void io_waiter::remove() noexcept
+inline void io_waiter::remove() noexcept
 {
     if (!added_) {
         LOG(trace) << "Waiter " << this << " not added, skipping removal";
@@ -120,5 +123,40 @@ void io_waiter::remove() noexcept
     added_ = false;
 }
 
+inline void io_waiter::watch(int fd, io_desc_type type) noexcept
+{
+    if (fd == fd_ && type == type_) { return; }
+
+    if (added_) { loop_.remove_waiter(this); }
+    fd_   = fd;
+    type_ = type;
+    if (added_) { loop_.add_waiter(this); }
+}
+
+inline void io_waiter::set_deadline(time_point_t complete_by) noexcept
+{
+    complete_by_ = complete_by;
+    if (added_) { loop_.update_deadline(this); }
+}
+
+inline bool io_promise::timeout() noexcept
+{
+    if (waiter_.complete_by_ != time_point_t::max() && waiter_.complete_by_ < waiter_.loop().now())
+    {
+        waiter_.result_ = io_result::timeout;
+        error_ = make_error_code(io_errc::operation_timeout);
+        return true;
+    }
+    return false;
+}
+
 } // namespace detail
+
+inline detail::io_promise yield(io_loop &loop) { return detail::io_promise{loop, loop.now()}; }
+
+inline detail::io_promise sleep(io_loop &loop, std::chrono::milliseconds duration)
+{
+    return detail::io_promise{loop, loop.now() + duration};
+}
+
 } // namespace io
\ No newline at end of file
@@ -12,4 +12,5 @@
 #include <io/impl/iobuf_pack.hpp>
 #include <io/impl/io_loop.hpp>
 #include <io/impl/epoll_poller.hpp>
+#include <io/impl/sim_poller.hpp>
 #include <io/impl/waiter.hpp>
\ No newline at end of file
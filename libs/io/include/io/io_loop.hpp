@@ -1,6 +1,8 @@
 #pragma once
 
 #include <coroutine>
+#include <memory>
+#include <memory_resource>
 #include <io/common.hpp>
 #include <io/iotask.hpp>
 #include <io/file_descriptor.hpp>
@@ -16,6 +18,7 @@ enum class poll_result
     success,
     timeout,
     error,
+    stalled, //!< Nothing can ever become ready, only a simulated poller knows that.
 };
 
 // Forward declare io_waiter class which is defined in waiter.hpp
@@ -29,6 +32,8 @@ enum class io_loop_state
 
     shutting_down, //!< The loop is shutting down.
     shutdown,     //!< The loop has stopped and is shut down. It cannot be restarted.
+
+    stalled, //!< run() gave up, the tasks left wait for something that can never happen.
 };
 
 template <typename poller_type>
@@ -38,9 +43,16 @@ class io_loop_basic
     io_loop_basic() {
         tasks_.reserve(INITIAL_CAPACITY);
         scheduled_.reserve(INITIAL_CAPACITY);
+        scheduled_scratch_.reserve(INITIAL_CAPACITY);
         waiters_.reserve(INITIAL_CAPACITY);
+        ready_waiters_.reserve(INITIAL_CAPACITY);
+        deadlines_.reserve(INITIAL_CAPACITY);
+    }
+    ~io_loop_basic()
+    {
+        // the newest first, a service may use the ones that existed when it was created
+        while (!services_.empty()) { services_.pop_back(); }
     }
-    ~io_loop_basic() = default;
 
     io_loop_basic(const io_loop_basic &) = delete;
     io_loop_basic(io_loop_basic &&)      = delete;
@@ -52,6 +64,23 @@ class io_loop_basic
     void run();
     void stop();
 
+    /**
+     * @brief Drains the loop and shuts it down.
+     *
+     * New tasks are no longer accepted and every waiter that is currently waiting completes with
+     * io_result::shutdown, so the handlers can notice, flush what they have and finish. Operations started after the
+     * notice run normally. Once all tasks finished, or at the latest at @p deadline, run() returns and the loop is
+     * shut down for good. Waiters still pending at the deadline are cancelled and their tasks get one more chance to
+     * run before the remaining ones are destroyed.
+     *
+     * Can be called from a task running on the loop or before run(). Calling it again can only move the deadline
+     * closer.
+     * @param deadline The time by which the in-flight tasks have to finish.
+     */
+    void shutdown(time_point_t deadline);
+
+    [[nodiscard]] io_loop_state state() const noexcept { return state_; }
+
     /**
      * @brief Schedule a generic coroutine to run.
      */
@@ -70,10 +99,71 @@ class io_loop_basic
      */
     [[nodiscard]] constexpr time_ticks_t next_timeout_ticks() const;
 
+    /**
+     * @brief Returns the loop's cached notion of the current time.
+     *
+     * While the loop is running the clock is sampled when it starts, after every poll and after a step that resumed
+     * coroutines. Deadline and timeout checks on hot paths should use this instead of reading the clock. Outside of
+     * run() there is nothing sampling the clock, so it is read directly.
+     * @return time_point_t The cached time.
+     */
+    [[nodiscard]] time_point_t now() noexcept
+    {
+        if (state_ == io_loop_state::running || state_ == io_loop_state::shutting_down) { return now_; }
+        return now_precise();
+    }
+
+    /**
+     * @brief Reads the clock, refreshing the cached time.
+     *
+     * The clock belongs to the poller, a simulated poller keeps a virtual clock.
+     * @return time_point_t The current time.
+     */
+    time_point_t now_precise() noexcept { return now_ = poller_.now(); }
+
+    /**
+     * @brief The poller driving the loop, e.g. to script events on a simulated poller.
+     */
+    [[nodiscard]] poller_type &poller() noexcept { return poller_; }
+
     poll_result poll(time_ticks_t timeout, std::vector<io_waiter *> &ready_waiters);
     void add_waiter(io_waiter *waiter);
     void remove_waiter(io_waiter *waiter);
 
+    /**
+     * @brief Takes the new complete_by_ of an added waiter into account, see io_waiter::set_deadline().
+     */
+    void update_deadline(io_waiter *waiter);
+
+    /**
+     * @brief Memory resource owned by the loop.
+     *
+     * A pool resource for the loop's internals and for user containers that opt in, e.g.
+     * `std::pmr::vector<int> v{loop.memory_resource()}`. Freed blocks go back to the pool, so containers that are
+     * created and destroyed over and over stop hitting malloc once the pool has warmed up. Not thread-safe, only use
+     * it from the loop's thread, and containers using it must not outlive the loop.
+     * @return std::pmr::memory_resource* The loop's memory resource.
+     */
+    [[nodiscard]] std::pmr::memory_resource *memory_resource() noexcept { return &pool_; }
+
+    /**
+     * @brief The loop's instance of @p T, created from @p args on first use and destroyed with the loop.
+     *
+     * For the per-loop singletons of higher layers, e.g. dns_resolver::instance(). They go before the loop's own
+     * state, so they can still remove their waiters.
+     */
+    template <typename T, typename... Args> T &service(Args &&...args)
+    {
+        for (auto &s : services_)
+        {
+            if (s.key == &service_key<T>) { return *static_cast<T *>(s.object.get()); }
+        }
+
+        auto object = std::make_shared<T>(std::forward<Args>(args)...);
+        services_.push_back(service_entry{&service_key<T>, object});
+        return *object;
+    }
+
     /**
      * @brief Get the number of active waiters in the loop.
      * @return The number of active waiters.
@@ -85,14 +175,55 @@ class io_loop_basic
   private:
     [[nodiscard]] int step();
     bool process_ready_waiters(std::vector<io_waiter *> &ready_waiters);
+    void complete_waiting(io_result result);
+    void expire(time_point_t now, std::vector<io_waiter *> &ready_waiters);
+
+    /// @brief An entry of the deadline heap, the key is kept here so sifting doesn't touch the waiters.
+    struct deadline
+    {
+        time_point_t at;
+        uint64_t order; //!< when the deadline was set, earlier first among equal deadlines
+        io_waiter *waiter;
+
+        [[nodiscard]] bool operator<(const deadline &other) const noexcept
+        {
+            return at != other.at ? at < other.at : order < other.order;
+        }
+    };
+
+    void push_deadline(io_waiter *waiter);
+    void erase_deadline(io_waiter *waiter);
+    void sift_up(size_t slot) noexcept;
+    void sift_down(size_t slot) noexcept;
+    void place(size_t slot, const deadline &entry) noexcept;
+
+    /// @brief Its address tells the services apart, without RTTI.
+    template <typename T> static constexpr char service_key = 0;
+
+    struct service_entry
+    {
+        const char *key;
+        std::shared_ptr<void> object;
+    };
 
   private:
+    // declared first so it outlives everything that allocates from it
+    std::pmr::unsynchronized_pool_resource pool_;
     poller_type poller_;
     io_loop_state state_ = io_loop_state::stopped;
+    time_point_t now_ = time_now();
+    time_point_t shutdown_deadline_ = time_point_t::max();
     static constexpr size_t INITIAL_CAPACITY = 64;
     std::vector<io_task> tasks_;
+    io_task_promise_base *finished_ = nullptr; //!< tasks that finished since the last step(), linked
     std::vector<std::coroutine_handle<>> scheduled_;
+    std::vector<std::coroutine_handle<>> scheduled_scratch_; //!< swapped with scheduled_ by step()
     std::vector<io_waiter *> waiters_;
+    std::vector<io_waiter *> ready_waiters_; //!< filled by poll() and the timeout sweep in run()
+    std::vector<deadline> deadlines_;        //!< min-heap of the added waiters that have a deadline
+    std::vector<io_waiter *> overdue_;       //!< deadline passed while they weren't waiting, time out once they are
+    uint64_t deadline_order_ = 0;
+    std::vector<service_entry> services_; //!< emptied by the destructor before anything above goes
 };
 
 } // namespace detail
@@ -109,6 +240,7 @@ class io_loop_basic
 
     case io::detail::io_loop_state::shutting_down: return "shutting_down";
     case io::detail::io_loop_state::shutdown: return "shutdown";
+    case io::detail::io_loop_state::stalled: return "stalled";
     default: return "unknown";
     }
 }
@@ -5,6 +5,8 @@
 #include <io/io_loop.hpp>
 #include <io/waiter.hpp>
 
+#include <utility>
+
 namespace io {
 namespace detail {
 
@@ -18,6 +20,8 @@ struct io_op_base : public io_desc_promise
     io_op_base(io_loop &loop, int fd, io_desc_type type, time_point_t complete_by = time_point_t::max()) noexcept
     : io_desc_promise{loop, fd, type, complete_by}
     {
+        waiter_.callback_ = &io_op_base::on_ready;
+        waiter_.data_     = this;
     }
 
     [[nodiscard]] bool await_ready() noexcept override
@@ -40,9 +44,10 @@ struct io_op_base : public io_desc_promise
         return false;
     }
 
-    void await_suspend(std::coroutine_handle<> awaiting_coroutine) noexcept
+    void await_suspend(std::coroutine_handle<> awaiting_coroutine) noexcept override
     {
-        waiter_.awaiting_coroutine_ = awaiting_coroutine;
+        // handed to the waiter by on_ready() once the operation got somewhere
+        awaiting_coroutine_ = awaiting_coroutine;
     }
 
     [[nodiscard]] io_result await_resume() noexcept
@@ -98,6 +103,38 @@ struct io_op_base : public io_desc_promise
     [[nodiscard]] std::string error_message() const noexcept {
         return error_.message();
     }
+
+  protected:
+    std::coroutine_handle<> awaiting_coroutine_{nullptr};
+
+  private:
+    /**
+     * @brief Runs the operation when the descriptor is ready, it keeps waiting if there was nothing to do after all.
+     *
+     * A wake can be for somebody else, an error condition on the descriptor wakes everybody waiting on it. The
+     * coroutine only resumes once the operation completed.
+     */
+    static void on_ready(io_result result, io_waiter *waiter)
+    {
+        auto *self     = static_cast<io_op_base *>(waiter->data_);
+        auto coroutine = std::exchange(self->awaiting_coroutine_, nullptr);
+        if (!coroutine) { return; }
+
+        if (result == io_result::done && !self->executed_)
+        {
+            self->waiter_.result_ = io_result::waiting;
+            self->execute();
+            if (self->waiter_.result() == io_result::waiting)
+            {
+                self->awaiting_coroutine_ = coroutine;
+                return;
+            }
+            self->executed_ = true;
+        }
+
+        // io_waiter::complete() schedules the coroutine after this callback returns
+        waiter->awaiting_coroutine_ = coroutine;
+    }
 };
 
 } // namespace detail
@@ -60,6 +60,12 @@ struct io_task_promise_base
     std::coroutine_handle<> continuation_;
     /// Stores any exception that occurred during the execution of the coroutine.
     std::exception_ptr exception_{nullptr};
+    /// Set while an io_loop owns the task, the list the loop collects its finished tasks in.
+    io_task_promise_base **finished_list_{nullptr};
+    /// Links the finished tasks of a loop.
+    io_task_promise_base *next_finished_{nullptr};
+    /// Where the owning loop keeps the task.
+    size_t task_slot_{0};
 
     /**
      * @brief Awaitable used for the final suspension point of the coroutine.
@@ -84,6 +90,13 @@ struct io_task_promise_base
             auto &promise = coroutine.promise();
 
             if (promise.continuation_ != nullptr) { return promise.continuation_; }
+
+            // a top level task, the loop that owns it destroys it
+            if (promise.finished_list_ != nullptr)
+            {
+                promise.next_finished_  = *promise.finished_list_;
+                *promise.finished_list_ = &promise;
+            }
             return std::noop_coroutine();
         }
 
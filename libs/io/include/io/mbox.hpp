@@ -2,6 +2,8 @@
 
 #include <io/io.hpp>
 #include <queue>
+#include <deque>
+#include <memory_resource>
 #include <optional>
 #include <limits>
 #include <concepts>
@@ -73,8 +75,8 @@ private:
     // Forward declaration for the mailbox reader
     class mailbox_reader;
     
-    // The message queue
-    std::queue<T> message_queue_;
+    // The message queue, its blocks come from the loop's memory resource
+    std::queue<T, std::pmr::deque<T>> message_queue_;
     
     // List of waiting readers
     std::vector<mailbox_reader*> readers_;
@@ -215,11 +217,14 @@ public:
     /**
      * Create a new mailbox.
      * 
+     * The queued messages are stored in memory taken from the loop's memory resource, so the mailbox must not
+     * outlive the loop.
+     * 
      * @param loop The io_loop this mailbox will use
      * @param max_messages Maximum number of messages (0 = unlimited)
      */
     explicit io_mbox(io_loop& loop, size_t max_messages = 0) noexcept
-        : loop_(loop), max_queue_size_(max_messages) {}
+        : message_queue_(std::pmr::deque<T>(detail::loop_memory_resource(loop))), loop_(loop), max_queue_size_(max_messages) {}
     
     /**
      * Destructor - detach all readers
@@ -407,8 +412,9 @@ public:
      * Clear all messages from the mailbox.
      */
     void clear() noexcept {
-        std::queue<T> empty;
-        std::swap(message_queue_, empty);
+        while (!message_queue_.empty()) {
+            message_queue_.pop();
+        }
     }
     
     /**
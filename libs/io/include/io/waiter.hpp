@@ -3,8 +3,10 @@
 #include <functional>
 #include <coroutine>
 #include <vector>
+#include <memory_resource>
 #include <chrono>
 #include <atomic>
+#include <cstdint>
 #include <system_error>
 
 #include <io/common.hpp>
@@ -32,11 +34,18 @@ inline const std::string to_string(io_result result) noexcept {
 
 namespace detail {
 
+/**
+ * @brief Returns the memory resource of @p loop, defined once the loop type is complete.
+ */
+inline std::pmr::memory_resource *loop_memory_resource(io_loop &loop) noexcept;
+
 enum class io_desc_type
 {
-    read  = 1,
-    write = 2,
-    both  = 3,
+    read           = 1,
+    write          = 2,
+    both           = 3,
+    error          = 4, //!< only error conditions, such as a socket's error queue filling up
+    read_exclusive = 9, //!< read, waking only one of the loops waiting on a shared descriptor
 };
 
 /**
@@ -67,28 +76,25 @@ enum class io_desc_type
 struct io_waiter
 {
     using callback_t = void(*)(io_result, io_waiter *);
-    
-    // Pre-reserve space for common case
-    static constexpr size_t DEFAULT_WAITERS_CAPACITY = 32;
 
     io_waiter() = delete;
     io_waiter(io_loop &loop, callback_t callback, struct io_promise *promise, time_point_t complete_by = time_point_t::max()) noexcept
-    : complete_by_{complete_by},
+    : waiters_{loop_memory_resource(loop)},
+      complete_by_{complete_by},
       callback_{callback},
       promise_{promise},
       loop_{loop} 
     {
-        waiters_.reserve(DEFAULT_WAITERS_CAPACITY);
     }
 
     io_waiter(io_loop &loop, io_waiter *waiter, callback_t callback, struct io_promise *promise, time_point_t complete_by = time_point_t::max()) noexcept
     : awaiting_waiter_{waiter},
+      waiters_{loop_memory_resource(loop)},
       complete_by_{complete_by},
       callback_{callback},
       promise_{promise},
       loop_{loop}
     {
-        waiters_.reserve(DEFAULT_WAITERS_CAPACITY);
     }
 
     ~io_waiter() noexcept {
@@ -113,8 +119,10 @@ struct io_waiter
     /**
      * @brief List of waiters that could be completed by this operation. (any waiter that has @e awaiting_waiter_ set to
      * this waiter)
+     *
+     * Only parent waiters ever fill this, it allocates from the loop's memory resource on first use.
      */
-    std::vector<io_waiter *> waiters_;
+    std::pmr::vector<io_waiter *> waiters_;
 
     /**
      * @brief The time point when the operation should be completed.
@@ -143,13 +151,23 @@ struct io_waiter
      */
     void *data_{nullptr};
 
+    static constexpr size_t NO_SLOT      = SIZE_MAX;
+    static constexpr size_t OVERDUE_SLOT = SIZE_MAX - 1;
+
+    /**
+     * @brief Where the loop keeps an added waiter, its index in the loop's waiter list and in the deadline heap. Only
+     * the loop touches these.
+     */
+    size_t loop_slot_{NO_SLOT};
+    size_t deadline_slot_{NO_SLOT};
+
     /**
      * @brief Completes the operation and calls the callback, if set.
      * @param result The result of the operation.
      * @param ec Optional error code to be set when result is io_result::error.
      * @return @e true if the the waiter should be removed from the I/O loop. @e false to keep it.
      */
-    [[nodiscard]] bool complete(io_result result, std::error_code ec = {}) noexcept;
+    [[nodiscard]] inline bool complete(io_result result, std::error_code ec = {}) noexcept;
     
     /**
      * @brief Thread-safe method to get current result
@@ -179,8 +197,21 @@ struct io_waiter
         awaiting_coroutine_ = nullptr;
     }
 
-    void add(io_waiter *awaiting_waiter = nullptr) noexcept;
-    void remove() noexcept;
+    inline void add(io_waiter *awaiting_waiter = nullptr) noexcept;
+    inline void remove() noexcept;
+
+    /**
+     * @brief Points the waiter at another descriptor or event, also while it is added, e.g. for an operation that
+     * goes on with the other side of a transfer. Unlike remove() and add() it keeps the link to a parent waiter.
+     */
+    inline void watch(int fd, io_desc_type type) noexcept;
+
+    /**
+     * @brief Moves the deadline, also of a waiter that is added already, e.g. to re-arm a timer that stays added.
+     *
+     * Writing complete_by_ directly is only for waiters that aren't added.
+     */
+    inline void set_deadline(time_point_t complete_by) noexcept;
 
     void set_completion_count(size_t count) noexcept { completion_count_ = count; }
 
@@ -263,16 +294,11 @@ struct io_promise
         waiter_.complete_by_ = complete_by;
     }
 
-    bool timeout() noexcept
-    {
-        if (waiter_.complete_by_ != time_point_t::max() && waiter_.complete_by_ < time_now())
-        {
-            waiter_.result_ = io_result::timeout;
-            error_ = make_error_code(io_errc::operation_timeout);
-            return true;
-        }
-        return false;
-    }
+    /**
+     * @brief Checks the deadline against the loop's cached time and marks the promise as timed out if it has passed.
+     * @return @e true if the promise timed out.
+     */
+    inline bool timeout() noexcept;
 
     virtual void cancel() noexcept
     {
@@ -349,6 +375,19 @@ struct io_desc_promise : public io_promise
 
 };
 
+/**
+ * @brief The promises an io_wait_for_any_promise or io_wait_for_all_promise resumes with.
+ *
+ * Allocated from the loop's memory resource. Converts to the std::vector<io_promise *> these promises returned
+ * before, so callers that keep the result in one still compile, at the cost of a copy.
+ */
+struct io_ready_promises : public std::pmr::vector<io_promise *>
+{
+    using std::pmr::vector<io_promise *>::vector;
+
+    operator std::vector<io_promise *>() const { return {begin(), end()}; }
+};
+
 /**
  * @brief A promise that allows waiting for a set of promises to complete.
  *
@@ -372,6 +411,16 @@ struct io_wait_for_any_promise : public io_promise
         }
     }
 
+    // for a set of promises only known at run time
+    io_wait_for_any_promise(io_loop &loop, time_point_t complete_by, const std::vector<io_promise *> &promises) noexcept
+    : io_promise{loop, complete_by}
+    {
+        for (auto *promise : promises)
+        {
+            promise->waiter_.add(&waiter_);
+        }
+    }
+
     [[nodiscard]] bool await_ready() noexcept override
     {
         bool ready = false;
@@ -396,9 +445,9 @@ struct io_wait_for_any_promise : public io_promise
         waiter_.awaiting_coroutine_ = awaiting_coroutine;
     }
 
-    [[nodiscard]] std::vector<io_promise *> await_resume() noexcept
+    [[nodiscard]] io_ready_promises await_resume() noexcept
     {
-        std::vector<io_promise *> ready_waiters;
+        io_ready_promises ready_waiters{loop_memory_resource(waiter_.loop())};
 
         for (auto *waiter : waiter_.waiters_)
         {
@@ -528,9 +577,9 @@ struct io_wait_for_all_promise : public io_promise
         waiter_.awaiting_coroutine_ = awaiting_coroutine;
     }
 
-    [[nodiscard]] std::vector<io_promise *> await_resume() noexcept
+    [[nodiscard]] io_ready_promises await_resume() noexcept
     {
-        std::vector<io_promise *> completed_waiters;
+        io_ready_promises completed_waiters{loop_memory_resource(waiter_.loop())};
         
         // Reserve space based on actual completed waiters to avoid reallocations
         size_t completed_count = 0;
@@ -592,10 +641,7 @@ struct io_wait_for_all_promise : public io_promise
 
 } // namespace detail
 
-auto yield(io_loop &loop) { return detail::io_promise{loop, time_now()}; }
-auto sleep(io_loop &loop, std::chrono::milliseconds duration)
-{
-    return detail::io_promise{loop, time_now() + duration};
-}
+inline detail::io_promise yield(io_loop &loop);
+inline detail::io_promise sleep(io_loop &loop, std::chrono::milliseconds duration);
 
 } // namespace io
\ No newline at end of file
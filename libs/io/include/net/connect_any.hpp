@@ -0,0 +1,203 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/error_handling.hpp>
+#include <io/iotask.hpp>
+#include <io/waiter.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace io
+{
+
+/// @brief Connection Attempt Delay recommended by RFC 8305.
+constexpr std::chrono::milliseconds DEFAULT_CONNECT_STAGGER{250};
+
+/// @brief The shortest delay RFC 8305 allows between attempts.
+constexpr std::chrono::milliseconds MIN_CONNECT_STAGGER{10};
+
+/**
+ * @brief Orders @p addrs for connection attempts as RFC 8305 section 4 does, alternating between the address families
+ * starting with the family of the first address, otherwise keeping the resolver's order.
+ */
+inline std::vector<struct sock_addr> interleave_families(std::span<const struct sock_addr> addrs)
+{
+    std::vector<struct sock_addr> first, other;
+    for (const auto &addr : addrs)
+    {
+        if (addr.family() == addrs.front().family()) { first.push_back(addr); }
+        else { other.push_back(addr); }
+    }
+
+    std::vector<struct sock_addr> ordered;
+    ordered.reserve(addrs.size());
+    for (size_t i = 0; i < std::max(first.size(), other.size()); ++i)
+    {
+        if (i < first.size()) { ordered.push_back(first[i]); }
+        if (i < other.size()) { ordered.push_back(other[i]); }
+    }
+    return ordered;
+}
+
+namespace detail
+{
+
+/**
+ * @brief One of the racing connects of connect_any.
+ */
+struct connect_attempt
+{
+    connect_attempt(io_loop &loop, int fd, const struct sock_addr &remote, time_point_t complete_by) noexcept
+    : fd{fd},
+      op{loop, fd, remote, complete_by}
+    {
+    }
+
+    int fd;
+    io_connect op;
+    bool pending{true};
+};
+
+} // namespace detail
+
+/**
+ * @brief Connects to the first of @p addrs that answers, "Happy Eyeballs" style (RFC 8305).
+ *
+ * The addresses are tried in the order of interleave_families(). The next attempt starts @p stagger after the
+ * previous one or as soon as all started ones failed, while the earlier ones keep going, so a dead address costs
+ * @p stagger rather than the whole connect timeout. The first connection that completes wins, the other attempts are
+ * cancelled and their sockets closed.
+ *
+ * @param addrs The destination's addresses, as the resolver returned them.
+ * @param stagger Delay between attempts, at least MIN_CONNECT_STAGGER.
+ * @param config Applied to every socket before it connects.
+ * @param complete_by Deadline for the whole race.
+ * @param error Set to the reason when no connection was made, the error of the first failed attempt if any failed,
+ *              if not null.
+ * @return The connected socket, -1 if none of the addresses could be reached.
+ */
+inline io_func<int> connect_any(io_loop &loop, std::span<const struct sock_addr> addrs,
+                                std::chrono::milliseconds stagger = DEFAULT_CONNECT_STAGGER,
+                                socket_config config = {}, time_point_t complete_by = time_point_t::max(),
+                                std::error_code *error = nullptr)
+{
+    auto fail = [error](std::error_code ec)
+    {
+        if (error) { *error = ec; }
+    };
+
+    if (addrs.empty())
+    {
+        fail(std::make_error_code(std::errc::invalid_argument));
+        co_return -1;
+    }
+
+    stagger                     = std::max(stagger, MIN_CONNECT_STAGGER);
+    auto ordered                = interleave_families(addrs);
+    size_t next                 = 0;
+    size_t running              = 0;
+    time_point_t next_start     = loop.now();
+    std::error_code first_error = {};
+
+    // io_connect can't move, deque keeps them in place
+    std::deque<detail::connect_attempt> attempts;
+    detail::connect_attempt *winner = nullptr;
+
+    auto abandon = [&attempts]()
+    {
+        for (auto &attempt : attempts)
+        {
+            if (!attempt.pending) { continue; }
+            attempt.op.cancel();
+            ::close(attempt.fd);
+        }
+    };
+
+    while (true)
+    {
+        if (next < ordered.size() && loop.now() < complete_by && (running == 0 || loop.now() >= next_start))
+        {
+            const auto &remote = ordered[next++];
+            int fd             = ::socket(remote.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd == -1)
+            {
+                if (!first_error) { first_error = system_error(); }
+                continue;
+            }
+
+            config.apply(fd);
+            attempts.emplace_back(loop, fd, remote, complete_by);
+            ++running;
+            next_start = loop.now() + stagger;
+            LOG(debug) << "Connecting to " << remote.to_string() << ", attempt " << attempts.size();
+        }
+
+        if (running == 0)
+        {
+            if (first_error) { fail(first_error); }
+            else if (loop.now() >= complete_by) { fail(make_error_code(io_errc::operation_timeout)); }
+            else { fail(std::make_error_code(std::errc::host_unreachable)); }
+            co_return -1;
+        }
+
+        // wake up for the next attempt or the deadline, whatever comes first
+        auto wake_at = next < ordered.size() ? std::min(next_start, complete_by) : complete_by;
+        detail::io_promise timer{loop, wake_at};
+
+        std::vector<detail::io_promise *> promises{&timer};
+        for (auto &attempt : attempts)
+        {
+            if (attempt.pending) { promises.push_back(&attempt.op); }
+        }
+
+        // the timer has the deadline, a timed out io_wait_for_any_promise would leave the attempts pointing at it
+        detail::io_wait_for_any_promise any{loop, time_point_t::max(), promises};
+        (void)co_await any;
+
+        for (auto &attempt : attempts)
+        {
+            if (!attempt.pending || attempt.op.waiter_.result() == io_result::waiting) { continue; }
+
+            auto result     = co_await attempt.op;
+            attempt.pending = false;
+            --running;
+
+            if (result == io_result::done)
+            {
+                winner = &attempt;
+                break;
+            }
+
+            if (!first_error) { first_error = attempt.op.error_ ? attempt.op.error_ : result_to_error(result); }
+            ::close(attempt.fd);
+        }
+
+        if (winner) { break; }
+
+        auto timer_result = timer.waiter_.result();
+        if (timer_result == io_result::waiting) { continue; }
+        if (timer_result != io_result::timeout || wake_at == complete_by)
+        {
+            // the deadline passed or the loop is going away
+            abandon();
+            fail(timer_result == io_result::timeout ? make_error_code(io_errc::operation_timeout)
+                                                    : result_to_error(timer_result));
+            co_return -1;
+        }
+    }
+
+    abandon();
+    co_return winner->fd;
+}
+
+} // namespace io
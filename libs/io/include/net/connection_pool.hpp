@@ -0,0 +1,496 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/error_handling.hpp>
+#include <io/iotask.hpp>
+#include <io/waiter.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace io
+{
+
+class connection_pool;
+
+struct connection_pool_options
+{
+    size_t max_idle   = 8;  //!< idle connections kept per destination, the rest are closed when they come back
+    size_t max_in_use = 64; //!< connections checked out or connecting per destination at once, 0 for no limit
+    std::chrono::milliseconds idle_timeout{60000};   //!< idle connections older than this are closed
+    std::chrono::milliseconds connect_timeout{5000}; //!< for opening a new connection, within the checkout deadline
+    socket_config config{};                          //!< applied to new connections
+};
+
+/**
+ * @brief A connection checked out of a connection_pool.
+ *
+ * release() hands it back for the next request to the same destination once the exchange on it is complete. A
+ * connection that is destroyed without release() is closed, since nobody knows what state its protocol was left in.
+ */
+class pooled_connection
+{
+  public:
+    pooled_connection() = default;
+    ~pooled_connection() { close(); }
+
+    pooled_connection(pooled_connection &&other) noexcept
+    : pool_{std::exchange(other.pool_, nullptr)},
+      destination_{std::exchange(other.destination_, nullptr)},
+      fd_{std::exchange(other.fd_, -1)},
+      reused_{other.reused_}
+    {
+    }
+
+    pooled_connection &operator=(pooled_connection &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            pool_        = std::exchange(other.pool_, nullptr);
+            destination_ = std::exchange(other.destination_, nullptr);
+            fd_          = std::exchange(other.fd_, -1);
+            reused_      = other.reused_;
+        }
+        return *this;
+    }
+
+    pooled_connection(const pooled_connection &)            = delete;
+    pooled_connection &operator=(const pooled_connection &) = delete;
+
+    [[nodiscard]] int fd() const noexcept { return fd_; }
+    [[nodiscard]] explicit operator bool() const noexcept { return fd_ != -1; }
+
+    /// @brief True if the connection was idle in the pool, false if it was opened for this checkout.
+    [[nodiscard]] bool reused() const noexcept { return reused_; }
+
+    /// @brief Returns the connection to the pool, to be kept alive for the next checkout.
+    void release() noexcept { give_back(true); }
+
+    /// @brief Closes the connection and frees its place in the pool.
+    void close() noexcept { give_back(false); }
+
+  private:
+    friend class connection_pool;
+
+    pooled_connection(connection_pool &pool, void *destination, int fd, bool reused) noexcept
+    : pool_{&pool},
+      destination_{destination},
+      fd_{fd},
+      reused_{reused}
+    {
+    }
+
+    void give_back(bool reuse) noexcept;
+
+    connection_pool *pool_{nullptr};
+    void *destination_{nullptr};
+    int fd_{-1};
+    bool reused_{false};
+};
+
+/**
+ * @brief Keeps connections to backends open between requests, a pool per loop.
+ *
+ * A checkout takes the most recently returned idle connection to the destination, after checking that the peer
+ * neither closed it nor sent anything unasked. Without one it connects, as long as fewer than max_in_use connections
+ * to the destination are out, otherwise it waits in line until one comes back or its deadline passes.
+ *
+ * @code
+ * io::connection_pool pool{loop};
+ * std::error_code error;
+ * auto conn = co_await pool.acquire(backend, loop.now() + 1s, &error);
+ * if (!conn) { ... }
+ * // send the request, read the whole response
+ * conn.release();
+ * @endcode
+ *
+ * Idle connections are closed idle_timeout after they came back, by a timer waiter that is armed as long as there
+ * are any, which keeps the loop running. clear() closes them all. The pool has to outlive its connections and the
+ * checkouts that are connecting, the ones waiting in line are cancelled when it goes. It is not thread safe, a loop
+ * thread has one of its own.
+ */
+class connection_pool
+{
+  public:
+    struct statistics
+    {
+        size_t hits{0};             //!< checkouts that got an idle connection
+        size_t misses{0};           //!< checkouts that opened a new connection
+        size_t waits{0};            //!< checkouts that had to wait for a connection to come back
+        size_t timeouts{0};         //!< checkouts that gave up at their deadline
+        size_t connect_failures{0}; //!< new connections that failed or timed out
+        size_t stale{0};            //!< idle connections that failed the health check
+        size_t expired{0};          //!< idle connections closed after idle_timeout
+        time_ticks_t wait_time{0};  //!< total time the checkouts that waited spent waiting
+        time_ticks_t max_wait_time{0};
+    };
+
+    explicit connection_pool(io_loop &loop, connection_pool_options options = {}) noexcept
+    : loop_{loop},
+      options_{std::move(options)},
+      expiry_{loop, &connection_pool::on_expiry, nullptr}
+    {
+        expiry_.data_ = this;
+    }
+
+    ~connection_pool() noexcept
+    {
+        clear();
+        for (auto &[addr, d] : destinations_)
+        {
+            // the checkouts resume after the destinations are gone, they must not touch the pool anymore
+            for (auto *waiter : d.waiters)
+            {
+                if (waiter->fd_ != -1) { ::close(std::exchange(waiter->fd_, -1)); }
+                waiter->destination_ = nullptr;
+                if (waiter->waiter_.result() == io_result::waiting) { (void)waiter->waiter_.complete(io_result::cancelled); }
+            }
+        }
+    }
+
+    connection_pool(const connection_pool &)            = delete;
+    connection_pool &operator=(const connection_pool &) = delete;
+
+    /**
+     * @brief Checks a connection to @p addr out.
+     *
+     * @param addr The destination.
+     * @param complete_by Deadline for the whole checkout, waiting and connecting.
+     * @param error Set to the reason when the returned connection is empty, if not null.
+     */
+    io_func<pooled_connection> acquire(struct sock_addr addr, time_point_t complete_by = time_point_t::max(),
+                                       std::error_code *error = nullptr);
+
+    /// @brief Closes the idle connections, the checked out ones are not affected.
+    void clear() noexcept
+    {
+        for (auto &[addr, d] : destinations_)
+        {
+            for (const auto &idle : d.idle) { ::close(idle.fd); }
+            d.idle.clear();
+        }
+        disarm_expiry();
+    }
+
+    /// @brief Idle connections to @p addr.
+    [[nodiscard]] size_t idle(const struct sock_addr &addr) const noexcept
+    {
+        auto it = destinations_.find(addr);
+        return it == destinations_.end() ? 0 : it->second.idle.size();
+    }
+
+    /// @brief Connections to @p addr that are checked out or connecting.
+    [[nodiscard]] size_t in_use(const struct sock_addr &addr) const noexcept
+    {
+        auto it = destinations_.find(addr);
+        return it == destinations_.end() ? 0 : it->second.in_use;
+    }
+
+    [[nodiscard]] const statistics &stats() const noexcept { return stats_; }
+    [[nodiscard]] const connection_pool_options &options() const noexcept { return options_; }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+
+  private:
+    friend class pooled_connection;
+
+    struct idle_connection
+    {
+        int fd;
+        time_point_t expires;
+    };
+
+    struct checkout_waiter;
+
+    struct destination
+    {
+        std::vector<idle_connection> idle; //!< the most recently returned last
+        size_t in_use{0};
+        std::deque<checkout_waiter *> waiters;
+    };
+
+    /**
+     * @brief A checkout waiting for a connection to come back, in line at its destination.
+     *
+     * What comes back is handed to the first one in line when it is woken, the connection or, when it was closed,
+     * its place to connect. A checkout that arrives before the woken one resumes finds nothing to take.
+     */
+    struct checkout_waiter : public detail::io_promise
+    {
+        checkout_waiter(connection_pool &pool, destination &d, time_point_t complete_by)
+        : io_promise{pool.loop_, complete_by},
+          pool_{pool},
+          destination_{&d}
+        {
+            destination_->waiters.push_back(this);
+        }
+
+        ~checkout_waiter() override
+        {
+            if (destination_ == nullptr) { return; }
+            auto &waiters = destination_->waiters;
+            waiters.erase(std::remove(waiters.begin(), waiters.end(), this), waiters.end());
+
+            // woken, but its task went away before it resumed, the next in line gets what it was handed
+            if (handed_) { pool_.give_back(*destination_, std::exchange(fd_, -1), true); }
+        }
+
+        connection_pool &pool_;
+        destination *destination_; //!< null once the pool is gone
+        bool handed_{false};       //!< holds a place at the destination, counted in in_use
+        int fd_{-1};               //!< the connection that came with the place, if it wasn't closed
+    };
+
+    /**
+     * @brief True if the peer of the idle connection @p fd neither closed it nor sent anything.
+     *
+     * A request/response peer has nothing to say between requests, readable means a close, a reset or a stray
+     * response, none of which the next request should find.
+     */
+    static bool healthy(int fd) noexcept
+    {
+        struct pollfd pfd = {fd, POLLIN | POLLRDHUP, 0};
+        return ::poll(&pfd, 1, 0) == 0;
+    }
+
+    /**
+     * @brief Hands the place of a connection and with @p fd other than -1 the connection itself to the first checkout
+     * in line at @p d.
+     * @return @e false if nobody waits.
+     */
+    static bool hand_over(destination &d, int fd) noexcept
+    {
+        for (auto *waiter : d.waiters)
+        {
+            if (waiter->waiter_.result() != io_result::waiting) { continue; }
+            waiter->handed_ = true;
+            waiter->fd_     = fd;
+            (void)waiter->waiter_.complete(io_result::done);
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief Takes the connection @p fd back, or with -1 its place only, and passes it on to the first in line.
+    void give_back(destination &d, int fd, bool reuse) noexcept
+    {
+        if (!reuse && fd != -1) { ::close(std::exchange(fd, -1)); }
+        if (hand_over(d, fd)) { return; }
+
+        --d.in_use;
+        if (fd == -1) { return; }
+        if (d.idle.size() < options_.max_idle)
+        {
+            d.idle.push_back({fd, loop_.now() + options_.idle_timeout});
+            arm_expiry(d.idle.back().expires);
+        }
+        else { ::close(fd); }
+    }
+
+    void count_wait(time_point_t start) noexcept
+    {
+        auto waited = std::chrono::duration_cast<time_ticks_t>(loop_.now() - start);
+        stats_.wait_time += waited;
+        stats_.max_wait_time = std::max(stats_.max_wait_time, waited);
+    }
+
+    void arm_expiry(time_point_t expires) noexcept
+    {
+        if (expiry_armed_)
+        {
+            expiry_.set_deadline(std::min(expiry_.complete_by_, expires));
+            return;
+        }
+
+        expiry_.result_      = io_result::waiting;
+        expiry_.complete_by_ = expires;
+        expiry_.add();
+        expiry_armed_ = true;
+    }
+
+    void disarm_expiry() noexcept
+    {
+        expiry_.remove();
+        expiry_armed_ = false;
+    }
+
+    /// @brief Closes the idle connections that expired, re-arms the timer for the next one if there is any.
+    static void on_expiry(io_result result, detail::io_waiter *waiter)
+    {
+        auto *self = static_cast<connection_pool *>(waiter->data_);
+        if (result != io_result::timeout)
+        {
+            // the loop is going away, the connections go with the pool
+            self->disarm_expiry();
+            return;
+        }
+
+        auto now  = self->loop_.now();
+        auto next = time_point_t::max();
+        for (auto &[addr, d] : self->destinations_)
+        {
+            auto keep = std::partition(d.idle.begin(), d.idle.end(),
+                                       [now](const idle_connection &idle) { return idle.expires <= now; });
+            for (auto it = d.idle.begin(); it != keep; ++it) { ::close(it->fd); }
+            self->stats_.expired += static_cast<size_t>(keep - d.idle.begin());
+            d.idle.erase(d.idle.begin(), keep);
+
+            // the oldest is first, partition keeps the order of the rest
+            if (!d.idle.empty()) { next = std::min(next, d.idle.front().expires); }
+        }
+
+        if (next == time_point_t::max()) { self->disarm_expiry(); }
+        else
+        {
+            waiter->result_ = io_result::waiting;
+            waiter->set_deadline(next);
+        }
+    }
+
+    io_loop &loop_;
+    connection_pool_options options_;
+    std::unordered_map<struct sock_addr, destination> destinations_;
+    detail::io_waiter expiry_;
+    bool expiry_armed_{false};
+    statistics stats_;
+};
+
+inline void pooled_connection::give_back(bool reuse) noexcept
+{
+    if (fd_ == -1) { return; }
+
+    if (pool_) { pool_->give_back(*static_cast<connection_pool::destination *>(destination_), fd_, reuse); }
+    else { ::close(fd_); }
+
+    fd_   = -1;
+    pool_ = nullptr;
+}
+
+inline io_func<pooled_connection> connection_pool::acquire(struct sock_addr addr, time_point_t complete_by,
+                                                           std::error_code *error)
+{
+    auto fail = [error](std::error_code ec)
+    {
+        if (error) { *error = ec; }
+    };
+
+    auto start  = loop_.now();
+    bool waited = false;
+    auto &d     = destinations_[addr];
+
+    while (true)
+    {
+        while (!d.idle.empty())
+        {
+            auto idle = d.idle.back();
+            d.idle.pop_back();
+
+            if (idle.expires <= loop_.now())
+            {
+                ::close(idle.fd);
+                ++stats_.expired;
+                continue;
+            }
+            if (!healthy(idle.fd))
+            {
+                LOG(debug) << "Idle connection " << idle.fd << " to " << addr.to_string() << " went stale";
+                ::close(idle.fd);
+                ++stats_.stale;
+                continue;
+            }
+
+            if (d.idle.empty() && expiry_armed_ && std::all_of(destinations_.begin(), destinations_.end(),
+                                                               [](const auto &entry)
+                                                               { return entry.second.idle.empty(); }))
+            {
+                disarm_expiry();
+            }
+
+            ++d.in_use;
+            ++stats_.hits;
+            if (waited) { count_wait(start); }
+            co_return pooled_connection{*this, &d, idle.fd, true};
+        }
+
+        if (options_.max_in_use == 0 || d.in_use < options_.max_in_use)
+        {
+            ++d.in_use;
+            ++stats_.misses;
+
+            int fd = ::socket(addr.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd == -1)
+            {
+                fail(system_error());
+                ++stats_.connect_failures;
+                give_back(d, -1, false);
+                co_return pooled_connection{};
+            }
+
+            auto deadline = std::min(complete_by, loop_.now() + options_.connect_timeout);
+            auto op       = connect(loop_, fd, addr, options_.config, deadline);
+            auto result   = co_await op;
+            if (result != io_result::done)
+            {
+                fail(op.error() ? op.error() : result_to_error(result));
+                ++stats_.connect_failures;
+                if (result == io_result::timeout) { ++stats_.timeouts; }
+                give_back(d, fd, false);
+                co_return pooled_connection{};
+            }
+
+            if (waited) { count_wait(start); }
+            co_return pooled_connection{*this, &d, fd, false};
+        }
+
+        // all out, wait for one to come back or for a place to connect
+        if (!waited) { ++stats_.waits; }
+        waited = true;
+
+        checkout_waiter waiter{*this, d, complete_by};
+        auto result = co_await waiter;
+        if (waiter.destination_ == nullptr)
+        {
+            fail(result_to_error(io_result::cancelled));
+            co_return pooled_connection{};
+        }
+        if (std::exchange(waiter.handed_, false))
+        {
+            int fd = std::exchange(waiter.fd_, -1);
+            if (fd != -1 && healthy(fd))
+            {
+                ++stats_.hits;
+                count_wait(start);
+                co_return pooled_connection{*this, &d, fd, true};
+            }
+            if (fd != -1)
+            {
+                ::close(fd);
+                ++stats_.stale;
+            }
+
+            // only the place came, give it up and take it again right away, nobody can come in between
+            --d.in_use;
+            continue;
+        }
+        if (result != io_result::done)
+        {
+            fail(result_to_error(result));
+            if (result == io_result::timeout) { ++stats_.timeouts; }
+            count_wait(start);
+            co_return pooled_connection{};
+        }
+    }
+}
+
+} // namespace io
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <io/flat_map.hpp>
+#include <io/hash.hpp>
+#include <net/sockaddr.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace io
+{
+
+/**
+ * @brief The local and remote address and port of a connection or UDP session, as a 40 byte key.
+ *
+ * sock_addr carries the whole sockaddr storage and its string form, a pair of them is far bigger than what tells
+ * two connections apart. socket_tuple keeps only the address bytes, the ports and the families, zero padded, so
+ * two tuples compare with one memcmp and hash as five words.
+ *
+ * Only IPv4 and IPv6 addresses are kept, any other family makes an empty side.
+ */
+class socket_tuple
+{
+  public:
+    socket_tuple() = default;
+
+    socket_tuple(const sock_addr &local, const sock_addr &remote) noexcept
+    {
+        local_family_  = set(local, local_addr_, local_port_);
+        remote_family_ = set(remote, remote_addr_, remote_port_);
+    }
+
+    [[nodiscard]] sock_addr local() const { return get(local_family_, local_addr_, local_port_); }
+    [[nodiscard]] sock_addr remote() const { return get(remote_family_, remote_addr_, remote_port_); }
+
+    /// @brief The same connection seen from the other end.
+    [[nodiscard]] socket_tuple reversed() const noexcept
+    {
+        socket_tuple t;
+        t.local_addr_    = remote_addr_;
+        t.remote_addr_   = local_addr_;
+        t.local_port_    = remote_port_;
+        t.remote_port_   = local_port_;
+        t.local_family_  = remote_family_;
+        t.remote_family_ = local_family_;
+        return t;
+    }
+
+    bool operator==(const socket_tuple &other) const noexcept { return memcmp(this, &other, sizeof(*this)) == 0; }
+    bool operator!=(const socket_tuple &other) const noexcept { return !(*this == other); }
+
+    [[nodiscard]] size_t hash() const noexcept
+    {
+        uint64_t tail = uint64_t(local_port_) << 48 | uint64_t(remote_port_) << 32 | uint64_t(local_family_) << 8 |
+                        remote_family_;
+        uint64_t h    = detail::hash_mum(detail::hash_load64(local_addr_.data()) ^ detail::HASH_K0,
+                                         detail::hash_load64(local_addr_.data() + 8) ^ detail::HASH_K1);
+        h ^= detail::hash_mum(detail::hash_load64(remote_addr_.data()) ^ detail::HASH_K2,
+                              detail::hash_load64(remote_addr_.data() + 8) ^ detail::HASH_K3);
+        return detail::hash_mum(h ^ detail::HASH_K1, tail ^ detail::HASH_K0);
+    }
+
+  private:
+    static uint8_t set(const sock_addr &addr, std::array<uint8_t, 16> &bytes, uint16_t &port) noexcept
+    {
+        if (addr.family() == AF_INET)
+        {
+            const auto &sin = reinterpret_cast<const sockaddr_in &>(*addr.sockaddr());
+            memcpy(bytes.data(), &sin.sin_addr, 4);
+            port = sin.sin_port;
+            return AF_INET;
+        }
+        if (addr.family() == AF_INET6)
+        {
+            const auto &sin6 = reinterpret_cast<const sockaddr_in6 &>(*addr.sockaddr());
+            memcpy(bytes.data(), &sin6.sin6_addr, 16);
+            port = sin6.sin6_port;
+            return AF_INET6;
+        }
+        return AF_UNSPEC;
+    }
+
+    static sock_addr get(uint8_t family, const std::array<uint8_t, 16> &bytes, uint16_t port)
+    {
+        if (family == AF_INET)
+        {
+            struct sockaddr_in sin = {};
+            sin.sin_family         = AF_INET;
+            sin.sin_port           = port;
+            memcpy(&sin.sin_addr, bytes.data(), 4);
+            return sock_addr(sin);
+        }
+        if (family == AF_INET6)
+        {
+            struct sockaddr_in6 sin6 = {};
+            sin6.sin6_family         = AF_INET6;
+            sin6.sin6_port           = port;
+            memcpy(&sin6.sin6_addr, bytes.data(), 16);
+            return sock_addr(sin6);
+        }
+        return sock_addr();
+    }
+
+    // no padding between or after the members, memcmp only sees what was set
+    std::array<uint8_t, 16> local_addr_{};
+    std::array<uint8_t, 16> remote_addr_{};
+    uint16_t local_port_    = 0; //!< network byte order
+    uint16_t remote_port_   = 0; //!< network byte order
+    uint8_t local_family_   = AF_UNSPEC;
+    uint8_t remote_family_  = AF_UNSPEC;
+    uint16_t reserved_      = 0;
+};
+
+static_assert(sizeof(socket_tuple) == 40);
+
+/**
+ * @brief Connection or session state by socket_tuple, without an allocation per entry.
+ *
+ * @code
+ * connection_table<session> sessions(4000000);
+ * auto [e, added] = sessions.try_emplace(socket_tuple(local, peer));
+ * @endcode
+ */
+template <typename T> using connection_table = flat_map<socket_tuple, T>;
+
+} // namespace io
+
+namespace std
+{
+template <> struct hash<io::socket_tuple>
+{
+    size_t operator()(const io::socket_tuple &tuple) const noexcept { return tuple.hash(); }
+};
+} // namespace std
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/iobuf.hpp>
+#include <io/ioops.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace io
+{
+
+class datagram_batch;
+
+namespace detail
+{
+
+/**
+ * @brief Receives as many datagrams as the batch holds and the socket has queued with one recvmmsg().
+ */
+struct io_recv_batch : public io_op_base
+{
+    io_recv_batch()                      = delete;
+    io_recv_batch(const io_recv_batch &) = delete;
+
+    io_recv_batch(io_loop &loop, int fd, datagram_batch &batch, int flags, time_point_t complete_by) noexcept
+    : io_op_base{loop, fd, io_desc_type::read, complete_by},
+      batch_{batch},
+      flags_{flags}
+    {
+    }
+
+    bool check_ready() noexcept override
+    {
+        execute();
+        return received_;
+    }
+
+    void execute() noexcept override;
+
+  private:
+    datagram_batch &batch_;
+    int flags_;
+    bool received_{false};
+};
+
+/**
+ * @brief Sends all datagrams of a batch with as few sendmmsg() calls as the socket allows.
+ *
+ * The transfer counts datagrams, not bytes.
+ */
+struct io_send_batch : public io_transfer_op
+{
+    io_send_batch()                      = delete;
+    io_send_batch(const io_send_batch &) = delete;
+
+    io_send_batch(io_loop &loop, int fd, datagram_batch &batch, size_t &datagrams_sent, int flags,
+                  time_point_t complete_by) noexcept;
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    datagram_batch &batch_;
+    int flags_;
+};
+
+/**
+ * @brief Sends a buffer as datagrams of segment_size bytes each, many per sendmsg() through UDP_SEGMENT.
+ *
+ * The kernel splits each send into datagrams (generic segmentation offload), so a system call and a trip through the
+ * stack carry up to MAX_SEGMENTS datagrams. Only the last datagram of the buffer may be shorter.
+ */
+struct io_send_segmented : public io_transfer_op
+{
+    /// @brief The most segments the kernel takes per send (UDP_MAX_SEGMENTS on older kernels).
+    static constexpr size_t MAX_SEGMENTS = 64;
+
+    /// @brief The most payload one send may carry, that of the largest IPv4 UDP datagram.
+    static constexpr size_t MAX_SEND = 65507;
+
+    io_send_segmented()                          = delete;
+    io_send_segmented(const io_send_segmented &) = delete;
+
+    io_send_segmented(io_loop &loop, int fd, const char *data, size_t len, uint16_t segment_size,
+                      const struct sock_addr *peer, size_t &bytes_sent, int flags, time_point_t complete_by) noexcept
+    : io_transfer_op{loop, len, bytes_sent, complete_by},
+      data_{data},
+      peer_{peer},
+      segment_size_{segment_size},
+      flags_{flags}
+    {
+        wait_fd_ = fd;
+    }
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    const char *data_;
+    const struct sock_addr *peer_;
+    uint16_t segment_size_;
+    int flags_;
+};
+
+} // namespace detail
+
+/**
+ * @brief A fixed number of datagram buffers with their peer addresses, received or sent with one system call.
+ *
+ * The buffers are io_bufs that share one allocation made up front, so receiving and sending doesn't allocate. A
+ * receiver reuses one batch for all its reads:
+ *
+ * @code
+ * io::datagram_batch batch{64};
+ * while (co_await io::recv_batch(loop, fd, batch) == io_result::done)
+ * {
+ *     for (size_t i = 0; i < batch.size(); ++i) { handle(batch.peer(i), batch.view(i)); }
+ * }
+ * @endcode
+ *
+ * A sender fills the batch with add() and sends it with io::send_batch(). Datagrams that don't fit into their
+ * buffer are cut short on receive and marked truncated(). A batch is neither copyable nor movable, the buffers
+ * refer to the storage of the batch.
+ *
+ * On a socket with enable_udp_gro() the kernel may hand over several datagrams of one sender in one buffer, all but
+ * the last of them segment_size() bytes long. segments() and segment() split them up again, for buffers without
+ * coalesced datagrams they are the whole buffer. Such a batch wants 64 KiB buffers.
+ */
+class datagram_batch
+{
+  public:
+    static constexpr size_t DEFAULT_DATAGRAM_SIZE = 2048;
+
+    /// @brief The most datagrams one recvmmsg() or sendmmsg() takes (UIO_MAXIOV).
+    static constexpr size_t MAX_BATCH = 1024;
+
+    /**
+     * @brief Creates a batch of @p capacity datagrams of up to @p datagram_size bytes each.
+     */
+    explicit datagram_batch(size_t capacity, size_t datagram_size = DEFAULT_DATAGRAM_SIZE)
+    : datagram_size_{datagram_size},
+      storage_{std::max<size_t>(capacity, 1) * datagram_size},
+      peers_(std::max<size_t>(capacity, 1)),
+      iov_(std::max<size_t>(capacity, 1)),
+      msgs_(std::max<size_t>(capacity, 1)),
+      control_(msgs_.size()),
+      segment_size_(msgs_.size())
+    {
+        bufs_.reserve(msgs_.size());
+        for (size_t i = 0; i < msgs_.size(); ++i)
+        {
+            bufs_.emplace_back(storage_, static_cast<off_t>(i * datagram_size), datagram_size);
+            msgs_[i].msg_hdr.msg_iov    = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    datagram_batch(const datagram_batch &)            = delete;
+    datagram_batch &operator=(const datagram_batch &) = delete;
+
+    [[nodiscard]] size_t capacity() const noexcept { return bufs_.size(); }
+    [[nodiscard]] size_t datagram_size() const noexcept { return datagram_size_; }
+
+    /// @brief Number of datagrams received by the last io::recv_batch() or added since the last clear().
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+    [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] bool full() const noexcept { return size_ == bufs_.size(); }
+
+    [[nodiscard]] io_buf &data(size_t i) noexcept { return bufs_[i]; }
+    [[nodiscard]] const io_buf &data(size_t i) const noexcept { return bufs_[i]; }
+
+    [[nodiscard]] std::string_view view(size_t i) const noexcept
+    {
+        return {bufs_[i].read_ptr(), bufs_[i].readable()};
+    }
+
+    /// @brief The sender of datagram @p i after a receive, its destination when sending.
+    [[nodiscard]] struct sock_addr &peer(size_t i) noexcept { return peers_[i]; }
+    [[nodiscard]] const struct sock_addr &peer(size_t i) const noexcept { return peers_[i]; }
+
+    /// @brief True if received datagram @p i was longer than datagram_size() and cut short.
+    [[nodiscard]] bool truncated(size_t i) const noexcept { return (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0; }
+
+    /// @brief Size of the datagrams coalesced into buffer @p i, the whole buffer if the kernel didn't coalesce any.
+    [[nodiscard]] size_t segment_size(size_t i) const noexcept
+    {
+        return segment_size_[i] != 0 ? segment_size_[i] : bufs_[i].readable();
+    }
+
+    /// @brief Number of datagrams in buffer @p i.
+    [[nodiscard]] size_t segments(size_t i) const noexcept
+    {
+        size_t seg = segment_size(i);
+        return seg == 0 ? 1 : (bufs_[i].readable() + seg - 1) / seg;
+    }
+
+    /// @brief Datagram @p k of buffer @p i.
+    [[nodiscard]] std::string_view segment(size_t i, size_t k) const noexcept
+    {
+        size_t seg = segment_size(i);
+        return view(i).substr(k * seg, seg);
+    }
+
+    /**
+     * @brief Adds a datagram to send to @p peer.
+     * @return @e false if the batch is full or @p payload is longer than datagram_size().
+     */
+    bool add(std::string_view payload, const struct sock_addr &peer)
+    {
+        if (!add(payload)) { return false; }
+        peers_[size_ - 1] = peer;
+        return true;
+    }
+
+    /**
+     * @brief Adds a datagram to send on a connected socket.
+     * @return @e false if the batch is full or @p payload is longer than datagram_size().
+     */
+    bool add(std::string_view payload)
+    {
+        if (full() || payload.size() > datagram_size_) { return false; }
+
+        auto &buf = bufs_[size_];
+        buf.reset();
+        buf.write(payload);
+        peers_[size_]        = {};
+        segment_size_[size_] = 0;
+        ++size_;
+        return true;
+    }
+
+    void clear() noexcept { size_ = 0; }
+
+  private:
+    friend struct detail::io_recv_batch;
+    friend struct detail::io_send_batch;
+
+    /// @brief Points every message at the whole of its empty buffer, its peer and its control data.
+    void prepare_receive() noexcept
+    {
+        for (size_t i = 0; i < bufs_.size(); ++i)
+        {
+            bufs_[i].reset();
+            iov_[i] = {bufs_[i].read_ptr(), datagram_size_};
+
+            auto &hdr          = msgs_[i].msg_hdr;
+            hdr.msg_name       = peers_[i].sockaddr();
+            hdr.msg_namelen    = detail::SOCK_ADDR_CAPACITY;
+            hdr.msg_control    = control_[i].data;
+            hdr.msg_controllen = sizeof(control_[i].data);
+            hdr.msg_flags      = 0;
+            msgs_[i].msg_len   = 0;
+        }
+        size_ = 0;
+    }
+
+    /// @brief Takes over what recvmmsg() filled into the first @p count messages.
+    void complete_receive(size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto &hdr = msgs_[i].msg_hdr;
+            bufs_[i].advance_write_ptr(std::min<size_t>(msgs_[i].msg_len, datagram_size_));
+            peers_[i].len_ref() = hdr.msg_namelen;
+
+            segment_size_[i] = 0;
+            for (auto *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                {
+                    int seg;
+                    memcpy(&seg, CMSG_DATA(cmsg), sizeof(seg));
+                    segment_size_[i] = static_cast<uint16_t>(seg);
+                }
+            }
+        }
+        size_ = count;
+    }
+
+    /// @brief Points every added message at its payload and its peer, if it has one.
+    void prepare_send() noexcept
+    {
+        for (size_t i = 0; i < size_; ++i)
+        {
+            iov_[i] = {bufs_[i].read_ptr(), bufs_[i].readable()};
+
+            auto &hdr          = msgs_[i].msg_hdr;
+            bool connected     = peers_[i].family() == AF_UNSPEC;
+            hdr.msg_name       = connected ? nullptr : peers_[i].sockaddr();
+            hdr.msg_namelen    = connected ? 0 : peers_[i].len();
+            hdr.msg_control    = nullptr;
+            hdr.msg_controllen = 0;
+        }
+    }
+
+    /// @brief Room for the UDP_GRO segment size of a message.
+    struct control_space
+    {
+        alignas(struct cmsghdr) char data[CMSG_SPACE(sizeof(int))];
+    };
+
+    size_t datagram_size_;
+    io_buf storage_;
+    std::vector<io_buf> bufs_;
+    std::vector<struct sock_addr> peers_;
+    std::vector<struct iovec> iov_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<control_space> control_;
+    std::vector<uint16_t> segment_size_;
+    size_t size_{0};
+};
+
+namespace detail
+{
+
+inline void io_recv_batch::execute() noexcept
+{
+    if (received_) return;
+
+    batch_.prepare_receive();
+    auto vlen = static_cast<unsigned>(std::min(batch_.capacity(), datagram_batch::MAX_BATCH));
+    int ret   = ::recvmmsg(waiter_.fd(), batch_.msgs_.data(), vlen, flags_, nullptr);
+
+    if (ret == -1)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) { return; }
+
+        handle_socket_error(error_, "recvmmsg");
+        waiter_.complete(io_result::error);
+        return;
+    }
+
+    batch_.complete_receive(static_cast<size_t>(ret));
+    received_ = true;
+    LOG(trace) << "Received " << ret << " datagrams";
+    waiter_.complete(io_result::done);
+}
+
+inline io_send_batch::io_send_batch(io_loop &loop, int fd, datagram_batch &batch, size_t &datagrams_sent, int flags,
+                                    time_point_t complete_by) noexcept
+: io_transfer_op{loop, batch.size(), datagrams_sent, complete_by},
+  batch_{batch},
+  flags_{flags}
+{
+    wait_fd_ = fd;
+    batch_.prepare_send();
+}
+
+inline io_send_batch::progress io_send_batch::transfer() noexcept
+{
+    while (bytes_transferred_ < len_)
+    {
+        auto vlen = static_cast<unsigned>(std::min(len_ - bytes_transferred_, datagram_batch::MAX_BATCH));
+        int ret   = ::sendmmsg(wait_fd_, batch_.msgs_.data() + bytes_transferred_, vlen, flags_);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+            handle_socket_error(error_, "sendmmsg");
+            return progress::error;
+        }
+
+        bytes_transferred_ += static_cast<size_t>(ret);
+        LOG(trace) << "Sent " << ret << " datagrams";
+    }
+
+    return progress::done;
+}
+
+inline io_send_segmented::progress io_send_segmented::transfer() noexcept
+{
+    if (segment_size_ == 0)
+    {
+        error_ = std::make_error_code(std::errc::invalid_argument);
+        return progress::error;
+    }
+
+    size_t per_send = segment_size_ * std::max<size_t>(1, std::min(MAX_SEGMENTS, MAX_SEND / segment_size_));
+
+    while (bytes_transferred_ < len_)
+    {
+        size_t chunk     = std::min(len_ - bytes_transferred_, per_send);
+        struct iovec iov = {const_cast<char *>(data_) + bytes_transferred_, chunk};
+
+        struct msghdr msg = {};
+        msg.msg_iov       = &iov;
+        msg.msg_iovlen    = 1;
+        if (peer_ != nullptr)
+        {
+            msg.msg_name    = const_cast<struct sockaddr *>(peer_->sockaddr());
+            msg.msg_namelen = peer_->len();
+        }
+
+        // a chunk of one datagram goes out as it is
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+        if (chunk > segment_size_)
+        {
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+
+            auto *cmsg       = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &segment_size_, sizeof(uint16_t));
+        }
+
+        auto ret = ::sendmsg(wait_fd_, &msg, flags_);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+            handle_socket_error(error_, "sendmsg");
+            return progress::error;
+        }
+
+        bytes_transferred_ += static_cast<size_t>(ret);
+        LOG(trace) << "Sent " << ret << " bytes in segments of " << segment_size_;
+    }
+
+    return progress::done;
+}
+
+} // namespace detail
+
+/**
+ * @brief Lets the kernel coalesce datagrams of one flow into one receive buffer (UDP_GRO), see datagram_batch.
+ */
+inline std::error_code enable_udp_gro(int fd, bool enable = true) noexcept
+{
+    int opt = enable ? 1 : 0;
+    if (setsockopt(fd, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) != 0) { return {errno, std::system_category()}; }
+    return {};
+}
+
+/**
+ * @brief Receives at least one and up to batch.capacity() datagrams into @p batch with one recvmmsg().
+ *
+ * Completes as soon as the socket has anything queued, batch.size() then holds the number of datagrams received.
+ */
+auto recv_batch(io_loop &loop, int fd, datagram_batch &batch, int flags = 0,
+                time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_recv_batch{loop, fd, batch, flags, complete_by};
+}
+
+/**
+ * @brief Sends the datagrams added to @p batch, each to its peer, with as few sendmmsg() calls as possible.
+ *
+ * The result is io_result::done once all of them were sent. On io_result::error @p datagrams_sent is the index of
+ * the datagram the kernel refused, the ones before it went out.
+ */
+auto send_batch(io_loop &loop, int fd, datagram_batch &batch, size_t &datagrams_sent, int flags = 0,
+                time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_send_batch{loop, fd, batch, datagrams_sent, flags, complete_by};
+}
+
+/**
+ * @brief Sends @p len bytes as datagrams of @p segment_size bytes to @p peer, the last one possibly shorter, with
+ * UDP segmentation offload.
+ *
+ * The result is io_result::done once all of them were sent, @p bytes_sent counts the payload that went out. Kernels
+ * or devices without segmentation offload make the first send fail and the result is io_result::error.
+ */
+auto send_segmented(io_loop &loop, int fd, const char *data, size_t len, uint16_t segment_size,
+                    const struct sock_addr &peer, size_t &bytes_sent, int flags = 0,
+                    time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_send_segmented{loop, fd, data, len, segment_size, &peer, bytes_sent, flags, complete_by};
+}
+
+/**
+ * @brief Like send_segmented() above, on a connected socket.
+ */
+auto send_segmented(io_loop &loop, int fd, const char *data, size_t len, uint16_t segment_size, size_t &bytes_sent,
+                    int flags = 0, time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_send_segmented{loop, fd, data, len, segment_size, nullptr, bytes_sent, flags, complete_by};
+}
+
+} // namespace io
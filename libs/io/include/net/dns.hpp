@@ -0,0 +1,207 @@
+#pragma once
+
+#include <io/io.hpp>
+#include <net/sockaddr.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace io
+{
+
+/**
+ * @brief Error codes of the DNS resolver.
+ */
+enum class dns_errc
+{
+    not_found      = 1, //!< the name doesn't exist (NXDOMAIN)
+    no_data        = 2, //!< the name exists but has no address of the requested family
+    timeout        = 3, //!< no server answered in time
+    server_failure = 4, //!< every server failed or refused the query
+    bad_response   = 5, //!< malformed or mismatched response
+    invalid_name   = 6, //!< not a valid host name
+    bad_service    = 7, //!< unknown service name
+};
+
+class dns_error_category : public std::error_category
+{
+  public:
+    static const dns_error_category &instance()
+    {
+        static dns_error_category category;
+        return category;
+    }
+
+    const char *name() const noexcept override { return "dns"; }
+
+    std::string message(int value) const override
+    {
+        switch (static_cast<dns_errc>(value))
+        {
+        case dns_errc::not_found: return "Host not found";
+        case dns_errc::no_data: return "No address for the host";
+        case dns_errc::timeout: return "DNS query timed out";
+        case dns_errc::server_failure: return "DNS server failure";
+        case dns_errc::bad_response: return "Malformed DNS response";
+        case dns_errc::invalid_name: return "Invalid host name";
+        case dns_errc::bad_service: return "Unknown service";
+        }
+        return "Unknown DNS error";
+    }
+};
+
+inline std::error_code make_error_code(dns_errc e) { return {static_cast<int>(e), dns_error_category::instance()}; }
+
+/**
+ * @brief Settings of a dns_resolver.
+ */
+struct dns_config
+{
+    /// @brief Servers, tried in order, port 53 unless given.
+    std::vector<sock_addr> servers;
+    /// @brief How long to wait for an answer from one server.
+    std::chrono::milliseconds timeout{5000};
+    /// @brief How many times every server is tried.
+    int attempts = 2;
+
+    /// @brief Cached answers live at most this long, whatever their TTL says.
+    std::chrono::seconds max_ttl{86400};
+    /// @brief Lifetime of a negative answer when the response carries no SOA record.
+    std::chrono::seconds negative_ttl{30};
+    /// @brief Negative answers live at most this long.
+    std::chrono::seconds max_negative_ttl{3600};
+    /// @brief Upper bound of the cache, expired entries go first.
+    size_t max_cache_entries = 4096;
+
+    /**
+     * @brief Reads the nameservers and the timeout/attempts options from a resolv.conf file.
+     *
+     * Falls back to 127.0.0.1 when the file has no usable nameserver.
+     */
+    static dns_config from_resolv_conf(const std::string &path = "/etc/resolv.conf");
+};
+
+/**
+ * @brief Non-blocking DNS stub resolver running on an io_loop.
+ *
+ * Looks A and AAAA records up over UDP with the servers of the configuration and returns them as a list of
+ * sock_addr, IPv6 first. Numeric addresses and "localhost" are answered without a query, other names are taken as
+ * fully qualified (no search domains, no /etc/hosts).
+ *
+ * Answers are cached for their TTL, the smallest one of the records used. "No such name" and "no records of this
+ * type" are cached too, for the SOA TTL of the response (RFC 2308). Lookups of a name that is already being queried
+ * don't send a query of their own, they wait for the answer of the first one.
+ *
+ * Every query uses its own connected UDP socket, so the kernel picks a random source port and drops datagrams from
+ * other sources, and a random query id. Responses with the TC bit and no usable answer count as a failure of that
+ * server, there is no TCP fallback.
+ *
+ * @code
+ * auto addrs = co_await dns_resolver::instance(loop).resolve("example.com", "443");
+ * for (auto &addr : addrs) { ... }
+ * @endcode
+ */
+class dns_resolver
+{
+  public:
+    explicit dns_resolver(io_loop &loop, dns_config config = dns_config::from_resolv_conf());
+    ~dns_resolver();
+
+    dns_resolver(const dns_resolver &)            = delete;
+    dns_resolver &operator=(const dns_resolver &) = delete;
+
+    /**
+     * @brief The resolver of @p loop, created with the system configuration on first use.
+     *
+     * It lives as long as @p loop, the loop owns it.
+     */
+    static dns_resolver &instance(io_loop &loop);
+
+    /**
+     * @brief Looks @p name up.
+     *
+     * @param name Host name or numeric address.
+     * @param service Port number or service name, the addresses have port 0 if empty.
+     * @param family AF_INET, AF_INET6 or AF_UNSPEC for both.
+     * @param socktype Socket type of the returned addresses.
+     * @param error Set to the reason when the list is empty, if not null.
+     * @return The addresses, empty if the lookup failed.
+     */
+    io_func<std::vector<sock_addr>> resolve(std::string name, std::string service = {}, int family = AF_UNSPEC,
+                                            int socktype = SOCK_STREAM, std::error_code *error = nullptr);
+
+    [[nodiscard]] const dns_config &config() const noexcept { return config_; }
+
+    /// @brief Number of queries sent to a server, retries included.
+    [[nodiscard]] uint64_t queries_sent() const noexcept { return queries_sent_; }
+    [[nodiscard]] size_t cache_size() const noexcept { return cache_.size(); }
+    void clear_cache() noexcept { cache_.clear(); }
+
+  private:
+    /// @brief Address bytes of an A (first 4 bytes) or AAAA record.
+    using address_t = std::array<uint8_t, 16>;
+
+    struct cache_entry
+    {
+        std::vector<address_t> addrs;
+        std::error_code error; //!< set for a negative answer
+        time_point_t expires;
+    };
+
+    /**
+     * @brief A query in flight, the lookups of the same name and type wait for its answer.
+     */
+    struct pending
+    {
+        std::vector<detail::io_promise *> waiters;
+        std::vector<address_t> addrs;
+        std::error_code error;
+        bool done{false};
+    };
+
+    struct pending_waiter;
+
+    /// @brief Cache and query key, the record type followed by the normalized name.
+    static std::string make_key(std::string_view name, uint16_t type);
+
+    /**
+     * @brief Asks the servers, caches the answer and wakes the lookups waiting for it.
+     */
+    io_task query(std::string key, std::string name, uint16_t type, std::shared_ptr<pending> state);
+
+    void finish(const std::string &key, pending &state, uint32_t ttl) noexcept;
+    void store(const std::string &key, const pending &state, uint32_t ttl);
+    uint16_t next_id() noexcept;
+
+    io_loop &loop_;
+    dns_config config_;
+    std::unordered_map<std::string, cache_entry> cache_;
+    std::unordered_map<std::string, std::shared_ptr<pending>> pending_;
+    uint32_t id_state_;
+    uint64_t queries_sent_{0};
+};
+
+/**
+ * @brief Looks @p name up with the resolver of @p loop.
+ */
+inline io_func<std::vector<sock_addr>> dns_resolve(io_loop &loop, std::string name, std::string service = {},
+                                                   int family = AF_UNSPEC, int socktype = SOCK_STREAM)
+{
+    return dns_resolver::instance(loop).resolve(std::move(name), std::move(service), family, socktype);
+}
+
+} // namespace io
+
+namespace std
+{
+template <> struct is_error_code_enum<io::dns_errc> : true_type
+{
+};
+} // namespace std
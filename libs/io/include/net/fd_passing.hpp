@@ -0,0 +1,220 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace io
+{
+
+/// @brief The most descriptors one message carries, the kernel's SCM_MAX_FD.
+inline constexpr size_t MAX_PASSED_FDS = 253;
+
+namespace detail
+{
+
+/**
+ * @brief Sends descriptors with SCM_RIGHTS over a Unix socket, along with a payload of at least one byte.
+ *
+ * The descriptors go with the first sendmsg(), a stream socket may take the rest of the payload in further ones.
+ * The receiver gets duplicates, the sender's descriptors stay open and are the caller's to close.
+ */
+struct io_send_fds : public io_transfer_op
+{
+    io_send_fds()                    = delete;
+    io_send_fds(const io_send_fds &) = delete;
+
+    io_send_fds(io_loop &loop, int fd, std::span<const int> fds, std::string_view data, const struct sock_addr *to,
+                size_t &bytes_sent, time_point_t complete_by) noexcept
+    : io_transfer_op{loop, data.empty() ? 1 : data.size(), bytes_sent, complete_by},
+      fds_{fds},
+      data_{data.empty() ? std::string_view{"\0", 1} : data},
+      to_{to}
+    {
+        wait_fd_ = fd;
+    }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        if (fds_.size() > MAX_PASSED_FDS)
+        {
+            error_ = std::make_error_code(std::errc::argument_list_too_long);
+            return progress::error;
+        }
+
+        while (bytes_transferred_ < len_)
+        {
+            struct iovec iov = {const_cast<char *>(data_.data()) + bytes_transferred_, len_ - bytes_transferred_};
+            struct msghdr msg = {};
+            msg.msg_iov       = &iov;
+            msg.msg_iovlen    = 1;
+            if (to_ != nullptr)
+            {
+                msg.msg_name    = const_cast<struct sockaddr *>(to_->sockaddr());
+                msg.msg_namelen = to_->len();
+            }
+
+            alignas(struct cmsghdr) char control[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+            if (bytes_transferred_ == 0 && !fds_.empty())
+            {
+                msg.msg_control    = control;
+                msg.msg_controllen = CMSG_SPACE(fds_.size() * sizeof(int));
+
+                auto *cmsg       = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type  = SCM_RIGHTS;
+                cmsg->cmsg_len   = CMSG_LEN(fds_.size() * sizeof(int));
+                memcpy(CMSG_DATA(cmsg), fds_.data(), fds_.size() * sizeof(int));
+            }
+
+            auto ret = ::sendmsg(wait_fd_, &msg, MSG_NOSIGNAL);
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN) { return progress::wait_write; }
+
+                handle_socket_error(error_, "send descriptors");
+                return progress::error;
+            }
+
+            bytes_transferred_ += static_cast<size_t>(ret);
+        }
+
+        return progress::done;
+    }
+
+  private:
+    std::span<const int> fds_;
+    std::string_view data_;
+    const struct sock_addr *to_;
+};
+
+/**
+ * @brief Receives one message and the descriptors that came with it.
+ *
+ * The descriptors are appended to @e fds close-on-exec, they belong to the caller from then on. A message that
+ * carried more descriptors than there is room for, @e max_fds rounded up to the control message alignment, fails
+ * with EMSGSIZE and the ones that got through are closed.
+ */
+struct io_recv_fds : public io_transfer_op
+{
+    io_recv_fds()                    = delete;
+    io_recv_fds(const io_recv_fds &) = delete;
+
+    io_recv_fds(io_loop &loop, int fd, std::vector<int> &fds, char *buffer, size_t buffer_size,
+                size_t &bytes_received, size_t max_fds, time_point_t complete_by) noexcept
+    : io_transfer_op{loop, buffer_size, bytes_received, complete_by},
+      fds_{fds},
+      buffer_{buffer},
+      control_len_{CMSG_SPACE(std::min(max_fds, MAX_PASSED_FDS) * sizeof(int))},
+      control_(control_len_ / sizeof(struct cmsghdr) + 1)
+    {
+        wait_fd_ = fd;
+    }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        while (true)
+        {
+            struct iovec iov  = {buffer_, len_};
+            struct msghdr msg = {};
+            msg.msg_iov        = &iov;
+            msg.msg_iovlen     = 1;
+            msg.msg_control    = control_.data();
+            msg.msg_controllen = control_len_;
+
+            auto ret = ::recvmsg(wait_fd_, &msg, MSG_CMSG_CLOEXEC);
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN) { return progress::wait_read; }
+
+                handle_socket_error(error_, "receive descriptors");
+                return progress::error;
+            }
+
+            size_t first = fds_.size();
+            for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) { continue; }
+
+                size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    int passed;
+                    memcpy(&passed, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                    fds_.push_back(passed);
+                }
+            }
+
+            if (msg.msg_flags & MSG_CTRUNC)
+            {
+                // the kernel closed the ones that didn't fit, the sender meant them to go together
+                for (size_t i = first; i < fds_.size(); ++i) { ::close(fds_[i]); }
+                fds_.resize(first);
+                error_ = std::make_error_code(std::errc::message_size);
+                LOG(warn) << "Descriptors received on socket " << wait_fd_ << " didn't fit";
+                return progress::error;
+            }
+
+            if (ret == 0 && fds_.size() == first) { return progress::closed; }
+            bytes_transferred_ = static_cast<size_t>(ret);
+            return progress::done;
+        }
+    }
+
+  private:
+    std::vector<int> &fds_;
+    char *buffer_;
+    size_t control_len_;
+    std::vector<struct cmsghdr> control_; //!< room for the control message, aligned for it
+};
+
+} // namespace detail
+
+/**
+ * @brief Passes @p fds to the process at the other end of the connected Unix socket @p fd.
+ *
+ * @p data goes with them, one zero byte if it is empty since a message without payload doesn't carry descriptors on
+ * a stream socket. The result is io_result::done once all of @p data was sent. @p fds and @p data have to stay
+ * valid until then.
+ */
+auto send_fds(io_loop &loop, int fd, std::span<const int> fds, std::string_view data, size_t &bytes_sent,
+              time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_send_fds{loop, fd, fds, data, nullptr, bytes_sent, complete_by};
+}
+
+/**
+ * @brief Passes @p fds in a datagram to @p to, from the unconnected Unix datagram socket @p fd.
+ */
+auto send_fds(io_loop &loop, int fd, const struct sock_addr &to, std::span<const int> fds, std::string_view data,
+              size_t &bytes_sent, time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_send_fds{loop, fd, fds, data, &to, bytes_sent, complete_by};
+}
+
+/**
+ * @brief Receives one message of up to @p buffer_size bytes on the Unix socket @p fd, with the descriptors passed
+ * along, which are appended to @p fds.
+ *
+ * The result is io_result::closed if the peer closed the connection without sending any.
+ */
+auto recv_fds(io_loop &loop, int fd, std::vector<int> &fds, char *buffer, size_t buffer_size, size_t &bytes_received,
+              size_t max_fds = MAX_PASSED_FDS, time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_recv_fds{loop, fd, fds, buffer, buffer_size, bytes_received, max_fds, complete_by};
+}
+
+} // namespace io
@@ -1,10 +1,446 @@
 #pragma once
 
+#include <io/hash.hpp>
 #include <net/sockaddr_def.hpp>
 
 namespace io
 {
 
+namespace detail
+{
+
+/**
+ * @brief Zero padded copy of a short address, big enough for the mask helpers and for reading a few bytes past any
+ * character of the address.
+ */
+struct addr_buffer
+{
+    alignas(16) char bytes[64];
+
+    bool load(const char *src, const char *end, size_t max) noexcept
+    {
+        size_t len = end - src;
+        if (len > max) { return false; }
+        memset(bytes, 0, sizeof(bytes));
+        memcpy(bytes, src, len);
+        return true;
+    }
+
+    /// @brief Bit i is set where bytes[i] equals @p c, for the first 48 bytes.
+    uint64_t equal_mask(char c) const noexcept
+    {
+#ifdef __SSE2__
+        const __m128i needle = _mm_set1_epi8(c);
+        uint64_t mask        = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i *>(bytes) + i);
+            mask |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
+        }
+        return mask;
+#else
+        uint64_t mask = 0;
+        for (int i = 0; i < 48; ++i) { mask |= uint64_t(bytes[i] == c) << i; }
+        return mask;
+#endif
+    }
+
+    /// @brief Bit i is set where bytes[i] is in [lo, hi], for the first 48 bytes.
+    uint64_t range_mask(char lo, char hi) const noexcept
+    {
+#ifdef __SSE2__
+        // ASCII only, bytes >= 0x80 compare as negative and never match
+        const __m128i below = _mm_set1_epi8(static_cast<char>(lo - 1));
+        const __m128i above = _mm_set1_epi8(static_cast<char>(hi + 1));
+        uint64_t mask       = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i *>(bytes) + i);
+            __m128i in    = _mm_and_si128(_mm_cmpgt_epi8(chunk, below), _mm_cmplt_epi8(chunk, above));
+            mask |= uint64_t(uint32_t(_mm_movemask_epi8(in))) << (16 * i);
+        }
+        return mask;
+#else
+        uint64_t mask = 0;
+        for (int i = 0; i < 48; ++i) { mask |= uint64_t(bytes[i] >= lo && bytes[i] <= hi) << i; }
+        return mask;
+#endif
+    }
+};
+
+/**
+ * @brief Dotted quad of 1-3 digit decimal octets without leading zeros, the form nearly every IPv4 address comes in.
+ *
+ * Finds the dots with one compare over the whole string instead of branching on every character.
+ * @return false if the string isn't in that form, the full parser decides then.
+ */
+inline bool parse_ipv4_quad(const char *src, const char *end, struct in_addr &out) noexcept
+{
+    addr_buffer buf;
+    size_t len = end - src;
+    if (len < 7 || !buf.load(src, end, 15)) { return false; }
+
+    uint64_t dots = buf.equal_mask('.');
+    if ((dots | buf.range_mask('0', '9')) != (1ull << len) - 1 || __builtin_popcountll(dots) != 3) { return false; }
+
+    // weights of the digits of a 1, 2 or 3 digit octet, the bytes after it are multiplied by 0
+    static constexpr int weights[4][3] = {{0, 0, 0}, {1, 0, 0}, {10, 1, 0}, {100, 10, 1}};
+
+    uint32_t addr = 0;
+    size_t start  = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        size_t stop = i < 3 ? __builtin_ctzll(dots) : len;
+        size_t n    = stop - start;
+        dots &= dots - 1;
+
+        const char *p = buf.bytes + start;
+        if (n == 0 || n > 3 || (n > 1 && p[0] == '0')) { return false; }
+
+        int value = (p[0] - '0') * weights[n][0] + (p[1] - '0') * weights[n][1] + (p[2] - '0') * weights[n][2];
+        if (value > 255) { return false; }
+
+        addr  = addr << 8 | value;
+        start = stop + 1;
+    }
+
+    out.s_addr = htonl(addr);
+    return true;
+}
+
+/**
+ * @brief Plain IPv6 address of hex groups and at most one "::", without an embedded IPv4 part or scope id.
+ *
+ * Splits at the colons found with one compare over the whole string and converts every group without a branch per
+ * digit.
+ * @return false if the string isn't in that form or is invalid, the full parser decides then.
+ */
+inline bool parse_ipv6_groups(const char *src, const char *end, struct in6_addr &out) noexcept
+{
+    addr_buffer buf;
+    size_t len = end - src;
+    if (len < 2 || !buf.load(src, end, 39)) { return false; }
+
+    uint64_t colons = buf.equal_mask(':');
+    uint64_t hex    = buf.range_mask('0', '9') | buf.range_mask('a', 'f') | buf.range_mask('A', 'F');
+    if ((colons | hex) != (1ull << len) - 1) { return false; }
+
+    // token boundaries, a "::" shows up as an empty token
+    size_t starts[10];
+    size_t lengths[10];
+    size_t tokens = 0;
+    size_t start  = 0;
+    for (uint64_t rest = colons;; rest &= rest - 1)
+    {
+        if (tokens == 10) { return false; }
+        size_t stop       = rest ? __builtin_ctzll(rest) : len;
+        starts[tokens]    = start;
+        lengths[tokens++] = stop - start;
+        if (!rest) { break; }
+        start = stop + 1;
+    }
+
+    size_t first = 0;
+    size_t last  = tokens;
+    // a leading or trailing "::" makes two empty tokens, keep one
+    if (lengths[0] == 0)
+    {
+        if (lengths[1] != 0) { return false; }
+        ++first;
+    }
+    if (lengths[last - 1] == 0 && last - 1 > first)
+    {
+        if (lengths[last - 2] != 0) { return false; }
+        --last;
+    }
+
+    uint16_t words[8] = {0};
+    size_t groups     = 0;
+    size_t gap        = 8;
+    for (size_t t = first; t < last; ++t)
+    {
+        size_t n = lengths[t];
+        if (n == 0)
+        {
+            if (gap != 8) { return false; }
+            gap = groups;
+            continue;
+        }
+        if (n > 4 || groups == 8) { return false; }
+
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(buf.bytes + starts[t]);
+        unsigned value         = 0;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            unsigned digit = (p[k] & 0xf) + 9 * (p[k] >> 6);
+            value          = k < n ? value << 4 | digit : value;
+        }
+        words[groups++] = static_cast<uint16_t>(value);
+    }
+
+    // "::" stands for at least one zero group
+    if (gap == 8 ? groups != 8 : groups == 8) { return false; }
+
+    uint8_t *bytes = out.s6_addr;
+    size_t zeros   = 8 - groups;
+    for (size_t i = 0, w = 0; i < 8; ++i)
+    {
+        uint16_t word    = (i >= gap && i < gap + zeros) ? 0 : words[w++];
+        bytes[2 * i]     = static_cast<uint8_t>(word >> 8);
+        bytes[2 * i + 1] = static_cast<uint8_t>(word);
+    }
+    return true;
+}
+
+/**
+ * @brief strtoul(base 10) over [src, end): leading blanks, a sign, ULONG_MAX on overflow.
+ * @return The end of the number, @p src if there is none.
+ */
+inline const char *parse_ulong(const char *src, const char *end, unsigned long &value) noexcept
+{
+    const char *p = src;
+    while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) { ++p; }
+
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) { ++p; }
+    if (p == end || *p < '0' || *p > '9') { return src; }
+
+    bool overflow = false;
+    value         = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        overflow = overflow || __builtin_mul_overflow(value, 10ul, &value) || __builtin_add_overflow(value, *p - '0', &value);
+    }
+
+    if (overflow) { value = ULONG_MAX; }
+    else if (negative) { value = -value; }
+    return p;
+}
+
+/**
+ * @brief Parses an IPv4 address the way inet_aton does, which is what getaddrinfo accepts for AF_INET.
+ *
+ * One to four parts separated by dots, each decimal, octal (leading 0) or hex (leading 0x), the last part fills the
+ * remaining bytes ("127.1" is 127.0.0.1). Nothing may follow the address.
+ */
+inline bool parse_ipv4(const char *src, const char *end, struct in_addr &out) noexcept
+{
+    if (parse_ipv4_quad(src, end, out)) { return true; }
+
+    uint32_t parts[4];
+    int count = 0;
+
+    while (true)
+    {
+        if (src == end || *src < '0' || *src > '9') { return false; }
+
+        uint64_t value = 0;
+        if (*src == '0' && src + 2 < end && (src[1] == 'x' || src[1] == 'X') && isxdigit(static_cast<unsigned char>(src[2])))
+        {
+            for (src += 2; src < end && isxdigit(static_cast<unsigned char>(*src)); ++src)
+            {
+                value = (value << 4) | (*src <= '9' ? *src - '0' : (*src | 0x20) - 'a' + 10);
+                if (value > 0xffffffff) { return false; }
+            }
+        }
+        else
+        {
+            unsigned base = *src == '0' ? 8 : 10;
+            for (; src < end && *src >= '0' && *src < static_cast<char>('0' + base); ++src)
+            {
+                value = value * base + (*src - '0');
+                if (value > 0xffffffff) { return false; }
+            }
+        }
+
+        if (src < end && *src == '.')
+        {
+            if (count == 3 || value > 0xff) { return false; }
+            parts[count++] = static_cast<uint32_t>(value);
+            ++src;
+            continue;
+        }
+
+        if (src != end) { return false; }
+
+        // the last part fills the remaining bytes
+        static constexpr uint64_t limits[] = {0xffffffff, 0xffffff, 0xffff, 0xff};
+        if (value > limits[count]) { return false; }
+
+        uint32_t addr = static_cast<uint32_t>(value);
+        for (int i = 0; i < count; ++i) { addr |= parts[i] << (24 - 8 * i); }
+        out.s_addr = htonl(addr);
+        return true;
+    }
+}
+
+/**
+ * @brief Parses a strict dotted quad, four decimal octets without leading zeros (the tail of an IPv6 address).
+ */
+inline bool parse_ipv4_strict(const char *src, const char *end, uint8_t *out) noexcept
+{
+    int octets     = 0;
+    int digits     = 0;
+    unsigned value = 0;
+
+    for (; src < end; ++src)
+    {
+        if (*src >= '0' && *src <= '9')
+        {
+            if (digits > 0 && value == 0) { return false; }
+            value = value * 10 + (*src - '0');
+            if (value > 255) { return false; }
+            ++digits;
+        }
+        else if (*src == '.' && digits > 0 && octets < 3)
+        {
+            out[octets++] = static_cast<uint8_t>(value);
+            digits = value = 0;
+        }
+        else { return false; }
+    }
+
+    if (digits == 0 || octets != 3) { return false; }
+    out[3] = static_cast<uint8_t>(value);
+    return true;
+}
+
+/**
+ * @brief Parses an IPv6 address the way inet_pton does, without a scope id.
+ */
+inline bool parse_ipv6(const char *src, const char *end, struct in6_addr &out) noexcept
+{
+    if (parse_ipv6_groups(src, end, out)) { return true; }
+
+    uint8_t bytes[16] = {0};
+    uint8_t *tp       = bytes;
+    uint8_t *colonp   = nullptr;
+
+    if (src == end) { return false; }
+    // a leading colon only starts a "::"
+    if (*src == ':' && (++src == end || *src != ':')) { return false; }
+
+    const char *token = src;
+    int digits        = 0;
+    unsigned value    = 0;
+
+    while (src < end)
+    {
+        char ch   = *src++;
+        int digit = ch >= '0' && ch <= '9'   ? ch - '0'
+                    : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10
+                    : ch >= 'A' && ch <= 'F' ? ch - 'A' + 10
+                                             : -1;
+        if (digit >= 0)
+        {
+            if (digits == 4) { return false; }
+            value = (value << 4) | digit;
+            ++digits;
+            continue;
+        }
+
+        if (ch == ':')
+        {
+            token = src;
+            if (digits == 0)
+            {
+                if (colonp) { return false; }
+                colonp = tp;
+                continue;
+            }
+            if (src == end || tp + 2 > bytes + 16) { return false; }
+            *tp++  = static_cast<uint8_t>(value >> 8);
+            *tp++  = static_cast<uint8_t>(value);
+            digits = value = 0;
+            continue;
+        }
+
+        if (ch == '.' && tp + 4 <= bytes + 16 && parse_ipv4_strict(token, end, tp))
+        {
+            tp += 4;
+            digits = 0;
+            break;
+        }
+
+        return false;
+    }
+
+    if (digits > 0)
+    {
+        if (tp + 2 > bytes + 16) { return false; }
+        *tp++ = static_cast<uint8_t>(value >> 8);
+        *tp++ = static_cast<uint8_t>(value);
+    }
+
+    if (colonp)
+    {
+        // "::" must stand for at least one zero group
+        if (tp == bytes + 16) { return false; }
+        size_t tail = tp - colonp;
+        memmove(bytes + 16 - tail, colonp, tail);
+        memset(colonp, 0, bytes + 16 - tail - colonp);
+        tp = bytes + 16;
+    }
+
+    if (tp != bytes + 16) { return false; }
+    memcpy(&out, bytes, 16);
+    return true;
+}
+
+/**
+ * @brief Parses the scope id after the '%' of an IPv6 address, an interface name for link local addresses or a
+ * number.
+ */
+inline bool parse_ipv6_scope(const char *scope, const struct in6_addr &addr, uint32_t &out) noexcept
+{
+    if (IN6_IS_ADDR_LINKLOCAL(&addr) || IN6_IS_ADDR_MC_LINKLOCAL(&addr))
+    {
+        if (uint32_t index = if_nametoindex(scope)) { out = index; return true; }
+    }
+
+    if (*scope < '0' || *scope > '9') { return false; }
+
+    uint64_t value = 0;
+    for (; *scope >= '0' && *scope <= '9'; ++scope) { value = std::min<uint64_t>(value * 10 + (*scope - '0'), 1ull << 32); }
+    if (*scope != '\0' || value > 0xffffffff) { return false; }
+
+    out = static_cast<uint32_t>(value);
+    return true;
+}
+
+/**
+ * @brief Resolves the socket type and protocol of an AF_INET/AF_INET6 address like getaddrinfo does: the first
+ * known combination that matches the hints, zero matches anything.
+ */
+inline bool inet_socktype(uint16_t socktype, uint16_t proto, uint16_t &out_type, uint16_t &out_proto) noexcept
+{
+    struct entry
+    {
+        uint16_t socktype;
+        uint16_t protocol;
+        bool any_protocol;
+    };
+
+    static constexpr entry table[] = {
+        {SOCK_STREAM, IPPROTO_TCP, false},    {SOCK_DGRAM, IPPROTO_UDP, false},  {SOCK_DCCP, IPPROTO_DCCP, false},
+        {SOCK_DGRAM, IPPROTO_UDPLITE, false}, {SOCK_STREAM, IPPROTO_SCTP, false}, {SOCK_SEQPACKET, IPPROTO_SCTP, false},
+        {SOCK_RAW, 0, true},
+    };
+
+    for (const auto &e : table)
+    {
+        if ((socktype == 0 || socktype == e.socktype) && (proto == 0 || e.any_protocol || proto == e.protocol))
+        {
+            out_type  = e.socktype;
+            out_proto = e.any_protocol ? proto : e.protocol;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace detail
+
 sock_addr::sock_addr() : len_(sizeof(addr_)), type_(0), protocol_(0), prefix_(0), str_valid_(false) { memset(&addr_, 0, sizeof(addr_)); }
 
 sock_addr::sock_addr(const struct sockaddr_in &sa, uint8_t prefix, uint16_t socktype, uint16_t proto)
@@ -170,49 +606,39 @@ inline bool sock_addr::parse_into_sockaddr_common(const std::string_view &addres
 
 inline bool sock_addr::parse_inet_address(const std::string_view &address, uint8_t family, uint16_t socktype, uint16_t proto)
 {
-    if (address.empty()) { return false; }
-
-    char addr_copy[address.size() + 1];
-    char port[6]             = {0};
-    uint8_t prefix           = 0;
-    bool has_port            = false;
-    bool has_prefix          = false;
-    bool error_cuz_of_braket = false;
-
-    strncpy(addr_copy, address.data(), address.size());
-    addr_copy[address.size()] = '\0';
-    char *addr                = addr_copy;
+    // Works on the view in place, the parts end at the first ']', '/' or port ':'
+    std::string_view str = address.substr(0, address.find('\0'));
+    if (str.empty()) { return false; }
+
+    const char *begin = str.data();
+    const char *end   = begin + str.size();
+    const char *addr  = begin;
+    char port[6]      = {0};
+    uint8_t prefix    = 0;
+    bool has_port     = false;
+    bool has_prefix   = false;
 
     // Handle brackets for IPv6
-    if (*addr == '[')
-    {
-        addr++;
-        error_cuz_of_braket = true;
-    }
+    bool error_cuz_of_braket = *addr == '[';
+    if (error_cuz_of_braket) { addr++; }
 
     // Find different parts of the address string
-    char *bracket_end  = strchr(addr, ']');
-    char *port_start   = strchr(bracket_end ? bracket_end : addr, ':');
-    char *prefix_start = strchr(bracket_end ? bracket_end : addr, '/');
+    const char *bracket_end  = static_cast<const char *>(memchr(addr, ']', end - addr));
+    const char *search       = bracket_end ? bracket_end : addr;
+    const char *port_start   = static_cast<const char *>(memchr(search, ':', end - search));
+    const char *prefix_start = static_cast<const char *>(memchr(search, '/', end - search));
+    const char *host_end     = bracket_end ? bracket_end : end;
 
-    // Handle IPv6 bracket closure
-    if (bracket_end)
-    {
-        error_cuz_of_braket = false;
-        *bracket_end        = '\0';
-        // Adjust port/prefix pointers if they're before the bracket end
-        if (port_start && port_start < bracket_end) port_start = strchr(bracket_end + 1, ':');
-        if (prefix_start && prefix_start < bracket_end) prefix_start = strchr(bracket_end + 1, '/');
-    }
+    if (bracket_end) { error_cuz_of_braket = false; }
 
     // Process prefix if present
     if (prefix_start)
     {
-        char *prefix_str = prefix_start + 1;
-        char *endptr;
-        unsigned long ival = strtoul(prefix_str, &endptr, 10);
+        unsigned long ival;
+        const char *prefix_str = prefix_start + 1;
+        const char *endptr     = detail::parse_ulong(prefix_str, end, ival);
 
-        if (endptr == prefix_str || (*endptr != '\0' && *endptr != ':'))
+        if (endptr == prefix_str || (endptr != end && *endptr != ':'))
         {
             LOG(error).print("Invalid prefix format");
             return false;
@@ -222,26 +648,27 @@ inline bool sock_addr::parse_inet_address(const std::string_view &address, uint8
         has_prefix = true;
 
         // If there's a port after the prefix
-        if (*endptr == ':') { port_start = endptr; }
-        *prefix_start = '\0';
+        if (endptr != end) { port_start = endptr; }
+        host_end = std::min(host_end, prefix_start);
     }
 
     // Process port if present
     if (port_start)
     {
+        unsigned long ival;
         const char *port_str = port_start + 1;
-        char *endptr;
-        unsigned long ival = strtoul(port_str, &endptr, 10);
+        const char *port_end = prefix_start > port_start ? prefix_start : end;
+        const char *endptr   = detail::parse_ulong(port_str, port_end, ival);
 
-        if (endptr == port_str || *endptr != '\0' || ival > 65535)
+        if (endptr == port_str || endptr != port_end || ival > 65535)
         {
             LOG(error).print("Invalid port number");
             return false;
         }
 
-        strncpy(port, port_str, sizeof(port) - 1);
-        has_port    = true;
-        *port_start = '\0';
+        memcpy(port, port_str, std::min<size_t>(port_end - port_str, sizeof(port) - 1));
+        has_port = true;
+        host_end = std::min(host_end, port_start);
     }
 
     if (error_cuz_of_braket)
@@ -250,60 +677,100 @@ inline bool sock_addr::parse_inet_address(const std::string_view &address, uint8
         return false;
     }
 
+    std::string_view host(addr, std::max(host_end, addr) - addr);
+
     // Check for localhost before wildcard
-    if (strcmp(addr, "localhost") == 0) { return setup_localhost(has_port ? port : nullptr, family, socktype, proto); }
+    if (host == "localhost") { return setup_localhost(has_port ? port : nullptr, family, socktype, proto); }
 
     // Handle wildcard addresses
-    if (*addr == '*' || strncmp(addr, "any", 3) == 0)
+    if (host.starts_with('*') || host.starts_with("any"))
     {
         return setup_wildcard(has_port ? port : nullptr, family, socktype, proto);
     }
 
-    // Setup and call getaddrinfo
-    struct addrinfo hints, *res = NULL;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family   = family;
-    hints.ai_socktype = socktype;
-    hints.ai_protocol = proto;
-    hints.ai_flags    = AI_NUMERICHOST | AI_NUMERICSERV;
+    return parse_numeric_host(host, has_port ? port : nullptr, family, socktype, proto, has_prefix ? &prefix : nullptr);
+}
 
-    int error;
-    if ((error = getaddrinfo(addr, (has_port ? port : NULL), &hints, &res)) == 0)
+inline bool sock_addr::parse_numeric_host(std::string_view host, const char *port, uint8_t family, uint16_t socktype,
+                                          uint16_t proto, const uint8_t *prefix)
+{
+    // Same results as getaddrinfo with AI_NUMERICHOST | AI_NUMERICSERV, without its allocations and locking
+    uint16_t type     = 0;
+    uint16_t protocol = 0;
+    if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6) { return false; }
+    if (!detail::inet_socktype(socktype, proto, type, protocol) || (port && type == SOCK_RAW))
+    {
+        LOG(error).printf("Unsupported socket type %u for protocol %u", socktype, proto);
+        return false;
+    }
+
+    // the port is already checked, only its first five characters count
+    unsigned long port_value = 0;
+    if (port && detail::parse_ulong(port, port + strlen(port), port_value) != port + strlen(port)) { return false; }
+
+    uint16_t port_n    = htons(static_cast<uint16_t>(port_value));
+    const char *begin  = host.data();
+    const char *end    = begin + host.size();
+    uint8_t max_prefix = 0;
+    struct in_addr sin = {};
+    struct in6_addr sin6;
+
+    if (family != AF_INET6 && detail::parse_ipv4(begin, end, sin))
+    {
+        addr_.sin.sin_family = AF_INET;
+        addr_.sin.sin_port   = port_n;
+        addr_.sin.sin_addr   = sin;
+        len_                 = sizeof(struct sockaddr_in);
+        max_prefix           = 32;
+    }
+    else if (const char *scope = static_cast<const char *>(memchr(begin, '%', host.size()));
+             detail::parse_ipv6(begin, scope ? scope : end, sin6) && (family != AF_INET || IN6_IS_ADDR_V4MAPPED(&sin6)))
     {
-        if (res->ai_addrlen > sizeof(addr_))
+        uint32_t scope_id = 0;
+        if (scope && !detail::parse_ipv6_scope(std::string(scope + 1, end).c_str(), sin6, scope_id))
         {
-            LOG(error).print("sockaddr too large");
-            freeaddrinfo(res);
+            LOG(error) << "Invalid scope id: " << host;
             return false;
         }
 
-        // Copy address and validate prefix
-        memcpy(&addr_, res->ai_addr, res->ai_addrlen);
-        len_      = res->ai_addrlen;
-        type_     = res->ai_socktype;
-        protocol_ = res->ai_protocol;
-
-        // Now that we know the actual address family, validate the prefix
-        if (has_prefix)
+        if (family == AF_INET)
         {
-            uint8_t max_prefix = (addr_.sa.sa_family == AF_INET6) ? 128 : 32;
-            if (prefix > max_prefix)
-            {
-                LOG(error).print("Prefix out of range for address family");
-                freeaddrinfo(res);
-                len_ = 0;
-                return false;
-            }
-            prefix_ = prefix;
+            // getaddrinfo hands out IPv4-mapped addresses as IPv4 when asked for AF_INET
+            addr_.sin.sin_family = AF_INET;
+            addr_.sin.sin_port   = port_n;
+            memcpy(&addr_.sin.sin_addr, sin6.s6_addr + 12, 4);
+            len_       = sizeof(struct sockaddr_in);
+            max_prefix = 32;
+        }
+        else
+        {
+            addr_.sin6.sin6_family   = AF_INET6;
+            addr_.sin6.sin6_port     = port_n;
+            addr_.sin6.sin6_addr     = sin6;
+            addr_.sin6.sin6_scope_id = scope_id;
+            len_                     = sizeof(struct sockaddr_in6);
+            max_prefix               = 128;
         }
-        else { prefix_ = (addr_.sa.sa_family == AF_INET) ? 32 : 128; }
-
-        freeaddrinfo(res);
-        return true;
+    }
+    else
+    {
+        LOG(error) << "Invalid numeric address: " << host;
+        return false;
     }
 
-    LOG(error).printf("getaddrinfo failed: %s", gai_strerror(error));
-    return false;
+    type_     = type;
+    protocol_ = protocol;
+
+    // Now that we know the actual address family, validate the prefix
+    if (prefix && *prefix > max_prefix)
+    {
+        LOG(error).print("Prefix out of range for address family");
+        memset(&addr_, 0, sizeof(addr_));
+        len_ = 0;
+        return false;
+    }
+    prefix_ = prefix ? *prefix : max_prefix;
+    return true;
 }
 
 inline bool sock_addr::parse_unix_address(const std::string_view &path, uint16_t socktype)
@@ -629,41 +1096,32 @@ namespace std
 {
 inline size_t hash<io::sock_addr>::operator()(const io::sock_addr &addr) const noexcept
 {
-    size_t h = 0;
+    // only what operator== compares goes into the hash, the family keeps equal bytes of different kinds apart
     switch (addr.family())
     {
     case AF_INET:
     {
         const auto &sin = reinterpret_cast<const sockaddr_in &>(*addr.sockaddr());
-        h               = std::hash<uint32_t>{}(sin.sin_addr.s_addr);
-        h ^= std::hash<uint16_t>{}(sin.sin_port) + 0x9e3779b9 + (h << 6) + (h >> 2);
-        break;
+        return io::detail::hash_words(uint64_t(sin.sin_addr.s_addr) << 16 | sin.sin_port, 0, AF_INET);
     }
     case AF_INET6:
     {
-        const auto &sin6          = reinterpret_cast<const sockaddr_in6 &>(*addr.sockaddr());
-        const uint8_t *addr_bytes = sin6.sin6_addr.s6_addr;
-        for (size_t i = 0; i < 16; ++i) { h ^= std::hash<uint8_t>{}(addr_bytes[i]) + 0x9e3779b9 + (h << 6) + (h >> 2); }
-        h ^= std::hash<uint16_t>{}(sin6.sin6_port) + 0x9e3779b9 + (h << 6) + (h >> 2);
-        break;
+        const auto &sin6 = reinterpret_cast<const sockaddr_in6 &>(*addr.sockaddr());
+        const auto *bytes = sin6.sin6_addr.s6_addr;
+        return io::detail::hash_words(io::detail::hash_load64(bytes), io::detail::hash_load64(bytes + 8),
+                                      uint64_t(sin6.sin6_port) << 16 | AF_INET6);
     }
     case AF_UNIX:
     {
         const auto &sun = reinterpret_cast<const sockaddr_un &>(*addr.sockaddr());
         if (sun.sun_path[0] == '\0')
         {
-            h                = std::hash<size_t>{}(addr.len());
-            const char *path = sun.sun_path;
-            for (size_t i = 0; i < addr.len() - sizeof(sa_family_t); ++i)
-            {
-                h ^= std::hash<char>{}(path[i]) + 0x9e3779b9 + (h << 6) + (h >> 2);
-            }
+            return io::detail::hash_bytes(sun.sun_path, addr.len() - sizeof(sa_family_t), AF_UNIX);
         }
-        else { h = std::hash<std::string>{}(sun.sun_path); }
-        break;
+        return io::detail::hash_bytes(sun.sun_path, strnlen(sun.sun_path, sizeof(sun.sun_path)), AF_UNIX);
     }
     }
-    return h;
+    return 0;
 }
 
 } // namespace std
\ No newline at end of file
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/iotask.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace io
+{
+
+/// @brief A connection taken off a listening socket, the fd is non-blocking and close-on-exec.
+struct accepted_connection
+{
+    int fd{-1};
+    struct sock_addr peer;
+};
+
+namespace detail
+{
+
+/**
+ * @brief Accepts connections until the listening socket has none left or the batch is full.
+ *
+ * io_accept takes one connection per wakeup and goes back to the poller for the next one, under a burst of connects
+ * the accept queue fills faster than that. This one calls accept4() until EAGAIN, so one wakeup takes the whole queue.
+ * A wakeup that finds the queue empty, because another loop took the connections, waits again instead of finishing.
+ */
+struct io_accept_batch : private io_transfer_count, public io_transfer_op
+{
+    io_accept_batch()                        = delete;
+    io_accept_batch(const io_accept_batch &) = delete;
+
+    io_accept_batch(io_loop &loop, int fd, std::vector<accepted_connection> &connections, size_t max, bool exclusive,
+                    time_point_t complete_by) noexcept
+    : io_transfer_op{loop, max, count_, complete_by},
+      fd_{fd},
+      connections_{connections}
+    {
+        connections_.clear();
+        wait_fd_ = fd;
+        if (exclusive) { read_type_ = io_desc_type::read_exclusive; }
+    }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        while (connections_.size() < len_)
+        {
+            auto &connection          = connections_.emplace_back();
+            connection.peer.len_ref() = SOCK_ADDR_CAPACITY;
+            connection.fd             = ::accept4(fd_, connection.peer.sockaddr(), &connection.peer.len_ref(),
+                                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (connection.fd != -1) { continue; }
+
+            connections_.pop_back();
+            switch (errno)
+            {
+            case EINTR:
+            // the peer gave up while queued, or a firewall said no, the next one may be fine
+            case ECONNABORTED:
+            case EPROTO:
+            case EPERM: continue;
+            case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+            case EWOULDBLOCK:
+#endif
+                if (connections_.empty()) { return progress::wait_read; }
+                bytes_transferred_ = connections_.size();
+                return progress::done;
+            default:
+                // out of descriptors or memory, hand out what was accepted and let the next call report it
+                if (!connections_.empty()) { break; }
+                handle_socket_error(error_, "accept");
+                return progress::error;
+            }
+            break;
+        }
+
+        bytes_transferred_ = connections_.size();
+        LOG(trace) << "Accepted " << bytes_transferred_ << " connections";
+        return progress::done;
+    }
+
+  private:
+    int fd_;
+    std::vector<accepted_connection> &connections_;
+};
+
+} // namespace detail
+
+/**
+ * @brief How the loops of a listener_set share the incoming connections.
+ */
+enum class listen_mode
+{
+    reuse_port, //!< a socket per loop bound with SO_REUSEPORT, the kernel spreads the connections by hash
+    exclusive,  //!< one socket all loops wait on with EPOLLEXCLUSIVE, a connection wakes one of them
+};
+
+struct listen_options
+{
+    listen_mode mode  = listen_mode::reuse_port;
+    int backlog       = SOMAXCONN;
+    bool steer_by_cpu = false; //!< reuse_port only, see listener_set::loop_for_cpu()
+};
+
+/**
+ * @brief Listening TCP sockets for a server running an io_loop per thread.
+ *
+ * @code
+ * io::listener_set listeners;
+ * if (auto error = listeners.open(addr, threads)) { ... }
+ * // on thread i
+ * loop.schedule(io::serve(loop, listeners.fd(i), handler, listeners.exclusive()), "acceptor");
+ * @endcode
+ *
+ * With listen_mode::reuse_port every loop has a socket and an accept queue of its own, which spreads the work best
+ * but leaves the connections that hashed to a stuck loop waiting. With listen_mode::exclusive the loops take turns on
+ * one queue. An address with port 0 binds the sockets to the port the first one got, address() has it.
+ *
+ * With listen_options::steer_by_cpu a classic BPF program on the reuseport group picks the socket by the CPU that
+ * processed the connection's SYN instead of by hash, so the connections of a CPU go to the loop pinned to it and the
+ * handler runs where the kernel already has the socket in its caches:
+ *
+ * @code
+ * // on the thread for CPU cpu
+ * io::pin_thread(cpu);
+ * loop.schedule(io::serve(loop, listeners.fd(listeners.loop_for_cpu(cpu)), handler), "acceptor");
+ * @endcode
+ */
+class listener_set
+{
+  public:
+    listener_set() = default;
+    ~listener_set() { close(); }
+
+    listener_set(const listener_set &)            = delete;
+    listener_set &operator=(const listener_set &) = delete;
+
+    /**
+     * @brief Opens the sockets for @p loops loops and starts listening on @p addr.
+     */
+    [[nodiscard]] std::error_code open(const struct sock_addr &addr, size_t loops,
+                                       const listen_options &options = {}) noexcept
+    {
+        close();
+        address_ = addr;
+        mode_    = options.mode;
+        loops_   = loops;
+
+        if (options.steer_by_cpu && (options.mode != listen_mode::reuse_port || loops == 0))
+        {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        size_t sockets = options.mode == listen_mode::reuse_port ? loops : 1;
+        for (size_t i = 0; i < sockets; ++i)
+        {
+            int fd = ::socket(address_.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd == -1) { return fail("socket"); }
+            fds_.push_back(fd);
+
+            int one = 1;
+            if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0) { return fail("SO_REUSEADDR"); }
+            if (options.mode == listen_mode::reuse_port &&
+                setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0)
+            {
+                return fail("SO_REUSEPORT");
+            }
+
+            if (::bind(fd, address_.sockaddr(), address_.len()) != 0) { return fail("bind"); }
+            if (::listen(fd, options.backlog) != 0) { return fail("listen"); }
+            if (i == 0 && getsockname(fd, address_.sockaddr(), &address_.len_ref()) != 0) { return fail("getsockname"); }
+        }
+
+        if (options.steer_by_cpu && !attach_cpu_filter()) { return fail("SO_ATTACH_REUSEPORT_CBPF"); }
+
+        LOG(debug) << "Listening on " << address_.to_string() << " with " << sockets << " sockets for " << loops << " loops";
+        return {};
+    }
+
+    void close() noexcept
+    {
+        for (int fd : fds_) { ::close(fd); }
+        fds_.clear();
+    }
+
+    /// @brief The socket loop number @p loop accepts from.
+    [[nodiscard]] int fd(size_t loop) const noexcept
+    {
+        if (fds_.empty()) { return -1; }
+        return mode_ == listen_mode::reuse_port ? fds_[loop % fds_.size()] : fds_.front();
+    }
+
+    /// @brief True if the loops share a socket and have to wait on it exclusively.
+    [[nodiscard]] bool exclusive() const noexcept { return mode_ == listen_mode::exclusive; }
+
+    /**
+     * @brief The loop that gets the connections processed on @p cpu when steering by CPU.
+     *
+     * The program picks socket cpu % loops, in the order the sockets joined the group, which is that of fd().
+     */
+    [[nodiscard]] size_t loop_for_cpu(int cpu) const noexcept
+    {
+        return loops_ == 0 || cpu < 0 ? 0 : static_cast<size_t>(cpu) % loops_;
+    }
+
+    [[nodiscard]] size_t loops() const noexcept { return loops_; }
+    [[nodiscard]] const struct sock_addr &address() const noexcept { return address_; }
+
+  private:
+    /// @brief Has the reuseport group return socket cpu % loops for each connection.
+    bool attach_cpu_filter() noexcept
+    {
+        struct sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(loops_)},
+            {BPF_RET | BPF_A, 0, 0, 0},
+        };
+        struct sock_fprog program = {static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+
+        // one socket attaches it for the whole group
+        return setsockopt(fds_.front(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+    }
+
+    std::error_code fail(const char *operation) noexcept
+    {
+        std::error_code error;
+        detail::handle_socket_error(error, operation);
+        close();
+        return error;
+    }
+
+    std::vector<int> fds_;
+    struct sock_addr address_;
+    listen_mode mode_{listen_mode::reuse_port};
+    size_t loops_{0};
+};
+
+/// @brief Connections an accept_batch() takes per wakeup unless told otherwise.
+constexpr size_t DEFAULT_ACCEPT_BATCH = 64;
+
+/**
+ * @brief Accepts every connection queued on the listening socket @p fd, up to @p max, into @p connections.
+ *
+ * Finishes with io_result::done once there was at least one. With @p exclusive only one of the loops waiting on a
+ * shared @p fd is woken per connection.
+ */
+auto accept_batch(io_loop &loop, int fd, std::vector<accepted_connection> &connections,
+                  size_t max = DEFAULT_ACCEPT_BATCH, bool exclusive = false,
+                  time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_accept_batch{loop, fd, connections, max, exclusive, complete_by};
+}
+
+/// @brief Runs a connection, which it owns and has to close.
+using connection_handler = std::function<io_task(int fd, struct sock_addr peer)>;
+
+/**
+ * @brief Accepts connections on @p fd and starts a task with @p handler for each one.
+ *
+ * The tasks of a batch are scheduled together after it was taken off the socket. Runs until accepting fails or the
+ * loop shuts down.
+ */
+inline io_task serve(io_loop &loop, int fd, connection_handler handler, bool exclusive = false,
+                     size_t batch = DEFAULT_ACCEPT_BATCH)
+{
+    std::vector<accepted_connection> connections;
+    connections.reserve(batch);
+
+    while (true)
+    {
+        auto result = co_await accept_batch(loop, fd, connections, batch, exclusive);
+        if (result != io_result::done)
+        {
+            LOG(debug) << "Stopped accepting on " << fd << ": " << to_string(result);
+            break;
+        }
+
+        for (auto &connection : connections)
+        {
+            if (!loop.schedule(handler(connection.fd, connection.peer), "connection")) { ::close(connection.fd); }
+        }
+    }
+}
+
+} // namespace io
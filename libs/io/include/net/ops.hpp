@@ -1,12 +1,18 @@
 #pragma once
 
 #include <io/common.hpp>
+#include <io/iobuf.hpp>
 #include <net/ops.hpp>
 #include <net/sockaddr.hpp>
+#include <linux/filter.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <climits>
 #include <coroutine>
+#include <span>
+#include <vector>
 
 namespace io
 {
@@ -21,6 +27,9 @@ struct socket_config
     bool tcp_nodelay        = true;
     int send_buffer_size    = 0;
     int recv_buffer_size    = 0;
+    int incoming_cpu        = -1;    //!< SO_INCOMING_CPU, the CPU whose loop should get a listener's connections
+    bool reuse_port         = false; //!< SO_REUSEPORT, only has an effect before bind()
+    std::vector<struct sock_filter> filter; //!< SO_ATTACH_FILTER, see socket_filter_builder
 
     void apply(int fd) const
     {
@@ -45,9 +54,38 @@ struct socket_config
         {
             setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &recv_buffer_size, sizeof(recv_buffer_size));
         }
+        if (incoming_cpu >= 0)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu));
+        }
+        if (reuse_port)
+        {
+            int opt = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        }
+        if (!filter.empty())
+        {
+            struct sock_fprog prog = {static_cast<unsigned short>(filter.size()),
+                                      const_cast<struct sock_filter *>(filter.data())};
+            if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0)
+            {
+                LOG(warn) << "Failed to attach a filter to socket " << fd << ": " << strerror(errno);
+            }
+        }
     }
 };
 
+/**
+ * @brief The CPU that processed the last packet of the connection @p fd in the kernel, -1 if unknown.
+ */
+inline int incoming_cpu(int fd) noexcept
+{
+    int cpu       = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) != 0) { return -1; }
+    return cpu;
+}
+
 namespace detail
 {
 
@@ -124,14 +162,18 @@ struct io_connect : public io_op_base
     bool check_ready() noexcept override
     {
         execute();
-        // We're ready if not in progress
-        return !in_progress_;
+        // We're ready if not in progress or if a connect in progress finished
+        return !in_progress_ || waiter_.result() != io_result::waiting;
     }
 
     void execute() noexcept override
     {
         if (in_progress_)
         {
+            // may be checked again before it finished, e.g. by io_wait_for_any_promise, and SO_ERROR is 0 until then
+            struct pollfd pfd = {waiter_.fd(), POLLOUT, 0};
+            if (::poll(&pfd, 1, 0) == 0) { return; }
+
             // Check if connection completed
             int error     = 0;
             socklen_t len = sizeof(error);
@@ -397,6 +439,386 @@ struct io_send : public io_op_base
     }
 };
 
+/// @brief Room for the largest address a sock_addr holds, what recvfrom() and recvmmsg() may write into one.
+inline constexpr socklen_t SOCK_ADDR_CAPACITY = sizeof(struct sockaddr_un);
+
+/**
+ * @brief Receives one datagram and the address it came from.
+ *
+ * Unlike io_recv an empty datagram is a valid result and not the end of the connection.
+ */
+struct io_recvfrom : public io_op_base
+{
+    char *buffer_;
+    size_t buffer_size_;
+    struct sock_addr &peer_;
+    ssize_t &bytes_received_;
+    int flags_;
+    bool received_ = false;
+
+    io_recvfrom()                    = delete;
+    io_recvfrom(const io_recvfrom &) = delete;
+
+    io_recvfrom(io_loop &loop,
+                int fd,
+                char *buffer,
+                size_t buffer_size,
+                struct sock_addr &peer,
+                ssize_t &bytes_received,
+                int flags                = 0,
+                time_point_t complete_by = time_point_t::max()) noexcept
+    : io_op_base{loop, fd, io_desc_type::read, complete_by},
+      buffer_{buffer},
+      buffer_size_{buffer_size},
+      peer_{peer},
+      bytes_received_{bytes_received},
+      flags_{flags}
+    {
+        bytes_received_ = 0;
+    }
+
+    bool check_ready() noexcept override
+    {
+        execute();
+        return received_;
+    }
+
+    void execute() noexcept override
+    {
+        if (received_) return;
+
+        peer_.len_ref() = SOCK_ADDR_CAPACITY;
+        ssize_t result  = ::recvfrom(waiter_.fd(), buffer_, buffer_size_, flags_, peer_.sockaddr(), &peer_.len_ref());
+
+        if (result == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return; }
+
+            handle_socket_error(error_, "recvfrom");
+            waiter_.complete(io_result::error);
+        }
+        else
+        {
+            bytes_received_ = result;
+            received_       = true;
+            LOG(trace) << "Received " << bytes_received_ << " bytes from " << peer_.to_string();
+            waiter_.complete(io_result::done);
+        }
+    }
+};
+
+/**
+ * @brief Sends one datagram to @e peer.
+ */
+struct io_sendto : public io_op_base
+{
+    const char *buffer_;
+    size_t buffer_size_;
+    const struct sock_addr &peer_;
+    size_t &bytes_sent_;
+    int flags_;
+    bool sent_ = false;
+
+    io_sendto()                  = delete;
+    io_sendto(const io_sendto &) = delete;
+
+    io_sendto(io_loop &loop,
+              int fd,
+              const char *buffer,
+              size_t buffer_size,
+              const struct sock_addr &peer,
+              size_t &bytes_sent,
+              int flags                = 0,
+              time_point_t complete_by = time_point_t::max()) noexcept
+    : io_op_base{loop, fd, io_desc_type::write, complete_by},
+      buffer_{buffer},
+      buffer_size_{buffer_size},
+      peer_{peer},
+      bytes_sent_{bytes_sent},
+      flags_{flags}
+    {
+        bytes_sent_ = 0;
+    }
+
+    bool check_ready() noexcept override
+    {
+        execute();
+        return sent_;
+    }
+
+    void execute() noexcept override
+    {
+        if (sent_) return;
+
+        auto ret = ::sendto(waiter_.fd(), buffer_, buffer_size_, flags_, peer_.sockaddr(), peer_.len());
+
+        if (ret == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return; }
+
+            handle_socket_error(error_, "sendto");
+            waiter_.complete(io_result::error);
+        }
+        else
+        {
+            bytes_sent_ = static_cast<size_t>(ret);
+            sent_       = true;
+            LOG(trace) << "Sent " << bytes_sent_ << " bytes to " << peer_.to_string();
+            waiter_.complete(io_result::done);
+        }
+    }
+};
+
+/**
+ * @brief Progress of a transfer that the operation keeps itself, bytes or accepted connections.
+ *
+ * A base of such operations, listed before io_transfer_op, so that it exists before io_transfer_op takes a reference
+ * to it.
+ */
+struct io_transfer_count
+{
+    size_t count_{0};
+};
+
+/**
+ * @brief Base of the operations that keep going until all of a transfer is done: splice, sendfile and the reads and
+ * writes of io::stream.
+ *
+ * Unlike the other operations a transfer keeps going until all of it is done, so one co_await may wait for the
+ * source to become readable and the destination to become writable any number of times. The waiter is switched to
+ * whichever side the transfer is stuck on and its callback continues the transfer on readiness, the coroutine is only
+ * resumed once the transfer finished, timed out or was cancelled.
+ *
+ * The result is io_result::done once @e len bytes arrived at the destination and io_result::closed when the source
+ * ended before that. In both cases bytes_transferred holds the bytes written to the destination.
+ */
+struct io_transfer_op : public io_op_base
+{
+    io_transfer_op()                       = delete;
+    io_transfer_op(const io_transfer_op &) = delete;
+
+    io_transfer_op(io_loop &loop, size_t len, size_t &bytes_transferred, time_point_t complete_by) noexcept
+    : io_op_base{loop, -1, io_desc_type::read, complete_by},
+      len_{len},
+      bytes_transferred_{bytes_transferred}
+    {
+        bytes_transferred_  = 0;
+        waiter_.callback_   = &io_transfer_op::on_ready;
+        waiter_.data_       = this;
+    }
+
+    bool check_ready() noexcept override { return advance(); }
+
+    // all the work is done by check_ready() and the readiness callback
+    void execute() noexcept override {}
+
+  protected:
+    enum class progress
+    {
+        done,
+        closed,
+        wait_read,  //!< waiting for wait_fd_ to become readable
+        wait_write, //!< waiting for wait_fd_ to become writable
+        error,
+    };
+
+    /**
+     * @brief Moves as much data as possible without blocking.
+     */
+    virtual progress transfer() noexcept = 0;
+
+    size_t len_;
+    size_t &bytes_transferred_;
+    int wait_fd_{-1};
+    io_desc_type read_type_{io_desc_type::read}; //!< what progress::wait_read waits for
+
+  private:
+    /**
+     * @brief Runs the transfer and finishes the operation or points the waiter at the blocked side.
+     * @return @e true if the operation finished.
+     */
+    bool advance() noexcept
+    {
+        switch (transfer())
+        {
+        case progress::done: finish(io_result::done); return true;
+        case progress::closed: finish(io_result::closed); return true;
+        case progress::error: finish(io_result::error); return true;
+        case progress::wait_read: wait_for(read_type_); return false;
+        case progress::wait_write: wait_for(io_desc_type::write); return false;
+        }
+
+        return true;
+    }
+
+    void finish(io_result result) noexcept
+    {
+        finished_ = true;
+        (void)waiter_.complete(result, error_);
+    }
+
+    void wait_for(io_desc_type type) noexcept
+    {
+        // under io_wait_for_any_promise the link to the parent has to survive the switch
+        waiter_.watch(wait_fd_, type);
+        waiter_.result_ = io_result::waiting;
+        waiter_.add();
+    }
+
+    static void on_ready(io_result result, io_waiter *waiter)
+    {
+        auto *self = static_cast<io_transfer_op *>(waiter->data_);
+        if (self->finished_) { return; }
+
+        // readiness, or an error condition on the descriptor that the next system call reports properly
+        if (result == io_result::done || result == io_result::error)
+        {
+            if (!self->advance()) { return; }
+        }
+        else { self->finished_ = true; }
+
+        // io_waiter::complete() schedules the coroutine after this callback returns
+        waiter->awaiting_coroutine_ = self->awaiting_coroutine_;
+    }
+
+    bool finished_{false};
+};
+
+/**
+ * @brief Sends a list of buffers with sendmsg(), gathered by the kernel instead of copied into one buffer first.
+ *
+ * The buffers are either iovecs, of which the operation keeps its own position, or io_bufs, whose read pointers it
+ * advances as their bytes go out. Each sendmsg() takes up to IOV_MAX buffers, the operation keeps going over partial
+ * writes and further chunks until everything was sent.
+ */
+struct io_sendv : public io_transfer_op
+{
+    static constexpr size_t MAX_IOV = IOV_MAX;
+
+    io_sendv()                 = delete;
+    io_sendv(const io_sendv &) = delete;
+
+    io_sendv(io_loop &loop, int fd, std::span<const struct iovec> iov, size_t &bytes_sent, int flags,
+             time_point_t complete_by) noexcept
+    : io_transfer_op{loop, total(iov), bytes_sent, complete_by},
+      iov_{iov},
+      flags_{flags}
+    {
+        wait_fd_ = fd;
+    }
+
+    io_sendv(io_loop &loop, int fd, std::span<io_buf> bufs, size_t &bytes_sent, int flags,
+             time_point_t complete_by) noexcept
+    : io_transfer_op{loop, total(bufs), bytes_sent, complete_by},
+      bufs_{bufs},
+      flags_{flags}
+    {
+        wait_fd_ = fd;
+    }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        struct iovec window[MAX_IOV];
+
+        while (bytes_transferred_ < len_)
+        {
+            struct msghdr msg = {};
+            msg.msg_iov       = window;
+            msg.msg_iovlen    = fill(window);
+
+            auto ret = ::sendmsg(wait_fd_, &msg, flags_);
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+                handle_socket_error(error_, "sendmsg");
+                return progress::error;
+            }
+
+            advance(static_cast<size_t>(ret));
+            bytes_transferred_ += static_cast<size_t>(ret);
+            LOG(trace) << "Sent " << ret << " bytes from " << msg.msg_iovlen << " buffers";
+        }
+
+        return progress::done;
+    }
+
+  private:
+    static size_t total(std::span<const struct iovec> iov) noexcept
+    {
+        size_t len = 0;
+        for (const auto &v : iov) { len += v.iov_len; }
+        return len;
+    }
+
+    static size_t total(std::span<io_buf> bufs) noexcept
+    {
+        size_t len = 0;
+        for (const auto &b : bufs) { len += b.readable(); }
+        return len;
+    }
+
+    /// @brief The next up to MAX_IOV unsent buffers, empty ones skipped.
+    size_t fill(struct iovec *window) noexcept
+    {
+        size_t count = 0;
+        if (!bufs_.empty())
+        {
+            for (size_t i = index_; i < bufs_.size() && count < MAX_IOV; ++i)
+            {
+                if (bufs_[i].readable() > 0) { window[count++] = {bufs_[i].read_ptr(), bufs_[i].readable()}; }
+            }
+            return count;
+        }
+
+        for (size_t i = index_; i < iov_.size() && count < MAX_IOV; ++i)
+        {
+            size_t skip = i == index_ ? offset_ : 0;
+            if (iov_[i].iov_len > skip)
+            {
+                window[count++] = {static_cast<char *>(iov_[i].iov_base) + skip, iov_[i].iov_len - skip};
+            }
+        }
+        return count;
+    }
+
+    /// @brief Moves the position past @p sent bytes.
+    void advance(size_t sent) noexcept
+    {
+        if (!bufs_.empty())
+        {
+            for (; index_ < bufs_.size() && sent > 0; ++index_)
+            {
+                size_t n = std::min(sent, bufs_[index_].readable());
+                bufs_[index_].advance_read_ptr(n);
+                sent -= n;
+                if (bufs_[index_].readable() > 0) { break; }
+            }
+            return;
+        }
+
+        sent += offset_;
+        offset_ = 0;
+        for (; index_ < iov_.size(); ++index_)
+        {
+            if (sent < iov_[index_].iov_len)
+            {
+                offset_ = sent;
+                break;
+            }
+            sent -= iov_[index_].iov_len;
+        }
+    }
+
+    std::span<const struct iovec> iov_;
+    std::span<io_buf> bufs_;
+    int flags_;
+    size_t index_{0};  //!< first buffer with unsent bytes
+    size_t offset_{0}; //!< bytes of iov_[index_] already sent
+};
+
 } // namespace detail
 
 // Add the new overload with socket configuration
@@ -430,4 +852,42 @@ auto send(io_loop &loop, int fd, const char *buffer, size_t buffer_size, size_t
     return detail::io_send{loop, fd, buffer, buffer_size, bytes_sent, flags, complete_by};
 }
 
+/**
+ * @brief Receives one datagram into @p buffer and the sender's address into @p peer.
+ */
+auto recvfrom(io_loop &loop, int fd, char *buffer, size_t buffer_size, struct sock_addr &peer, ssize_t &bytes_received,
+              int flags = 0, time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_recvfrom{loop, fd, buffer, buffer_size, peer, bytes_received, flags, complete_by};
+}
+
+/**
+ * @brief Sends @p buffer as one datagram to @p peer.
+ */
+auto sendto(io_loop &loop, int fd, const char *buffer, size_t buffer_size, const struct sock_addr &peer,
+            size_t &bytes_sent, int flags = 0, time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_sendto{loop, fd, buffer, buffer_size, peer, bytes_sent, flags, complete_by};
+}
+
+/**
+ * @brief Sends the buffers of @p iov in order, with as few system calls as the socket allows.
+ *
+ * @p iov and the memory it points to have to stay valid until the operation finished.
+ */
+auto sendv(io_loop &loop, int fd, std::span<const struct iovec> iov, size_t &bytes_sent, int flags = 0,
+           time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_sendv{loop, fd, iov, bytes_sent, flags, complete_by};
+}
+
+/**
+ * @brief Sends the readable bytes of @p bufs in order and advances their read pointers by what was sent.
+ */
+auto sendv(io_loop &loop, int fd, std::span<io_buf> bufs, size_t &bytes_sent, int flags = 0,
+           time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_sendv{loop, fd, bufs, bytes_sent, flags, complete_by};
+}
+
 } // namespace io
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/error_handling.hpp>
+#include <io/waiter.hpp>
+#include <net/ops.hpp>
+
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace io
+{
+
+struct output_queue_options
+{
+    size_t flush_size = 16 * 1024; //!< queued bytes that go out right away instead of at the flush, also the chunk size
+    std::chrono::microseconds flush_delay{0}; //!< how long writes gather, 0 for until the writing task suspends
+    size_t high_watermark = 256 * 1024;       //!< writers wait once this much is queued
+    size_t low_watermark  = 64 * 1024;        //!< until the queue drained to this
+    bool cork             = false;            //!< TCP_CORK the socket while a batch gathers instead of MSG_MORE
+};
+
+/**
+ * @brief Gathers the small writes to a connection and sends them together, one sendmsg() per flush.
+ *
+ * Writes are copied into the queue and go out when the flush delay passes, with the default of 0 as soon as the
+ * writing task suspends, so a handler that writes a response in pieces sends it in one syscall and as few packets
+ * as it needs. Once flush_size bytes are queued the full chunks go out right away with MSG_MORE, which lets the
+ * kernel hold a partial segment for the rest. The flush sends the last chunk without it. With cork set the socket is
+ * corked with TCP_CORK while a batch gathers instead, and uncorked when the queue is empty.
+ *
+ * @code
+ * io::output_queue out{loop, fd};
+ * co_await out.write(status_line);
+ * co_await out.write(headers);
+ * co_await out.write(body);
+ * co_await out.flush(); // before closing
+ * @endcode
+ *
+ * When the peer reads slower than the handler writes, the queue grows up to high_watermark, then writes wait until
+ * it drained to low_watermark, in the order they came. flush() waits until everything queued is sent. After a send
+ * error the queued data is dropped and every write and flush reports io_result::error.
+ *
+ * The queue borrows @p fd, which the caller closes after the queue is gone or flushed, and the socket may be read by
+ * the same task at the same time. Whatever is still queued when the queue is destroyed is dropped, waiting writes
+ * are cancelled.
+ */
+class output_queue
+{
+    struct pending;
+
+  public:
+    struct statistics
+    {
+        size_t writes{0};     //!< writes queued
+        size_t blocked{0};    //!< writes that had to wait for the queue to drain
+        size_t sends{0};      //!< sendmsg() calls that sent something
+        size_t bytes_sent{0}; //!< bytes sent
+        size_t max_queued{0}; //!< the most bytes queued at once
+    };
+
+    /// @brief The most buffers a flush hands to one sendmsg().
+    static constexpr size_t MAX_IOV = IOV_MAX;
+
+    output_queue(io_loop &loop, int fd, output_queue_options options = {}) noexcept
+    : loop_{loop},
+      fd_{fd},
+      options_{std::move(options)},
+      timer_{loop, &output_queue::on_timer, nullptr},
+      writable_{loop, &output_queue::on_writable, nullptr}
+    {
+        options_.flush_size    = std::max<size_t>(options_.flush_size, 1);
+        options_.low_watermark = std::min(options_.low_watermark, options_.high_watermark);
+
+        timer_.data_    = this;
+        writable_.data_ = this;
+        writable_.set_descriptor(fd_, detail::io_desc_type::write);
+    }
+
+    ~output_queue() noexcept
+    {
+        timer_.remove();
+        writable_.remove();
+        for (auto *list : {&writers_, &flushers_})
+        {
+            for (auto *waiter : *list)
+            {
+                waiter->queue_ = nullptr;
+                if (waiter->waiter_.result() == io_result::waiting) { (void)waiter->waiter_.complete(io_result::cancelled); }
+            }
+        }
+    }
+
+    output_queue(const output_queue &)            = delete;
+    output_queue &operator=(const output_queue &) = delete;
+
+    /**
+     * @brief Queues @p data, waiting for the queue to drain first if it is over the high watermark.
+     *
+     * The data is copied once the write is queued, until the result it has to stay valid.
+     */
+    [[nodiscard]] auto write(std::string_view data, time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return pending{*this, data, false, complete_by};
+    }
+
+    /// @brief Queues @p data unless writers have to wait. @return @e false if it wasn't queued.
+    bool try_write(std::string_view data) noexcept
+    {
+        if (error_ || !accepts()) { return false; }
+        queue(data);
+        return true;
+    }
+
+    /// @brief Sends what is queued now and waits until the queue is empty.
+    [[nodiscard]] auto flush(time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return pending{*this, {}, true, complete_by};
+    }
+
+    /// @brief Bytes queued and not sent yet.
+    [[nodiscard]] size_t queued() const noexcept { return queued_; }
+
+    /// @brief True while writes have to wait for the queue to drain.
+    [[nodiscard]] bool blocked() const noexcept { return blocked_; }
+
+    /// @brief The send error the queue stopped at.
+    [[nodiscard]] std::error_code error() const noexcept { return error_; }
+
+    [[nodiscard]] const output_queue_options &options() const noexcept { return options_; }
+    [[nodiscard]] const statistics &stats() const noexcept { return stats_; }
+    [[nodiscard]] int fd() const noexcept { return fd_; }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+
+  private:
+    /**
+     * @brief A write or flush, in line at the queue when it has to wait.
+     */
+    struct pending : public detail::io_promise
+    {
+        pending(output_queue &queue, std::string_view data, bool flush, time_point_t complete_by) noexcept
+        : io_promise{queue.loop_, complete_by},
+          queue_{&queue},
+          data_{data},
+          flush_{flush}
+        {
+        }
+
+        ~pending() override
+        {
+            if (queue_ == nullptr) { return; }
+            auto &list = flush_ ? queue_->flushers_ : queue_->writers_;
+            list.erase(std::remove(list.begin(), list.end(), this), list.end());
+        }
+
+        bool await_ready() noexcept override
+        {
+            auto &queue = *queue_;
+            if (!queue.error_)
+            {
+                if (flush_) { queue.send(false); }
+                else if (queue.accepts())
+                {
+                    queue.queue(data_);
+                    waiter_.result_ = io_result::done;
+                    return true;
+                }
+            }
+
+            if (queue.error_)
+            {
+                error_          = queue.error_;
+                waiter_.result_ = io_result::error;
+                return true;
+            }
+            if (flush_ && queue.queued_ == 0)
+            {
+                waiter_.result_ = io_result::done;
+                return true;
+            }
+
+            if (flush_) { queue.flushers_.push_back(this); }
+            else
+            {
+                ++queue.stats_.blocked;
+                queue.writers_.push_back(this);
+            }
+            return io_promise::await_ready();
+        }
+
+        output_queue *queue_;
+        std::string_view data_;
+        bool flush_;
+    };
+
+    struct chunk
+    {
+        std::vector<char> data; //!< filled up to flush_size
+        size_t sent{0};
+    };
+
+    /// @brief Writes can go straight into the queue, nobody is in line before them.
+    [[nodiscard]] bool accepts() const noexcept { return !blocked_ && writers_.empty(); }
+
+    /// @brief Appends @p data and sends the full chunks once flush_size is reached.
+    void queue(std::string_view data) noexcept
+    {
+        append(data);
+        if (queued_ >= options_.flush_size) { send(true); }
+    }
+
+    void append(std::string_view data) noexcept
+    {
+        if (queued_ == 0 && options_.cork && !corked_) { set_cork(true); }
+
+        while (!data.empty())
+        {
+            if (chunks_.empty() || chunks_.back().data.size() == options_.flush_size)
+            {
+                chunks_.emplace_back();
+                if (!spare_.empty())
+                {
+                    chunks_.back().data = std::move(spare_.back());
+                    spare_.pop_back();
+                }
+                else { chunks_.back().data.reserve(options_.flush_size); }
+            }
+
+            auto &last = chunks_.back().data;
+            size_t len = std::min(data.size(), options_.flush_size - last.size());
+            last.insert(last.end(), data.data(), data.data() + len);
+            data.remove_prefix(len);
+            queued_ += len;
+        }
+
+        ++stats_.writes;
+        stats_.max_queued = std::max(stats_.max_queued, queued_);
+        if (queued_ >= options_.high_watermark) { blocked_ = true; }
+
+        if (!timer_armed_)
+        {
+            timer_.result_      = io_result::waiting;
+            timer_.complete_by_ = loop_.now() + options_.flush_delay;
+            timer_.add();
+            timer_armed_ = true;
+        }
+    }
+
+    /**
+     * @brief Sends the queued chunks in as few sendmsg() calls as it takes, until the socket is full.
+     *
+     * @param more Leave the chunk being filled for the flush and send the rest with MSG_MORE.
+     */
+    void send(bool more) noexcept
+    {
+        if (writable_armed_) { return; }
+
+        while (queued_ > 0)
+        {
+            size_t count = std::min(more ? chunks_.size() - 1 : chunks_.size(), MAX_IOV);
+            if (count == 0) { break; }
+
+            struct iovec iov[MAX_IOV];
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto &c         = chunks_[i];
+                iov[i].iov_base = c.data.data() + c.sent;
+                iov[i].iov_len  = c.data.size() - c.sent;
+            }
+
+            struct msghdr msg = {};
+            msg.msg_iov       = iov;
+            msg.msg_iovlen    = count;
+
+            int flags   = MSG_NOSIGNAL | (more && !options_.cork ? MSG_MORE : 0);
+            ssize_t ret = ::sendmsg(fd_, &msg, flags);
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    wait_writable();
+                    return;
+                }
+                fail(std::error_code(errno, std::system_category()));
+                return;
+            }
+
+            ++stats_.sends;
+            stats_.bytes_sent += static_cast<size_t>(ret);
+            consume(static_cast<size_t>(ret));
+        }
+
+        if (queued_ == 0)
+        {
+            if (timer_armed_)
+            {
+                timer_.remove();
+                timer_armed_ = false;
+            }
+            if (corked_) { set_cork(false); }
+        }
+        drained();
+    }
+
+    /// @brief Drops @p len sent bytes from the front of the queue, the emptied chunks are kept for reuse.
+    void consume(size_t len) noexcept
+    {
+        queued_ -= len;
+        while (len > 0)
+        {
+            auto &front = chunks_.front();
+            size_t part = std::min(len, front.data.size() - front.sent);
+            front.sent += part;
+            len -= part;
+
+            if (front.sent == front.data.size())
+            {
+                front.data.clear();
+                if (spare_.size() < 4) { spare_.push_back(std::move(front.data)); }
+                chunks_.pop_front();
+            }
+        }
+    }
+
+    /// @brief Lets the writers in line go while the queue takes them, completes the flushes once it is empty.
+    void drained() noexcept
+    {
+        if (blocked_ && queued_ <= options_.low_watermark) { blocked_ = false; }
+
+        for (auto *waiter : writers_)
+        {
+            if (blocked_) { break; }
+            if (waiter->waiter_.result() != io_result::waiting) { continue; }
+            // no sends from here, the timer flushes what they queued
+            append(waiter->data_);
+            (void)waiter->waiter_.complete(io_result::done);
+        }
+
+        if (queued_ > 0) { return; }
+        for (auto *waiter : flushers_)
+        {
+            if (waiter->waiter_.result() == io_result::waiting) { (void)waiter->waiter_.complete(io_result::done); }
+        }
+    }
+
+    void fail(std::error_code error) noexcept
+    {
+        LOG(debug) << "Output queue of socket " << fd_ << " failed with " << queued_ << " bytes queued: "
+                   << error.message();
+        error_   = error;
+        queued_  = 0;
+        blocked_ = false;
+        chunks_.clear();
+        timer_.remove();
+        timer_armed_ = false;
+        writable_.remove();
+        writable_armed_ = false;
+
+        for (auto *list : {&writers_, &flushers_})
+        {
+            for (auto *waiter : *list)
+            {
+                if (waiter->waiter_.result() != io_result::waiting) { continue; }
+                waiter->set_error(error);
+                (void)waiter->waiter_.complete(io_result::error, error);
+            }
+        }
+    }
+
+    void wait_writable() noexcept
+    {
+        if (fd_ == -1)
+        {
+            fail(std::make_error_code(std::errc::bad_file_descriptor));
+            return;
+        }
+        writable_.result_ = io_result::waiting;
+        writable_.add();
+        writable_armed_ = true;
+    }
+
+    void set_cork(bool on) noexcept
+    {
+        int value = on ? 1 : 0;
+        if (setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) != 0)
+        {
+            LOG(debug) << "Failed to set TCP_CORK on socket " << fd_ << ": " << strerror(errno);
+        }
+        corked_ = on;
+    }
+
+    /// @brief The flush delay passed, sends everything.
+    static void on_timer(io_result result, detail::io_waiter *waiter)
+    {
+        auto *self = static_cast<output_queue *>(waiter->data_);
+        waiter->remove();
+        self->timer_armed_ = false;
+        if (result == io_result::timeout) { self->send(false); }
+    }
+
+    /// @brief The socket takes more, sends everything.
+    static void on_writable(io_result result, detail::io_waiter *waiter)
+    {
+        auto *self = static_cast<output_queue *>(waiter->data_);
+        waiter->remove();
+        self->writable_armed_ = false;
+
+        if (result == io_result::done) { self->send(false); }
+        else if (result != io_result::cancelled && result != io_result::shutdown) { self->fail(result_to_error(result)); }
+    }
+
+    io_loop &loop_;
+    int fd_;
+    output_queue_options options_;
+    detail::io_waiter timer_;
+    detail::io_waiter writable_;
+    bool timer_armed_{false};
+    bool writable_armed_{false};
+    bool corked_{false};
+    bool blocked_{false};
+    std::deque<chunk> chunks_;
+    std::vector<std::vector<char>> spare_;
+    size_t queued_{0};
+    std::deque<pending *> writers_;
+    std::deque<pending *> flushers_;
+    std::error_code error_;
+    statistics stats_;
+};
+
+} // namespace io
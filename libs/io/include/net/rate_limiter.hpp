@@ -0,0 +1,434 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/iotask.hpp>
+#include <io/waiter.hpp>
+#include <net/ops.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <span>
+
+namespace io
+{
+
+class rate_limiter;
+
+/**
+ * @brief The timer that wakes the waiting acquires of all the rate limiters of a loop.
+ *
+ * One timer waiter is armed for the earliest time any limiter with acquires in line has the tokens for the first
+ * of them, limiters without waiting acquires cost it nothing. It keeps the loop running while it is armed. It has to
+ * outlive its limiters and is not thread safe, a loop thread has one of its own.
+ */
+class rate_limit_timer
+{
+  public:
+    explicit rate_limit_timer(io_loop &loop) noexcept
+    : loop_{loop},
+      timer_{loop, &rate_limit_timer::on_timer, nullptr}
+    {
+        timer_.data_ = this;
+    }
+
+    ~rate_limit_timer() noexcept { timer_.remove(); }
+
+    rate_limit_timer(const rate_limit_timer &)            = delete;
+    rate_limit_timer &operator=(const rate_limit_timer &) = delete;
+
+    /// @brief Limiters with acquires waiting for tokens.
+    [[nodiscard]] size_t waiting() const noexcept { return waiting_; }
+
+    [[nodiscard]] bool armed() const noexcept { return armed_; }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+
+  private:
+    friend class rate_limiter;
+
+    /// @brief Lines @p limiter up for the timer and fires it by @p ready at the latest.
+    void schedule(rate_limiter &limiter, time_point_t ready) noexcept;
+
+    void unlink(rate_limiter &limiter) noexcept;
+
+    void arm(time_point_t when) noexcept
+    {
+        if (when == time_point_t::max()) { return; }
+        if (armed_)
+        {
+            timer_.set_deadline(std::min(timer_.complete_by_, when));
+            return;
+        }
+
+        timer_.result_      = io_result::waiting;
+        timer_.complete_by_ = when;
+        timer_.add();
+        armed_ = true;
+    }
+
+    static void on_timer(io_result result, detail::io_waiter *waiter);
+
+    io_loop &loop_;
+    detail::io_waiter timer_;
+    bool armed_{false};
+    rate_limiter *first_{nullptr}; //!< limiters with waiting acquires, linked through rate_limiter::next_
+    size_t waiting_{0};
+};
+
+/**
+ * @brief A token bucket: @e rate tokens a second, up to @e burst of them saved up.
+ *
+ * A token is whatever the caller makes it, a byte for traffic shaping, a request for request rates. An acquire takes
+ * its tokens right away when the bucket has them and nobody is in line before it, otherwise it waits in line for the
+ * refill, on the shared rate_limit_timer. Acquires bigger than the burst go once the bucket is full and leave it in
+ * debt, so they pass at the rate instead of never.
+ *
+ * @code
+ * io::rate_limit_timer timer{loop};
+ * io::rate_limiter per_tenant{timer, 10e6, 256 * 1024}; // 10 MB/s
+ * if (co_await per_tenant.acquire(len) != io::io_result::done) { ... }
+ * @endcode
+ *
+ * Acquires don't allocate, the waiting ones are linked through the awaitable in the coroutine frame. send() paces
+ * io_send through one or more limiters, a destination's and a tenant's say.
+ */
+class rate_limiter
+{
+    struct pending;
+
+  public:
+    struct statistics
+    {
+        size_t acquires{0}; //!< acquires that got their tokens
+        size_t waits{0};    //!< acquires that had to wait in line
+        size_t timeouts{0}; //!< acquires that gave up at their deadline
+        size_t tokens{0};   //!< tokens handed out, minus the ones given back
+    };
+
+    /**
+     * @param rate Tokens added a second, 0 stops the refill.
+     * @param burst Tokens the bucket holds, it starts full.
+     */
+    rate_limiter(rate_limit_timer &timer, double rate, double burst) noexcept
+    : timer_{timer},
+      rate_{std::max(rate, 0.0)},
+      burst_{std::max(burst, 1.0)},
+      tokens_{burst_},
+      last_{timer.loop().now()}
+    {
+    }
+
+    ~rate_limiter() noexcept
+    {
+        timer_.unlink(*this);
+        for (auto *p = first_; p != nullptr; p = p->next_)
+        {
+            p->limiter_ = nullptr;
+            if (p->waiter_.result() == io_result::waiting) { (void)p->waiter_.complete(io_result::cancelled); }
+        }
+    }
+
+    rate_limiter(const rate_limiter &)            = delete;
+    rate_limiter &operator=(const rate_limiter &) = delete;
+
+    /**
+     * @brief Takes @p tokens, waiting in line for the refill when the bucket doesn't have them.
+     *
+     * The result is io_result::done with the tokens taken, io_result::timeout if @p complete_by passed first.
+     */
+    [[nodiscard]] auto acquire(size_t tokens, time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return pending{*this, tokens, complete_by};
+    }
+
+    /// @brief Takes @p tokens if the bucket has them and nobody waits. @return @e false if it didn't.
+    bool try_acquire(size_t tokens) noexcept
+    {
+        refill(timer_.loop().now());
+        if (first_ != nullptr || !covers(tokens)) { return false; }
+        take(tokens);
+        return true;
+    }
+
+    /// @brief Gives back @p tokens that were acquired and not used, up to the burst.
+    void release(size_t tokens) noexcept
+    {
+        tokens_ = std::min(burst_, tokens_ + static_cast<double>(tokens));
+        stats_.tokens -= std::min(stats_.tokens, tokens);
+        wake(timer_.loop().now());
+    }
+
+    /// @brief Changes the rate and the burst, the tokens saved up so far stay up to the new burst.
+    void set_rate(double rate, double burst) noexcept
+    {
+        auto now = timer_.loop().now();
+        refill(now);
+        rate_   = std::max(rate, 0.0);
+        burst_  = std::max(burst, 1.0);
+        tokens_ = std::min(tokens_, burst_);
+        wake(now);
+    }
+
+    /// @brief Tokens in the bucket now, negative while it pays off a big acquire.
+    [[nodiscard]] double available() noexcept
+    {
+        refill(timer_.loop().now());
+        return tokens_;
+    }
+
+    [[nodiscard]] double rate() const noexcept { return rate_; }
+    [[nodiscard]] double burst() const noexcept { return burst_; }
+
+    /// @brief Acquires waiting in line.
+    [[nodiscard]] size_t waiting() const noexcept
+    {
+        size_t count = 0;
+        for (auto *p = first_; p != nullptr; p = p->next_) { ++count; }
+        return count;
+    }
+
+    [[nodiscard]] const statistics &stats() const noexcept { return stats_; }
+    [[nodiscard]] rate_limit_timer &timer() const noexcept { return timer_; }
+
+  private:
+    friend class rate_limit_timer;
+
+    /**
+     * @brief An acquire, linked into the limiter's line while it waits.
+     */
+    struct pending : public detail::io_promise
+    {
+        pending(rate_limiter &limiter, size_t tokens, time_point_t complete_by) noexcept
+        : io_promise{limiter.timer_.loop(), complete_by},
+          limiter_{&limiter},
+          tokens_{tokens}
+        {
+        }
+
+        ~pending() override
+        {
+            if (limiter_ == nullptr || !linked_) { return; }
+            if (waiter_.result() == io_result::timeout) { ++limiter_->stats_.timeouts; }
+            limiter_->unlink(*this);
+        }
+
+        bool await_ready() noexcept override
+        {
+            if (limiter_ == nullptr)
+            {
+                waiter_.result_ = io_result::cancelled;
+                return true;
+            }
+            if (limiter_->try_acquire(tokens_))
+            {
+                waiter_.result_ = io_result::done;
+                return true;
+            }
+
+            ++limiter_->stats_.waits;
+            limiter_->link(*this);
+            return io_promise::await_ready();
+        }
+
+        rate_limiter *limiter_;
+        size_t tokens_;
+        pending *next_{nullptr};
+        pending *prev_{nullptr};
+        bool linked_{false};
+    };
+
+    /// @brief True if the bucket holds @p tokens, or is full for an acquire bigger than the burst.
+    [[nodiscard]] bool covers(size_t tokens) const noexcept
+    {
+        return tokens_ >= std::min(static_cast<double>(tokens), burst_);
+    }
+
+    void take(size_t tokens) noexcept
+    {
+        tokens_ -= static_cast<double>(tokens);
+        ++stats_.acquires;
+        stats_.tokens += tokens;
+    }
+
+    /// @brief Adds the tokens for the time since the last refill, @p now may be ahead of the loop's clock a little.
+    void refill(time_point_t now) noexcept
+    {
+        if (now <= last_) { return; }
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        tokens_        = std::min(burst_, tokens_ + rate_ * elapsed);
+        last_          = now;
+    }
+
+    /// @brief When the bucket will cover @p tokens at the current rate.
+    [[nodiscard]] time_point_t ready_at(size_t tokens) const noexcept
+    {
+        double missing = std::min(static_cast<double>(tokens), burst_) - tokens_;
+        if (missing <= 0) { return last_; }
+        if (rate_ <= 0) { return time_point_t::max(); }
+
+        auto wait = std::chrono::duration<double>(missing / rate_);
+        return last_ + std::chrono::ceil<time_point_t::duration>(wait);
+    }
+
+    /**
+     * @brief Hands the tokens out to the acquires in line, in order, as far as they go.
+     * @return When the first one left can go, time_point_t::max() if none is left.
+     */
+    time_point_t wake(time_point_t now) noexcept
+    {
+        refill(now);
+        while (first_ != nullptr)
+        {
+            auto *p = first_;
+            if (p->waiter_.result() != io_result::waiting)
+            {
+                // timed out, it resumes without its tokens
+                if (p->waiter_.result() == io_result::timeout) { ++stats_.timeouts; }
+                unlink(*p);
+                continue;
+            }
+            if (!covers(p->tokens_))
+            {
+                auto ready = ready_at(p->tokens_);
+                timer_.schedule(*this, ready);
+                return ready;
+            }
+
+            take(p->tokens_);
+            unlink(*p);
+            (void)p->waiter_.complete(io_result::done);
+        }
+        return time_point_t::max();
+    }
+
+    void link(pending &p) noexcept
+    {
+        p.prev_   = last_pending_;
+        p.next_   = nullptr;
+        p.linked_ = true;
+        if (last_pending_ != nullptr) { last_pending_->next_ = &p; }
+        else { first_ = &p; }
+        last_pending_ = &p;
+
+        if (&p == first_) { timer_.schedule(*this, ready_at(p.tokens_)); }
+    }
+
+    void unlink(pending &p) noexcept
+    {
+        if (p.prev_ != nullptr) { p.prev_->next_ = p.next_; }
+        else { first_ = p.next_; }
+        if (p.next_ != nullptr) { p.next_->prev_ = p.prev_; }
+        else { last_pending_ = p.prev_; }
+        p.next_ = p.prev_ = nullptr;
+        p.linked_         = false;
+    }
+
+    rate_limit_timer &timer_;
+    double rate_;
+    double burst_;
+    double tokens_;
+    time_point_t last_; //!< of the last refill
+    pending *first_{nullptr};
+    pending *last_pending_{nullptr};
+    rate_limiter *next_{nullptr}; //!< in the timer's list
+    rate_limiter *prev_{nullptr};
+    bool scheduled_{false};
+    statistics stats_;
+};
+
+inline void rate_limit_timer::schedule(rate_limiter &limiter, time_point_t ready) noexcept
+{
+    if (!limiter.scheduled_)
+    {
+        limiter.prev_ = nullptr;
+        limiter.next_ = first_;
+        if (first_ != nullptr) { first_->prev_ = &limiter; }
+        first_             = &limiter;
+        limiter.scheduled_ = true;
+        ++waiting_;
+    }
+    arm(ready);
+}
+
+inline void rate_limit_timer::unlink(rate_limiter &limiter) noexcept
+{
+    if (!limiter.scheduled_) { return; }
+    if (limiter.prev_ != nullptr) { limiter.prev_->next_ = limiter.next_; }
+    else { first_ = limiter.next_; }
+    if (limiter.next_ != nullptr) { limiter.next_->prev_ = limiter.prev_; }
+    limiter.next_ = limiter.prev_ = nullptr;
+    limiter.scheduled_            = false;
+    --waiting_;
+}
+
+inline void rate_limit_timer::on_timer(io_result result, detail::io_waiter *waiter)
+{
+    auto *self = static_cast<rate_limit_timer *>(waiter->data_);
+    // the loop fires timers up to a millisecond early, the refill counts from the deadline then
+    auto now = std::max(self->loop_.now(), waiter->complete_by_);
+    waiter->remove();
+    self->armed_ = false;
+    if (result != io_result::timeout) { return; }
+
+    for (auto *limiter = self->first_; limiter != nullptr;)
+    {
+        auto *following = limiter->next_;
+        // a limiter that is still short re-arms the timer on its own
+        if (limiter->wake(now) == time_point_t::max()) { self->unlink(*limiter); }
+        limiter = following;
+    }
+}
+
+/**
+ * @brief Sends @p len bytes from @p buf to @p fd at the pace of @p limiters, one byte a token.
+ *
+ * Each piece sent takes its bytes from every limiter first, in their order, pieces are at most the smallest burst.
+ * Tokens a partial send didn't use are given back. The result is io_result::done once everything is sent,
+ * otherwise the result of the acquire or the send that failed, @p bytes_sent counts what went out either way.
+ */
+inline io_func<io_result> send(std::span<rate_limiter *const> limiters, int fd, const char *buf, size_t len,
+                               size_t &bytes_sent, int flags = 0, time_point_t complete_by = time_point_t::max())
+{
+    bytes_sent = 0;
+    if (limiters.empty()) { co_return io_result::error; }
+
+    auto &loop   = limiters.front()->timer().loop();
+    double piece = limiters.front()->burst();
+    for (auto *limiter : limiters) { piece = std::min(piece, limiter->burst()); }
+
+    while (bytes_sent < len)
+    {
+        size_t want = std::min(len - bytes_sent, static_cast<size_t>(piece));
+        for (size_t i = 0; i < limiters.size(); ++i)
+        {
+            auto result = co_await limiters[i]->acquire(want, complete_by);
+            if (result != io_result::done)
+            {
+                for (size_t j = 0; j < i; ++j) { limiters[j]->release(want); }
+                co_return result;
+            }
+        }
+
+        size_t sent = 0;
+        auto op     = send(loop, fd, buf + bytes_sent, want, sent, flags, complete_by);
+        auto result = co_await op;
+        if (sent < want)
+        {
+            for (auto *limiter : limiters) { limiter->release(want - sent); }
+        }
+        bytes_sent += sent;
+        if (result != io_result::done) { co_return result; }
+    }
+    co_return io_result::done;
+}
+
+/// @brief send() paced by one limiter.
+inline io_func<io_result> send(rate_limiter &limiter, int fd, const char *buf, size_t len, size_t &bytes_sent,
+                               int flags = 0, time_point_t complete_by = time_point_t::max())
+{
+    rate_limiter *limiters[] = {&limiter};
+    auto result = co_await send(std::span<rate_limiter *const>{limiters}, fd, buf, len, bytes_sent, flags, complete_by);
+    co_return result;
+}
+
+} // namespace io
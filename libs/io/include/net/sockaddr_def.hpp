@@ -6,10 +6,17 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/un.h>
+#include <net/if.h>
 #include <netdb.h>
 #include <common/log.hpp>
 #include <iostream>
 #include <climits>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace io
 {
@@ -238,6 +245,18 @@ private:
      */
     bool parse_inet_address(const std::string_view &address, uint8_t family, uint16_t socktype, uint16_t proto);
 
+    /**
+     * @brief Parses a numeric IPv4 or IPv6 host (with an optional %scope) like getaddrinfo with AI_NUMERICHOST would
+     * @param host Host part, without brackets, port and prefix
+     * @param port Port string or nullptr
+     * @param family Address family
+     * @param socktype Socket type
+     * @param proto Protocol
+     * @param prefix Prefix length or nullptr for a host address
+     * @return true if parsing was successful
+     */
+    bool parse_numeric_host(std::string_view host, const char* port, uint8_t family, uint16_t socktype, uint16_t proto, const uint8_t* prefix);
+
     /**
      * @brief Sets up a wildcard address
      * @param port Port string or nullptr
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace io
+{
+
+/**
+ * @brief Compiles predicates on the datagrams a UDP socket receives into a classic BPF program for
+ * socket_config::filter or attach_filter().
+ *
+ * The kernel runs the program before it queues a datagram, one that fails any of the predicates is dropped there
+ * and never wakes the receiver. The predicates are checked in the order they were added, the cheapest and most
+ * selective first is best.
+ *
+ * @code
+ * std::vector<io::network_range> trusted = {io::network_range{"10.0.0.0/8"}, io::network_range{"[fd00::]/8"}};
+ * io::socket_config config;
+ * config.filter = io::socket_filter_builder{}.source_in(trusted).first_byte(0x80, 0xc0).build(); // RTP version 2
+ * config.apply(fd); // before bind(), or datagrams that arrive in between skip the filter
+ * @endcode
+ *
+ * Offsets are those of a UDP socket, where the program sees the datagram from its UDP header on, the IP header is
+ * reached through SKF_NET_OFF. The port predicates work the same on TCP sockets, first_byte() does not.
+ */
+class socket_filter_builder
+{
+  public:
+    /// @brief The longest program the kernel takes (BPF_MAXINSNS).
+    static constexpr size_t MAX_INSTRUCTIONS = 4096;
+
+    /// @brief Where loads reach the IP header instead of the UDP header.
+    static constexpr uint32_t NET_HEADER = static_cast<uint32_t>(SKF_NET_OFF);
+
+    /**
+     * @brief Passes datagrams whose source address is in one of @p ranges.
+     *
+     * An IPv4 range matches IPv4 packets, also those a dual-stack IPv6 socket receives as mapped addresses, an IPv6
+     * range IPv6 packets. Without ranges nothing passes.
+     */
+    socket_filter_builder &source_in(std::span<const network_range> ranges)
+    {
+        std::vector<const network_range *> v4, v6;
+        for (const auto &range : ranges)
+        {
+            if (!range.valid()) { continue; }
+            (range.network().family() == AF_INET ? v4 : v6).push_back(&range);
+        }
+
+        // the IP version from the first nibble of the network header
+        emit(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, NET_HEADER));
+        emit(BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4));
+        size_t to_v4 = 0, to_v6 = 0;
+        if (!v4.empty())
+        {
+            emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 4, 0, 1));
+            to_v4 = emit(BPF_STMT(BPF_JMP | BPF_JA, 0));
+        }
+        if (!v6.empty())
+        {
+            emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 0, 1));
+            to_v6 = emit(BPF_STMT(BPF_JMP | BPF_JA, 0));
+        }
+        drop();
+
+        std::vector<size_t> to_pass;
+        if (!v4.empty())
+        {
+            target(to_v4);
+            for (const auto *range : v4)
+            {
+                auto net = ntohl(reinterpret_cast<const sockaddr_in *>(range->network().sockaddr())->sin_addr.s_addr);
+                to_pass.push_back(match_prefix(&net, 1, NET_HEADER + 12, range->prefix()));
+            }
+            drop();
+        }
+        if (!v6.empty())
+        {
+            target(to_v6);
+            for (const auto *range : v6)
+            {
+                uint32_t net[4];
+                memcpy(net, reinterpret_cast<const sockaddr_in6 *>(range->network().sockaddr())->sin6_addr.s6_addr,
+                       sizeof(net));
+                for (auto &word : net) { word = ntohl(word); }
+                to_pass.push_back(match_prefix(net, 4, NET_HEADER + 8, range->prefix()));
+            }
+            drop();
+        }
+
+        for (size_t jump : to_pass) { target(jump); }
+        return *this;
+    }
+
+    socket_filter_builder &source_in(const network_range &range) { return source_in(std::span{&range, 1}); }
+
+    /// @brief Passes datagrams to a port in [@p first, @p last].
+    socket_filter_builder &destination_port(uint16_t first, uint16_t last) { return port(2, first, last); }
+    socket_filter_builder &destination_port(uint16_t port) { return destination_port(port, port); }
+
+    /// @brief Passes datagrams from a port in [@p first, @p last].
+    socket_filter_builder &source_port(uint16_t first, uint16_t last) { return port(0, first, last); }
+    socket_filter_builder &source_port(uint16_t port) { return source_port(port, port); }
+
+    /**
+     * @brief Passes datagrams whose first payload byte, masked with @p mask, is @p value. Empty ones don't pass.
+     */
+    socket_filter_builder &first_byte(uint8_t value, uint8_t mask = 0xff)
+    {
+        emit(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 8));
+        if (mask != 0xff) { emit(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, mask)); }
+        emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint8_t>(value & mask), 1, 0));
+        drop();
+        return *this;
+    }
+
+    /// @brief The program, which passes what all the predicates passed, whole.
+    [[nodiscard]] std::vector<struct sock_filter> build() const
+    {
+        auto program = code_;
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+        return program;
+    }
+
+  private:
+    size_t emit(struct sock_filter instruction)
+    {
+        code_.push_back(instruction);
+        return code_.size() - 1;
+    }
+
+    void drop() { emit(BPF_STMT(BPF_RET | BPF_K, 0)); }
+
+    /// @brief Points the BPF_JA at @p jump to the next instruction emitted.
+    void target(size_t jump) { code_[jump].k = static_cast<uint32_t>(code_.size() - jump - 1); }
+
+    /**
+     * @brief Compares the first @p prefix bits of the address at @p offset with @p net, @p words words of it.
+     *
+     * Falls through to the next instruction after the comparison if they differ.
+     * @return The jump to take once they match.
+     */
+    size_t match_prefix(const uint32_t *net, size_t words, uint32_t offset, unsigned prefix)
+    {
+        size_t full    = prefix / 32;
+        unsigned rest  = prefix % 32;
+        size_t compare = full + (rest != 0 ? 1 : 0);
+
+        // ld, and if partial, jeq per word, then the jump to pass
+        size_t remaining = compare * 2 + (rest != 0 ? 1 : 0) + 1;
+        for (size_t i = 0; i < compare && i < words; ++i)
+        {
+            uint32_t mask = i < full ? 0xffffffffu : 0xffffffffu << (32 - rest);
+            emit(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offset + static_cast<uint32_t>(i * 4)));
+            remaining -= 1;
+            if (mask != 0xffffffffu)
+            {
+                emit(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, mask));
+                remaining -= 1;
+            }
+            remaining -= 1;
+            // a mismatch skips the rest of this range, the jump to pass included
+            emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, net[i] & mask, 0, static_cast<uint8_t>(remaining)));
+        }
+        return emit(BPF_STMT(BPF_JMP | BPF_JA, 0));
+    }
+
+    socket_filter_builder &port(uint32_t offset, uint16_t first, uint16_t last)
+    {
+        emit(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offset));
+        if (first == last) { emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, first, 1, 0)); }
+        else
+        {
+            emit(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, 2));
+            emit(BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, last, 1, 0));
+            emit(BPF_STMT(BPF_JMP | BPF_JA, 1));
+        }
+        drop();
+        return *this;
+    }
+
+    std::vector<struct sock_filter> code_;
+};
+
+/**
+ * @brief Attaches @p program to @p fd with SO_ATTACH_FILTER, replacing the one it had.
+ */
+inline std::error_code attach_filter(int fd, std::span<const struct sock_filter> program) noexcept
+{
+    if (program.empty() || program.size() > socket_filter_builder::MAX_INSTRUCTIONS)
+    {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    struct sock_fprog prog = {static_cast<unsigned short>(program.size()),
+                              const_cast<struct sock_filter *>(program.data())};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    return {};
+}
+
+/// @brief Removes the filter of @p fd, it receives everything again.
+inline std::error_code detach_filter(int fd) noexcept
+{
+    int unused = 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused)) != 0)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    return {};
+}
+
+} // namespace io
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/file_descriptor.hpp>
+#include <io/ioops.hpp>
+#include <net/ops.hpp>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
+#include <coroutine>
+#include <limits>
+#include <vector>
+
+namespace io
+{
+
+namespace detail
+{
+
+/**
+ * @brief A pipe that carries the data of a splice() between two descriptors that aren't pipes.
+ *
+ * Creating a pipe costs two descriptors and a couple of system calls, so the pipes of finished transfers are kept
+ * per thread and reused. Only empty pipes go back, a pipe that still holds data of a failed transfer is closed.
+ */
+struct splice_pipe
+{
+    static constexpr int PIPE_SIZE    = 256 * 1024;
+    static constexpr size_t MAX_CACHED = 16;
+
+    file_descriptor read_end;
+    file_descriptor write_end;
+    size_t capacity{0};
+    size_t buffered{0}; //!< bytes in the pipe that didn't reach the destination yet
+
+    [[nodiscard]] bool valid() const noexcept { return read_end.get() != -1; }
+
+    static splice_pipe acquire() noexcept
+    {
+        auto &pipes = cache();
+        if (!pipes.empty())
+        {
+            splice_pipe p = std::move(pipes.back());
+            pipes.pop_back();
+            return p;
+        }
+
+        splice_pipe p;
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) { return p; }
+
+        p.read_end.reset(fds[0]);
+        p.write_end.reset(fds[1]);
+
+        // a larger pipe means fewer round trips per transfer, the default is 64KiB and an unprivileged process may
+        // grow it up to /proc/sys/fs/pipe-max-size
+        (void)fcntl(fds[1], F_SETPIPE_SZ, PIPE_SIZE);
+        int size   = fcntl(fds[1], F_GETPIPE_SZ);
+        p.capacity = size > 0 ? static_cast<size_t>(size) : 65536;
+
+        return p;
+    }
+
+    static void release(splice_pipe &&p) noexcept
+    {
+        auto &pipes = cache();
+        if (!p.valid() || p.buffered != 0 || pipes.size() >= MAX_CACHED) { return; }
+
+        pipes.push_back(std::move(p));
+    }
+
+  private:
+    static std::vector<splice_pipe> &cache() noexcept
+    {
+        static thread_local std::vector<splice_pipe> pipes;
+        return pipes;
+    }
+};
+
+/**
+ * @brief Moves data between two descriptors, neither of them a pipe, through an internal pipe.
+ */
+struct io_splice : public io_transfer_op
+{
+    io_splice()                  = delete;
+    io_splice(const io_splice &) = delete;
+
+    io_splice(io_loop &loop, int in_fd, int out_fd, size_t len, size_t &bytes_transferred,
+              time_point_t complete_by = time_point_t::max()) noexcept
+    : io_transfer_op{loop, len, bytes_transferred, complete_by},
+      in_fd_{in_fd},
+      out_fd_{out_fd},
+      pipe_{splice_pipe::acquire()}
+    {
+    }
+
+    ~io_splice() override { splice_pipe::release(std::move(pipe_)); }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        if (!pipe_.valid())
+        {
+            handle_socket_error(error_, "create splice pipe");
+            return progress::error;
+        }
+
+        while (true)
+        {
+            // drain the pipe first, whatever left the source has to reach the destination
+            if (pipe_.buffered > 0)
+            {
+                auto ret = ::splice(pipe_.read_end.get(), nullptr, out_fd_, nullptr, pipe_.buffered,
+                                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (ret == -1)
+                {
+                    if (errno == EINTR) { continue; }
+                    if (errno == EAGAIN) { return wait(out_fd_, progress::wait_write); }
+
+                    handle_socket_error(error_, "splice");
+                    return progress::error;
+                }
+
+                pipe_.buffered -= static_cast<size_t>(ret);
+                bytes_transferred_ += static_cast<size_t>(ret);
+                continue;
+            }
+
+            if (bytes_transferred_ >= len_) { return progress::done; }
+            if (eof_) { return progress::closed; }
+
+            // the pipe is empty here, so EAGAIN can only come from the source
+            auto ret = ::splice(in_fd_, nullptr, pipe_.write_end.get(), nullptr,
+                                std::min(len_ - bytes_transferred_, pipe_.capacity),
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN) { return wait(in_fd_, progress::wait_read); }
+
+                handle_socket_error(error_, "splice");
+                return progress::error;
+            }
+
+            if (ret == 0) { eof_ = true; }
+            pipe_.buffered += static_cast<size_t>(ret);
+        }
+    }
+
+  private:
+    progress wait(int fd, progress p) noexcept
+    {
+        wait_fd_ = fd;
+        return p;
+    }
+
+    int in_fd_;
+    int out_fd_;
+    splice_pipe pipe_;
+    bool eof_{false};
+};
+
+/**
+ * @brief Sends a range of a file with sendfile(), the file is read straight from the page cache.
+ */
+struct io_sendfile : public io_transfer_op
+{
+    /// @brief Upper bound for one sendfile() call, it doesn't accept more than 0x7ffff000 bytes anyway.
+    static constexpr size_t MAX_CHUNK = 0x7ffff000;
+
+    io_sendfile()                    = delete;
+    io_sendfile(const io_sendfile &) = delete;
+
+    io_sendfile(io_loop &loop, int out_fd, int in_fd, off_t offset, size_t len, size_t &bytes_transferred,
+                time_point_t complete_by = time_point_t::max()) noexcept
+    : io_transfer_op{loop, len, bytes_transferred, complete_by},
+      out_fd_{out_fd},
+      in_fd_{in_fd},
+      offset_{offset}
+    {
+        wait_fd_ = out_fd;
+    }
+
+  protected:
+    progress transfer() noexcept override
+    {
+        while (bytes_transferred_ < len_)
+        {
+            // a regular file is always ready, only the destination can block
+            auto ret = ::sendfile(out_fd_, in_fd_, &offset_, std::min(len_ - bytes_transferred_, MAX_CHUNK));
+            if (ret == -1)
+            {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN) { return progress::wait_write; }
+
+                handle_socket_error(error_, "sendfile");
+                return progress::error;
+            }
+
+            if (ret == 0) { return progress::closed; }
+            bytes_transferred_ += static_cast<size_t>(ret);
+        }
+
+        return progress::done;
+    }
+
+  private:
+    int out_fd_;
+    int in_fd_;
+    off_t offset_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Moves @p len bytes from @p in_fd to @p out_fd without copying them through user space.
+ *
+ * Both descriptors have to be non-blocking, typically sockets. The data goes through an internal pipe with splice(),
+ * the operation finishes once all of it reached @p out_fd. With @p len set to SIZE_MAX it forwards until @p in_fd
+ * is closed and returns io_result::closed, e.g. one direction of a proxy.
+ */
+auto splice(io_loop &loop, int in_fd, int out_fd, size_t len, size_t &bytes_transferred,
+            time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_splice{loop, in_fd, out_fd, len, bytes_transferred, complete_by};
+}
+
+/**
+ * @brief Sends @p len bytes of the file @p in_fd, starting at @p offset, to the non-blocking socket @p out_fd.
+ *
+ * Returns io_result::closed if the file ends before @p len bytes were sent.
+ */
+auto sendfile(io_loop &loop, int out_fd, int in_fd, off_t offset, size_t len, size_t &bytes_transferred,
+              time_point_t complete_by = time_point_t::max()) noexcept
+{
+    return detail::io_sendfile{loop, out_fd, in_fd, offset, len, bytes_transferred, complete_by};
+}
+
+} // namespace io
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/file_descriptor.hpp>
+#include <io/iobuf.hpp>
+#include <io/ioops.hpp>
+#include <net/ops.hpp>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+namespace io
+{
+
+class stream;
+
+namespace detail
+{
+
+/**
+ * @brief Reads into the input buffer of a stream until there is what the caller waits for.
+ *
+ * Every recv() asks for all the free space of the buffer, so one system call takes whatever the socket has queued.
+ * What's already buffered counts: a read_exact() or read_until() that is satisfied by earlier reads finishes
+ * without a system call.
+ */
+struct io_stream_read : private io_transfer_count, public io_transfer_op
+{
+    enum class mode
+    {
+        some,  //!< at least one new byte
+        exact, //!< at least want_ bytes buffered
+        until, //!< delim_ buffered
+    };
+
+    io_stream_read()                       = delete;
+    io_stream_read(const io_stream_read &) = delete;
+
+    io_stream_read(io::stream &s, mode m, size_t want, std::string_view delim, size_t *found,
+                   time_point_t complete_by) noexcept;
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    [[nodiscard]] bool satisfied() noexcept;
+
+    io::stream &stream_;
+    mode mode_;
+    size_t want_;
+    std::string_view delim_;
+    size_t *found_;
+    size_t scanned_{0}; //!< bytes from the read pointer on that are known not to start the delimiter
+};
+
+/**
+ * @brief Sends the output buffer of a stream and then @e len bytes from the caller, both with one sendmsg() per
+ * round, until all of it went out.
+ */
+struct io_stream_write : private io_transfer_count, public io_transfer_op
+{
+    io_stream_write()                        = delete;
+    io_stream_write(const io_stream_write &) = delete;
+
+    io_stream_write(io::stream &s, const char *data, size_t len, size_t *written, time_point_t complete_by) noexcept;
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    io::stream &stream_;
+    const char *data_;
+    size_t *written_;
+};
+
+} // namespace detail
+
+/**
+ * @brief A connected socket with an input and an output buffer.
+ *
+ * Reads fill the input buffer and complete once it holds what the caller asked for, a number of bytes or a
+ * delimiter, however many recv() calls that takes. Parsers then work on the buffered bytes in place through
+ * read_ptr() and readable() and consume them with advance_read_ptr(), without copying them out first. The unconsumed
+ * bytes move to the front of the buffer when the free space at its end runs out.
+ *
+ * @code
+ * io::stream s{loop, fd};
+ * size_t len = 0;
+ * while (co_await s.read_until("\r\n", len) == io_result::done)
+ * {
+ *     handle_line(std::string_view(s.read_ptr(), len - 2));
+ *     s.advance_read_ptr(len);
+ *     s.write("OK\r\n");
+ *     if (co_await s.flush() != io_result::done) { break; }
+ * }
+ * @endcode
+ *
+ * Reads return io_result::closed when the peer closed the connection before there was enough data, and
+ * io_result::error with error() set otherwise, std::errc::no_buffer_space if the request can't fit into the input
+ * buffer. The stream owns the descriptor and closes it on destruction. Only one read and one write may be in flight
+ * at a time.
+ */
+class stream
+{
+  public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * @brief Takes over the connected, non-blocking socket @p fd.
+     */
+    stream(io_loop &loop, int fd, size_t input_size = DEFAULT_BUFFER_SIZE, size_t output_size = DEFAULT_BUFFER_SIZE)
+    : loop_{loop},
+      fd_{fd},
+      in_{input_size},
+      out_{output_size},
+      in_base_{in_.read_ptr()},
+      out_base_{out_.read_ptr()}
+    {
+    }
+
+    stream(const stream &)            = delete;
+    stream &operator=(const stream &) = delete;
+
+    [[nodiscard]] int fd() const noexcept { return fd_.get(); }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+    [[nodiscard]] const std::error_code &error() const noexcept { return error_; }
+
+    /// @brief True once the peer closed its side of the connection.
+    [[nodiscard]] bool eof() const noexcept { return eof_; }
+
+    void close() noexcept { fd_.reset(); }
+
+    /// @brief The buffered input, from read_ptr() on.
+    [[nodiscard]] io_buf &input() noexcept { return in_; }
+    /// @brief The output that wasn't sent yet.
+    [[nodiscard]] io_buf &output() noexcept { return out_; }
+
+    [[nodiscard]] const char *read_ptr() const noexcept { return in_.read_ptr(); }
+    [[nodiscard]] size_t readable() const noexcept { return in_.readable(); }
+    [[nodiscard]] std::string_view view() const noexcept { return {in_.read_ptr(), in_.readable()}; }
+
+    /// @brief Consumes @p len buffered bytes.
+    void advance_read_ptr(size_t len) noexcept
+    {
+        in_.advance_read_ptr(std::min(len, in_.readable()));
+        if (in_.readable() == 0) { in_.reset(); }
+    }
+
+    /**
+     * @brief Reads whatever the socket has, at least one byte.
+     */
+    [[nodiscard]] detail::io_stream_read read_some(time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_stream_read::mode::some, 1, {}, nullptr, complete_by};
+    }
+
+    /**
+     * @brief Reads until at least @p len bytes are buffered.
+     */
+    [[nodiscard]] detail::io_stream_read read_exact(size_t len, time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_stream_read::mode::exact, len, {}, nullptr, complete_by};
+    }
+
+    /**
+     * @brief Reads until @p delim is buffered, @p len is set to the bytes up to and including its first occurrence.
+     *
+     * @p delim has to stay valid until the read finished.
+     */
+    [[nodiscard]] detail::io_stream_read read_until(std::string_view delim, size_t &len,
+                                                    time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        len = 0;
+        return {*this, detail::io_stream_read::mode::until, 0, delim, &len, complete_by};
+    }
+
+    /**
+     * @brief Appends @p data to the output buffer without sending it.
+     * @return The bytes that fit, flush() makes room for more.
+     */
+    size_t write(std::string_view data) noexcept
+    {
+        size_t len = std::min(data.size(), prepare_output());
+        memcpy(out_.write_ptr(), data.data(), len);
+        out_.advance_write_ptr(len);
+        return len;
+    }
+
+    /**
+     * @brief Sends everything in the output buffer.
+     */
+    [[nodiscard]] detail::io_stream_write flush(time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, nullptr, 0, nullptr, complete_by};
+    }
+
+    /**
+     * @brief Sends the output buffer and then @p len bytes of @p data, which aren't copied.
+     *
+     * @p written is set to the bytes of @p data that were sent, less than @p len only if the operation failed or
+     * timed out. @p data has to stay valid until the write finished.
+     */
+    [[nodiscard]] detail::io_stream_write write_all(const char *data, size_t len, size_t &written,
+                                                    time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, data, len, &written, complete_by};
+    }
+
+  private:
+    friend struct detail::io_stream_read;
+    friend struct detail::io_stream_write;
+
+    /// @brief Free space at the end of the input buffer, moves the unconsumed bytes to the front if there is none.
+    size_t prepare_input() noexcept { return prepare(in_, in_base_); }
+    size_t prepare_output() noexcept { return prepare(out_, out_base_); }
+
+    static size_t prepare(io_buf &buf, char *base) noexcept
+    {
+        size_t tail = buf.size() - static_cast<size_t>(buf.write_ptr() - base);
+        if (tail > 0 || buf.read_ptr() == base) { return tail; }
+
+        size_t len       = buf.readable();
+        const char *data = buf.read_ptr();
+        buf.reset();
+        memmove(base, data, len);
+        buf.advance_write_ptr(len);
+        return buf.size() - len;
+    }
+
+    void consume_output(size_t len) noexcept
+    {
+        out_.advance_read_ptr(len);
+        if (out_.readable() == 0) { out_.reset(); }
+    }
+
+    io_loop &loop_;
+    detail::file_descriptor fd_;
+    io_buf in_;
+    io_buf out_;
+    char *in_base_;  //!< start of the input storage, read_ptr() moves away from it as bytes are consumed
+    char *out_base_; //!< start of the output storage
+    std::error_code error_;
+    bool eof_{false};
+};
+
+namespace detail
+{
+
+inline io_stream_read::io_stream_read(io::stream &s, mode m, size_t want, std::string_view delim, size_t *found,
+                                      time_point_t complete_by) noexcept
+: io_transfer_op{s.loop(), want, count_, complete_by},
+  stream_{s},
+  mode_{m},
+  want_{want},
+  delim_{delim},
+  found_{found}
+{
+    wait_fd_ = s.fd();
+}
+
+inline bool io_stream_read::satisfied() noexcept
+{
+    switch (mode_)
+    {
+    case mode::some: return count_ > 0;
+    case mode::exact: return stream_.readable() >= want_;
+    case mode::until:
+    {
+        auto view = stream_.view();
+        if (delim_.empty()) { return true; }
+        if (view.size() < delim_.size()) { return false; }
+
+        auto pos = view.find(delim_, scanned_);
+        if (pos == std::string_view::npos)
+        {
+            // a later read can complete a delimiter that starts in the last bytes
+            scanned_ = view.size() - delim_.size() + 1;
+            return false;
+        }
+        *found_ = pos + delim_.size();
+        return true;
+    }
+    }
+    return true;
+}
+
+inline io_transfer_op::progress io_stream_read::transfer() noexcept
+{
+    while (!satisfied())
+    {
+        if (stream_.eof_) { return progress::closed; }
+
+        size_t room = stream_.prepare_input();
+        if (room == 0)
+        {
+            error_ = std::make_error_code(std::errc::no_buffer_space);
+            LOG(error) << "Stream input buffer full after " << stream_.readable() << " bytes";
+            stream_.error_ = error_;
+            return progress::error;
+        }
+
+        auto ret = ::recv(wait_fd_, stream_.in_.write_ptr(), room, 0);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_read; }
+
+            handle_socket_error(error_, "recv");
+            stream_.error_ = error_;
+            return progress::error;
+        }
+
+        if (ret == 0)
+        {
+            stream_.eof_ = true;
+            continue;
+        }
+
+        stream_.in_.advance_write_ptr(static_cast<size_t>(ret));
+        count_ += static_cast<size_t>(ret);
+        LOG(trace) << "Stream received " << ret << " bytes";
+
+        // a short read emptied the socket, the next recv() would only return EAGAIN
+        if (static_cast<size_t>(ret) < room && !satisfied()) { return progress::wait_read; }
+    }
+
+    return progress::done;
+}
+
+inline io_stream_write::io_stream_write(io::stream &s, const char *data, size_t len, size_t *written,
+                                        time_point_t complete_by) noexcept
+: io_transfer_op{s.loop(), len, count_, complete_by},
+  stream_{s},
+  data_{data},
+  written_{written}
+{
+    wait_fd_ = s.fd();
+    if (written_) { *written_ = 0; }
+}
+
+inline io_transfer_op::progress io_stream_write::transfer() noexcept
+{
+    while (stream_.out_.readable() > 0 || count_ < len_)
+    {
+        struct iovec iov[2];
+        int count = 0;
+        if (stream_.out_.readable() > 0) { iov[count++] = {stream_.out_.read_ptr(), stream_.out_.readable()}; }
+        if (count_ < len_) { iov[count++] = {const_cast<char *>(data_ + count_), len_ - count_}; }
+
+        struct msghdr msg = {};
+        msg.msg_iov       = iov;
+        msg.msg_iovlen    = count;
+
+        auto ret = ::sendmsg(wait_fd_, &msg, MSG_NOSIGNAL);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+            handle_socket_error(error_, "sendmsg");
+            stream_.error_ = error_;
+            return progress::error;
+        }
+
+        auto left       = static_cast<size_t>(ret);
+        size_t buffered = std::min(left, stream_.out_.readable());
+        stream_.consume_output(buffered);
+        count_ += left - buffered;
+        if (written_) { *written_ = count_; }
+    }
+
+    return progress::done;
+}
+
+} // namespace detail
+
+} // namespace io
@@ -0,0 +1,645 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/error_handling.hpp>
+#include <io/file_descriptor.hpp>
+#include <io/ioops.hpp>
+#include <net/ops.hpp>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509_vfy.h>
+
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+namespace io
+{
+
+/**
+ * @brief Error category of the OpenSSL error queue, the value is the packed error code of ERR_get_error(), as its
+ * 32 bits.
+ */
+class tls_error_category : public std::error_category
+{
+  public:
+    static const tls_error_category &instance()
+    {
+        static tls_error_category category;
+        return category;
+    }
+
+    const char *name() const noexcept override { return "tls"; }
+
+    std::string message(int value) const override
+    {
+        char buf[256];
+        ERR_error_string_n(static_cast<uint32_t>(value), buf, sizeof(buf));
+        return buf;
+    }
+};
+
+/**
+ * @brief The last error on the OpenSSL error queue of this thread, clears the queue.
+ *
+ * A failed system call OpenSSL made comes back as its errno in std::system_category, so it compares equal to the
+ * std::errc the socket operations report.
+ */
+inline std::error_code tls_error() noexcept
+{
+    unsigned long last = ERR_peek_last_error();
+    ERR_clear_error();
+    if (last == 0) { return std::make_error_code(std::errc::protocol_error); }
+#ifdef ERR_SYSTEM_ERROR
+    if (ERR_SYSTEM_ERROR(last)) { return {ERR_GET_REASON(last), std::system_category()}; }
+#endif
+    return {static_cast<int>(static_cast<uint32_t>(last)), tls_error_category::instance()};
+}
+
+enum class tls_role
+{
+    client,
+    server,
+};
+
+class tls_stream;
+
+/**
+ * @brief Certificates, peer verification and the session cache shared by the TLS streams of one side.
+ *
+ * A client context remembers the last session of every session key, by default the server name, and offers it on
+ * the next connection with the same key so the handshake can skip the certificate exchange. Once it holds
+ * max_sessions of them, the least recently used one makes room for a new key. Servers resume with the
+ * stateless session tickets of OpenSSL. Not thread safe, a loop thread has one of its own.
+ */
+class tls_context
+{
+  public:
+    static constexpr size_t DEFAULT_MAX_SESSIONS = 1024;
+
+    explicit tls_context(tls_role role, size_t max_sessions = DEFAULT_MAX_SESSIONS)
+    : ctx_{SSL_CTX_new(role == tls_role::client ? TLS_client_method() : TLS_server_method())},
+      role_{role},
+      max_sessions_{max_sessions}
+    {
+        if (!ctx_)
+        {
+            LOG(error) << "SSL_CTX_new: " << tls_error().message();
+            return;
+        }
+
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+        if (role_ == tls_role::client)
+        {
+            // the sessions are kept here, by session key rather than by the session id OpenSSL would use
+            SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(ctx_, &tls_context::on_new_session);
+        }
+        else
+        {
+            static const unsigned char id_context[] = "io::tls";
+            SSL_CTX_set_session_id_context(ctx_, id_context, sizeof(id_context) - 1);
+        }
+    }
+
+    ~tls_context()
+    {
+        for (auto &cached : sessions_) { SSL_SESSION_free(cached.session); }
+        SSL_CTX_free(ctx_);
+    }
+
+    tls_context(const tls_context &)            = delete;
+    tls_context &operator=(const tls_context &) = delete;
+
+    [[nodiscard]] explicit operator bool() const noexcept { return ctx_ != nullptr; }
+    [[nodiscard]] SSL_CTX *native() const noexcept { return ctx_; }
+    [[nodiscard]] tls_role role() const noexcept { return role_; }
+
+    /**
+     * @brief Uses the PEM certificate chain @p cert_pem, leaf first, and its private key @p key_pem.
+     */
+    std::error_code use_certificate(std::string_view cert_pem, std::string_view key_pem)
+    {
+        BIO *certs = BIO_new_mem_buf(cert_pem.data(), static_cast<int>(cert_pem.size()));
+        X509 *leaf = PEM_read_bio_X509(certs, nullptr, nullptr, nullptr);
+        bool ok    = leaf && SSL_CTX_use_certificate(ctx_, leaf) == 1;
+        X509_free(leaf);
+
+        // intermediates, owned by the context once added
+        X509 *extra = nullptr;
+        while (ok && (extra = PEM_read_bio_X509(certs, nullptr, nullptr, nullptr)) != nullptr)
+        {
+            if (SSL_CTX_add_extra_chain_cert(ctx_, extra) != 1)
+            {
+                X509_free(extra);
+                ok = false;
+            }
+        }
+        BIO_free(certs);
+
+        BIO *keys     = BIO_new_mem_buf(key_pem.data(), static_cast<int>(key_pem.size()));
+        EVP_PKEY *key = ok ? PEM_read_bio_PrivateKey(keys, nullptr, nullptr, nullptr) : nullptr;
+        ok            = key && SSL_CTX_use_PrivateKey(ctx_, key) == 1 && SSL_CTX_check_private_key(ctx_) == 1;
+        EVP_PKEY_free(key);
+        BIO_free(keys);
+
+        if (!ok) { return tls_error(); }
+        // the end of the PEM data leaves an error behind
+        ERR_clear_error();
+        return {};
+    }
+
+    /**
+     * @brief Trusts the PEM certificates in @p ca_pem and from then on verifies the peer's certificate.
+     */
+    std::error_code trust(std::string_view ca_pem)
+    {
+        BIO *bio          = BIO_new_mem_buf(ca_pem.data(), static_cast<int>(ca_pem.size()));
+        X509_STORE *store = SSL_CTX_get_cert_store(ctx_);
+        size_t added      = 0;
+        X509 *cert        = nullptr;
+        while ((cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) != nullptr)
+        {
+            if (X509_STORE_add_cert(store, cert) == 1) { ++added; }
+            X509_free(cert);
+        }
+        BIO_free(bio);
+
+        if (added == 0) { return tls_error(); }
+        ERR_clear_error();
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+        return {};
+    }
+
+    /**
+     * @brief Lets the streams hand the record layer to the kernel (kTLS) after the handshake.
+     *
+     * kTLS needs OpenSSL to talk to the socket itself, streams of such a context use a socket BIO instead of the
+     * memory BIO pair. The kernel takes over only if it has the tls module and supports the negotiated cipher,
+     * otherwise the encryption stays in OpenSSL, see tls_stream::ktls_send().
+     */
+    void enable_ktls(bool enable = true) noexcept
+    {
+        ktls_ = enable;
+#ifdef SSL_OP_ENABLE_KTLS
+        if (enable) { SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS); }
+        else { SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS); }
+#endif
+    }
+
+    [[nodiscard]] bool ktls() const noexcept { return ktls_; }
+
+    /// @brief Sessions kept for resumption.
+    [[nodiscard]] size_t cached_sessions() const noexcept { return sessions_.size(); }
+
+    /// @brief Forgets the session of @p key, e.g. after the server rejected it.
+    void forget_session(const std::string &key) noexcept
+    {
+        auto it = index_.find(key);
+        if (it == index_.end()) { return; }
+        SSL_SESSION_free(it->second->session);
+        sessions_.erase(it->second);
+        index_.erase(it);
+    }
+
+  private:
+    friend class tls_stream;
+
+    struct cached_session
+    {
+        std::string key;
+        SSL_SESSION *session;
+    };
+
+    /// @brief The cached session of @p key, still owned by the cache, nullptr if there is none. Marks it used.
+    [[nodiscard]] SSL_SESSION *session(const std::string &key) noexcept
+    {
+        auto it = index_.find(key);
+        if (it == index_.end()) { return nullptr; }
+        sessions_.splice(sessions_.begin(), sessions_, it->second);
+        return it->second->session;
+    }
+
+    static int on_new_session(SSL *ssl, SSL_SESSION *session);
+
+    SSL_CTX *ctx_;
+    tls_role role_;
+    size_t max_sessions_;
+    bool ktls_{false};
+    std::list<cached_session> sessions_; //!< most recently used first
+    std::unordered_map<std::string, std::list<cached_session>::iterator> index_;
+};
+
+namespace detail
+{
+
+/**
+ * @brief Runs an SSL call until it succeeds, moving the records between the socket and OpenSSL on the way.
+ *
+ * SSL_ERROR_WANT_READ and SSL_ERROR_WANT_WRITE become waits for the socket to become readable or writable.
+ */
+struct io_tls_op : private io_transfer_count, public io_transfer_op
+{
+    enum class action
+    {
+        handshake,
+        read,     //!< at least one byte of application data
+        write,    //!< all len_ bytes
+        shutdown, //!< sends close_notify, doesn't wait for the peer's
+    };
+
+    io_tls_op()                  = delete;
+    io_tls_op(const io_tls_op &) = delete;
+
+    io_tls_op(tls_stream &s, action a, char *data, size_t len, size_t *transferred,
+              time_point_t complete_by) noexcept;
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    progress flush() noexcept;
+    progress fill() noexcept;
+    progress failed(int ret) noexcept;
+
+    tls_stream &stream_;
+    action action_;
+    char *data_;
+    size_t *transferred_;
+    bool called_{false}; //!< the SSL call succeeded, what it produced may still have to go out
+};
+
+} // namespace detail
+
+/**
+ * @brief A TLS connection over a non-blocking socket, driven by the io_loop.
+ *
+ * OpenSSL works on a BIO pair, a memory buffer in each direction. The operations move the records between the
+ * socket and the BIO pair with recv() and send() into and out of the BIO buffers, so OpenSSL never touches the
+ * socket and every wait is a wait of the loop. With tls_context::enable_ktls() OpenSSL uses the socket directly
+ * instead, which is what kTLS needs, and its WANT_READ/WANT_WRITE become the waits.
+ *
+ * @code
+ * io::tls_stream tls{loop, client_ctx, fd, "example.com"};
+ * if (co_await tls.handshake(deadline) != io_result::done) { ... tls.error() ... }
+ * size_t n = 0;
+ * co_await tls.write(request.data(), request.size(), n, deadline);
+ * co_await tls.read(buf, sizeof(buf), n, deadline);
+ * @endcode
+ *
+ * Reads return io_result::closed when the peer closed the connection, with or without close_notify, and
+ * io_result::error with error() set otherwise. The stream owns the descriptor. Only one operation may be in flight at
+ * a time, TLS reads can need writes and the other way round.
+ */
+class tls_stream
+{
+  public:
+    static constexpr size_t BIO_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * @brief Takes over the connected, non-blocking socket @p fd.
+     *
+     * @param server_name Client side: sent as SNI and, if the context verifies peers, checked against the
+     *                    server's certificate.
+     * @param session_key Client side: the key of the session cache, the server name if empty.
+     */
+    tls_stream(io_loop &loop, tls_context &ctx, int fd, std::string server_name = {}, std::string session_key = {})
+    : loop_{loop},
+      ctx_{ctx},
+      fd_{fd},
+      ssl_{SSL_new(ctx.native())},
+      session_key_{session_key.empty() ? server_name : std::move(session_key)}
+    {
+        if (!ssl_)
+        {
+            error_ = tls_error();
+            return;
+        }
+
+        SSL_set_app_data(ssl_, this);
+        if (ctx.ktls()) { SSL_set_fd(ssl_, fd); }
+        else
+        {
+            BIO *internal = nullptr;
+            BIO_new_bio_pair(&internal, BIO_BUFFER_SIZE, &network_, BIO_BUFFER_SIZE);
+            SSL_set_bio(ssl_, internal, internal);
+        }
+
+        if (ctx.role() == tls_role::server)
+        {
+            SSL_set_accept_state(ssl_);
+            return;
+        }
+
+        SSL_set_connect_state(ssl_);
+        if (!server_name.empty())
+        {
+            SSL_set_tlsext_host_name(ssl_, server_name.c_str());
+            SSL_set1_host(ssl_, server_name.c_str());
+        }
+        if (auto *session = ctx.session(session_key_)) { SSL_set_session(ssl_, session); }
+    }
+
+    ~tls_stream()
+    {
+        SSL_free(ssl_);
+        BIO_free(network_);
+    }
+
+    tls_stream(const tls_stream &)            = delete;
+    tls_stream &operator=(const tls_stream &) = delete;
+
+    [[nodiscard]] int fd() const noexcept { return fd_.get(); }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+    [[nodiscard]] SSL *native() const noexcept { return ssl_; }
+    [[nodiscard]] const std::error_code &error() const noexcept { return error_; }
+
+    /// @brief True once the peer closed the connection.
+    [[nodiscard]] bool eof() const noexcept { return eof_; }
+
+    /// @brief True if the handshake resumed a cached session.
+    [[nodiscard]] bool resumed() const noexcept { return ssl_ && SSL_session_reused(ssl_) == 1; }
+
+    /// @brief True if the kernel encrypts what is sent.
+    [[nodiscard]] bool ktls_send() const noexcept
+    {
+#ifndef OPENSSL_NO_KTLS
+        return ctx_.ktls() && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+        return false;
+#endif
+    }
+
+    /// @brief True if the kernel decrypts what is received.
+    [[nodiscard]] bool ktls_recv() const noexcept
+    {
+#ifndef OPENSSL_NO_KTLS
+        return ctx_.ktls() && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Runs the handshake, the peer's certificate is verified if the context trusts any.
+     */
+    [[nodiscard]] detail::io_tls_op handshake(time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_tls_op::action::handshake, nullptr, 0, nullptr, complete_by};
+    }
+
+    /**
+     * @brief Reads up to @p size bytes of application data, at least one.
+     */
+    [[nodiscard]] detail::io_tls_op read(char *buffer, size_t size, size_t &bytes_read,
+                                         time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_tls_op::action::read, buffer, size, &bytes_read, complete_by};
+    }
+
+    /**
+     * @brief Writes all @p len bytes of @p data, which has to stay valid until the write finished.
+     */
+    [[nodiscard]] detail::io_tls_op write(const char *data, size_t len, size_t &written,
+                                          time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_tls_op::action::write, const_cast<char *>(data), len, &written, complete_by};
+    }
+
+    /**
+     * @brief Sends close_notify, the connection can be closed once it completed.
+     */
+    [[nodiscard]] detail::io_tls_op shutdown(time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return {*this, detail::io_tls_op::action::shutdown, nullptr, 0, nullptr, complete_by};
+    }
+
+  private:
+    friend struct detail::io_tls_op;
+    friend class tls_context;
+
+    io_loop &loop_;
+    tls_context &ctx_;
+    detail::file_descriptor fd_;
+    SSL *ssl_;
+    BIO *network_{nullptr}; //!< our end of the BIO pair, nullptr if OpenSSL uses the socket
+    std::string session_key_;
+    std::error_code error_;
+    bool eof_{false};
+};
+
+inline int tls_context::on_new_session(SSL *ssl, SSL_SESSION *session)
+{
+    auto *stream = static_cast<tls_stream *>(SSL_get_app_data(ssl));
+    if (!stream || stream->session_key_.empty()) { return 0; }
+
+    auto &ctx = stream->ctx_;
+    auto it   = ctx.index_.find(stream->session_key_);
+    if (it != ctx.index_.end())
+    {
+        SSL_SESSION_free(it->second->session);
+        it->second->session = session;
+        ctx.sessions_.splice(ctx.sessions_.begin(), ctx.sessions_, it->second);
+        return 1;
+    }
+
+    if (ctx.max_sessions_ == 0) { return 0; }
+    if (ctx.sessions_.size() >= ctx.max_sessions_)
+    {
+        auto &oldest = ctx.sessions_.back();
+        SSL_SESSION_free(oldest.session);
+        ctx.index_.erase(oldest.key);
+        ctx.sessions_.pop_back();
+    }
+    ctx.sessions_.push_front({stream->session_key_, session});
+    ctx.index_.emplace(stream->session_key_, ctx.sessions_.begin());
+    // the cache keeps the reference OpenSSL passed in
+    return 1;
+}
+
+namespace detail
+{
+
+inline io_tls_op::io_tls_op(tls_stream &s, action a, char *data, size_t len, size_t *transferred,
+                            time_point_t complete_by) noexcept
+: io_transfer_op{s.loop(), len, count_, complete_by},
+  stream_{s},
+  action_{a},
+  data_{data},
+  transferred_{transferred},
+  called_{a == action::write && len == 0}
+{
+    wait_fd_ = s.fd();
+    if (transferred_) { *transferred_ = 0; }
+}
+
+/**
+ * @brief Sends the records OpenSSL put into the BIO pair, straight from its buffer.
+ */
+inline io_transfer_op::progress io_tls_op::flush() noexcept
+{
+    if (!stream_.network_) { return progress::done; }
+
+    char *data = nullptr;
+    int len    = 0;
+    while ((len = BIO_nread0(stream_.network_, &data)) > 0)
+    {
+        auto ret = ::send(wait_fd_, data, static_cast<size_t>(len), MSG_NOSIGNAL);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+            handle_socket_error(error_, "send");
+            return progress::error;
+        }
+        BIO_nread(stream_.network_, &data, static_cast<int>(ret));
+    }
+    return progress::done;
+}
+
+/**
+ * @brief Receives records into the BIO pair, straight into its buffer.
+ */
+inline io_transfer_op::progress io_tls_op::fill() noexcept
+{
+    char *space = nullptr;
+    int room    = BIO_nwrite0(stream_.network_, &space);
+    // full of records OpenSSL didn't take yet, the next call does
+    if (room <= 0) { return progress::done; }
+
+    while (true)
+    {
+        auto ret = ::recv(wait_fd_, space, static_cast<size_t>(room), 0);
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_read; }
+
+            handle_socket_error(error_, "recv");
+            return progress::error;
+        }
+        if (ret == 0)
+        {
+            stream_.eof_ = true;
+            return progress::closed;
+        }
+
+        BIO_nwrite(stream_.network_, &space, static_cast<int>(ret));
+        return progress::done;
+    }
+}
+
+/**
+ * @brief Turns the result @p ret of an SSL call that failed into what the operation has to do next.
+ */
+inline io_transfer_op::progress io_tls_op::failed(int ret) noexcept
+{
+    int err = SSL_get_error(stream_.ssl_, ret);
+    switch (err)
+    {
+    case SSL_ERROR_WANT_READ:
+        if (!stream_.network_) { return progress::wait_read; }
+        // what the call produced, e.g. a ClientHello, is what the peer waits for before it answers
+        if (auto p = flush(); p != progress::done) { return p; }
+        return fill();
+    case SSL_ERROR_WANT_WRITE:
+        // the BIO pair is full, flush() makes room
+        return stream_.network_ ? flush() : progress::wait_write;
+    case SSL_ERROR_ZERO_RETURN:
+        stream_.eof_ = true;
+        return progress::closed;
+    case SSL_ERROR_SYSCALL:
+        if (ERR_peek_error() == 0)
+        {
+            // the socket BIO saw the connection end without close_notify, or the system call failed
+            if (errno == 0 || errno == ECONNRESET)
+            {
+                stream_.eof_ = true;
+                return progress::closed;
+            }
+            handle_socket_error(error_, "SSL");
+            return progress::error;
+        }
+        [[fallthrough]];
+    default:
+        error_ = tls_error();
+        if (long verify = SSL_get_verify_result(stream_.ssl_); verify != X509_V_OK)
+        {
+            LOG(error) << "TLS certificate verification failed: " << X509_verify_cert_error_string(verify);
+        }
+        else { LOG(error) << "TLS error: " << error_.message(); }
+
+        // the alert that tells the peer, if the socket takes it right away
+        if (stream_.network_)
+        {
+            auto error = error_;
+            (void)flush();
+            error_ = error;
+        }
+        return progress::error;
+    }
+}
+
+inline io_transfer_op::progress io_tls_op::transfer() noexcept
+{
+    if (!stream_.ssl_)
+    {
+        error_ = stream_.error_;
+        return progress::error;
+    }
+
+    while (true)
+    {
+        // what OpenSSL produced goes out first, the peer may wait for it before it sends what OpenSSL waits for
+        if (auto p = flush(); p != progress::done)
+        {
+            if (p == progress::error) { stream_.error_ = error_; }
+            return p;
+        }
+        if (called_) { return progress::done; }
+
+        ERR_clear_error();
+        errno      = 0;
+        int ret    = 0;
+        size_t len = 0;
+        switch (action_)
+        {
+        case action::handshake: ret = SSL_do_handshake(stream_.ssl_); break;
+        case action::read: ret = SSL_read_ex(stream_.ssl_, data_, len_, &len); break;
+        case action::write: ret = SSL_write_ex(stream_.ssl_, data_ + count_, len_ - count_, &len); break;
+        // 0 means close_notify was sent and the peer's didn't arrive yet
+        case action::shutdown: ret = SSL_shutdown(stream_.ssl_) >= 0 ? 1 : -1; break;
+        }
+
+        if (ret == 1)
+        {
+            count_ += len;
+            if (transferred_) { *transferred_ = count_; }
+            called_ = action_ != action::write || count_ == len_;
+            continue;
+        }
+
+        if (auto p = failed(ret); p != progress::done)
+        {
+            if (p == progress::error) { stream_.error_ = error_; }
+            return p;
+        }
+    }
+}
+
+} // namespace detail
+
+} // namespace io
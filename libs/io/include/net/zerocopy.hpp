@@ -0,0 +1,279 @@
+#pragma once
+
+#include <io/common.hpp>
+#include <io/iobuf.hpp>
+#include <io/ioops.hpp>
+#include <io/waiter.hpp>
+#include <net/ops.hpp>
+
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace io
+{
+
+class zerocopy_sender;
+
+namespace detail
+{
+
+/**
+ * @brief Sends the readable bytes of an io_buf through a zerocopy_sender, with MSG_ZEROCOPY while at least the
+ * sender's threshold is left and with a copying send() below that.
+ */
+struct io_zerocopy_send : public io_transfer_op
+{
+    io_zerocopy_send()                         = delete;
+    io_zerocopy_send(const io_zerocopy_send &) = delete;
+
+    io_zerocopy_send(zerocopy_sender &sender, io_buf &buf, size_t &bytes_sent, time_point_t complete_by) noexcept;
+
+  protected:
+    progress transfer() noexcept override;
+
+  private:
+    zerocopy_sender &sender_;
+    io_buf &buf_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Sends large buffers on a connected TCP socket without copying them into the kernel (MSG_ZEROCOPY).
+ *
+ * The kernel sends straight from the pages of the buffer and reports on the socket's error queue once it is done
+ * with them. Until then the sender keeps a reference to every buffer it sent from, so their memory stays allocated
+ * however long the caller's io_buf lives. The reports are picked up by a waiter on EPOLLERR of the socket, armed
+ * while any buffer is pending, which also keeps the loop running until the last one is released.
+ *
+ * @code
+ * io::zerocopy_sender sender{loop, fd};
+ * size_t sent = 0;
+ * co_await sender.send(response, sent);
+ * @endcode
+ *
+ * The bytes of a buffer must not change while the kernel may still send them, so a buffer that was sent from is not
+ * written to again until pending() dropped back to zero, new data goes into a new io_buf. Below the threshold the
+ * page pinning and the completion cost more than the copy saves and the sender copies. If the socket doesn't take
+ * SO_ZEROCOPY every send copies. The kernel may also copy a zero-copy send anyway, for instance when it is delivered
+ * to a local socket, stats() counts those.
+ */
+class zerocopy_sender
+{
+  public:
+    /// @brief Below this many bytes a send copies, the kernel documentation puts the break-even around 10 KB.
+    static constexpr size_t DEFAULT_THRESHOLD = 16 * 1024;
+
+    struct statistics
+    {
+        size_t zerocopy_sends{0}; //!< send() system calls with MSG_ZEROCOPY
+        size_t copy_sends{0};     //!< send() system calls without, below the threshold or as a fallback
+        size_t completed{0};      //!< zero-copy sends the kernel reported done
+        size_t copied{0};         //!< of those, the ones the kernel had to copy after all
+    };
+
+    /**
+     * @brief Sends on the connected, non-blocking socket @p fd, which stays owned by the caller.
+     */
+    zerocopy_sender(io_loop &loop, int fd, size_t threshold = DEFAULT_THRESHOLD) noexcept
+    : loop_{loop},
+      fd_{fd},
+      threshold_{threshold},
+      reaper_{loop, &zerocopy_sender::on_ready, nullptr}
+    {
+        int one  = 1;
+        enabled_ = setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        if (!enabled_) { LOG(debug) << "SO_ZEROCOPY not available, sends will copy: " << strerror(errno); }
+
+        reaper_.data_ = this;
+        reaper_.set_descriptor(fd_, detail::io_desc_type::error);
+    }
+
+    zerocopy_sender(const zerocopy_sender &)            = delete;
+    zerocopy_sender &operator=(const zerocopy_sender &) = delete;
+
+    ~zerocopy_sender() noexcept { reaper_.remove(); }
+
+    /**
+     * @brief Sends the readable bytes of @p buf and advances its read pointer by what was sent.
+     *
+     * The result is io_result::done once all of it was handed to the kernel, which may still send from the buffer
+     * afterwards.
+     */
+    auto send(io_buf &buf, size_t &bytes_sent, time_point_t complete_by = time_point_t::max()) noexcept
+    {
+        return detail::io_zerocopy_send{*this, buf, bytes_sent, complete_by};
+    }
+
+    /**
+     * @brief Releases the buffers of the completions on the error queue, without waiting for more.
+     * @return Number of zero-copy sends completed.
+     */
+    size_t reap() noexcept;
+
+    /// @brief Zero-copy sends whose buffers the kernel may still use.
+    [[nodiscard]] size_t pending() const noexcept { return pending_.size(); }
+
+    /// @brief True if the socket took SO_ZEROCOPY.
+    [[nodiscard]] bool enabled() const noexcept { return enabled_; }
+
+    [[nodiscard]] size_t threshold() const noexcept { return threshold_; }
+    [[nodiscard]] const statistics &stats() const noexcept { return stats_; }
+    [[nodiscard]] int fd() const noexcept { return fd_; }
+    [[nodiscard]] io_loop &loop() const noexcept { return loop_; }
+
+  private:
+    friend struct detail::io_zerocopy_send;
+
+    /// @brief Keeps @p buf until the kernel reports the zero-copy send that was just made done.
+    void track(const io_buf &buf) noexcept
+    {
+        pending_.emplace_back(std::piecewise_construct, std::forward_as_tuple(next_id_++), std::forward_as_tuple(buf));
+
+        if (pending_.size() == 1)
+        {
+            reaper_.result_ = io_result::waiting;
+            reaper_.add();
+        }
+    }
+
+    static void on_ready(io_result result, detail::io_waiter *waiter);
+
+    io_loop &loop_;
+    int fd_;
+    size_t threshold_;
+    bool enabled_{false};
+    detail::io_waiter reaper_;
+    std::deque<std::pair<uint32_t, io_buf>> pending_; //!< in the order of the ids the kernel gives the sends
+    uint32_t next_id_{0};
+    statistics stats_;
+};
+
+inline size_t zerocopy_sender::reap() noexcept
+{
+    size_t completed = 0;
+
+    while (!pending_.empty())
+    {
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+        struct msghdr msg  = {};
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (::recvmsg(fd_, &msg, MSG_ERRQUEUE) == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { LOG(warn) << "Failed to read the error queue: " << strerror(errno); }
+            break;
+        }
+
+        for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            bool recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                           (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recverr) { continue; }
+
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) { continue; }
+
+            // sends [ee_info, ee_data] are done, the ids wrap around
+            uint32_t last = err.ee_data;
+            size_t count  = err.ee_data - err.ee_info + 1;
+            while (!pending_.empty() && static_cast<int32_t>(last - pending_.front().first) >= 0) { pending_.pop_front(); }
+
+            completed += count;
+            stats_.completed += count;
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) { stats_.copied += count; }
+        }
+    }
+
+    return completed;
+}
+
+inline void zerocopy_sender::on_ready(io_result, detail::io_waiter *waiter)
+{
+    auto *self = static_cast<zerocopy_sender *>(waiter->data_);
+
+    if (self->reap() == 0 && !self->pending_.empty())
+    {
+        // a send may have reaped first, but an error or hangup that stays reported would wake the reaper for ever
+        struct pollfd pfd = {self->fd_, 0, 0};
+        if (::poll(&pfd, 1, 0) > 0)
+        {
+            LOG(debug) << "Socket " << self->fd_ << " failed, " << self->pending_.size() << " zero-copy sends left";
+            waiter->remove();
+            return;
+        }
+    }
+
+    // stay armed while the kernel holds buffers
+    if (!self->pending_.empty()) { waiter->result_ = io_result::waiting; }
+    else { waiter->remove(); }
+}
+
+namespace detail
+{
+
+inline io_zerocopy_send::io_zerocopy_send(zerocopy_sender &sender, io_buf &buf, size_t &bytes_sent,
+                                          time_point_t complete_by) noexcept
+: io_transfer_op{sender.loop(), buf.readable(), bytes_sent, complete_by},
+  sender_{sender},
+  buf_{buf}
+{
+    wait_fd_ = sender.fd();
+}
+
+inline io_zerocopy_send::progress io_zerocopy_send::transfer() noexcept
+{
+    while (bytes_transferred_ < len_)
+    {
+        size_t left   = len_ - bytes_transferred_;
+        bool zerocopy = sender_.enabled_ && left >= sender_.threshold_;
+
+        auto ret = ::send(wait_fd_, buf_.read_ptr(), left, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+        if (ret == -1)
+        {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return progress::wait_write; }
+
+            // too many unreported completions for the socket's option memory, copy this one
+            if (errno == ENOBUFS && zerocopy)
+            {
+                sender_.reap();
+                ret = ::send(wait_fd_, buf_.read_ptr(), left, MSG_NOSIGNAL);
+                zerocopy = false;
+                if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) { return progress::wait_write; }
+            }
+
+            if (ret == -1)
+            {
+                handle_socket_error(error_, "send");
+                return progress::error;
+            }
+        }
+
+        if (zerocopy)
+        {
+            ++sender_.stats_.zerocopy_sends;
+            sender_.track(buf_);
+        }
+        else { ++sender_.stats_.copy_sends; }
+
+        buf_.advance_read_ptr(static_cast<size_t>(ret));
+        bytes_transferred_ += static_cast<size_t>(ret);
+        LOG(trace) << "Sent " << ret << (zerocopy ? " bytes without copying" : " bytes");
+    }
+
+    return progress::done;
+}
+
+} // namespace detail
+
+} // namespace io
@@ -0,0 +1,751 @@
+#include <net/dns.hpp>
+#include <net/ops.hpp>
+
+#include <common/log.hpp>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace io
+{
+
+namespace
+{
+
+constexpr uint16_t DNS_PORT = 53;
+
+constexpr uint16_t TYPE_A     = 1;
+constexpr uint16_t TYPE_CNAME = 5;
+constexpr uint16_t TYPE_SOA   = 6;
+constexpr uint16_t TYPE_AAAA  = 28;
+constexpr uint16_t TYPE_OPT   = 41;
+constexpr uint16_t CLASS_IN   = 1;
+
+constexpr uint16_t FLAG_QR = 0x8000;
+constexpr uint16_t FLAG_TC = 0x0200;
+constexpr uint16_t FLAG_RD = 0x0100;
+
+constexpr uint16_t RCODE_NOERROR  = 0;
+constexpr uint16_t RCODE_NXDOMAIN = 3;
+
+/// @brief Advertised with EDNS0, the size that avoids IP fragmentation on practically every path.
+constexpr uint16_t EDNS_UDP_SIZE = 1232;
+
+constexpr size_t MAX_NAME_LENGTH  = 253;
+constexpr size_t MAX_LABEL_LENGTH = 63;
+constexpr int MAX_CNAME_CHAIN     = 16;
+
+uint16_t read_u16(const uint8_t *p) noexcept { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+uint32_t read_u32(const uint8_t *p) noexcept
+{
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 |
+           p[3];
+}
+
+void write_u16(std::vector<uint8_t> &out, uint16_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+/**
+ * @brief Lower case, without the trailing dot, and checked for the DNS length limits.
+ * @return The normalized name, empty if @p name isn't a valid host name.
+ */
+std::string normalize_name(std::string_view name)
+{
+    if (!name.empty() && name.back() == '.') { name.remove_suffix(1); }
+    if (name.empty() || name.size() > MAX_NAME_LENGTH) { return {}; }
+
+    std::string out;
+    out.reserve(name.size());
+
+    size_t label = 0;
+    for (char c : name)
+    {
+        if (c == '.')
+        {
+            if (label == 0) { return {}; }
+            label = 0;
+        }
+        else
+        {
+            // a DNS label can hold any byte, but a host name can't have these
+            if (static_cast<unsigned char>(c) <= ' ' || c == 0x7f || ++label > MAX_LABEL_LENGTH) { return {}; }
+        }
+        out.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+
+    return label == 0 ? std::string{} : out;
+}
+
+/**
+ * @brief Reads a possibly compressed name at @p offset and moves @p offset past it.
+ */
+bool read_name(const uint8_t *msg, size_t len, size_t &offset, std::string &out)
+{
+    out.clear();
+
+    size_t pos  = offset;
+    int jumps   = 0;
+    bool jumped = false;
+
+    while (true)
+    {
+        if (pos >= len) { return false; }
+        uint8_t label = msg[pos];
+
+        if ((label & 0xc0) == 0xc0)
+        {
+            if (pos + 1 >= len || ++jumps > MAX_CNAME_CHAIN) { return false; }
+            if (!jumped) { offset = pos + 2; }
+            jumped = true;
+            pos    = static_cast<size_t>(label & 0x3f) << 8 | msg[pos + 1];
+            continue;
+        }
+        if ((label & 0xc0) != 0) { return false; }
+
+        if (label == 0)
+        {
+            if (!jumped) { offset = pos + 1; }
+            return true;
+        }
+
+        if (pos + 1 + label > len) { return false; }
+        if (!out.empty()) { out.push_back('.'); }
+        for (size_t i = 0; i < label; ++i)
+        {
+            out.push_back(static_cast<char>(std::tolower(msg[pos + 1 + i])));
+        }
+        if (out.size() > MAX_NAME_LENGTH) { return false; }
+
+        pos += 1 + label;
+    }
+}
+
+/**
+ * @brief A query for @p name with an EDNS0 OPT record, the id is filled in when it is sent.
+ */
+std::vector<uint8_t> build_query(const std::string &name, uint16_t type)
+{
+    std::vector<uint8_t> out;
+    out.reserve(12 + name.size() + 2 + 4 + 11);
+
+    write_u16(out, 0);       // id
+    write_u16(out, FLAG_RD); // recursion desired
+    write_u16(out, 1);       // questions
+    write_u16(out, 0);       // answers
+    write_u16(out, 0);       // authority
+    write_u16(out, 1);       // additional, the OPT record
+
+    size_t start = 0;
+    while (start <= name.size())
+    {
+        size_t end = name.find('.', start);
+        if (end == std::string::npos) { end = name.size(); }
+
+        out.push_back(static_cast<uint8_t>(end - start));
+        out.insert(out.end(), name.begin() + start, name.begin() + end);
+        start = end + 1;
+    }
+    out.push_back(0);
+
+    write_u16(out, type);
+    write_u16(out, CLASS_IN);
+
+    out.push_back(0); // root name
+    write_u16(out, TYPE_OPT);
+    write_u16(out, EDNS_UDP_SIZE);
+    write_u16(out, 0); // extended rcode and version
+    write_u16(out, 0); // flags
+    write_u16(out, 0); // no options
+
+    return out;
+}
+
+struct dns_answer
+{
+    enum class status
+    {
+        ignore,  //!< not the response to our query
+        answer,  //!< a positive or negative answer
+        failure, //!< the server couldn't answer, try the next one
+    };
+
+    std::vector<std::array<uint8_t, 16>> addrs;
+    std::error_code error;
+    uint32_t ttl{std::numeric_limits<uint32_t>::max()};
+    bool has_soa{false};
+};
+
+struct dns_record
+{
+    std::string owner;
+    uint16_t type;
+    uint16_t cls;
+    uint32_t ttl;
+    size_t rdata;
+    uint16_t rdlength;
+};
+
+/**
+ * @brief Reads @p count resource records starting at @p offset.
+ */
+bool read_records(const uint8_t *msg, size_t len, size_t &offset, size_t count, std::vector<dns_record> &records)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        dns_record rr;
+        if (!read_name(msg, len, offset, rr.owner) || offset + 10 > len) { return false; }
+
+        rr.type     = read_u16(msg + offset);
+        rr.cls      = read_u16(msg + offset + 2);
+        rr.ttl      = read_u32(msg + offset + 4);
+        rr.rdlength = read_u16(msg + offset + 8);
+        rr.rdata    = offset + 10;
+
+        // RFC 2181: a TTL with the most significant bit set is read as zero
+        if (rr.ttl & 0x80000000u) { rr.ttl = 0; }
+
+        offset = rr.rdata + rr.rdlength;
+        if (offset > len) { return false; }
+
+        records.push_back(std::move(rr));
+    }
+
+    return true;
+}
+
+dns_answer::status parse_response(const uint8_t *msg, size_t len, uint16_t id, const std::string &name, uint16_t type,
+                                  dns_answer &out)
+{
+    using status = dns_answer::status;
+
+    if (len < 12 || read_u16(msg) != id) { return status::ignore; }
+
+    uint16_t flags = read_u16(msg + 2);
+    if (!(flags & FLAG_QR) || ((flags >> 11) & 0xf) != 0) { return status::ignore; }
+
+    uint16_t rcode = flags & 0xf;
+    size_t qdcount = read_u16(msg + 4);
+    size_t ancount = read_u16(msg + 6);
+    size_t nscount = read_u16(msg + 8);
+
+    // a server that can't parse the query may not echo the question
+    if (qdcount != 1) { return rcode != RCODE_NOERROR ? status::failure : status::ignore; }
+
+    size_t offset = 12;
+    std::string owner;
+    if (!read_name(msg, len, offset, owner) || offset + 4 > len) { return status::ignore; }
+    if (owner != name || read_u16(msg + offset) != type || read_u16(msg + offset + 2) != CLASS_IN)
+    {
+        return status::ignore;
+    }
+    offset += 4;
+
+    if (rcode != RCODE_NOERROR && rcode != RCODE_NXDOMAIN) { return status::failure; }
+
+    std::vector<dns_record> answers;
+    std::vector<dns_record> authority;
+    if (!read_records(msg, len, offset, ancount, answers)) { return status::failure; }
+    // the authority section only matters for the TTL of a negative answer, a truncated one is fine
+    bool have_authority = read_records(msg, len, offset, nscount, authority);
+
+    // follow the CNAME chain, the addresses belong to its last name
+    std::string target = name;
+    uint32_t chain_ttl = std::numeric_limits<uint32_t>::max();
+    for (int i = 0; i < MAX_CNAME_CHAIN; ++i)
+    {
+        auto it = std::find_if(answers.begin(), answers.end(), [&](const dns_record &rr)
+                               { return rr.type == TYPE_CNAME && rr.cls == CLASS_IN && rr.owner == target; });
+        if (it == answers.end()) { break; }
+
+        size_t rdata = it->rdata;
+        if (!read_name(msg, len, rdata, target)) { return status::failure; }
+        chain_ttl = std::min(chain_ttl, it->ttl);
+    }
+
+    const uint16_t addr_len = type == TYPE_A ? 4 : 16;
+    for (const auto &rr : answers)
+    {
+        if (rr.type != type || rr.cls != CLASS_IN || rr.owner != target || rr.rdlength != addr_len) { continue; }
+
+        std::array<uint8_t, 16> addr{};
+        std::memcpy(addr.data(), msg + rr.rdata, addr_len);
+        out.addrs.push_back(addr);
+        out.ttl = std::min(out.ttl, rr.ttl);
+    }
+
+    // whatever didn't fit may be the part we need
+    if ((flags & FLAG_TC) && out.addrs.empty()) { return status::failure; }
+
+    if (!out.addrs.empty())
+    {
+        out.ttl = std::min(out.ttl, chain_ttl);
+        return status::answer;
+    }
+
+    out.error = make_error_code(rcode == RCODE_NXDOMAIN ? dns_errc::not_found : dns_errc::no_data);
+
+    // RFC 2308: a negative answer lives for the smaller of the SOA TTL and its MINIMUM field
+    for (const auto &rr : have_authority ? authority : std::vector<dns_record>{})
+    {
+        if (rr.type != TYPE_SOA || rr.cls != CLASS_IN) { continue; }
+
+        size_t rdata = rr.rdata;
+        std::string skip;
+        if (!read_name(msg, len, rdata, skip) || !read_name(msg, len, rdata, skip)) { break; }
+        if (rdata + 20 > rr.rdata + rr.rdlength) { break; }
+
+        out.ttl     = std::min(rr.ttl, read_u32(msg + rdata + 16));
+        out.has_soa = true;
+        break;
+    }
+
+    return status::answer;
+}
+
+/**
+ * @brief The port of @p service, a number or a name from the services database.
+ */
+bool parse_service(const std::string &service, int socktype, uint16_t &port)
+{
+    port = 0;
+    if (service.empty()) { return true; }
+
+    unsigned value = 0;
+    auto [end, ec] = std::from_chars(service.data(), service.data() + service.size(), value);
+    if (ec == std::errc{} && end == service.data() + service.size()) { return value <= 0xffff && (port = value, true); }
+
+    struct servent entry;
+    struct servent *result = nullptr;
+    char buf[1024];
+    getservbyname_r(service.c_str(), socktype == SOCK_DGRAM ? "udp" : "tcp", &entry, buf, sizeof(buf), &result);
+    if (!result) { return false; }
+
+    port = ntohs(static_cast<uint16_t>(result->s_port));
+    return true;
+}
+
+sock_addr make_addr(int family, const uint8_t *addr, uint16_t port, int socktype)
+{
+    if (family == AF_INET)
+    {
+        struct sockaddr_in sin{};
+        sin.sin_family = AF_INET;
+        sin.sin_port   = htons(port);
+        std::memcpy(&sin.sin_addr, addr, 4);
+        return sock_addr(sin, 0, static_cast<uint16_t>(socktype));
+    }
+
+    struct sockaddr_in6 sin6{};
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port   = htons(port);
+    std::memcpy(&sin6.sin6_addr, addr, 16);
+    return sock_addr(sin6, 0, static_cast<uint16_t>(socktype));
+}
+
+} // namespace
+
+dns_config dns_config::from_resolv_conf(const std::string &path)
+{
+    dns_config config;
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword) || keyword[0] == '#' || keyword[0] == ';') { continue; }
+
+        if (keyword == "nameserver")
+        {
+            std::string server;
+            words >> server;
+            std::array<uint8_t, 16> bytes{};
+            if (inet_pton(AF_INET, server.c_str(), bytes.data()) == 1)
+            {
+                config.servers.push_back(make_addr(AF_INET, bytes.data(), DNS_PORT, SOCK_DGRAM));
+            }
+            else if (inet_pton(AF_INET6, server.c_str(), bytes.data()) == 1)
+            {
+                config.servers.push_back(make_addr(AF_INET6, bytes.data(), DNS_PORT, SOCK_DGRAM));
+            }
+            else { LOG(warn) << "Ignoring nameserver " << server << " in " << path; }
+        }
+        else if (keyword == "options")
+        {
+            std::string option;
+            while (words >> option)
+            {
+                if (option.starts_with("timeout:"))
+                {
+                    config.timeout = std::chrono::seconds(std::max(1, std::atoi(option.c_str() + 8)));
+                }
+                else if (option.starts_with("attempts:"))
+                {
+                    config.attempts = std::max(1, std::atoi(option.c_str() + 9));
+                }
+            }
+        }
+    }
+
+    if (config.servers.empty())
+    {
+        config.servers.emplace_back(std::string_view{"127.0.0.1"}, std::to_string(DNS_PORT), SOCK_DGRAM, AF_INET);
+    }
+
+    return config;
+}
+
+/**
+ * @brief A lookup waiting for the answer of a query in flight.
+ */
+struct dns_resolver::pending_waiter : public detail::io_promise
+{
+    pending_waiter(io_loop &loop, std::shared_ptr<pending> state)
+    : io_promise{loop, time_point_t::max()},
+      state_{std::move(state)}
+    {
+        state_->waiters.push_back(this);
+    }
+
+    ~pending_waiter() override
+    {
+        auto &waiters = state_->waiters;
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), this), waiters.end());
+    }
+
+    std::shared_ptr<pending> state_;
+};
+
+dns_resolver::dns_resolver(io_loop &loop, dns_config config) : loop_{loop}, config_{std::move(config)}
+{
+    if (config_.servers.empty()) { LOG(warn) << "DNS resolver without servers, every lookup will fail"; }
+    if (config_.attempts < 1) { config_.attempts = 1; }
+
+    id_state_ = std::random_device{}();
+    if (id_state_ == 0) { id_state_ = 0x9e3779b9; }
+}
+
+dns_resolver::~dns_resolver() = default;
+
+dns_resolver &dns_resolver::instance(io_loop &loop) { return loop.service<dns_resolver>(loop); }
+
+std::string dns_resolver::make_key(std::string_view name, uint16_t type)
+{
+    std::string key;
+    key.reserve(name.size() + 2);
+    key.push_back(static_cast<char>(type >> 8));
+    key.push_back(static_cast<char>(type));
+    key.append(name);
+    return key;
+}
+
+uint16_t dns_resolver::next_id() noexcept
+{
+    // the id is one of the two things an off-path attacker has to guess, the other one is the source port
+    uint16_t id;
+    if (getrandom(&id, sizeof(id), GRND_NONBLOCK) == sizeof(id)) { return id; }
+
+    id_state_ ^= id_state_ << 13;
+    id_state_ ^= id_state_ >> 17;
+    id_state_ ^= id_state_ << 5;
+    return static_cast<uint16_t>(id_state_);
+}
+
+io_func<std::vector<sock_addr>> dns_resolver::resolve(std::string name, std::string service, int family, int socktype,
+                                                      std::error_code *error)
+{
+    std::vector<sock_addr> result;
+    auto fail = [&](std::error_code ec)
+    {
+        if (error) { *error = ec; }
+        LOG(debug) << "Failed to resolve " << name << ": " << ec.message();
+    };
+
+    if (error) { error->clear(); }
+
+    uint16_t port;
+    if (!parse_service(service, socktype, port))
+    {
+        fail(make_error_code(dns_errc::bad_service));
+        co_return result;
+    }
+
+    if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6)
+    {
+        fail(std::make_error_code(std::errc::address_family_not_supported));
+        co_return result;
+    }
+
+    // numeric addresses, "[::1]" as well
+    std::string_view literal = name;
+    if (literal.size() > 2 && literal.front() == '[' && literal.back() == ']')
+    {
+        literal = literal.substr(1, literal.size() - 2);
+    }
+    std::array<uint8_t, 16> numeric;
+    std::string literal_str{literal};
+    if (inet_pton(AF_INET6, literal_str.c_str(), numeric.data()) == 1)
+    {
+        if (family != AF_INET) { result.push_back(make_addr(AF_INET6, numeric.data(), port, socktype)); }
+        else { fail(make_error_code(dns_errc::no_data)); }
+        co_return result;
+    }
+    if (inet_pton(AF_INET, literal_str.c_str(), numeric.data()) == 1)
+    {
+        if (family != AF_INET6) { result.push_back(make_addr(AF_INET, numeric.data(), port, socktype)); }
+        else { fail(make_error_code(dns_errc::no_data)); }
+        co_return result;
+    }
+
+    std::string host = normalize_name(name);
+    if (host.empty())
+    {
+        fail(make_error_code(dns_errc::invalid_name));
+        co_return result;
+    }
+
+    if (host == "localhost")
+    {
+        if (family != AF_INET) { result.push_back(make_addr(AF_INET6, in6addr_loopback.s6_addr, port, socktype)); }
+        if (family != AF_INET6)
+        {
+            const uint8_t loopback[4] = {127, 0, 0, 1};
+            result.push_back(make_addr(AF_INET, loopback, port, socktype));
+        }
+        co_return result;
+    }
+
+    struct lookup
+    {
+        uint16_t type;
+        std::vector<address_t> addrs;
+        std::error_code error;
+        std::shared_ptr<pending> state;
+    };
+
+    std::vector<lookup> lookups;
+    if (family != AF_INET) { lookups.push_back({TYPE_AAAA, {}, {}, {}}); }
+    if (family != AF_INET6) { lookups.push_back({TYPE_A, {}, {}, {}}); }
+
+    // start all the queries before waiting for any of them
+    for (auto &l : lookups)
+    {
+        auto key = make_key(host, l.type);
+
+        auto cached = cache_.find(key);
+        if (cached != cache_.end())
+        {
+            if (cached->second.expires > loop_.now())
+            {
+                l.addrs = cached->second.addrs;
+                l.error = cached->second.error;
+                continue;
+            }
+            cache_.erase(cached);
+        }
+
+        auto &state = pending_[key];
+        if (!state)
+        {
+            state = std::make_shared<pending>();
+            if (!loop_.schedule(query(key, host, l.type, state), "dns_query"))
+            {
+                state->done  = true;
+                state->error = make_error_code(io_errc::loop_shutdown);
+                pending_.erase(key);
+                l.error = make_error_code(io_errc::loop_shutdown);
+                continue;
+            }
+        }
+        l.state = state;
+    }
+
+    for (auto &l : lookups)
+    {
+        if (!l.state) { continue; }
+
+        if (!l.state->done)
+        {
+            pending_waiter waiter{loop_, l.state};
+            auto res = co_await waiter;
+            if (res != io_result::done)
+            {
+                l.error = result_to_error(res);
+                continue;
+            }
+        }
+
+        l.addrs = l.state->addrs;
+        l.error = l.state->error;
+    }
+
+    std::error_code first_error;
+    for (auto &l : lookups)
+    {
+        for (auto &addr : l.addrs)
+        {
+            result.push_back(make_addr(l.type == TYPE_A ? AF_INET : AF_INET6, addr.data(), port, socktype));
+        }
+
+        // "no such name" says more than "no address of this family"
+        if (l.error && (!first_error || l.error == make_error_code(dns_errc::not_found))) { first_error = l.error; }
+    }
+
+    if (result.empty()) { fail(first_error ? first_error : make_error_code(dns_errc::no_data)); }
+
+    co_return result;
+}
+
+io_task dns_resolver::query(std::string key, std::string name, uint16_t type, std::shared_ptr<pending> state)
+{
+    // if the loop destroys the task before it finished, the next lookup of the name has to start a new query
+    struct abandon_guard
+    {
+        dns_resolver &resolver;
+        const std::string &key;
+        pending &state;
+
+        ~abandon_guard()
+        {
+            if (state.done) { return; }
+
+            state.done  = true;
+            state.error = make_error_code(io_errc::operation_aborted);
+            auto it     = resolver.pending_.find(key);
+            if (it != resolver.pending_.end() && it->second.get() == &state) { resolver.pending_.erase(it); }
+        }
+    } guard{*this, key, *state};
+
+    auto packet = build_query(name, type);
+    std::array<uint8_t, 4096> buf;
+    std::error_code last_error = make_error_code(dns_errc::timeout);
+
+    for (int attempt = 0; attempt < config_.attempts; ++attempt)
+    {
+        for (const auto &server : config_.servers)
+        {
+            detail::file_descriptor fd{socket(server.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+            if (fd.get() == -1 || ::connect(fd.get(), server.sockaddr(), server.len()) == -1)
+            {
+                last_error = system_error();
+                LOG(warn) << "Failed to set up a DNS socket for " << server.to_string() << ": " << last_error.message();
+                continue;
+            }
+
+            uint16_t id = next_id();
+            packet[0]   = static_cast<uint8_t>(id >> 8);
+            packet[1]   = static_cast<uint8_t>(id);
+
+            if (::send(fd.get(), packet.data(), packet.size(), 0) != static_cast<ssize_t>(packet.size()))
+            {
+                last_error = system_error();
+                continue;
+            }
+            ++queries_sent_;
+
+            auto deadline = loop_.now() + config_.timeout;
+            while (true)
+            {
+                ssize_t received = 0;
+                auto res = co_await io::recv(loop_, fd.get(), reinterpret_cast<char *>(buf.data()), buf.size(),
+                                             received, 0, deadline);
+
+                if (res == io_result::timeout)
+                {
+                    last_error = make_error_code(dns_errc::timeout);
+                    break;
+                }
+                if (res == io_result::shutdown || res == io_result::cancelled)
+                {
+                    state->error = result_to_error(res);
+                    finish(key, *state, 0);
+                    co_return;
+                }
+                if (res != io_result::done)
+                {
+                    // e.g. ECONNREFUSED from an ICMP port unreachable
+                    last_error = make_error_code(dns_errc::server_failure);
+                    break;
+                }
+
+                dns_answer answer;
+                auto status = parse_response(buf.data(), static_cast<size_t>(received), id, name, type, answer);
+                if (status == dns_answer::status::ignore) { continue; }
+                if (status == dns_answer::status::failure)
+                {
+                    last_error = make_error_code(dns_errc::server_failure);
+                    break;
+                }
+
+                state->addrs = std::move(answer.addrs);
+                state->error = answer.error;
+
+                uint32_t ttl = answer.ttl;
+                if (answer.error)
+                {
+                    ttl = answer.has_soa ? std::min<uint32_t>(ttl, config_.max_negative_ttl.count())
+                                         : static_cast<uint32_t>(config_.negative_ttl.count());
+                }
+                else { ttl = std::min<uint32_t>(ttl, config_.max_ttl.count()); }
+
+                finish(key, *state, ttl);
+                co_return;
+            }
+        }
+    }
+
+    // failures aren't cached, the next lookup asks again
+    state->error = last_error;
+    finish(key, *state, 0);
+}
+
+void dns_resolver::finish(const std::string &key, pending &state, uint32_t ttl) noexcept
+{
+    state.done = true;
+
+    if (ttl > 0) { store(key, state, ttl); }
+
+    auto it = pending_.find(key);
+    if (it != pending_.end() && it->second.get() == &state) { pending_.erase(it); }
+
+    auto waiters = std::move(state.waiters);
+    state.waiters.clear();
+    for (auto *waiter : waiters) { (void)waiter->waiter_.complete(io_result::done); }
+}
+
+void dns_resolver::store(const std::string &key, const pending &state, uint32_t ttl)
+{
+    auto now = loop_.now();
+
+    if (cache_.size() >= config_.max_cache_entries)
+    {
+        std::erase_if(cache_, [now](const auto &entry) { return entry.second.expires <= now; });
+        if (cache_.size() >= config_.max_cache_entries && !cache_.empty())
+        {
+            // none expired yet, the one that expires first has the least left to give
+            cache_.erase(std::min_element(cache_.begin(), cache_.end(), [](const auto &a, const auto &b)
+                                          { return a.second.expires < b.second.expires; }));
+        }
+    }
+    if (config_.max_cache_entries == 0) { return; }
+
+    cache_[key] = cache_entry{state.addrs, state.error, now + std::chrono::seconds(ttl)};
+}
+
+} // namespace io
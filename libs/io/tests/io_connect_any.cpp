@@ -0,0 +1,216 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/connect_any.hpp>
+#include <net/sockaddr.hpp>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/**
+ * @brief A loopback listening socket, with @p backlog 0 and its queue filled it drops further SYNs like a dead host.
+ */
+struct backend
+{
+    explicit backend(int backlog = 64)
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+        REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+        REQUIRE(listen(fd, backlog) == 0);
+        REQUIRE(getsockname(fd, addr.sockaddr(), &addr.len_ref()) == 0);
+    }
+
+    ~backend()
+    {
+        for (int client : clients) { close(client); }
+        close(fd);
+    }
+
+    /// @brief Fills the accept queue, the next SYN goes unanswered.
+    void fill()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            int client = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            (void)::connect(client, addr.sockaddr(), addr.len());
+            clients.push_back(client);
+        }
+        // let the handshakes finish
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    int fd{-1};
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    std::vector<int> clients;
+};
+
+/// @brief An address nothing listens on, connects to it are refused right away.
+struct sock_addr refusing_addr()
+{
+    backend closed;
+    return closed.addr;
+}
+
+uint16_t peer_port(int fd)
+{
+    struct sock_addr peer{"127.0.0.1:0", AF_INET};
+    REQUIRE(getpeername(fd, peer.sockaddr(), &peer.len_ref()) == 0);
+    return ntohs(reinterpret_cast<const sockaddr_in *>(peer.sockaddr())->sin_port);
+}
+
+uint16_t port(const struct sock_addr &addr)
+{
+    return ntohs(reinterpret_cast<const sockaddr_in *>(addr.sockaddr())->sin_port);
+}
+
+} // namespace
+
+TEST_CASE("interleave_families alternates families starting with the first", "[io_connect_any]")
+{
+    std::vector<struct sock_addr> addrs = {
+        sock_addr("[2001:db8::1]:80", AF_INET6), sock_addr("[2001:db8::2]:80", AF_INET6),
+        sock_addr("[2001:db8::3]:80", AF_INET6), sock_addr("192.0.2.1:80", AF_INET),
+        sock_addr("192.0.2.2:80", AF_INET)};
+
+    auto ordered = interleave_families(addrs);
+    REQUIRE(ordered.size() == 5);
+    REQUIRE(ordered[0] == addrs[0]);
+    REQUIRE(ordered[1] == addrs[3]);
+    REQUIRE(ordered[2] == addrs[1]);
+    REQUIRE(ordered[3] == addrs[4]);
+    REQUIRE(ordered[4] == addrs[2]);
+}
+
+TEST_CASE("connect_any gets past an address that doesn't answer after the stagger", "[io_connect_any]")
+{
+    io_loop loop;
+    loop.init();
+
+    backend dead{0};
+    dead.fill();
+    backend live;
+    std::vector<struct sock_addr> addrs = {dead.addr, live.addr};
+
+    int fd = -1;
+    std::error_code error;
+    auto elapsed = std::chrono::milliseconds(0);
+    auto client  = [&]() -> io_task
+    {
+        auto start = loop.now();
+        fd         = co_await connect_any(loop, addrs, std::chrono::milliseconds(30), {},
+                                          loop.now() + std::chrono::seconds(5), &error);
+        elapsed    = std::chrono::duration_cast<std::chrono::milliseconds>(loop.now() - start);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(fd != -1);
+    REQUIRE_FALSE(error);
+    REQUIRE(peer_port(fd) == port(live.addr));
+    // the dead address cost the stagger, not the SYN retransmit a second later
+    REQUIRE(elapsed >= std::chrono::milliseconds(25));
+    REQUIRE(elapsed < std::chrono::milliseconds(900));
+    close(fd);
+}
+
+TEST_CASE("connect_any moves on right away when an attempt is refused", "[io_connect_any]")
+{
+    io_loop loop;
+    loop.init();
+
+    backend live;
+    std::vector<struct sock_addr> addrs = {refusing_addr(), live.addr};
+
+    int fd       = -1;
+    auto elapsed = std::chrono::milliseconds(0);
+    auto client  = [&]() -> io_task
+    {
+        auto start = loop.now();
+        fd         = co_await connect_any(loop, addrs, std::chrono::seconds(2));
+        elapsed    = std::chrono::duration_cast<std::chrono::milliseconds>(loop.now() - start);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(fd != -1);
+    REQUIRE(peer_port(fd) == port(live.addr));
+    REQUIRE(elapsed < std::chrono::milliseconds(1000));
+    close(fd);
+}
+
+TEST_CASE("connect_any reports the first error when every address fails", "[io_connect_any]")
+{
+    io_loop loop;
+    loop.init();
+
+    std::vector<struct sock_addr> addrs = {refusing_addr(), refusing_addr()};
+
+    int fd = 0;
+    std::error_code error;
+    auto client = [&]() -> io_task
+    { fd = co_await connect_any(loop, addrs, DEFAULT_CONNECT_STAGGER, {}, time_point_t::max(), &error); };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(fd == -1);
+    REQUIRE(error == std::errc::connection_refused);
+}
+
+TEST_CASE("connect_any gives up at the deadline and closes the attempts", "[io_connect_any]")
+{
+    io_loop loop;
+    loop.init();
+
+    backend dead{0};
+    dead.fill();
+    std::vector<struct sock_addr> addrs = {dead.addr, dead.addr};
+
+    int fd = 0;
+    std::error_code error;
+    auto client = [&]() -> io_task
+    {
+        auto deadline = loop.now() + std::chrono::milliseconds(50);
+        fd            = co_await connect_any(loop, addrs, std::chrono::milliseconds(10), {}, deadline, &error);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(fd == -1);
+    REQUIRE(error == make_error_code(io_errc::operation_timeout));
+}
+
+TEST_CASE("connect_any without addresses", "[io_connect_any]")
+{
+    io_loop loop;
+    loop.init();
+
+    int fd = 0;
+    std::error_code error;
+    auto client = [&]() -> io_task
+    {
+        fd = co_await connect_any(loop, std::span<const struct sock_addr>{}, DEFAULT_CONNECT_STAGGER, {},
+                                  time_point_t::max(), &error);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(fd == -1);
+    REQUIRE(error == std::errc::invalid_argument);
+}
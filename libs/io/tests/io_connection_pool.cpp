@@ -0,0 +1,367 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/connection_pool.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/**
+ * @brief A loopback listening socket whose connections stay in the accept queue until taken.
+ */
+struct backend
+{
+    backend()
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+        REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+        REQUIRE(listen(fd, 64) == 0);
+        REQUIRE(getsockname(fd, addr.sockaddr(), &addr.len_ref()) == 0);
+    }
+
+    ~backend()
+    {
+        for (int peer : peers) { close(peer); }
+        close(fd);
+    }
+
+    /// @brief Accepts what is queued, returns how many connections were accepted so far.
+    size_t take()
+    {
+        int peer = -1;
+        while ((peer = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC)) != -1) { peers.push_back(peer); }
+        return peers.size();
+    }
+
+    int fd{-1};
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    std::vector<int> peers;
+};
+
+} // namespace
+
+TEST_CASE("released connections are reused", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool pool{loop};
+
+    int first_fd = -1, second_fd = -1;
+    bool first_reused = true, second_reused = false;
+    auto client = [&]() -> io_task
+    {
+        auto first   = co_await pool.acquire(server.addr);
+        first_fd     = first.fd();
+        first_reused = first.reused();
+        first.release();
+
+        auto second   = co_await pool.acquire(server.addr);
+        second_fd     = second.fd();
+        second_reused = second.reused();
+        second.release();
+        pool.clear();
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(first_fd != -1);
+    REQUIRE_FALSE(first_reused);
+    REQUIRE(second_fd == first_fd);
+    REQUIRE(second_reused);
+    REQUIRE(pool.stats().misses == 1);
+    REQUIRE(pool.stats().hits == 1);
+    REQUIRE(server.take() == 1);
+    REQUIRE(pool.idle(server.addr) == 0);
+    REQUIRE(pool.in_use(server.addr) == 0);
+}
+
+TEST_CASE("connections closed without release are not reused", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.max_idle = 1;
+    connection_pool pool{loop, options};
+
+    size_t idle_after_close = 1, idle_after_release = 0;
+    auto client = [&]() -> io_task
+    {
+        {
+            auto dropped = co_await pool.acquire(server.addr);
+        }
+        idle_after_close = pool.idle(server.addr);
+
+        auto a = co_await pool.acquire(server.addr);
+        auto b = co_await pool.acquire(server.addr);
+        a.release();
+        // max_idle is 1, the second one is closed
+        b.release();
+        idle_after_release = pool.idle(server.addr);
+        pool.clear();
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(idle_after_close == 0);
+    REQUIRE(idle_after_release == 1);
+    REQUIRE(pool.stats().misses == 3);
+    REQUIRE(server.take() == 3);
+}
+
+TEST_CASE("checkouts wait in line when max_in_use connections are out", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.max_in_use = 1;
+    connection_pool pool{loop, options};
+
+    std::vector<int> order;
+    int holder_fd = -1, waiter_fd = -1;
+    auto holder = [&]() -> io_task
+    {
+        auto conn = co_await pool.acquire(server.addr);
+        holder_fd = conn.fd();
+        order.push_back(1);
+        co_await io::sleep(loop, std::chrono::milliseconds(20));
+        conn.release();
+    };
+    auto waiter = [&]() -> io_task
+    {
+        co_await io::sleep(loop, std::chrono::milliseconds(5));
+        auto conn = co_await pool.acquire(server.addr, loop.now() + std::chrono::seconds(1));
+        waiter_fd = conn.fd();
+        order.push_back(2);
+        conn.release();
+        pool.clear();
+    };
+
+    REQUIRE(loop.schedule(holder(), "holder"));
+    REQUIRE(loop.schedule(waiter(), "waiter"));
+    loop.run();
+
+    REQUIRE(order == std::vector<int>{1, 2});
+    REQUIRE(waiter_fd == holder_fd);
+    REQUIRE(pool.stats().waits == 1);
+    REQUIRE(pool.stats().hits == 1);
+    REQUIRE(pool.stats().max_wait_time >= std::chrono::milliseconds(10));
+    REQUIRE(server.take() == 1);
+}
+
+TEST_CASE("a returned connection goes to the checkout in line, not to a newcomer", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.max_in_use = 1;
+    connection_pool pool{loop, options};
+
+    int holder_fd = -1, waiter_fd = -1;
+    bool newcomer_got = true;
+    std::error_code newcomer_error;
+    auto holder = [&]() -> io_task
+    {
+        auto conn = co_await pool.acquire(server.addr);
+        holder_fd = conn.fd();
+        co_await io::sleep(loop, std::chrono::milliseconds(10));
+
+        // checks out again before the one in line resumes
+        conn.release();
+        auto again   = co_await pool.acquire(server.addr, loop.now() + std::chrono::milliseconds(10), &newcomer_error);
+        newcomer_got = static_cast<bool>(again);
+    };
+    auto waiter = [&]() -> io_task
+    {
+        co_await io::sleep(loop, std::chrono::milliseconds(2));
+        auto conn = co_await pool.acquire(server.addr, loop.now() + std::chrono::milliseconds(200));
+        waiter_fd = conn.fd();
+        co_await io::sleep(loop, std::chrono::milliseconds(30));
+        conn.close();
+    };
+
+    REQUIRE(loop.schedule(holder(), "holder"));
+    REQUIRE(loop.schedule(waiter(), "waiter"));
+    loop.run();
+
+    REQUIRE(waiter_fd == holder_fd);
+    REQUIRE_FALSE(newcomer_got);
+    REQUIRE(newcomer_error == make_error_code(io_errc::operation_timeout));
+    REQUIRE(pool.in_use(server.addr) == 0);
+}
+
+TEST_CASE("a waiting checkout gives up at its deadline", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.max_in_use = 1;
+    connection_pool pool{loop, options};
+
+    std::error_code error;
+    bool got = true;
+    auto client = [&]() -> io_task
+    {
+        auto held  = co_await pool.acquire(server.addr);
+        auto again = co_await pool.acquire(server.addr, loop.now() + std::chrono::milliseconds(10), &error);
+        got        = static_cast<bool>(again);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE_FALSE(got);
+    REQUIRE(error == make_error_code(io_errc::operation_timeout));
+    REQUIRE(pool.stats().timeouts == 1);
+    REQUIRE(pool.in_use(server.addr) == 0);
+}
+
+TEST_CASE("checkouts in line when the pool goes away are cancelled", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.max_in_use = 1;
+    auto pool          = std::make_unique<connection_pool>(loop, options);
+
+    std::vector<std::error_code> errors(2);
+    std::vector<bool> got(2, true);
+    auto holder = [&]() -> io_task
+    {
+        auto conn = co_await pool->acquire(server.addr);
+        REQUIRE(conn);
+        co_await io::sleep(loop, std::chrono::milliseconds(10));
+
+        // wakes the first in line, neither resumes before the pool is gone
+        conn.close();
+        pool.reset();
+    };
+    auto waiter = [&](size_t i) -> io_task
+    {
+        co_await io::sleep(loop, std::chrono::milliseconds(2));
+        auto conn = co_await pool->acquire(server.addr, loop.now() + std::chrono::seconds(1), &errors[i]);
+        got[i]    = static_cast<bool>(conn);
+    };
+
+    REQUIRE(loop.schedule(holder(), "holder"));
+    REQUIRE(loop.schedule(waiter(0), "first"));
+    REQUIRE(loop.schedule(waiter(1), "second"));
+    loop.run();
+
+    REQUIRE(pool == nullptr);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        REQUIRE_FALSE(got[i]);
+        REQUIRE(errors[i] == result_to_error(io_result::cancelled));
+    }
+}
+
+TEST_CASE("idle connections the peer closed are not handed out", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool pool{loop};
+
+    int stale_fd = -1;
+    bool reused  = true;
+    auto client  = [&]() -> io_task
+    {
+        auto conn = co_await pool.acquire(server.addr);
+        stale_fd  = conn.fd();
+        conn.release();
+
+        // the backend drops its side while the connection sits in the pool
+        server.take();
+        for (int peer : server.peers) { close(peer); }
+        server.peers.clear();
+        co_await io::sleep(loop, std::chrono::milliseconds(5));
+
+        auto fresh = co_await pool.acquire(server.addr);
+        reused     = fresh.reused();
+        fresh.release();
+        pool.clear();
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(stale_fd != -1);
+    REQUIRE_FALSE(reused);
+    REQUIRE(pool.stats().stale == 1);
+    REQUIRE(pool.stats().misses == 2);
+}
+
+TEST_CASE("idle connections expire after idle_timeout", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    backend server;
+    connection_pool_options options;
+    options.idle_timeout = std::chrono::milliseconds(10);
+    connection_pool pool{loop, options};
+
+    auto client = [&]() -> io_task
+    {
+        auto a = co_await pool.acquire(server.addr);
+        auto b = co_await pool.acquire(server.addr);
+        a.release();
+        b.release();
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    // the expiry timer keeps the loop running until both are closed
+    loop.run();
+
+    REQUIRE(pool.stats().expired == 2);
+    REQUIRE(pool.idle(server.addr) == 0);
+}
+
+TEST_CASE("failed connects free their place", "[io_connection_pool]")
+{
+    io_loop loop;
+    loop.init();
+    connection_pool pool{loop};
+
+    // nothing listens on a port that was just closed
+    struct sock_addr addr;
+    {
+        backend closed;
+        addr = closed.addr;
+    }
+
+    std::error_code error;
+    bool got    = true;
+    auto client = [&]() -> io_task
+    {
+        auto conn = co_await pool.acquire(addr, loop.now() + std::chrono::seconds(1), &error);
+        got       = static_cast<bool>(conn);
+    };
+
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE_FALSE(got);
+    REQUIRE(error);
+    REQUIRE(pool.stats().connect_failures == 1);
+    REQUIRE(pool.in_use(addr) == 0);
+}
@@ -0,0 +1,190 @@
+#include <common/catch.hpp>
+
+#include <io/flat_map.hpp>
+#include <net/connection_table.hpp>
+#include <net/sockaddr.hpp>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+sock_addr v4_addr(uint32_t addr, uint16_t port)
+{
+    struct sockaddr_in sin = {};
+    sin.sin_family         = AF_INET;
+    sin.sin_addr.s_addr    = htonl(addr);
+    sin.sin_port           = htons(port);
+    return sock_addr(sin);
+}
+
+/// @brief A hash with only 64 values, to get long probe sequences.
+struct clustered_hash
+{
+    size_t operator()(uint64_t key) const noexcept { return key % 64; }
+};
+
+} // namespace
+
+TEST_CASE("flat_map insert, find and erase", "[flat_map]")
+{
+    flat_map<std::string, int> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find("a") == nullptr);
+    REQUIRE_FALSE(map.erase("a"));
+
+    auto [e, added] = map.try_emplace("a", 1);
+    REQUIRE(added);
+    REQUIRE(e->key == "a");
+    REQUIRE(e->value == 1);
+
+    auto [again, added_again] = map.try_emplace("a", 2);
+    REQUIRE_FALSE(added_again);
+    REQUIRE(again->value == 1);
+
+    REQUIRE_FALSE(map.insert_or_assign("a", 3).second);
+    REQUIRE(map.find("a")->value == 3);
+
+    map["b"] += 5;
+    REQUIRE(map["b"] == 5);
+    REQUIRE(map.size() == 2);
+
+    REQUIRE(map.erase("a"));
+    REQUIRE_FALSE(map.contains("a"));
+    REQUIRE(map.contains("b"));
+    REQUIRE(map.size() == 1);
+
+    map.clear();
+    REQUIRE(map.empty());
+    REQUIRE(map.find("b") == nullptr);
+}
+
+TEST_CASE("flat_map matches unordered_map under churn", "[flat_map]")
+{
+    std::mt19937_64 rng(7);
+    flat_map<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> reference;
+
+    for (int round = 0; round < 200000; ++round)
+    {
+        uint64_t key = rng() % 5000;
+        switch (rng() % 3)
+        {
+        case 0:
+        case 1:
+        {
+            bool added = map.try_emplace(key, round).second;
+            REQUIRE(added == reference.emplace(key, round).second);
+            break;
+        }
+        case 2: REQUIRE(map.erase(key) == (reference.erase(key) != 0)); break;
+        }
+    }
+
+    REQUIRE(map.size() == reference.size());
+    for (const auto &[key, value] : reference)
+    {
+        const auto *e = map.find(key);
+        REQUIRE(e != nullptr);
+        REQUIRE(e->value == value);
+    }
+
+    size_t walked = 0;
+    for (const auto &e : map)
+    {
+        REQUIRE(reference.at(e.key) == e.value);
+        ++walked;
+    }
+    REQUIRE(walked == reference.size());
+}
+
+TEST_CASE("flat_map with a bad hash", "[flat_map]")
+{
+    flat_map<uint64_t, int, clustered_hash> map;
+    for (uint64_t key = 0; key < 1000; ++key) { REQUIRE(map.try_emplace(key, int(key)).second); }
+    for (uint64_t key = 0; key < 1000; key += 2) { REQUIRE(map.erase(key)); }
+    REQUIRE(map.size() == 500);
+    for (uint64_t key = 0; key < 1000; ++key) { REQUIRE(map.contains(key) == (key % 2 == 1)); }
+}
+
+TEST_CASE("flat_map erase_if and move only values", "[flat_map]")
+{
+    flat_map<uint64_t, std::unique_ptr<int>> map(100);
+    size_t capacity = map.capacity();
+    for (uint64_t key = 0; key < 100; ++key) { map.try_emplace(key, std::make_unique<int>(int(key))); }
+    REQUIRE(map.capacity() == capacity);
+
+    REQUIRE(map.erase_if([](auto &e) { return *e.value % 3 == 0; }) == 34);
+    REQUIRE(map.size() == 66);
+    for (uint64_t key = 0; key < 100; ++key)
+    {
+        const auto *e = map.find(key);
+        REQUIRE((e != nullptr) == (key % 3 != 0));
+        if (e) { REQUIRE(*e->value == int(key)); }
+    }
+
+    flat_map<uint64_t, std::unique_ptr<int>> moved(std::move(map));
+    REQUIRE(moved.size() == 66);
+    REQUIRE(map.empty());
+    REQUIRE(*moved.find(1)->value == 1);
+}
+
+TEST_CASE("socket_tuple keys", "[connection_table]")
+{
+    sock_addr local("10.0.0.1:443");
+    sock_addr peer("192.0.2.7:50000");
+    sock_addr local6("[2001:db8::1]:443");
+    sock_addr peer6("[2001:db8::7]:50000");
+
+    socket_tuple t(local, peer);
+    REQUIRE(t.local() == local);
+    REQUIRE(t.remote() == peer);
+    REQUIRE(t == socket_tuple(local, peer));
+    REQUIRE(t != socket_tuple(peer, local));
+    REQUIRE(t.reversed() == socket_tuple(peer, local));
+    REQUIRE(std::hash<socket_tuple>{}(t) != std::hash<socket_tuple>{}(t.reversed()));
+
+    socket_tuple t6(local6, peer6);
+    REQUIRE(t6.local() == local6);
+    REQUIRE(t6.remote() == peer6);
+    REQUIRE(t6 != t);
+
+    connection_table<std::string> table;
+    table.try_emplace(t, "v4");
+    table.try_emplace(t6, "v6");
+    REQUIRE(table.find(socket_tuple(local, peer))->value == "v4");
+    REQUIRE(table.find(socket_tuple(local6, peer6))->value == "v6");
+    REQUIRE(table.find(socket_tuple(local, sock_addr("192.0.2.7:50001"))) == nullptr);
+}
+
+TEST_CASE("connection_table with many sessions", "[connection_table]")
+{
+    // one local address, peers from a /16 on every port: the hash has to spread keys that differ in a few bits
+    sock_addr local = v4_addr(0x0a000001, 53);
+    connection_table<uint32_t> table;
+    std::unordered_set<size_t> hashes;
+
+    for (uint32_t i = 0; i < 200000; ++i)
+    {
+        socket_tuple key(local, v4_addr(0xc0a80000 | (i & 0xffff), uint16_t(1024 + i / 0x10000)));
+        REQUIRE(table.try_emplace(key, i).second);
+        hashes.insert(std::hash<socket_tuple>{}(key));
+    }
+    REQUIRE(table.size() == 200000);
+    REQUIRE(hashes.size() == 200000);
+
+    for (uint32_t i = 0; i < 200000; i += 7)
+    {
+        socket_tuple key(local, v4_addr(0xc0a80000 | (i & 0xffff), uint16_t(1024 + i / 0x10000)));
+        const auto *e = table.find(key);
+        REQUIRE(e != nullptr);
+        REQUIRE(e->value == i);
+    }
+}
@@ -0,0 +1,307 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/datagram.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/// @brief A non-blocking UDP socket bound to an ephemeral loopback port.
+struct udp_socket
+{
+    int fd = -1;
+    struct sock_addr addr{"127.0.0.1:0", AF_INET, SOCK_DGRAM};
+
+    udp_socket()
+    {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+        REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+        REQUIRE(getsockname(fd, addr.sockaddr(), &addr.len_ref()) == 0);
+
+        int size = 4 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    ~udp_socket()
+    {
+        if (fd != -1) { close(fd); }
+    }
+};
+
+} // namespace
+
+TEST_CASE("sendto and recvfrom exchange single datagrams", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b;
+
+    std::vector<std::string> received;
+    std::vector<struct sock_addr> senders;
+
+    std::vector<std::string> payloads = {"hello", "", "world"};
+    size_t sent_total                 = 0;
+
+    auto sender = [&]() -> io_task
+    {
+        for (const auto &payload : payloads)
+        {
+            size_t sent = 0;
+            if (co_await sendto(loop, a.fd, payload.data(), payload.size(), b.addr, sent) != io_result::done) { break; }
+            sent_total += sent;
+        }
+    };
+
+    auto receiver = [&]() -> io_task
+    {
+        char buf[64];
+        while (received.size() < 3)
+        {
+            struct sock_addr peer;
+            ssize_t n = 0;
+            if (co_await recvfrom(loop, b.fd, buf, sizeof(buf), peer, n) != io_result::done) { co_return; }
+            received.emplace_back(buf, n);
+            senders.push_back(peer);
+        }
+    };
+
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    // an empty datagram is data, not the end of a connection
+    REQUIRE(sent_total == 10);
+    REQUIRE(received == payloads);
+    for (const auto &peer : senders) { REQUIRE(peer == a.addr); }
+}
+
+TEST_CASE("batches send and receive many datagrams per call", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b;
+
+    constexpr size_t count = 1000;
+    datagram_batch out{64, 256};
+    datagram_batch in{64, 256};
+
+    std::vector<std::string> received;
+    size_t calls        = 0;
+    size_t largest_read = 0;
+
+    size_t sent_total = 0;
+    auto sender       = [&]() -> io_task
+    {
+        for (size_t i = 0; i < count;)
+        {
+            out.clear();
+            for (; i < count && out.add("datagram " + std::to_string(i), b.addr); ++i) {}
+
+            size_t sent = 0;
+            if (co_await send_batch(loop, a.fd, out, sent) != io_result::done) { break; }
+            sent_total += sent;
+        }
+    };
+
+    auto receiver = [&]() -> io_task
+    {
+        while (received.size() < count)
+        {
+            if (co_await recv_batch(loop, b.fd, in, 0, loop.now() + std::chrono::seconds(2)) != io_result::done)
+            {
+                co_return;
+            }
+
+            ++calls;
+            largest_read = std::max(largest_read, in.size());
+            for (size_t i = 0; i < in.size(); ++i)
+            {
+                REQUIRE(in.peer(i) == a.addr);
+                REQUIRE_FALSE(in.truncated(i));
+                received.emplace_back(in.view(i));
+            }
+        }
+    };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    loop.run();
+
+    REQUIRE(sent_total == count);
+    REQUIRE(received.size() == count);
+    for (size_t i = 0; i < count; ++i) { REQUIRE(received[i] == "datagram " + std::to_string(i)); }
+    REQUIRE(largest_read > 1);
+    REQUIRE(calls < count);
+}
+
+TEST_CASE("batches address each datagram and mark truncated ones", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b, c;
+
+    datagram_batch out{8, 2048};
+    datagram_batch to_b{8, 16};
+    datagram_batch to_c{8, 16};
+
+    REQUIRE(out.add("for b", b.addr));
+    REQUIRE(out.add("for c", c.addr));
+    REQUIRE(out.add(std::string(100, 'x'), b.addr));
+    REQUIRE_FALSE(out.add(std::string(2049, 'x'), b.addr));
+
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+    auto sender      = [&]() -> io_task { result = co_await send_batch(loop, a.fd, out, sent); };
+
+    auto receiver = [&](int fd, datagram_batch &batch, size_t want) -> io_task
+    {
+        // both datagrams for b may take more than one call to arrive
+        std::vector<std::string> got;
+        while (got.size() < want)
+        {
+            if (co_await recv_batch(loop, fd, batch) != io_result::done) { co_return; }
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                REQUIRE(batch.peer(i) == a.addr);
+                got.emplace_back(batch.view(i));
+                if (got.back().size() == 16) { REQUIRE(batch.truncated(i)); }
+                else { REQUIRE_FALSE(batch.truncated(i)); }
+            }
+        }
+        if (fd == b.fd) { REQUIRE(got == std::vector<std::string>{"for b", std::string(16, 'x')}); }
+        else { REQUIRE(got == std::vector<std::string>{"for c"}); }
+    };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    REQUIRE(loop.schedule(receiver(b.fd, to_b, 2), "receiver b"));
+    REQUIRE(loop.schedule(receiver(c.fd, to_c, 1), "receiver c"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(sent == 3);
+}
+
+TEST_CASE("send_batch stops at the datagram the kernel refuses", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b;
+
+    // the datagrams without a peer go to the connected one, the second names an address an IPv4 socket can't reach
+    REQUIRE(connect(a.fd, b.addr.sockaddr(), b.addr.len()) == 0);
+
+    datagram_batch out{4, 64};
+    REQUIRE(out.add("first"));
+    REQUIRE(out.add("second", sock_addr("[::1]:9", AF_INET6, SOCK_DGRAM)));
+    REQUIRE(out.add("third"));
+
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+    auto sender      = [&]() -> io_task { result = co_await send_batch(loop, a.fd, out, sent); };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    REQUIRE(result == io_result::error);
+    REQUIRE(sent == 1);
+}
+
+TEST_CASE("send_segmented sends a buffer as equal datagrams", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b;
+
+    // 300 datagrams of 1000 bytes and a short one, more than one send takes
+    std::string data(300 * 1000 + 123, '\0');
+    for (size_t i = 0; i < data.size(); ++i) { data[i] = static_cast<char>(i / 1000 + i % 7); }
+
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+    auto sender      = [&]() -> io_task
+    {
+        result = co_await send_segmented(loop, a.fd, data.data(), data.size(), 1000, b.addr, sent);
+    };
+
+    datagram_batch in{64, 2048};
+    std::vector<std::string> received;
+    auto receiver = [&]() -> io_task
+    {
+        while (received.size() < 301)
+        {
+            if (co_await recv_batch(loop, b.fd, in, 0, loop.now() + std::chrono::seconds(2)) != io_result::done)
+            {
+                co_return;
+            }
+            for (size_t i = 0; i < in.size(); ++i) { received.emplace_back(in.view(i)); }
+        }
+    };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(sent == data.size());
+    REQUIRE(received.size() == 301);
+    for (size_t i = 0; i < received.size(); ++i) { REQUIRE(received[i] == data.substr(i * 1000, 1000)); }
+}
+
+TEST_CASE("batches split datagrams coalesced by GRO", "[io_datagram]")
+{
+    io_loop loop;
+    loop.init();
+    udp_socket a, b;
+    REQUIRE_FALSE(enable_udp_gro(b.fd));
+
+    std::string data(200 * 1200 + 500, '\0');
+    for (size_t i = 0; i < data.size(); ++i) { data[i] = static_cast<char>(i / 1200 * 3 + i % 11); }
+
+    size_t sent = 0;
+    auto sender = [&]() -> io_task
+    {
+        (void)co_await send_segmented(loop, a.fd, data.data(), data.size(), 1200, b.addr, sent);
+    };
+
+    datagram_batch in{8, 65536};
+    std::vector<std::string> received;
+    size_t most_segments = 0;
+    auto receiver        = [&]() -> io_task
+    {
+        while (received.size() < 201)
+        {
+            if (co_await recv_batch(loop, b.fd, in, 0, loop.now() + std::chrono::seconds(2)) != io_result::done)
+            {
+                co_return;
+            }
+            for (size_t i = 0; i < in.size(); ++i)
+            {
+                REQUIRE(in.peer(i) == a.addr);
+                most_segments = std::max(most_segments, in.segments(i));
+                for (size_t k = 0; k < in.segments(i); ++k) { received.emplace_back(in.segment(i, k)); }
+            }
+        }
+    };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    loop.run();
+
+    REQUIRE(sent == data.size());
+    REQUIRE(received.size() == 201);
+    for (size_t i = 0; i < received.size(); ++i) { REQUIRE(received[i] == data.substr(i * 1200, 1200)); }
+    REQUIRE(most_segments > 1);
+}
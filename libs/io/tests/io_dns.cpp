@@ -0,0 +1,532 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/dns.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+constexpr uint16_t TYPE_A    = 1;
+constexpr uint16_t TYPE_AAAA = 28;
+
+/**
+ * @brief Stand-in DNS server on loopback, answers from a small zone and counts the queries.
+ */
+struct fake_dns_server
+{
+    struct record
+    {
+        std::vector<std::string> a;
+        std::vector<std::string> aaaa;
+        uint32_t ttl = 300;
+        std::string cname;     //!< answer with a CNAME to this name first
+        bool nxdomain  = false;
+        uint32_t soa_ttl = 60; //!< TTL of the SOA record of negative answers
+        int drop = 0;          //!< number of queries to ignore, -1 for all
+    };
+
+    io_loop &loop;
+    int fd = -1;
+    sock_addr addr;
+    bool stop = false;
+    std::map<std::string, record> zone;
+    std::map<std::pair<std::string, uint16_t>, int> queries;
+
+    explicit fake_dns_server(io_loop &l) : loop{l}
+    {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+
+        addr          = sock_addr("127.0.0.1:0", AF_INET, SOCK_DGRAM);
+        socklen_t len = addr.len();
+        REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+        REQUIRE(getsockname(fd, addr.sockaddr(), &len) == 0);
+    }
+
+    ~fake_dns_server() { close(fd); }
+
+    dns_config config(std::chrono::milliseconds timeout = std::chrono::milliseconds(200), int attempts = 2) const
+    {
+        dns_config c;
+        c.servers  = {addr};
+        c.timeout  = timeout;
+        c.attempts = attempts;
+        return c;
+    }
+
+    int count(const std::string &name, uint16_t type) const
+    {
+        auto it = queries.find({name, type});
+        return it == queries.end() ? 0 : it->second;
+    }
+
+    static void put_u16(std::vector<uint8_t> &out, uint16_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    static void put_u32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        put_u16(out, static_cast<uint16_t>(v >> 16));
+        put_u16(out, static_cast<uint16_t>(v));
+    }
+
+    static void put_name(std::vector<uint8_t> &out, const std::string &name)
+    {
+        size_t start = 0;
+        while (start < name.size())
+        {
+            size_t end = name.find('.', start);
+            if (end == std::string::npos) { end = name.size(); }
+            out.push_back(static_cast<uint8_t>(end - start));
+            out.insert(out.end(), name.begin() + start, name.begin() + end);
+            start = end + 1;
+        }
+        out.push_back(0);
+    }
+
+    static void put_rr(std::vector<uint8_t> &out, const std::string *owner, uint16_t type, uint32_t ttl,
+                       const std::vector<uint8_t> &rdata)
+    {
+        if (owner) { put_name(out, *owner); }
+        else { put_u16(out, 0xc00c); } // pointer to the question
+        put_u16(out, type);
+        put_u16(out, 1);
+        put_u32(out, ttl);
+        put_u16(out, static_cast<uint16_t>(rdata.size()));
+        out.insert(out.end(), rdata.begin(), rdata.end());
+    }
+
+    std::vector<uint8_t> answer(const uint8_t *query, size_t len, bool &drop)
+    {
+        drop = false;
+
+        // question name, type and class right after the header
+        std::string name;
+        size_t offset = 12;
+        while (offset < len && query[offset] != 0)
+        {
+            if (!name.empty()) { name.push_back('.'); }
+            name.append(reinterpret_cast<const char *>(query + offset + 1), query[offset]);
+            offset += 1 + query[offset];
+        }
+        size_t question_end = offset + 5;
+        uint16_t type       = static_cast<uint16_t>(query[offset + 1] << 8 | query[offset + 2]);
+
+        ++queries[{name, type}];
+
+        auto it        = zone.find(name);
+        bool nxdomain  = it == zone.end() || it->second.nxdomain;
+        record empty;
+        record &rec    = it == zone.end() ? empty : it->second;
+
+        if (rec.drop != 0)
+        {
+            if (rec.drop > 0) { --rec.drop; }
+            drop = true;
+            return {};
+        }
+
+        std::vector<uint8_t> out(query, query + question_end);
+        out[2] = 0x81;                      // QR, RD
+        out[3] = nxdomain ? 0x83 : 0x80;    // RA, rcode
+        out[6] = out[7] = out[8] = out[9] = out[10] = out[11] = 0;
+
+        uint16_t answers   = 0;
+        uint16_t authority = 0;
+
+        const std::string *owner = nullptr;
+        if (!nxdomain && !rec.cname.empty())
+        {
+            std::vector<uint8_t> target;
+            put_name(target, rec.cname);
+            put_rr(out, nullptr, 5, rec.ttl, target);
+            ++answers;
+            owner = &rec.cname;
+        }
+
+        if (!nxdomain)
+        {
+            for (const auto &a : type == TYPE_A ? rec.a : rec.aaaa)
+            {
+                std::vector<uint8_t> rdata(type == TYPE_A ? 4 : 16);
+                REQUIRE(inet_pton(type == TYPE_A ? AF_INET : AF_INET6, a.c_str(), rdata.data()) == 1);
+                put_rr(out, owner, type, rec.ttl, rdata);
+                ++answers;
+            }
+        }
+
+        if (nxdomain || (answers == 0 || (owner && answers == 1)))
+        {
+            std::vector<uint8_t> soa;
+            put_name(soa, "ns.test");
+            put_name(soa, "admin.test");
+            for (uint32_t v : {1u, 3600u, 600u, 86400u}) { put_u32(soa, v); }
+            put_u32(soa, rec.soa_ttl); // minimum
+            std::string apex = "test";
+            put_rr(out, &apex, 6, 3600, soa);
+            ++authority;
+        }
+
+        out[6]  = static_cast<uint8_t>(answers >> 8);
+        out[7]  = static_cast<uint8_t>(answers);
+        out[8]  = static_cast<uint8_t>(authority >> 8);
+        out[9]  = static_cast<uint8_t>(authority);
+        return out;
+    }
+
+    io_task run()
+    {
+        uint8_t buf[1500];
+
+        while (!stop)
+        {
+            struct sockaddr_storage peer;
+            struct iovec iov{buf, sizeof(buf)};
+            struct msghdr msg{};
+            msg.msg_name    = &peer;
+            msg.msg_namelen = sizeof(peer);
+            msg.msg_iov     = &iov;
+            msg.msg_iovlen  = 1;
+
+            ssize_t received = 0;
+            auto op = io::recvmsg(loop, fd, &msg, received, 0, loop.now() + std::chrono::milliseconds(10));
+            if (co_await op != io_result::done) { continue; }
+
+            bool drop  = false;
+            auto reply = answer(buf, static_cast<size_t>(received), drop);
+            if (!drop)
+            {
+                sendto(fd, reply.data(), reply.size(), 0, reinterpret_cast<struct sockaddr *>(&peer), msg.msg_namelen);
+            }
+        }
+    }
+};
+
+std::vector<std::string> to_strings(const std::vector<sock_addr> &addrs)
+{
+    std::vector<std::string> out;
+    for (const auto &addr : addrs) { out.push_back(addr.to_string()); }
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("dns resolves A and AAAA records", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["www.example.test"] = {.a = {"192.0.2.1", "192.0.2.2"}, .aaaa = {"2001:db8::1"}};
+
+    dns_resolver resolver{loop, server.config()};
+
+    std::vector<sock_addr> both, v4, v6;
+    std::error_code ec;
+
+    auto client = [&]() -> io_task
+    {
+        both = co_await resolver.resolve("WWW.Example.test.", "80", AF_UNSPEC, SOCK_STREAM, &ec);
+        v4   = co_await resolver.resolve("www.example.test", "http", AF_INET);
+        v6   = co_await resolver.resolve("www.example.test", "", AF_INET6);
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE_FALSE(ec);
+    REQUIRE(both.size() == 3);
+    REQUIRE(both[0].family() == AF_INET6);
+    REQUIRE(both[0].port() == 80);
+    REQUIRE(both[1] == sock_addr("192.0.2.1:80", AF_INET));
+    REQUIRE(both[2] == sock_addr("192.0.2.2:80", AF_INET));
+
+    REQUIRE(v4.size() == 2);
+    REQUIRE(v4[0].port() == 80);
+    REQUIRE(v6.size() == 1);
+    REQUIRE(v6[0].family() == AF_INET6);
+
+    // the later lookups came from the cache
+    REQUIRE(server.count("www.example.test", TYPE_A) == 1);
+    REQUIRE(server.count("www.example.test", TYPE_AAAA) == 1);
+    REQUIRE(resolver.queries_sent() == 2);
+}
+
+TEST_CASE("dns caches for the TTL", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["short.test"]   = {.a = {"192.0.2.10"}, .ttl = 1};
+    server.zone["nocache.test"] = {.a = {"192.0.2.11"}, .ttl = 0};
+
+    dns_resolver resolver{loop, server.config()};
+    size_t found = 0;
+
+    auto client = [&]() -> io_task
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            found += (co_await resolver.resolve("short.test", "", AF_INET)).size();
+            found += (co_await resolver.resolve("nocache.test", "", AF_INET)).size();
+        }
+
+        co_await io::sleep(loop, std::chrono::milliseconds(1100));
+        found += (co_await resolver.resolve("short.test", "", AF_INET)).size();
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(found == 5);
+    REQUIRE(server.count("short.test", TYPE_A) == 2);
+    REQUIRE(server.count("nocache.test", TYPE_A) == 2);
+}
+
+TEST_CASE("dns evicts the entry that expires first when the cache is full", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["long.test"]  = {.a = {"192.0.2.20"}, .ttl = 3600};
+    server.zone["short.test"] = {.a = {"192.0.2.21"}, .ttl = 60};
+    server.zone["third.test"] = {.a = {"192.0.2.22"}, .ttl = 600};
+
+    auto config              = server.config();
+    config.max_cache_entries = 2;
+    dns_resolver resolver{loop, config};
+    size_t found = 0;
+
+    auto client = [&]() -> io_task
+    {
+        for (const char *name : {"long.test", "short.test", "third.test", "long.test", "short.test"})
+        {
+            found += (co_await resolver.resolve(name, "", AF_INET)).size();
+        }
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(found == 5);
+    REQUIRE(server.count("long.test", TYPE_A) == 1);
+    REQUIRE(server.count("short.test", TYPE_A) == 2);
+    REQUIRE(resolver.cache_size() == 2);
+}
+
+TEST_CASE("dns caches negative answers", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["v4only.test"] = {.a = {"192.0.2.20"}};
+
+    dns_resolver resolver{loop, server.config()};
+    std::error_code missing[2], no_data[2];
+    size_t unspec = 0;
+
+    auto client = [&]() -> io_task
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            auto r1 = co_await resolver.resolve("missing.test", "", AF_UNSPEC, SOCK_STREAM, &missing[i]);
+            auto r2 = co_await resolver.resolve("v4only.test", "", AF_INET6, SOCK_STREAM, &no_data[i]);
+            REQUIRE(r1.empty());
+            REQUIRE(r2.empty());
+        }
+        unspec = (co_await resolver.resolve("v4only.test")).size();
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        REQUIRE(missing[i] == dns_errc::not_found);
+        REQUIRE(no_data[i] == dns_errc::no_data);
+    }
+    REQUIRE(unspec == 1);
+    REQUIRE(server.count("missing.test", TYPE_A) == 1);
+    REQUIRE(server.count("missing.test", TYPE_AAAA) == 1);
+    REQUIRE(server.count("v4only.test", TYPE_AAAA) == 1);
+    REQUIRE(server.count("v4only.test", TYPE_A) == 1);
+}
+
+TEST_CASE("dns coalesces concurrent lookups", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["busy.test"] = {.a = {"192.0.2.30"}, .aaaa = {"2001:db8::30"}};
+
+    dns_resolver resolver{loop, server.config()};
+
+    constexpr int clients = 20;
+    int resolved = 0;
+    int finished = 0;
+
+    auto client = [&]() -> io_task
+    {
+        auto addrs = co_await resolver.resolve("busy.test", "443");
+        if (addrs.size() == 2) { ++resolved; }
+        if (++finished == clients) { server.stop = true; }
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    for (int i = 0; i < clients; ++i) { REQUIRE(loop.schedule(client(), "client")); }
+    loop.run();
+
+    REQUIRE(resolved == clients);
+    REQUIRE(server.count("busy.test", TYPE_A) == 1);
+    REQUIRE(server.count("busy.test", TYPE_AAAA) == 1);
+    REQUIRE(resolver.queries_sent() == 2);
+}
+
+TEST_CASE("dns retries and times out", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["flaky.test"] = {.a = {"192.0.2.40"}, .drop = 1};
+    server.zone["dead.test"]  = {.a = {"192.0.2.41"}, .drop = -1};
+
+    dns_resolver resolver{loop, server.config(std::chrono::milliseconds(50), 2)};
+    std::vector<sock_addr> flaky, dead;
+    std::error_code flaky_ec, dead_ec;
+
+    auto client = [&]() -> io_task
+    {
+        flaky = co_await resolver.resolve("flaky.test", "", AF_INET, SOCK_STREAM, &flaky_ec);
+        dead  = co_await resolver.resolve("dead.test", "", AF_INET, SOCK_STREAM, &dead_ec);
+        // failures aren't cached
+        (void)co_await resolver.resolve("dead.test", "", AF_INET);
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE_FALSE(flaky_ec);
+    REQUIRE(flaky.size() == 1);
+    REQUIRE(server.count("flaky.test", TYPE_A) == 2);
+
+    REQUIRE(dead.empty());
+    REQUIRE(dead_ec == dns_errc::timeout);
+    REQUIRE(server.count("dead.test", TYPE_A) == 4);
+}
+
+TEST_CASE("dns follows CNAME records", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    server.zone["alias.test"] = {.a = {"192.0.2.50"}, .ttl = 120, .cname = "real.test"};
+
+    dns_resolver resolver{loop, server.config()};
+    std::vector<sock_addr> addrs;
+
+    auto client = [&]() -> io_task
+    {
+        addrs       = co_await resolver.resolve("alias.test", "8080", AF_INET);
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(to_strings(addrs) == std::vector<std::string>{"192.0.2.50:8080"});
+}
+
+TEST_CASE("dns answers numeric hosts and localhost without a query", "[io_dns]")
+{
+    io_loop loop;
+    loop.init();
+
+    fake_dns_server server{loop};
+    dns_resolver resolver{loop, server.config()};
+
+    std::vector<sock_addr> v4, v6, local;
+    std::error_code invalid, service;
+
+    auto client = [&]() -> io_task
+    {
+        v4    = co_await resolver.resolve("10.1.2.3", "53", AF_UNSPEC, SOCK_DGRAM);
+        v6    = co_await resolver.resolve("[::1]", "443");
+        local = co_await resolver.resolve("localhost", "80", AF_INET);
+        (void)co_await resolver.resolve("bad..name", "", AF_UNSPEC, SOCK_STREAM, &invalid);
+        (void)co_await resolver.resolve("localhost", "no-such-service", AF_UNSPEC, SOCK_STREAM, &service);
+        server.stop = true;
+    };
+
+    REQUIRE(loop.schedule(server.run(), "dns_server"));
+    REQUIRE(loop.schedule(client(), "client"));
+    loop.run();
+
+    REQUIRE(to_strings(v4) == std::vector<std::string>{"10.1.2.3:53"});
+    REQUIRE(v4[0].type() == SOCK_DGRAM);
+    REQUIRE(v6.size() == 1);
+    REQUIRE(v6[0].family() == AF_INET6);
+    REQUIRE(v6[0].port() == 443);
+    REQUIRE(to_strings(local) == std::vector<std::string>{"127.0.0.1:80"});
+    REQUIRE(invalid == dns_errc::invalid_name);
+    REQUIRE(service == dns_errc::bad_service);
+    REQUIRE(resolver.queries_sent() == 0);
+}
+
+TEST_CASE("dns reads resolv.conf", "[io_dns]")
+{
+    char name[] = "/tmp/io_dns_resolv_XXXXXX";
+    int fd      = mkstemp(name);
+    REQUIRE(fd != -1);
+
+    std::string content = "# comment\nnameserver 192.0.2.53\nnameserver 2001:db8::53\nnameserver bogus\n"
+                          "search example.test\noptions timeout:3 attempts:4\n";
+    REQUIRE(write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+    close(fd);
+
+    auto config = dns_config::from_resolv_conf(name);
+    unlink(name);
+
+    REQUIRE(config.servers.size() == 2);
+    REQUIRE(config.servers[0] == sock_addr("192.0.2.53:53", AF_INET, SOCK_DGRAM));
+    REQUIRE(config.servers[1].family() == AF_INET6);
+    REQUIRE(config.servers[1].port() == 53);
+    REQUIRE(config.timeout == std::chrono::seconds(3));
+    REQUIRE(config.attempts == 4);
+
+    auto fallback = dns_config::from_resolv_conf("/nonexistent/resolv.conf");
+    REQUIRE(fallback.servers.size() == 1);
+    REQUIRE(fallback.servers[0].to_string() == "127.0.0.1:53");
+}
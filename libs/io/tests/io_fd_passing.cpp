@@ -0,0 +1,312 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/fd_passing.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/// @brief A connected pair of non-blocking Unix sockets of @p type.
+std::pair<int, int> unix_pair(int type = SOCK_STREAM)
+{
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0);
+    return {fds[0], fds[1]};
+}
+
+/// @brief A listening loopback TCP socket and its address.
+int tcp_listener(struct sock_addr &addr, int backlog = 16)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+    REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+    REQUIRE(listen(fd, backlog) == 0);
+    REQUIRE(getsockname(fd, addr.sockaddr(), &addr.len_ref()) == 0);
+    return fd;
+}
+
+int tcp_client(const struct sock_addr &addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+    REQUIRE(::connect(fd, addr.sockaddr(), addr.len()) == 0);
+    return fd;
+}
+
+std::string read_some(int fd)
+{
+    char buf[256];
+    auto n = read(fd, buf, sizeof(buf));
+    return n > 0 ? std::string(buf, static_cast<size_t>(n)) : std::string{};
+}
+
+/**
+ * @brief The worker side, in a child process: takes descriptors off @p channel until it closes and answers on each
+ * connection, accepting from the listening sockets among them. Returns the exit code, Catch2 is the parent's.
+ */
+int worker(int channel)
+{
+    io_loop loop;
+    loop.init();
+    int status = 1;
+
+    auto task = [&]() -> io_task
+    {
+        while (true)
+        {
+            std::vector<int> fds;
+            char buf[64];
+            size_t len  = 0;
+            auto op     = recv_fds(loop, channel, fds, buf, sizeof(buf), len);
+            auto result = co_await op;
+            if (result == io_result::closed) { break; }
+            if (result != io_result::done || fds.size() != 1) { co_return; }
+
+            std::string kind(buf, len);
+            int fd = fds[0];
+            if (kind == "listener")
+            {
+                // everything that queued up while the old process had the socket
+                for (int i = 0; i < 3; ++i)
+                {
+                    int conn = -1;
+                    struct sock_addr peer;
+                    auto accept_result = co_await accept(loop, fd, conn, peer, loop.now() + std::chrono::seconds(5));
+                    if (accept_result != io_result::done) { co_return; }
+                    (void)!write(conn, "taken over", 10);
+                    close(conn);
+                }
+            }
+            else { (void)!write(fd, "worker", 6); }
+            close(fd);
+        }
+        status = 0;
+    };
+
+    (void)loop.schedule(task(), "worker");
+    loop.run();
+    return status;
+}
+
+/// @brief Forks a worker on the far end of a Unix socket pair, returns its pid and the near end.
+std::pair<pid_t, int> spawn_worker()
+{
+    auto [near, far] = unix_pair(SOCK_SEQPACKET);
+    pid_t pid        = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0)
+    {
+        close(near);
+        _exit(worker(far));
+    }
+    close(far);
+    return {pid, near};
+}
+
+int wait_worker(pid_t pid)
+{
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// @brief Sends @p fd with @p kind on @p channel.
+io_task hand_over(io_loop &loop, int channel, int fd, std::string kind, io_result &result)
+{
+    int fds[]   = {fd};
+    size_t sent = 0;
+    result      = co_await send_fds(loop, channel, fds, kind, sent);
+}
+
+} // namespace
+
+TEST_CASE("send_fds passes descriptors with the payload", "[io_fd_passing]")
+{
+    io_loop loop;
+    loop.init();
+    auto [a, b] = unix_pair();
+
+    int pipe_fds[2];
+    REQUIRE(pipe2(pipe_fds, O_CLOEXEC) == 0);
+
+    std::vector<int> received;
+    std::string payload;
+    io_result sent_result = io_result::waiting, recv_result = io_result::waiting;
+
+    auto sender = [&]() -> io_task
+    {
+        size_t sent = 0;
+        sent_result = co_await send_fds(loop, a, pipe_fds, "pipe", sent);
+    };
+    auto receiver = [&]() -> io_task
+    {
+        char buf[16];
+        size_t len  = 0;
+        recv_result = co_await recv_fds(loop, b, received, buf, sizeof(buf), len);
+        payload.assign(buf, len);
+    };
+
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    REQUIRE(sent_result == io_result::done);
+    REQUIRE(recv_result == io_result::done);
+    REQUIRE(payload == "pipe");
+    REQUIRE(received.size() == 2);
+    REQUIRE((fcntl(received[0], F_GETFD) & FD_CLOEXEC) != 0);
+
+    // the received write end feeds the original read end
+    REQUIRE(write(received[1], "through", 7) == 7);
+    REQUIRE(read_some(pipe_fds[0]) == "through");
+
+    for (int fd : received) { close(fd); }
+    for (int fd : {a, b, pipe_fds[0], pipe_fds[1]}) { close(fd); }
+}
+
+TEST_CASE("recv_fds closes descriptors that don't fit and fails", "[io_fd_passing]")
+{
+    io_loop loop;
+    loop.init();
+    auto [a, b] = unix_pair(SOCK_SEQPACKET);
+
+    int fds[] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    std::vector<int> received;
+    io_result recv_result = io_result::waiting;
+    std::error_code error;
+
+    auto sender = [&]() -> io_task
+    {
+        size_t sent = 0;
+        (void)co_await send_fds(loop, a, fds, {}, sent);
+    };
+    auto receiver = [&]() -> io_task
+    {
+        char buf[16];
+        size_t len  = 0;
+        auto op     = recv_fds(loop, b, received, buf, sizeof(buf), len, 1);
+        recv_result = co_await op;
+        error       = op.error();
+    };
+
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    REQUIRE(recv_result == io_result::error);
+    REQUIRE(error == std::errc::message_size);
+    REQUIRE(received.empty());
+    close(a);
+    close(b);
+}
+
+TEST_CASE("send_fds to a Unix datagram address", "[io_fd_passing]")
+{
+    io_loop loop;
+    loop.init();
+
+    struct sock_addr addr{"@io-fd-passing-" + std::to_string(getpid()), AF_UNIX, SOCK_DGRAM};
+    int server = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    REQUIRE(bind(server, addr.sockaddr(), addr.len()) == 0);
+    int client = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    int passed[] = {server};
+    std::vector<int> received;
+    io_result sent_result = io_result::waiting, recv_result = io_result::waiting;
+    size_t len = 0;
+
+    auto sender = [&]() -> io_task
+    {
+        size_t sent = 0;
+        sent_result = co_await send_fds(loop, client, addr, passed, {}, sent);
+    };
+    auto receiver = [&]() -> io_task
+    {
+        char buf[16];
+        recv_result = co_await recv_fds(loop, server, received, buf, sizeof(buf), len);
+    };
+
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    REQUIRE(sent_result == io_result::done);
+    REQUIRE(recv_result == io_result::done);
+    REQUIRE(len == 1);
+    REQUIRE(received.size() == 1);
+    REQUIRE(received[0] != server);
+
+    for (int fd : received) { close(fd); }
+    close(client);
+    close(server);
+}
+
+TEST_CASE("a front process hands accepted connections to a worker process", "[io_fd_passing]")
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int listener      = tcp_listener(addr);
+    auto [pid, front] = spawn_worker();
+
+    io_loop loop;
+    loop.init();
+
+    int client = tcp_client(addr);
+    int conn   = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    REQUIRE(conn != -1);
+
+    io_result handed = io_result::waiting;
+    REQUIRE(loop.schedule(hand_over(loop, front, conn, "connection", handed), "front"));
+    loop.run();
+    REQUIRE(handed == io_result::done);
+    // the front is out of it, the worker's copy is the connection now
+    close(conn);
+
+    REQUIRE(read_some(client) == "worker");
+
+    close(front);
+    REQUIRE(wait_worker(pid) == 0);
+    close(client);
+    close(listener);
+}
+
+TEST_CASE("a new process takes over a listening socket with its accept queue", "[io_fd_passing]")
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int listener      = tcp_listener(addr);
+    auto [pid, front] = spawn_worker();
+
+    io_loop loop;
+    loop.init();
+
+    // connections that arrive before the handover wait in the accept queue
+    std::vector<int> clients;
+    for (int i = 0; i < 3; ++i) { clients.push_back(tcp_client(addr)); }
+
+    io_result handed = io_result::waiting;
+    REQUIRE(loop.schedule(hand_over(loop, front, listener, "listener", handed), "old"));
+    loop.run();
+    REQUIRE(handed == io_result::done);
+    close(listener);
+
+    for (int client : clients)
+    {
+        REQUIRE(read_some(client) == "taken over");
+        close(client);
+    }
+
+    close(front);
+    REQUIRE(wait_worker(pid) == 0);
+}
@@ -0,0 +1,206 @@
+#include <io/io.hpp>
+#include <io/file.hpp>
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace io;
+using namespace io::detail;
+
+namespace
+{
+
+struct temp_file
+{
+    std::string path;
+
+    temp_file()
+    {
+        char name[] = "/tmp/io_file_test_XXXXXX";
+        int fd = mkstemp(name);
+        REQUIRE(fd != -1);
+        ::close(fd);
+        path = name;
+    }
+
+    ~temp_file() { unlink(path.c_str()); }
+};
+
+} // namespace
+
+TEST_CASE("file write and read back", "[io_file]")
+{
+    auto backend = GENERATE(file_backend_type::thread_pool, file_backend_type::automatic);
+
+    io_loop loop;
+    loop.init();
+    temp_file tmp;
+
+    file f{loop, backend};
+    REQUIRE_FALSE(f.open(tmp.path, O_RDWR));
+    INFO("backend: " << to_string(f.backend()));
+
+    const std::string data = "hello from the file backend";
+    std::string read_back(data.size(), '\0');
+    bool done = false;
+
+    auto task = [&]() -> io_task {
+        size_t written = 0;
+        auto w = f.write_at(data.data(), data.size(), 0, written);
+        REQUIRE(co_await w == io_result::done);
+        REQUIRE(written == data.size());
+
+        auto sync = f.fsync();
+        REQUIRE(co_await sync == io_result::done);
+
+        size_t read = 0;
+        auto r = f.read_at(read_back.data(), read_back.size(), 0, read);
+        REQUIRE(co_await r == io_result::done);
+        REQUIRE(read == data.size());
+
+        // short read at the end of the file, nothing past it
+        char tail[64];
+        auto short_read = f.read_at(tail, sizeof(tail), 6, read);
+        REQUIRE(co_await short_read == io_result::done);
+        REQUIRE(read == data.size() - 6);
+
+        auto past_end = f.read_at(tail, sizeof(tail), 1000, read);
+        REQUIRE(co_await past_end == io_result::done);
+        REQUIRE(read == 0);
+
+        done = true;
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(task(), "file_task"));
+    loop.run();
+
+    REQUIRE(done);
+    REQUIRE(read_back == data);
+    REQUIRE(f.in_flight() == 0);
+    REQUIRE(loop.waiter_count() == 0);
+}
+
+TEST_CASE("file reads into io_buf", "[io_file]")
+{
+    auto backend = GENERATE(file_backend_type::thread_pool, file_backend_type::automatic);
+
+    io_loop loop;
+    loop.init();
+    temp_file tmp;
+
+    file f{loop, backend};
+    REQUIRE_FALSE(f.open(tmp.path, O_RDWR));
+    REQUIRE_FALSE(f.advise(0, 0, POSIX_FADV_SEQUENTIAL));
+
+    io_buf out{16};
+    out.write("0123456789abcdef");
+
+    io_buf in{32};
+    size_t written = 0;
+    size_t read = 0;
+
+    auto task = [&]() -> io_task {
+        auto w = f.write_at(out, 0, written);
+        REQUIRE(co_await w == io_result::done);
+
+        auto r = f.read_at(in, 0, read);
+        REQUIRE(co_await r == io_result::done);
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(task(), "file_task"));
+    loop.run();
+
+    REQUIRE(written == 16);
+    REQUIRE(out.readable() == 0);
+    REQUIRE(read == 16);
+    REQUIRE(in.readable() == 16);
+    REQUIRE(std::string(in.read_ptr(), in.readable()) == "0123456789abcdef");
+}
+
+TEST_CASE("file concurrent reads", "[io_file]")
+{
+    auto backend = GENERATE(file_backend_type::thread_pool, file_backend_type::automatic);
+
+    io_loop loop;
+    loop.init();
+    temp_file tmp;
+
+    constexpr size_t blocks = 64;
+    constexpr size_t block_size = 4096;
+
+    std::vector<char> content(blocks * block_size);
+    for (size_t i = 0; i < content.size(); ++i) { content[i] = static_cast<char>(i / block_size); }
+    {
+        int fd = ::open(tmp.path.c_str(), O_WRONLY);
+        REQUIRE(::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+        ::close(fd);
+    }
+
+    file f{loop, backend};
+    REQUIRE_FALSE(f.open(tmp.path, O_RDONLY));
+
+    std::vector<std::vector<char>> results(blocks, std::vector<char>(block_size));
+    size_t completed = 0;
+    size_t max_in_flight = 0;
+
+    auto reader = [&](size_t block) -> io_task {
+        size_t read = 0;
+        auto r = f.read_at(results[block].data(), block_size, block * block_size, read);
+        max_in_flight = std::max(max_in_flight, f.in_flight());
+        if (co_await r == io_result::done && read == block_size) { ++completed; }
+        co_return;
+    };
+
+    for (size_t i = 0; i < blocks; ++i) { REQUIRE(loop.schedule(reader(i), "reader")); }
+    loop.run();
+
+    REQUIRE(completed == blocks);
+    REQUIRE(max_in_flight > 1);
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        REQUIRE(results[i] == std::vector<char>(block_size, static_cast<char>(i)));
+    }
+}
+
+TEST_CASE("file errors", "[io_file]")
+{
+    io_loop loop;
+    loop.init();
+    temp_file tmp;
+
+    file f{loop};
+    file closed{loop};
+    REQUIRE(f.open("/nonexistent/dir/file", O_RDONLY));
+    REQUIRE_FALSE(f.open(tmp.path, O_RDONLY));
+
+    std::error_code write_error;
+    std::error_code closed_error;
+
+    auto task = [&]() -> io_task {
+        size_t written = 0;
+        auto w = f.write_at("x", 1, 0, written);
+        REQUIRE(co_await w == io_result::error);
+        write_error = w.error();
+
+        size_t read = 0;
+        char buf[8];
+        auto r = closed.read_at(buf, sizeof(buf), 0, read);
+        REQUIRE(co_await r == io_result::error);
+        closed_error = r.error();
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(task(), "file_task"));
+    loop.run();
+
+    REQUIRE(write_error == std::error_code(EBADF, std::system_category()));
+    REQUIRE(closed_error == std::error_code(EBADF, std::system_category()));
+}
@@ -0,0 +1,278 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/cpu_affinity.hpp>
+#include <io/io.hpp>
+#include <net/listener.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/// @brief Opens @p count blocking connections to @p addr, which land in the accept queue before anyone accepts.
+std::vector<int> connect_clients(const struct sock_addr &addr, size_t count)
+{
+    std::vector<int> fds;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+        REQUIRE(::connect(fd, addr.sockaddr(), addr.len()) == 0);
+        fds.push_back(fd);
+    }
+    return fds;
+}
+
+void close_all(const std::vector<int> &fds)
+{
+    for (int fd : fds) { close(fd); }
+}
+
+/**
+ * @brief Runs a loop per listener socket, each serving connections until @p total of them were handled.
+ */
+void serve_on_threads(listener_set &listeners, size_t total, std::atomic<size_t> &handled,
+                      std::vector<size_t> &per_loop)
+{
+    std::vector<std::thread> threads;
+    per_loop.assign(listeners.loops(), 0);
+
+    for (size_t i = 0; i < listeners.loops(); ++i)
+    {
+        threads.emplace_back(
+            [&, i]()
+            {
+                io_loop loop;
+                loop.init();
+
+                auto handler = [&, i](int fd, struct sock_addr) -> io_task
+                {
+                    char byte     = 0;
+                    ssize_t bytes = 0;
+                    if (co_await recv(loop, fd, &byte, 1, bytes) == io_result::done && bytes == 1) { ++per_loop[i]; }
+                    close(fd);
+                    ++handled;
+                };
+
+                // another thread's loop may be the one that handles the last connection
+                auto watcher = [&]() -> io_task
+                {
+                    while (handled < total) { co_await io::sleep(loop, std::chrono::milliseconds(1)); }
+                    loop.shutdown(loop.now() + std::chrono::seconds(1));
+                };
+
+                // assertions aren't thread safe, the counts tell what happened
+                (void)loop.schedule(serve(loop, listeners.fd(i), handler, listeners.exclusive()), "acceptor");
+                (void)loop.schedule(watcher(), "watcher");
+                loop.run();
+            });
+    }
+
+    std::vector<int> clients = connect_clients(listeners.address(), total);
+    for (int fd : clients) { REQUIRE(::send(fd, "x", 1, 0) == 1); }
+
+    for (auto &thread : threads) { thread.join(); }
+    close_all(clients);
+}
+
+} // namespace
+
+TEST_CASE("accept_batch takes the whole accept queue in one call", "[io_listener]")
+{
+    io_loop loop;
+    loop.init();
+
+    listener_set listeners;
+    REQUIRE_FALSE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 1));
+    std::vector<int> clients = connect_clients(listeners.address(), 20);
+
+    std::vector<accepted_connection> first, second;
+    io_result first_result = io_result::waiting;
+    auto acceptor          = [&]() -> io_task
+    {
+        first_result = co_await accept_batch(loop, listeners.fd(0), first);
+        // nothing left, the second one only finishes at the deadline
+        auto deadline = loop.now() + std::chrono::milliseconds(20);
+        (void)co_await accept_batch(loop, listeners.fd(0), second, DEFAULT_ACCEPT_BATCH, false, deadline);
+    };
+
+    REQUIRE(loop.schedule(acceptor(), "acceptor"));
+    loop.run();
+
+    REQUIRE(first_result == io_result::done);
+    REQUIRE(first.size() == 20);
+    REQUIRE(second.empty());
+    for (const auto &connection : first)
+    {
+        REQUIRE(connection.fd != -1);
+        REQUIRE(connection.peer.family() == AF_INET);
+        close(connection.fd);
+    }
+    close_all(clients);
+}
+
+TEST_CASE("accept_batch stops at the batch size", "[io_listener]")
+{
+    io_loop loop;
+    loop.init();
+
+    listener_set listeners;
+    REQUIRE_FALSE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 1));
+    std::vector<int> clients = connect_clients(listeners.address(), 10);
+
+    std::vector<size_t> sizes;
+    auto acceptor = [&]() -> io_task
+    {
+        std::vector<accepted_connection> connections;
+        for (size_t total = 0; total < 10; total += connections.size())
+        {
+            if (co_await accept_batch(loop, listeners.fd(0), connections, 4) != io_result::done) { co_return; }
+            sizes.push_back(connections.size());
+            for (const auto &connection : connections) { close(connection.fd); }
+        }
+    };
+
+    REQUIRE(loop.schedule(acceptor(), "acceptor"));
+    loop.run();
+
+    REQUIRE(sizes == std::vector<size_t>{4, 4, 2});
+    close_all(clients);
+}
+
+TEST_CASE("serve hands connections to tasks on every loop of a SO_REUSEPORT set", "[io_listener]")
+{
+    listener_set listeners;
+    REQUIRE_FALSE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 2));
+    REQUIRE(listeners.fd(0) != listeners.fd(1));
+    REQUIRE_FALSE(listeners.exclusive());
+
+    std::atomic<size_t> handled{0};
+    std::vector<size_t> per_loop;
+    serve_on_threads(listeners, 200, handled, per_loop);
+
+    REQUIRE(handled == 200);
+    REQUIRE(per_loop[0] + per_loop[1] == 200);
+    // the kernel hashes the client ports over both sockets
+    REQUIRE(per_loop[0] > 0);
+    REQUIRE(per_loop[1] > 0);
+}
+
+TEST_CASE("serve shares one listening socket between loops with EPOLLEXCLUSIVE", "[io_listener]")
+{
+    listener_set listeners;
+    REQUIRE_FALSE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 2, {listen_mode::exclusive}));
+    REQUIRE(listeners.fd(0) == listeners.fd(1));
+    REQUIRE(listeners.exclusive());
+
+    std::atomic<size_t> handled{0};
+    std::vector<size_t> per_loop;
+    serve_on_threads(listeners, 200, handled, per_loop);
+
+    REQUIRE(handled == 200);
+    REQUIRE(per_loop[0] + per_loop[1] == 200);
+}
+
+TEST_CASE("listener_set reports a port in use", "[io_listener]")
+{
+    listener_set first;
+    REQUIRE_FALSE(first.open(sock_addr("127.0.0.1:0", AF_INET), 1, {listen_mode::exclusive}));
+
+    // without SO_REUSEPORT on the first socket nobody else gets the port
+    listener_set second;
+    auto error = second.open(first.address(), 1);
+    REQUIRE(error == std::errc::address_in_use);
+    REQUIRE(second.fd(0) == -1);
+}
+
+TEST_CASE("pinned threads report their CPU", "[io_listener]")
+{
+    auto cpus = allowed_cpus();
+    REQUIRE_FALSE(cpus.empty());
+
+    int cpu = -1;
+    std::thread thread(
+        [&]()
+        {
+            if (!pin_thread(cpus.back())) { cpu = current_cpu(); }
+        });
+    thread.join();
+
+    REQUIRE(cpu == cpus.back());
+    REQUIRE(pin_thread(-1) == std::errc::invalid_argument);
+}
+
+TEST_CASE("socket_config sets SO_INCOMING_CPU and SO_REUSEPORT", "[io_listener]")
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+
+    socket_config config;
+    config.incoming_cpu = 0;
+    config.reuse_port   = true;
+    config.apply(fd);
+
+    int value     = 0;
+    socklen_t len = sizeof(value);
+    REQUIRE(getsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value, &len) == 0);
+    REQUIRE(value == 1);
+    REQUIRE(incoming_cpu(fd) == 0);
+    close(fd);
+}
+
+TEST_CASE("steering by CPU sends connections to the socket of the CPU's loop", "[io_listener]")
+{
+    listen_options options;
+    options.steer_by_cpu = true;
+
+    listener_set listeners;
+    REQUIRE_FALSE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 2, options));
+
+    // on loopback the SYN is processed on the CPU of the connecting thread
+    int cpu = allowed_cpus().front();
+    std::vector<int> clients;
+    std::thread client(
+        [&]()
+        {
+            if (!pin_thread(cpu)) { clients = connect_clients(listeners.address(), 20); }
+        });
+    client.join();
+    REQUIRE(clients.size() == 20);
+
+    size_t steered = listeners.loop_for_cpu(cpu);
+    std::vector<size_t> accepted(2, 0);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        int fd = -1;
+        while ((fd = accept4(listeners.fd(i), nullptr, nullptr, SOCK_CLOEXEC)) != -1)
+        {
+            ++accepted[i];
+            REQUIRE(incoming_cpu(fd) == cpu);
+            close(fd);
+        }
+    }
+
+    REQUIRE(accepted[steered] == 20);
+    REQUIRE(accepted[1 - steered] == 0);
+    close_all(clients);
+}
+
+TEST_CASE("steering by CPU needs a socket per loop", "[io_listener]")
+{
+    listen_options options;
+    options.mode         = listen_mode::exclusive;
+    options.steer_by_cpu = true;
+
+    listener_set listeners;
+    REQUIRE(listeners.open(sock_addr("127.0.0.1:0", AF_INET), 2, options) == std::errc::invalid_argument);
+}
@@ -282,3 +282,255 @@ TEST_CASE("Waiter reuse with complex operations", "[io_loop]") {
     
     REQUIRE(completion_count == 4);
 }
+
+TEST_CASE("Shutdown drains in-flight tasks", "[io_loop]") {
+    io_loop loop;
+    loop.init();
+
+    io_result notice = io_result::waiting;
+    bool flushed = false;
+    bool rejected = false;
+
+    auto worker = [&]() -> io_task {
+        auto idle = sleep(loop, std::chrono::seconds(10));
+        notice = co_await idle;
+
+        // operations started after the notice still run
+        auto flush = sleep(loop, std::chrono::milliseconds(20));
+        flushed = (co_await flush == io_result::timeout);
+        co_return;
+    };
+
+    auto controller = [&]() -> io_task {
+        auto delay = sleep(loop, std::chrono::milliseconds(20));
+        co_await delay;
+
+        loop.shutdown(loop.now() + std::chrono::seconds(1));
+        rejected = !loop.schedule(worker(), "late");
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(worker(), "worker"));
+    REQUIRE(loop.schedule(controller(), "controller"));
+
+    auto start = time_now();
+    loop.run();
+
+    REQUIRE(notice == io_result::shutdown);
+    REQUIRE(flushed);
+    REQUIRE(rejected);
+    REQUIRE(loop.state() == io_loop_state::shutdown);
+    REQUIRE(time_now() - start < std::chrono::milliseconds(500));
+
+    // a shut down loop can't be restarted
+    REQUIRE_FALSE(loop.schedule(worker(), "after"));
+    loop.run();
+    REQUIRE(loop.state() == io_loop_state::shutdown);
+}
+
+TEST_CASE("Shutdown cancels tasks at the deadline", "[io_loop]") {
+    io_loop loop;
+    loop.init();
+
+    int notices = 0;
+    bool cancelled = false;
+
+    auto worker = [&]() -> io_task {
+        while (true)
+        {
+            auto idle = sleep(loop, std::chrono::seconds(10));
+            auto result = co_await idle;
+            if (result == io_result::shutdown) { ++notices; }
+            if (result == io_result::cancelled) { break; }
+        }
+        cancelled = true;
+        co_return;
+    };
+
+    auto controller = [&]() -> io_task {
+        co_await yield(loop);
+        loop.shutdown(loop.now() + std::chrono::milliseconds(50));
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(worker(), "worker"));
+    REQUIRE(loop.schedule(controller(), "controller"));
+
+    auto start = time_now();
+    loop.run();
+    auto elapsed = time_now() - start;
+
+    REQUIRE(notices == 1);
+    REQUIRE(cancelled);
+    REQUIRE(elapsed >= std::chrono::milliseconds(40));
+    REQUIRE(elapsed < std::chrono::milliseconds(500));
+    REQUIRE(loop.state() == io_loop_state::shutdown);
+}
+
+TEST_CASE("Shutdown destroys tasks that ignore the cancellation", "[io_loop]") {
+    io_loop loop;
+    loop.init();
+
+    struct guard {
+        bool &destroyed;
+        ~guard() { destroyed = true; }
+    };
+
+    bool destroyed = false;
+    int wakeups = 0;
+
+    auto stubborn = [&]() -> io_task {
+        guard g{destroyed};
+        while (true)
+        {
+            auto idle = sleep(loop, std::chrono::seconds(10));
+            co_await idle;
+            ++wakeups;
+        }
+    };
+
+    auto controller = [&]() -> io_task {
+        co_await yield(loop);
+        loop.shutdown(loop.now() + std::chrono::milliseconds(20));
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(stubborn(), "stubborn"));
+    REQUIRE(loop.schedule(controller(), "controller"));
+    loop.run();
+
+    REQUIRE(wakeups == 2);
+    REQUIRE(destroyed);
+    REQUIRE(loop.state() == io_loop_state::shutdown);
+}
+
+TEST_CASE("A reader and a writer wait on one descriptor", "[io_loop]") {
+    io_loop_basic<epoll_poller> loop;
+    loop.init();
+
+    int sockets[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) == 0);
+
+    io_result read_result = io_result::waiting;
+    io_result write_result = io_result::waiting;
+
+    auto reader = [&]() -> io_task {
+        auto readable = io_desc_promise{loop, sockets[0], io_desc_type::read, time_now() + std::chrono::seconds(1)};
+        read_result = co_await readable;
+        co_return;
+    };
+
+    auto writer = [&]() -> io_task {
+        auto writable = io_desc_promise{loop, sockets[0], io_desc_type::write, time_now() + std::chrono::seconds(1)};
+        write_result = co_await writable;
+        REQUIRE(write(sockets[1], "x", 1) == 1);
+        co_return;
+    };
+
+    loop.schedule(reader(), "reader");
+    loop.schedule(writer(), "writer");
+    loop.run();
+
+    REQUIRE(write_result == io_result::done);
+    REQUIRE(read_result == io_result::done);
+
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST_CASE("A reused descriptor number gets registered again", "[io_loop]") {
+    io_loop_basic<epoll_poller> loop;
+    loop.init();
+
+    int first[2], second[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, first) == 0);
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, second) == 0);
+    const int fd = first[0];
+
+    io_result reused_result = io_result::waiting;
+
+    // still waiting when its descriptor gets closed under it
+    auto stale = [&]() -> io_task {
+        auto readable = io_desc_promise{loop, fd, io_desc_type::read, time_now() + std::chrono::milliseconds(500)};
+        co_await readable;
+        co_return;
+    };
+
+    auto reuser = [&]() -> io_task {
+        co_await yield(loop);
+
+        // closes the first socket and puts the second one under its number
+        REQUIRE(dup2(second[0], fd) == fd);
+        REQUIRE(write(second[1], "x", 1) == 1);
+
+        auto readable = io_desc_promise{loop, fd, io_desc_type::read, time_now() + std::chrono::milliseconds(200)};
+        reused_result = co_await readable;
+        co_return;
+    };
+
+    loop.schedule(stale(), "stale");
+    loop.schedule(reuser(), "reuser");
+    loop.run();
+
+    REQUIRE(reused_result == io_result::done);
+
+    for (int s : {fd, first[1], second[0], second[1]}) { close(s); }
+}
+
+TEST_CASE("Loop services live as long as their loop", "[io_loop]") {
+    struct counter {
+        explicit counter(int &alive) : alive_(alive) { ++alive_; }
+        ~counter() { --alive_; }
+        int &alive_;
+    };
+
+    int alive = 0;
+    {
+        io_loop loop;
+        auto &first = loop.service<counter>(alive);
+        REQUIRE(&loop.service<counter>(alive) == &first);
+        REQUIRE(alive == 1);
+    }
+    REQUIRE(alive == 0);
+
+    // a loop built where the last one was gets services of its own
+    alignas(io_loop) unsigned char storage[sizeof(io_loop)];
+    auto *loop = new (storage) io_loop;
+    loop->service<counter>(alive);
+    loop->~io_loop();
+    loop = new (storage) io_loop;
+    REQUIRE(alive == 0);
+    loop->service<counter>(alive);
+    REQUIRE(alive == 1);
+    loop->~io_loop();
+    REQUIRE(alive == 0);
+}
+
+TEST_CASE("Wait for any and all results still go into a std::vector", "[io_loop]") {
+    io_loop loop;
+    loop.init();
+
+    io_promise p1{loop, time_point_t::max()};
+    io_promise p2{loop, time_point_t::max()};
+    std::vector<io_promise*> any_ready, all_ready;
+
+    auto task = [&]() -> io_task {
+        std::vector<io_promise*> promises{&p1, &p2};
+        auto complete = [&]() -> io_task {
+            p1.waiter_.complete(io_result::done);
+            co_return;
+        };
+        REQUIRE(loop.schedule(complete(), "complete_first"));
+        any_ready = co_await io_wait_for_any_promise{loop, time_now() + std::chrono::seconds(1), promises};
+
+        p2.waiter_.complete(io_result::done);
+        std::vector<io_promise*> all = co_await io_wait_for_all_promise{loop, time_now() + std::chrono::seconds(1), promises};
+        all_ready = all;
+    };
+
+    REQUIRE(loop.schedule(task(), "waiter"));
+    loop.run();
+
+    REQUIRE(any_ready == std::vector<io_promise*>{&p1});
+    REQUIRE(all_ready == std::vector<io_promise*>{&p1, &p2});
+}
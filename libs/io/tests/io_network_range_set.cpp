@@ -0,0 +1,195 @@
+#include <common/catch.hpp>
+
+#include <net/network_range_set.hpp>
+#include <net/sockaddr.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+std::string tag_of(const network_range_set<std::string> &set, const std::string &addr)
+{
+    const auto *tag = set.find(sock_addr(addr));
+    return tag ? *tag : "";
+}
+
+/// @brief The answer of a linear scan over all ranges, what the table has to match.
+const network_range *linear_match(const std::vector<network_range> &ranges, const sock_addr &addr)
+{
+    const network_range *best = nullptr;
+    for (const auto &range : ranges)
+    {
+        if (range.contains(addr) && (!best || range.prefix() > best->prefix())) { best = &range; }
+    }
+    return best;
+}
+
+} // namespace
+
+TEST_CASE("network_range_set finds the most specific range", "[network_range_set]")
+{
+    network_range_set<std::string> set;
+    REQUIRE(set.insert(network_range("10.0.0.0/8"), "ten"));
+    REQUIRE(set.insert(network_range("10.1.0.0/16"), "lab"));
+    REQUIRE(set.insert(network_range("10.1.2.0/24"), "rack"));
+    REQUIRE(set.insert(network_range("10.1.2.3/32"), "host"));
+    REQUIRE(set.insert(network_range("10.1.2.128/25"), "upper"));
+    REQUIRE(set.insert(network_range("[2001:db8::]/32"), "doc"));
+    REQUIRE(set.insert(network_range("[2001:db8:1::]/48"), "site"));
+    REQUIRE(set.insert(network_range("[2001:db8:1:2::1]/128"), "v6host"));
+    REQUIRE(set.size() == 8);
+
+    REQUIRE(tag_of(set, "10.200.0.1") == "ten");
+    REQUIRE(tag_of(set, "10.1.200.1") == "lab");
+    REQUIRE(tag_of(set, "10.1.2.4") == "rack");
+    REQUIRE(tag_of(set, "10.1.2.3") == "host");
+    REQUIRE(tag_of(set, "10.1.2.200") == "upper");
+    REQUIRE(tag_of(set, "11.0.0.1").empty());
+
+    REQUIRE(tag_of(set, "[2001:db8:ffff::1]") == "doc");
+    REQUIRE(tag_of(set, "[2001:db8:1:5::1]") == "site");
+    REQUIRE(tag_of(set, "[2001:db8:1:2::1]") == "v6host");
+    REQUIRE(tag_of(set, "[2001:db8:1:2::2]") == "site");
+    REQUIRE(tag_of(set, "[2001:db9::1]").empty());
+
+    // no mixing of families
+    REQUIRE_FALSE(set.contains(sock_addr("[::ffff:10.1.2.3]")));
+    REQUIRE_FALSE(set.contains(sock_addr("/tmp/socket", AF_UNIX)));
+
+    const auto *e = set.match(sock_addr("10.1.2.77"));
+    REQUIRE(e);
+    REQUIRE(e->range.prefix() == 24);
+    REQUIRE(e->range.network().to_string() == "10.1.2.0");
+}
+
+TEST_CASE("network_range_set insert order and duplicates", "[network_range_set]")
+{
+    // shorter ranges added after longer ones don't hide them
+    network_range_set<int> set;
+    REQUIRE(set.insert(network_range("192.168.1.0/24"), 24));
+    REQUIRE(set.insert(network_range("192.168.1.1/32"), 32));
+    REQUIRE(set.insert(network_range("192.168.0.0/16"), 16));
+    REQUIRE(set.insert(network_range("0.0.0.0/0"), 0));
+    REQUIRE(set.insert(network_range("[::]/0"), 100));
+
+    REQUIRE(*set.find(sock_addr("192.168.1.1")) == 32);
+    REQUIRE(*set.find(sock_addr("192.168.1.2")) == 24);
+    REQUIRE(*set.find(sock_addr("192.168.2.1")) == 16);
+    REQUIRE(*set.find(sock_addr("8.8.8.8")) == 0);
+    REQUIRE(*set.find(sock_addr("[2001:db8::1]")) == 100);
+
+    // the same range again replaces the value, host bits don't matter
+    REQUIRE(set.insert(network_range("192.168.1.77/24"), 240));
+    REQUIRE(set.size() == 5);
+    REQUIRE(*set.find(sock_addr("192.168.1.2")) == 240);
+    REQUIRE(*set.find(sock_addr("192.168.1.1")) == 32);
+
+    REQUIRE_FALSE(set.insert(network_range(), 1));
+
+    set.clear();
+    REQUIRE(set.empty());
+    REQUIRE_FALSE(set.contains(sock_addr("192.168.1.1")));
+}
+
+TEST_CASE("network_range_set bulk build", "[network_range_set]")
+{
+    std::vector<network_range> ranges = {network_range("172.16.0.0/12"), network_range("172.16.5.0/24"),
+                                         network_range("[fd00::]/8"), network_range("bogus")};
+
+    network_range_set<> set(ranges);
+    REQUIRE(set.size() == 3);
+    REQUIRE(set.contains(sock_addr("172.20.1.1")));
+    REQUIRE(set.match(sock_addr("172.16.5.5"))->range.prefix() == 24);
+    REQUIRE(set.contains(sock_addr("[fd12::1]")));
+    REQUIRE_FALSE(set.contains(sock_addr("172.32.0.1")));
+}
+
+TEST_CASE("network_range_set allocates a family's table on its first range", "[network_range_set]")
+{
+    network_range_set<> set;
+    REQUIRE(set.table_memory() == 0);
+    REQUIRE_FALSE(set.contains(sock_addr("10.0.0.1")));
+    REQUIRE_FALSE(set.contains(sock_addr("[2001:db8::1]")));
+
+    // a 16 bit root for IPv4 only, the IPv6 one stays unallocated
+    REQUIRE(set.insert(network_range("10.0.0.0/8"), true));
+    REQUIRE(set.table_memory() == 65536 * sizeof(uint32_t));
+    REQUIRE(set.contains(sock_addr("10.0.0.1")));
+    REQUIRE_FALSE(set.contains(sock_addr("[2001:db8::1]")));
+
+    REQUIRE(set.insert(network_range("[2001:db8::]/16"), true));
+    REQUIRE(set.table_memory() == 2 * 65536 * sizeof(uint32_t));
+    REQUIRE(set.contains(sock_addr("[2001:db8::1]")));
+}
+
+TEST_CASE("network_range_set agrees with a linear scan", "[network_range_set]")
+{
+    std::mt19937 rng(1234);
+    std::vector<network_range> ranges;
+    std::vector<network_range_set<int>::entry> entries;
+
+    // clustered ranges of all lengths so that they nest
+    for (int i = 0; i < 2000; ++i)
+    {
+        bool v6 = i % 2;
+        if (!v6)
+        {
+            struct sockaddr_in sin = {};
+            sin.sin_family         = AF_INET;
+            sin.sin_addr.s_addr    = htonl(0x0a000000u | (rng() & 0x0003ffffu));
+            ranges.emplace_back(sock_addr(sin, static_cast<uint8_t>(8 + rng() % 25)));
+        }
+        else
+        {
+            struct sockaddr_in6 sin6 = {};
+            sin6.sin6_family         = AF_INET6;
+            sin6.sin6_addr.s6_addr[0] = 0x20;
+            sin6.sin6_addr.s6_addr[1] = 0x01;
+            for (int b = 2; b < 16; ++b) { sin6.sin6_addr.s6_addr[b] = b < 8 ? rng() % 4 : rng(); }
+            ranges.emplace_back(sock_addr(sin6, static_cast<uint8_t>(16 + rng() % 113)));
+        }
+        entries.push_back({ranges.back(), i});
+    }
+
+    network_range_set<int> bulk(entries);
+    network_range_set<int> incremental;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) { incremental.insert(it->range, it->value); }
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        sock_addr addr;
+        if (i % 2 == 0)
+        {
+            struct sockaddr_in sin = {};
+            sin.sin_family         = AF_INET;
+            sin.sin_addr.s_addr    = htonl(0x0a000000u | (rng() & 0x0003ffffu));
+            addr                   = sock_addr(sin);
+        }
+        else
+        {
+            struct sockaddr_in6 sin6 = {};
+            sin6.sin6_family         = AF_INET6;
+            sin6.sin6_addr.s6_addr[0] = 0x20;
+            sin6.sin6_addr.s6_addr[1] = 0x01;
+            for (int b = 2; b < 16; ++b) { sin6.sin6_addr.s6_addr[b] = b < 8 ? rng() % 4 : rng(); }
+            addr = sock_addr(sin6);
+        }
+
+        const auto *expected = linear_match(ranges, addr);
+        for (const auto *set : {&bulk, &incremental})
+        {
+            const auto *e = set->match(addr);
+            REQUIRE((e == nullptr) == (expected == nullptr));
+            if (e)
+            {
+                REQUIRE(e->range.prefix() == expected->prefix());
+                REQUIRE(e->range.network() == expected->network());
+            }
+        }
+    }
+}
@@ -0,0 +1,300 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/output_queue.hpp>
+
+#include "test_sockets.hpp"
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+using namespace io;
+using namespace io::test;
+
+namespace
+{
+
+std::string piece(size_t i, size_t size)
+{
+    return std::string(size, static_cast<char>('a' + i % 26));
+}
+
+} // namespace
+
+TEST_CASE("output_queue sends the writes of one turn in one sendmsg", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue out{loop, pair.fds[0]};
+    std::string expected, received;
+    for (size_t i = 0; i < 100; ++i) { expected += piece(i, 10); }
+
+    io_result flushed = io_result::waiting;
+    auto writer       = [&]() -> io_task
+    {
+        for (size_t i = 0; i < 100; ++i)
+        {
+            auto result = co_await out.write(piece(i, 10));
+            REQUIRE(result == io_result::done);
+        }
+        REQUIRE(out.stats().sends == 0);
+        REQUIRE(out.queued() == expected.size());
+        flushed = co_await out.flush();
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size()), "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(flushed == io_result::done);
+    REQUIRE(received == expected);
+    REQUIRE(out.queued() == 0);
+    REQUIRE(out.stats().writes == 100);
+    REQUIRE(out.stats().sends == 1);
+    REQUIRE(out.stats().bytes_sent == expected.size());
+}
+
+TEST_CASE("output_queue flushes when the writing task suspends", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue out{loop, pair.fds[0]};
+    std::string received;
+    size_t sends_after_first = 0;
+
+    auto writer = [&]() -> io_task
+    {
+        REQUIRE(out.try_write("hello "));
+        REQUIRE(out.try_write("world"));
+        // the flush timer runs once this task waits for anything
+        co_await io::sleep(loop, std::chrono::milliseconds(5));
+        sends_after_first = out.stats().sends;
+        REQUIRE(out.queued() == 0);
+
+        auto result = co_await out.write("!");
+        REQUIRE(result == io_result::done);
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, 12), "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(received == "hello world!");
+    REQUIRE(sends_after_first == 1);
+    REQUIRE(out.stats().sends == 2);
+}
+
+TEST_CASE("output_queue holds writes for the flush delay", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue_options options;
+    options.flush_delay = std::chrono::milliseconds(50);
+    output_queue out{loop, pair.fds[0], options};
+    std::string received;
+    size_t queued_meanwhile = 0;
+
+    auto writer = [&]() -> io_task
+    {
+        REQUIRE(out.try_write("one "));
+        co_await io::sleep(loop, std::chrono::milliseconds(5));
+        REQUIRE(out.try_write("two"));
+        queued_meanwhile = out.queued();
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, 7), "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(queued_meanwhile == 7);
+    REQUIRE(received == "one two");
+    REQUIRE(out.stats().sends == 1);
+}
+
+TEST_CASE("output_queue sends full chunks right away", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue_options options;
+    options.flush_size = 1024;
+    output_queue out{loop, pair.fds[0], options};
+
+    std::string expected, received;
+    size_t queued_at_end = 0;
+    auto writer          = [&]() -> io_task
+    {
+        for (size_t i = 0; i < 10; ++i)
+        {
+            expected += piece(i, 500);
+            auto result = co_await out.write(piece(i, 500));
+            REQUIRE(result == io_result::done);
+        }
+        // the full chunks went with MSG_MORE, the one being filled waits for the flush
+        queued_at_end = out.queued();
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, 5000), "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(queued_at_end < 1024);
+    REQUIRE(received == expected);
+    REQUIRE(out.stats().sends > 1);
+}
+
+TEST_CASE("output_queue makes writers wait for a slow peer", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    int small = 16 * 1024;
+    REQUIRE(setsockopt(pair.fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small)) == 0);
+    REQUIRE(setsockopt(pair.fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small)) == 0);
+
+    output_queue_options options;
+    options.high_watermark = 64 * 1024;
+    options.low_watermark  = 16 * 1024;
+    output_queue out{loop, pair.fds[0], options};
+
+    std::string expected, received;
+    for (size_t i = 0; i < 1024; ++i) { expected += piece(i, 1024); }
+
+    io_result flushed = io_result::waiting;
+    auto writer       = [&]() -> io_task
+    {
+        for (size_t i = 0; i < 1024; ++i)
+        {
+            auto result = co_await out.write(std::string_view{expected}.substr(i * 1024, 1024));
+            if (result != io_result::done) { co_return; }
+            REQUIRE(out.queued() <= options.high_watermark + 1024);
+        }
+        flushed = co_await out.flush();
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size(), std::chrono::milliseconds(1)),
+                          "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(flushed == io_result::done);
+    REQUIRE(received == expected);
+    REQUIRE(out.stats().blocked > 0);
+    REQUIRE(out.stats().max_queued <= options.high_watermark + 1024);
+    REQUIRE(out.stats().max_queued >= options.high_watermark);
+}
+
+TEST_CASE("output_queue corks the socket while a batch gathers", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue_options options;
+    options.cork = true;
+    output_queue out{loop, pair.fds[0], options};
+
+    std::string received;
+    int corked = -1, after = -1;
+    auto writer = [&]() -> io_task
+    {
+        REQUIRE(out.try_write("corked"));
+        socklen_t len = sizeof(corked);
+        REQUIRE(getsockopt(pair.fds[0], IPPROTO_TCP, TCP_CORK, &corked, &len) == 0);
+
+        auto result = co_await out.flush();
+        REQUIRE(result == io_result::done);
+        len = sizeof(after);
+        REQUIRE(getsockopt(pair.fds[0], IPPROTO_TCP, TCP_CORK, &after, &len) == 0);
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, 6), "receiver"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(corked == 1);
+    REQUIRE(after == 0);
+    REQUIRE(received == "corked");
+}
+
+TEST_CASE("output_queue reports a send error to every write after it", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    // the peer resets the connection
+    struct linger reset = {1, 0};
+    REQUIRE(setsockopt(pair.fds[1], SOL_SOCKET, SO_LINGER, &reset, sizeof(reset)) == 0);
+    pair.close_end(1);
+
+    output_queue out{loop, pair.fds[0]};
+    io_result flushed = io_result::waiting, written = io_result::waiting;
+    auto writer       = [&]() -> io_task
+    {
+        REQUIRE(out.try_write("lost"));
+        flushed = co_await out.flush();
+        written = co_await out.write("also lost");
+    };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(flushed == io_result::error);
+    REQUIRE(written == io_result::error);
+    REQUIRE(out.error());
+    REQUIRE(out.queued() == 0);
+    REQUIRE_FALSE(out.try_write("nope"));
+}
+
+TEST_CASE("output_queue keeps no descriptor of its own", "[io_output_queue]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    output_queue out{loop, pair.fds[0]};
+    std::string received;
+    io_result eof = io_result::waiting;
+
+    auto writer = [&]() -> io_task
+    {
+        auto result = co_await out.write("bye");
+        REQUIRE(result == io_result::done);
+        result = co_await out.flush();
+        REQUIRE(result == io_result::done);
+
+        // the queue is still around, closing the caller's descriptor ends the connection
+        pair.close_end(0);
+    };
+
+    auto reader = [&]() -> io_task
+    {
+        co_await receive_all(loop, pair.fds[1], received, 3);
+        char buf[16];
+        ssize_t n = 0;
+        auto op   = recv(loop, pair.fds[1], buf, sizeof(buf), n, 0, loop.now() + std::chrono::seconds(5));
+        eof       = co_await op;
+    };
+
+    REQUIRE(loop.schedule(reader(), "reader"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(received == "bye");
+    REQUIRE(eof == io_result::closed);
+}
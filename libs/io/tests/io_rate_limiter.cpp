@@ -0,0 +1,218 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/rate_limiter.hpp>
+
+#include "test_sockets.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace io;
+using namespace io::test;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+std::chrono::milliseconds since(io_loop &loop, time_point_t start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(loop.now() - start);
+}
+
+} // namespace
+
+TEST_CASE("rate_limiter hands out the burst and then waits for the refill", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    rate_limit_timer timer{loop};
+    rate_limiter limiter{timer, 1000, 100};
+
+    auto burst = 1000ms, refill = 0ms;
+    auto task  = [&]() -> io_task
+    {
+        auto start  = loop.now();
+        auto result = co_await limiter.acquire(100);
+        REQUIRE(result == io_result::done);
+        burst = since(loop, start);
+
+        start  = loop.now();
+        result = co_await limiter.acquire(50);
+        REQUIRE(result == io_result::done);
+        refill = since(loop, start);
+    };
+
+    REQUIRE(loop.schedule(task(), "task"));
+    loop.run();
+
+    REQUIRE(burst < 5ms);
+    // 50 tokens at 1000 a second
+    REQUIRE(refill >= 45ms);
+    REQUIRE(refill < 500ms);
+    REQUIRE(limiter.stats().acquires == 2);
+    REQUIRE(limiter.stats().waits == 1);
+    REQUIRE(limiter.stats().tokens == 150);
+    REQUIRE_FALSE(timer.armed());
+    REQUIRE(timer.waiting() == 0);
+}
+
+TEST_CASE("rate_limiter serves the acquires in line in order", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    rate_limit_timer timer{loop};
+    rate_limiter limiter{timer, 2000, 10};
+    REQUIRE(limiter.try_acquire(10));
+
+    std::vector<int> order;
+    size_t waiting_limiters = 0;
+    auto acquirer           = [&](int id, size_t tokens) -> io_task
+    {
+        auto result = co_await limiter.acquire(tokens);
+        REQUIRE(result == io_result::done);
+        order.push_back(id);
+        waiting_limiters = std::max(waiting_limiters, timer.waiting());
+    };
+
+    // the small ones behind the big one don't overtake it
+    REQUIRE(loop.schedule(acquirer(1, 10), "first"));
+    REQUIRE(loop.schedule(acquirer(2, 1), "second"));
+    REQUIRE(loop.schedule(acquirer(3, 1), "third"));
+    loop.run();
+
+    REQUIRE(order == std::vector<int>{1, 2, 3});
+    REQUIRE(limiter.waiting() == 0);
+    REQUIRE(waiting_limiters <= 1);
+}
+
+TEST_CASE("rate_limiters share one timer", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    rate_limit_timer timer{loop};
+    rate_limiter fast{timer, 1000, 10};
+    rate_limiter slow{timer, 100, 10};
+    REQUIRE(fast.try_acquire(10));
+    REQUIRE(slow.try_acquire(10));
+
+    auto fast_time = 0ms, slow_time = 0ms;
+    size_t waiting = 0;
+    auto acquirer  = [&](rate_limiter &limiter, std::chrono::milliseconds &elapsed) -> io_task
+    {
+        auto start  = loop.now();
+        auto result = co_await limiter.acquire(5);
+        REQUIRE(result == io_result::done);
+        elapsed = since(loop, start);
+    };
+    auto watcher = [&]() -> io_task
+    {
+        co_await io::sleep(loop, 1ms);
+        waiting = timer.waiting();
+    };
+
+    REQUIRE(loop.schedule(acquirer(fast, fast_time), "fast"));
+    REQUIRE(loop.schedule(acquirer(slow, slow_time), "slow"));
+    REQUIRE(loop.schedule(watcher(), "watcher"));
+    loop.run();
+
+    REQUIRE(waiting == 2);
+    REQUIRE(fast_time >= 4ms);
+    REQUIRE(fast_time < 40ms);
+    REQUIRE(slow_time >= 45ms);
+    REQUIRE(slow_time < 500ms);
+    REQUIRE(timer.waiting() == 0);
+}
+
+TEST_CASE("rate_limiter lets an acquire bigger than the burst through in debt", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    rate_limit_timer timer{loop};
+    rate_limiter limiter{timer, 1000, 10};
+
+    io_result result = io_result::waiting;
+    auto task        = [&]() -> io_task { result = co_await limiter.acquire(30); };
+
+    REQUIRE(loop.schedule(task(), "task"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(limiter.available() < -19);
+    REQUIRE_FALSE(limiter.try_acquire(1));
+}
+
+TEST_CASE("rate_limiter acquire gives up at its deadline", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    rate_limit_timer timer{loop};
+    rate_limiter stopped{timer, 0, 10};
+    REQUIRE(stopped.try_acquire(10));
+
+    io_result result = io_result::waiting;
+    auto task        = [&]() -> io_task { result = co_await stopped.acquire(1, loop.now() + 20ms); };
+
+    REQUIRE(loop.schedule(task(), "task"));
+    loop.run();
+
+    REQUIRE(result == io_result::timeout);
+    REQUIRE(stopped.stats().timeouts == 1);
+    REQUIRE(stopped.waiting() == 0);
+
+    // given back tokens count again
+    stopped.release(5);
+    REQUIRE(stopped.try_acquire(5));
+}
+
+TEST_CASE("send paces the bytes through every limiter", "[io_rate_limiter]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+    rate_limit_timer timer{loop};
+    rate_limiter destination{timer, 4 * 1024 * 1024, 64 * 1024};
+    rate_limiter tenant{timer, 1024 * 1024, 64 * 1024};
+
+    std::string data(256 * 1024, 'r'), received;
+    size_t sent  = 0;
+    auto elapsed = 0ms;
+    auto sender  = [&]() -> io_task
+    {
+        rate_limiter *limiters[] = {&destination, &tenant};
+        auto start               = loop.now();
+        auto result = co_await send(std::span<rate_limiter *const>{limiters}, pair.fds[0], data.data(), data.size(),
+                                    sent);
+        REQUIRE(result == io_result::done);
+        elapsed = since(loop, start);
+    };
+    auto receiver = [&]() -> io_task
+    {
+        std::vector<char> buf(64 * 1024);
+        while (received.size() < data.size())
+        {
+            ssize_t n   = 0;
+            auto result = co_await recv(loop, pair.fds[1], buf.data(), buf.size(), n, 0, loop.now() + 2s);
+            if (result != io_result::done || n <= 0) { co_return; }
+            received.append(buf.data(), static_cast<size_t>(n));
+        }
+    };
+
+    REQUIRE(loop.schedule(receiver(), "receiver"));
+    REQUIRE(loop.schedule(sender(), "sender"));
+    loop.run();
+
+    REQUIRE(sent == data.size());
+    REQUIRE(received == data);
+    // the tenant's burst goes right away, the other 192 KB at 1 MB/s
+    REQUIRE(elapsed >= 170ms);
+    REQUIRE(elapsed < 1000ms);
+    REQUIRE(tenant.stats().tokens == data.size());
+    REQUIRE(destination.stats().tokens == data.size());
+}
@@ -0,0 +1,154 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+
+#include "test_sockets.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace io;
+using namespace io::test;
+
+TEST_CASE("sendv gathers iovecs across partial writes and IOV_MAX", "[io_sendv]")
+{
+    io_loop loop;
+    loop.init();
+    // small buffers so that sendmsg() comes back with partial writes
+    socket_pair pair{8 * 1024};
+
+    // more pieces than one sendmsg() takes, of sizes from empty to larger than the socket buffer
+    std::mt19937 rng(11);
+    std::vector<std::string> pieces(3 * detail::io_sendv::MAX_IOV + 17);
+    std::string expected;
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        size_t len = i % 97 == 0 ? 20000 : rng() % 200;
+        pieces[i].resize(len);
+        for (auto &c : pieces[i]) { c = static_cast<char>('a' + rng() % 26); }
+        expected += pieces[i];
+    }
+
+    std::vector<struct iovec> iov;
+    for (auto &p : pieces) { iov.push_back({p.data(), p.size()}); }
+
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+    std::string received;
+
+    auto writer = [&]() -> io_task { result = co_await sendv(loop, pair.fds[0], iov, sent); };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size()), "reader"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(sent == expected.size());
+    REQUIRE(received == expected);
+}
+
+TEST_CASE("sendv advances io_buf read pointers", "[io_sendv]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{8 * 1024};
+
+    std::vector<io_buf> bufs;
+    bufs.reserve(3);
+    bufs.emplace_back(64);
+    bufs.emplace_back(100000);
+    bufs.emplace_back(16);
+
+    std::string header = "HTTP/1.1 200 OK\r\n\r\n";
+    std::string body(100000, 'b');
+    std::string trailer = "0\r\n\r\n";
+    bufs[0].write(header);
+    bufs[1].write(body);
+    bufs[2].write(trailer);
+
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+    std::string received;
+    std::string expected = header + body + trailer;
+
+    auto writer = [&]() -> io_task { result = co_await sendv(loop, pair.fds[0], std::span<io_buf>(bufs), sent); };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size()), "reader"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(sent == expected.size());
+    REQUIRE(received == expected);
+    for (const auto &b : bufs) { REQUIRE(b.readable() == 0); }
+}
+
+TEST_CASE("sendv reports errors", "[io_sendv]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{8 * 1024};
+    pair.close_end(1);
+
+    std::string data = "lost";
+    struct iovec iov = {data.data(), data.size()};
+    size_t sent      = 0;
+    io_result result = io_result::waiting;
+
+    auto writer = [&]() -> io_task
+    {
+        result = co_await sendv(loop, pair.fds[0], std::span<const struct iovec>(&iov, 1), sent, MSG_NOSIGNAL);
+    };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(result == io_result::error);
+    REQUIRE(sent == 0);
+}
+
+TEST_CASE("sendv under io_wait_for_any_promise completes the parent once everything was sent", "[io_sendv]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{8 * 1024};
+
+    std::string data(200000, 'w');
+    std::vector<struct iovec> iov{{data.data(), data.size()}};
+
+    size_t sent           = 0;
+    size_t sent_at_wakeup = 0;
+    bool op_ready         = false;
+    io_result result      = io_result::waiting;
+    std::string received;
+
+    auto writer = [&]() -> io_task
+    {
+        auto op = sendv(loop, pair.fds[0], iov, sent);
+        detail::io_promise timer{loop, loop.now() + std::chrono::seconds(2)};
+
+        // the operation waits for writability many times, the parent only hears of it when it finished
+        std::vector<detail::io_promise *> promises{&op, &timer};
+        auto ready     = co_await detail::io_wait_for_any_promise{loop, loop.now() + std::chrono::seconds(5), promises};
+        op_ready       = ready.size() == 1 && ready[0] == &op;
+        sent_at_wakeup = sent;
+        result         = co_await op;
+    };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, data.size(), std::chrono::milliseconds(1)),
+                          "reader"));
+    loop.run();
+
+    REQUIRE(op_ready);
+    REQUIRE(sent_at_wakeup == data.size());
+    REQUIRE(result == io_result::done);
+    REQUIRE(received == data);
+}
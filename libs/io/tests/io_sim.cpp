@@ -0,0 +1,250 @@
+#include <io/io.hpp>
+#include <common/log.hpp>
+#include <common/catch.hpp>
+#include <chrono>
+#include <vector>
+
+// built with IO_LOOP_POLLER=sim_poller, io_loop runs on the simulated poller and its virtual clock
+
+using namespace io;
+using namespace io::detail;
+
+static_assert(std::is_same_v<io_loop, io_loop_basic<sim_poller>>);
+
+TEST_CASE("sim_poller long sleeps take no wall-clock time", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    auto start = loop.now();
+    io_result result = io_result::waiting;
+
+    auto sleeper = [&]() -> io_task {
+        auto nap = sleep(loop, std::chrono::hours(1));
+        result = co_await nap;
+        co_return;
+    };
+
+    auto wall_start = std::chrono::steady_clock::now();
+    REQUIRE(loop.schedule(sleeper(), "sleeper"));
+    loop.run();
+
+    REQUIRE(result == io_result::timeout);
+    REQUIRE(loop.now() - start >= std::chrono::hours(1));
+    REQUIRE(loop.now() - start < std::chrono::hours(1) + std::chrono::milliseconds(1));
+    REQUIRE(std::chrono::steady_clock::now() - wall_start < std::chrono::seconds(1));
+}
+
+TEST_CASE("sim_poller timers fire in deadline order", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    auto start = loop.now();
+    std::vector<int> order;
+    std::vector<time_point_t> fired;
+
+    auto timer = [&](int id, std::chrono::milliseconds delay) -> io_task {
+        auto nap = sleep(loop, delay);
+        co_await nap;
+        order.push_back(id);
+        fired.push_back(loop.now());
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(timer(3, std::chrono::milliseconds(300)), "t3"));
+    REQUIRE(loop.schedule(timer(1, std::chrono::milliseconds(100)), "t1"));
+    REQUIRE(loop.schedule(timer(2, std::chrono::milliseconds(200)), "t2"));
+    loop.run();
+
+    REQUIRE(order == std::vector<int>{1, 2, 3});
+    for (size_t i = 0; i < fired.size(); ++i)
+    {
+        auto expected = start + std::chrono::milliseconds(100 * (i + 1));
+        REQUIRE(fired[i] - expected < std::chrono::milliseconds(1));
+    }
+}
+
+TEST_CASE("sim_poller wait_for_any and wait_for_all in virtual time", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    auto start = loop.now();
+    auto p1 = io_promise{loop, start + std::chrono::milliseconds(100)};
+    auto p2 = io_promise{loop, start + std::chrono::milliseconds(200)};
+    auto p3 = io_promise{loop, start + std::chrono::milliseconds(300)};
+
+    auto waiter = [&]() -> io_task {
+        io_wait_for_any_promise any{loop, start + std::chrono::milliseconds(150), {&p1, &p2, &p3}};
+        auto ready = co_await any;
+        REQUIRE(ready.size() == 1);
+        REQUIRE(ready[0] == &p1);
+        REQUIRE(loop.now() - start < std::chrono::milliseconds(101));
+
+        io_wait_for_all_promise all{loop, start + std::chrono::milliseconds(350), {&p2, &p3}};
+        ready = co_await all;
+        REQUIRE(ready.size() == 2);
+        REQUIRE(loop.now() - start >= std::chrono::milliseconds(299));
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(waiter(), "waiter"));
+    loop.run();
+}
+
+TEST_CASE("sim_poller multiple timeout promises with partial completion", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    auto start = loop.now();
+    auto p1 = io_promise{loop, start + std::chrono::milliseconds(100)};
+    auto p2 = io_promise{loop, start + std::chrono::milliseconds(200)};
+    auto p3 = io_promise{loop, start + std::chrono::milliseconds(300)};
+
+    auto waiter = [&]() -> io_task {
+        io_wait_for_any_promise any{loop, start + std::chrono::milliseconds(150), {&p1, &p2, &p3}};
+        auto ready = co_await any;
+
+        // only p1 times out within 150ms
+        REQUIRE(ready.size() == 1);
+        REQUIRE(ready[0] == &p1);
+        auto res = co_await p1;
+        REQUIRE(res == io_result::timeout);
+        REQUIRE(p2.waiter_.result() == io_result::waiting);
+        REQUIRE(p3.waiter_.result() == io_result::waiting);
+
+        // the others keep their own deadlines
+        res = co_await p2;
+        REQUIRE(res == io_result::timeout);
+        REQUIRE(loop.now() - start >= std::chrono::milliseconds(199));
+        REQUIRE(loop.now() - start < std::chrono::milliseconds(201));
+        res = co_await p3;
+        REQUIRE(res == io_result::timeout);
+        REQUIRE(loop.now() - start >= std::chrono::milliseconds(299));
+        REQUIRE(loop.now() - start < std::chrono::milliseconds(301));
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(waiter(), "waiter"));
+    loop.run();
+}
+
+TEST_CASE("sim_poller multiple timeout promises with full completion", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    auto start = loop.now();
+    auto p1 = io_promise{loop, start + std::chrono::milliseconds(100)};
+    auto p2 = io_promise{loop, start + std::chrono::milliseconds(200)};
+    auto p3 = io_promise{loop, start + std::chrono::milliseconds(300)};
+
+    auto waiter = [&]() -> io_task {
+        io_wait_for_all_promise all{loop, start + std::chrono::milliseconds(350), {&p1, &p2, &p3}};
+        auto ready = co_await all;
+
+        // all three time out within 350ms, done once the last one did
+        REQUIRE(ready.size() == 3);
+        REQUIRE(loop.now() - start >= std::chrono::milliseconds(299));
+        REQUIRE(loop.now() - start < std::chrono::milliseconds(301));
+
+        auto res = co_await p1;
+        REQUIRE(res == io_result::timeout);
+        res = co_await p2;
+        REQUIRE(res == io_result::timeout);
+        res = co_await p3;
+        REQUIRE(res == io_result::timeout);
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(waiter(), "waiter"));
+    loop.run();
+}
+
+TEST_CASE("sim_poller delivers scripted readiness", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    constexpr int fd = 1000;
+    auto start = loop.now();
+    loop.poller().ready_at(start + std::chrono::milliseconds(50), fd, io_desc_type::read);
+    loop.poller().ready_at(start + std::chrono::milliseconds(80), fd, io_desc_type::write);
+
+    io_result read_result = io_result::waiting;
+    io_result write_result = io_result::waiting;
+    time_point_t read_at{};
+    time_point_t write_at{};
+
+    auto reader = [&]() -> io_task {
+        io_desc_promise readable{loop, fd, io_desc_type::read, start + std::chrono::seconds(1)};
+        read_result = co_await readable;
+        read_at = loop.now();
+        co_return;
+    };
+
+    auto writer = [&]() -> io_task {
+        io_desc_promise writable{loop, fd, io_desc_type::write, start + std::chrono::seconds(1)};
+        write_result = co_await writable;
+        write_at = loop.now();
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(reader(), "reader"));
+    REQUIRE(loop.schedule(writer(), "writer"));
+    loop.run();
+
+    REQUIRE(read_result == io_result::done);
+    REQUIRE(write_result == io_result::done);
+    REQUIRE(read_at - start == std::chrono::milliseconds(50));
+    REQUIRE(write_at - start == std::chrono::milliseconds(80));
+    REQUIRE(loop.poller().pending_events() == 0);
+}
+
+TEST_CASE("sim_poller keeps readiness until a waiter shows up", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    constexpr int fd = 1001;
+    auto start = loop.now();
+    loop.poller().ready_at(start + std::chrono::milliseconds(10), fd, io_desc_type::read);
+
+    io_result result = io_result::waiting;
+
+    auto late_reader = [&]() -> io_task {
+        auto nap = sleep(loop, std::chrono::milliseconds(100));
+        co_await nap;
+        REQUIRE(loop.poller().pending_events() == 1);
+
+        io_desc_promise readable{loop, fd, io_desc_type::read, loop.now() + std::chrono::seconds(1)};
+        result = co_await readable;
+        REQUIRE(loop.now() - start < std::chrono::milliseconds(101));
+        co_return;
+    };
+
+    REQUIRE(loop.schedule(late_reader(), "late_reader"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(loop.poller().pending_events() == 0);
+}
+
+TEST_CASE("sim_poller stops a loop that can never make progress", "[io_sim]") {
+    io_loop loop;
+    loop.init();
+
+    constexpr int fd = 1002;
+    bool finished = false;
+
+    // no deadline and nothing scripted for the descriptor
+    auto reader = [&]() -> io_task {
+        io_desc_promise readable{loop, fd, io_desc_type::read, time_point_t::max()};
+        co_await readable;
+        finished = true;
+        co_return;
+    };
+
+    auto wall_start = std::chrono::steady_clock::now();
+    REQUIRE(loop.schedule(reader(), "reader"));
+    loop.run();
+
+    REQUIRE(loop.state() == io_loop_state::stalled);
+    REQUIRE_FALSE(finished);
+    REQUIRE(std::chrono::steady_clock::now() - wall_start < std::chrono::seconds(1));
+}
@@ -1,7 +1,8 @@
-#include <io/iotask.hpp>
+#include <io/io.hpp>
 #include <common/catch.hpp>
 #include <net/sockaddr.hpp>
 #include <sys/un.h>
+#include <unordered_set>
 
 using namespace io;
 
@@ -439,6 +440,30 @@ TEST_CASE("sock_addr hash function", "[sock_addr]") {
         REQUIRE(std::hash<sock_addr>{}(addr1) != std::hash<sock_addr>{}(addr2));
     }
 
+    SECTION("nearby addresses and ports spread") {
+        std::unordered_set<size_t> v4_hashes, v6_hashes, low_bits;
+        for (uint32_t i = 0; i < 65536; ++i) {
+            struct sockaddr_in sin = {};
+            sin.sin_family = AF_INET;
+            sin.sin_addr.s_addr = htonl(0x0a000000 | (i >> 4));
+            sin.sin_port = htons(static_cast<uint16_t>(1000 + (i & 15)));
+            v4_hashes.insert(std::hash<sock_addr>{}(sock_addr(sin)));
+
+            struct sockaddr_in6 sin6 = {};
+            sin6.sin6_family = AF_INET6;
+            sin6.sin6_addr.s6_addr[0] = 0x20;
+            sin6.sin6_addr.s6_addr[14] = static_cast<uint8_t>(i >> 8);
+            sin6.sin6_addr.s6_addr[15] = static_cast<uint8_t>(i);
+            auto h = std::hash<sock_addr>{}(sock_addr(sin6));
+            v6_hashes.insert(h);
+            low_bits.insert(h & 0xffff);
+        }
+        REQUIRE(v4_hashes.size() == 65536);
+        REQUIRE(v6_hashes.size() == 65536);
+        // a random function fills about 63% of the 2^16 buckets
+        REQUIRE(low_bits.size() > 40000);
+    }
+
     SECTION("verify unordered_map usage") {
         std::unordered_map<sock_addr, std::string> addr_map;
         
@@ -694,3 +719,67 @@ TEST_CASE("sock_addr with loopback addresses", "[sock_addr]") {
     }
 }
 
+
+TEST_CASE("numeric address forms", "[sock_addr]") {
+    SECTION("ipv4 shorthand like inet_aton") {
+        REQUIRE(sock_addr("127.1", AF_INET).to_string() == "127.0.0.1");
+        REQUIRE(sock_addr("10.1.515", AF_INET).to_string() == "10.1.2.3");
+        REQUIRE(sock_addr("0x7f.0.0.1:80", AF_INET).to_string() == "127.0.0.1:80");
+        REQUIRE(sock_addr("010.0.0.1", AF_INET).to_string() == "8.0.0.1");
+        REQUIRE(sock_addr("3232235777", AF_INET).to_string() == "192.168.1.1");
+        REQUIRE(sock_addr("08.0.0.1", AF_INET).len() == 0);
+        REQUIRE(sock_addr("1.2.3.4.5", AF_INET).len() == 0);
+        REQUIRE(sock_addr("1.2.65536", AF_INET).len() == 0);
+        REQUIRE(sock_addr("1..2", AF_INET).len() == 0);
+    }
+
+    SECTION("ipv6 forms") {
+        REQUIRE(sock_addr("[1:2:3:4:5:6:7:8]:1", AF_INET6).to_string() == "[1:2:3:4:5:6:7:8]:1");
+        REQUIRE(sock_addr("[::ffff:1.2.3.4]", AF_INET6).to_string() == "[::ffff:1.2.3.4]");
+        REQUIRE(sock_addr("[1:2:3:4:5:6:7::8]", AF_INET6).len() == 0);
+        REQUIRE(sock_addr("[::01.2.3.4]", AF_INET6).len() == 0);
+        REQUIRE(sock_addr("[12345::]", AF_INET6).len() == 0);
+        REQUIRE(sock_addr("[:1::]", AF_INET6).len() == 0);
+    }
+
+    SECTION("family selection") {
+        REQUIRE(sock_addr("1.2.3.4", AF_UNSPEC).family() == AF_INET);
+        REQUIRE(sock_addr("[::1]", AF_UNSPEC).family() == AF_INET6);
+        REQUIRE(sock_addr("1.2.3.4", AF_INET6).len() == 0);
+        REQUIRE(sock_addr("[::1]", AF_INET).len() == 0);
+
+        // IPv4-mapped addresses come back as IPv4 when asked for AF_INET
+        sock_addr mapped("[::ffff:10.0.0.1]:53", AF_INET);
+        REQUIRE(mapped.family() == AF_INET);
+        REQUIRE(mapped.to_string() == "10.0.0.1:53");
+    }
+
+    SECTION("scope id") {
+        sock_addr numeric("[fe80::1%7]:80", AF_INET6);
+        REQUIRE(numeric.len() == sizeof(struct sockaddr_in6));
+        REQUIRE(reinterpret_cast<const sockaddr_in6 *>(numeric.sockaddr())->sin6_scope_id == 7);
+
+        sock_addr named("[fe80::1%lo]", AF_INET6);
+        REQUIRE(reinterpret_cast<const sockaddr_in6 *>(named.sockaddr())->sin6_scope_id == if_nametoindex("lo"));
+
+        REQUIRE(sock_addr("[fe80::1%]", AF_INET6).len() == 0);
+        REQUIRE(sock_addr("[2001:db8::1%lo]", AF_INET6).len() == 0);
+    }
+
+    SECTION("socket type and protocol") {
+        sock_addr any_type("1.2.3.4:53", AF_INET, 0, 0);
+        REQUIRE(any_type.type() == SOCK_STREAM);
+        REQUIRE(any_type.protocol() == IPPROTO_TCP);
+
+        sock_addr udp("1.2.3.4:53", AF_INET, 0, IPPROTO_UDP);
+        REQUIRE(udp.type() == SOCK_DGRAM);
+        REQUIRE(udp.protocol() == IPPROTO_UDP);
+
+        sock_addr raw("1.2.3.4", AF_INET, SOCK_RAW, IPPROTO_ICMP);
+        REQUIRE(raw.type() == SOCK_RAW);
+        REQUIRE(raw.protocol() == IPPROTO_ICMP);
+
+        REQUIRE(sock_addr("1.2.3.4:53", AF_INET, SOCK_STREAM, IPPROTO_UDP).len() == 0);
+        REQUIRE(sock_addr("1.2.3.4:53", AF_INET, SOCK_RAW, 0).len() == 0);
+    }
+}
@@ -0,0 +1,182 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/socket_filter.hpp>
+#include <net/sockaddr.hpp>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace
+{
+
+/// @brief A UDP socket bound to @p addr (port 0 for any) with @p config applied before bind().
+int udp_socket(struct sock_addr &addr, const socket_config &config = {})
+{
+    int fd = socket(addr.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+    config.apply(fd);
+    REQUIRE(bind(fd, addr.sockaddr(), addr.len()) == 0);
+    REQUIRE(getsockname(fd, addr.sockaddr(), &addr.len_ref()) == 0);
+    return fd;
+}
+
+void send_from(const char *source, uint16_t family, const struct sock_addr &to, const std::string &payload)
+{
+    struct sock_addr from{source, family};
+    int fd = udp_socket(from);
+    REQUIRE(sendto(fd, payload.data(), payload.size(), 0, to.sockaddr(), to.len()) ==
+            static_cast<ssize_t>(payload.size()));
+    close(fd);
+}
+
+/// @brief Everything queued on @p fd, one string per datagram.
+std::vector<std::string> drain(int fd)
+{
+    std::vector<std::string> received;
+    char buf[2048];
+    while (true)
+    {
+        auto n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0) { break; }
+        received.emplace_back(buf, static_cast<size_t>(n));
+    }
+    return received;
+}
+
+bool ipv6_loopback()
+{
+    int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sock_addr addr{"[::1]:0", AF_INET6};
+    bool ok = fd != -1 && bind(fd, addr.sockaddr(), addr.len()) == 0;
+    if (fd != -1) { close(fd); }
+    return ok;
+}
+
+} // namespace
+
+TEST_CASE("socket filter drops datagrams from outside the source ranges", "[io_socket_filter]")
+{
+    std::vector<network_range> allowed = {network_range{"127.0.0.2/32"}, network_range{"127.1.0.0/16"}};
+
+    socket_config config;
+    config.filter = socket_filter_builder{}.source_in(allowed).build();
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int fd = udp_socket(addr, config);
+
+    send_from("127.0.0.1:0", AF_INET, addr, "unwanted");
+    send_from("127.0.0.2:0", AF_INET, addr, "exact");
+    send_from("127.0.0.3:0", AF_INET, addr, "neighbour");
+    send_from("127.1.2.3:0", AF_INET, addr, "in range");
+
+    REQUIRE(drain(fd) == std::vector<std::string>{"exact", "in range"});
+    close(fd);
+}
+
+TEST_CASE("socket filter on the first payload byte", "[io_socket_filter]")
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int fd = udp_socket(addr);
+    // the top two bits of the first byte, an RTP version 2 header
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.first_byte(0x80, 0xc0).build()));
+
+    send_from("127.0.0.1:0", AF_INET, addr, "\x80rtp");
+    send_from("127.0.0.1:0", AF_INET, addr, "\x40old");
+    send_from("127.0.0.1:0", AF_INET, addr, "\xbfmarker");
+    send_from("127.0.0.1:0", AF_INET, addr, "");
+
+    REQUIRE(drain(fd) == std::vector<std::string>{"\x80rtp", "\xbfmarker"});
+
+    // without the filter everything arrives again
+    REQUIRE_FALSE(detach_filter(fd));
+    send_from("127.0.0.1:0", AF_INET, addr, "\x40old");
+    REQUIRE(drain(fd).size() == 1);
+    close(fd);
+}
+
+TEST_CASE("socket filter on ports", "[io_socket_filter]")
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int fd    = udp_socket(addr);
+    auto port = ntohs(reinterpret_cast<const sockaddr_in *>(addr.sockaddr())->sin_port);
+
+    struct sock_addr source{"127.0.0.1:0", AF_INET};
+    int sender = udp_socket(source);
+    auto from  = ntohs(reinterpret_cast<const sockaddr_in *>(source.sockaddr())->sin_port);
+    auto send  = [&](const char *payload) { (void)sendto(sender, payload, 1, 0, addr.sockaddr(), addr.len()); };
+
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.destination_port(port).source_port(from).build()));
+    send("a");
+    REQUIRE(drain(fd).size() == 1);
+
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.destination_port(port - 1).build()));
+    send("b");
+    REQUIRE(drain(fd).empty());
+
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.source_port(from - 1, from + 1).build()));
+    send("c");
+    REQUIRE(drain(fd).size() == 1);
+
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.source_port(from + 1, from + 10).build()));
+    send("d");
+    REQUIRE(drain(fd).empty());
+
+    close(sender);
+    close(fd);
+}
+
+TEST_CASE("socket filter with IPv6 ranges on a dual-stack socket", "[io_socket_filter]")
+{
+    if (!ipv6_loopback()) { SKIP("no IPv6 loopback"); }
+
+    std::vector<network_range> allowed = {network_range{"[::1]/128"}, network_range{"127.0.0.0/8"}};
+    socket_config config;
+    config.filter = socket_filter_builder{}.source_in(allowed).first_byte('k').build();
+    struct sock_addr addr{"[::]:0", AF_INET6};
+    int fd = udp_socket(addr, config);
+    auto port = std::to_string(ntohs(reinterpret_cast<const sockaddr_in6 *>(addr.sockaddr())->sin6_port));
+
+    send_from("[::1]:0", AF_INET6, sock_addr{"[::1]:" + port, AF_INET6}, "keep v6");
+    send_from("[::1]:0", AF_INET6, sock_addr{"[::1]:" + port, AF_INET6}, "drop v6");
+    send_from("127.0.0.1:0", AF_INET, sock_addr{"127.0.0.1:" + port, AF_INET}, "keep v4");
+    REQUIRE(drain(fd) == std::vector<std::string>{"keep v6", "keep v4"});
+
+    // an IPv6 socket that only takes another IPv6 network
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.source_in(network_range{"[2001:db8::]/32"}).build()));
+    send_from("[::1]:0", AF_INET6, sock_addr{"[::1]:" + port, AF_INET6}, "v6");
+    send_from("127.0.0.1:0", AF_INET, sock_addr{"127.0.0.1:" + port, AF_INET}, "v4");
+    REQUIRE(drain(fd).empty());
+    close(fd);
+}
+
+TEST_CASE("socket filter program limits", "[io_socket_filter]")
+{
+    struct sock_addr addr{"127.0.0.1:0", AF_INET};
+    int fd = udp_socket(addr);
+
+    REQUIRE(attach_filter(fd, {}) == std::errc::invalid_argument);
+
+    // without ranges nothing passes
+    REQUIRE_FALSE(attach_filter(fd, socket_filter_builder{}.source_in(std::span<const network_range>{}).build()));
+    send_from("127.0.0.1:0", AF_INET, addr, "x");
+    REQUIRE(drain(fd).empty());
+
+    // many ranges stay within the jump offsets
+    std::vector<network_range> ranges;
+    for (int i = 0; i < 200; ++i) { ranges.emplace_back("10." + std::to_string(i) + ".0.0/16"); }
+    ranges.emplace_back("127.0.0.1/32");
+    auto program = socket_filter_builder{}.source_in(ranges).build();
+    REQUIRE(program.size() > 255);
+    REQUIRE_FALSE(attach_filter(fd, program));
+    send_from("127.0.0.1:0", AF_INET, addr, "last range");
+    REQUIRE(drain(fd) == std::vector<std::string>{"last range"});
+    close(fd);
+}
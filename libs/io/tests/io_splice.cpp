@@ -0,0 +1,187 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/splice.hpp>
+
+#include "test_sockets.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace io;
+using namespace io::test;
+
+namespace
+{
+
+std::vector<char> make_payload(size_t size)
+{
+    std::vector<char> payload(size);
+    for (size_t i = 0; i < size; ++i) { payload[i] = static_cast<char>(i * 7 + i / 251); }
+    return payload;
+}
+
+io_task write_all(io_loop &loop, int fd, const std::vector<char> &payload, bool &ok)
+{
+    size_t offset = 0;
+    while (offset < payload.size())
+    {
+        size_t sent = 0;
+        auto res    = co_await send(loop, fd, payload.data() + offset, payload.size() - offset, sent);
+        if (res != io_result::done) { co_return; }
+        offset += sent;
+    }
+
+    ok = true;
+}
+
+} // namespace
+
+TEST_CASE("splice forwards until the source closes", "[io_splice]")
+{
+    io_loop loop;
+    loop.init();
+
+    socket_pair source{16 * 1024};
+    socket_pair sink{16 * 1024};
+
+    const auto payload = make_payload(4 * 1024 * 1024);
+    std::vector<char> received;
+    bool written = false;
+
+    io_result result = io_result::waiting;
+    size_t transferred = 0;
+
+    auto writer = [&]() -> io_task
+    {
+        co_await write_all(loop, source.fds[0], payload, written);
+        source.close_end(0);
+    };
+
+    auto forwarder = [&]() -> io_task
+    {
+        auto op = io::splice(loop, source.fds[1], sink.fds[0], std::numeric_limits<size_t>::max(), transferred);
+        result  = co_await op;
+    };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    REQUIRE(loop.schedule(forwarder(), "forwarder"));
+    REQUIRE(loop.schedule(receive_all(loop, sink.fds[1], received, payload.size()), "reader"));
+    loop.run();
+
+    REQUIRE(written);
+    REQUIRE(result == io_result::closed);
+    REQUIRE(transferred == payload.size());
+    REQUIRE(received == payload);
+}
+
+TEST_CASE("splice stops after len bytes", "[io_splice]")
+{
+    io_loop loop;
+    loop.init();
+
+    socket_pair source{16 * 1024};
+    socket_pair sink{16 * 1024};
+
+    std::string data(3000, 'x');
+    REQUIRE(::write(source.fds[0], data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+
+    size_t transferred = 0;
+    io_result result   = io_result::waiting;
+
+    auto forwarder = [&]() -> io_task
+    {
+        auto op = io::splice(loop, source.fds[1], sink.fds[0], 1000, transferred);
+        result  = co_await op;
+    };
+
+    REQUIRE(loop.schedule(forwarder(), "forwarder"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(transferred == 1000);
+
+    // the rest is still waiting in the source
+    char buf[4096];
+    REQUIRE(::read(sink.fds[1], buf, sizeof(buf)) == 1000);
+    REQUIRE(::read(source.fds[1], buf, sizeof(buf)) == 2000);
+}
+
+TEST_CASE("splice times out", "[io_splice]")
+{
+    io_loop loop;
+    loop.init();
+
+    socket_pair source{16 * 1024};
+    socket_pair sink{16 * 1024};
+
+    size_t transferred = 0;
+    io_result result   = io_result::waiting;
+
+    auto forwarder = [&]() -> io_task
+    {
+        auto op = io::splice(loop, source.fds[1], sink.fds[0], 100, transferred,
+                             loop.now() + std::chrono::milliseconds(20));
+        result  = co_await op;
+    };
+
+    REQUIRE(loop.schedule(forwarder(), "forwarder"));
+    loop.run();
+
+    REQUIRE(result == io_result::timeout);
+    REQUIRE(transferred == 0);
+    REQUIRE(loop.waiter_count() == 0);
+}
+
+TEST_CASE("sendfile sends a file range", "[io_splice]")
+{
+    io_loop loop;
+    loop.init();
+
+    char name[] = "/tmp/io_sendfile_test_XXXXXX";
+    int file_fd = mkstemp(name);
+    REQUIRE(file_fd != -1);
+    unlink(name);
+
+    const auto payload = make_payload(1024 * 1024);
+    REQUIRE(::write(file_fd, payload.data(), payload.size()) == static_cast<ssize_t>(payload.size()));
+
+    socket_pair sink{16 * 1024};
+    std::vector<char> received;
+
+    const size_t offset = 4096;
+    size_t transferred  = 0;
+    io_result result    = io_result::waiting;
+
+    size_t tail_transferred = 0;
+    io_result tail_result   = io_result::waiting;
+
+    auto sender = [&]() -> io_task
+    {
+        auto op = io::sendfile(loop, sink.fds[0], file_fd, offset, payload.size() - 2 * offset, transferred);
+        result  = co_await op;
+
+        // asking for more than the file has ends with closed
+        auto tail   = io::sendfile(loop, sink.fds[0], file_fd, payload.size() - offset, 2 * offset, tail_transferred);
+        tail_result = co_await tail;
+    };
+
+    REQUIRE(loop.schedule(sender(), "sender"));
+    REQUIRE(loop.schedule(receive_all(loop, sink.fds[1], received, payload.size() - offset), "reader"));
+    loop.run();
+
+    close(file_fd);
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(transferred == payload.size() - 2 * offset);
+    REQUIRE(tail_result == io_result::closed);
+    REQUIRE(tail_transferred == offset);
+    REQUIRE(received == std::vector<char>(payload.begin() + offset, payload.end()));
+}
@@ -0,0 +1,219 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/stream.hpp>
+
+#include "test_sockets.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace io;
+using namespace io::test;
+
+namespace
+{
+
+/// @brief Writes @p chunks one after the other, each once the previous one was sent.
+io_task write_chunks(io_loop &loop, socket_pair &pair, std::vector<std::string> chunks, bool close_after)
+{
+    for (const auto &chunk : chunks)
+    {
+        size_t offset = 0;
+        while (offset < chunk.size())
+        {
+            size_t sent = 0;
+            if (co_await send(loop, pair.fds[0], chunk.data() + offset, chunk.size() - offset, sent) != io_result::done)
+            {
+                co_return;
+            }
+            offset += sent;
+        }
+        co_await io::sleep(loop, std::chrono::milliseconds(1));
+    }
+    if (close_after) { pair.close_end(0); }
+}
+
+} // namespace
+
+TEST_CASE("stream reads lines split over several packets", "[io_stream]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{16 * 1024};
+    stream s{loop, pair.release(1)};
+
+    std::vector<std::string> lines;
+    io_result last = io_result::waiting;
+
+    auto reader = [&]() -> io_task
+    {
+        size_t len = 0;
+        while ((last = co_await s.read_until("\r\n", len)) == io_result::done)
+        {
+            lines.emplace_back(s.read_ptr(), len - 2);
+            s.advance_read_ptr(len);
+        }
+    };
+
+    REQUIRE(loop.schedule(write_chunks(loop, pair, {"hello\r\nwor", "ld\r", "\n\r\nlast", " line\r\ntrailing"}, true),
+                          "writer"));
+    REQUIRE(loop.schedule(reader(), "reader"));
+    loop.run();
+
+    REQUIRE(lines == std::vector<std::string>{"hello", "world", "", "last line"});
+    REQUIRE(last == io_result::closed);
+    REQUIRE(s.eof());
+    REQUIRE(s.view() == "trailing");
+}
+
+TEST_CASE("stream reads length prefixed frames in place", "[io_stream]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{16 * 1024};
+    // smaller than the data in flight, so the unconsumed bytes have to move to the front
+    stream s{loop, pair.release(1), 4096};
+
+    std::mt19937 rng(3);
+    std::vector<std::string> frames;
+    std::string wire;
+    for (int i = 0; i < 2000; ++i)
+    {
+        std::string frame(rng() % 3000, '\0');
+        for (auto &c : frame) { c = static_cast<char>(rng()); }
+        uint16_t len = htons(static_cast<uint16_t>(frame.size()));
+        wire.append(reinterpret_cast<const char *>(&len), 2);
+        wire += frame;
+        frames.push_back(std::move(frame));
+    }
+
+    std::vector<std::string> chunks;
+    for (size_t offset = 0; offset < wire.size();)
+    {
+        size_t len = std::min<size_t>(1 + rng() % 20000, wire.size() - offset);
+        chunks.push_back(wire.substr(offset, len));
+        offset += len;
+    }
+
+    size_t matched = 0;
+    auto reader    = [&]() -> io_task
+    {
+        while (co_await s.read_exact(2) == io_result::done)
+        {
+            uint16_t len;
+            memcpy(&len, s.read_ptr(), 2);
+            len = ntohs(len);
+            if (co_await s.read_exact(2 + len) != io_result::done) { break; }
+
+            if (std::string_view(s.read_ptr() + 2, len) == frames[matched]) { ++matched; }
+            s.advance_read_ptr(2 + len);
+        }
+    };
+
+    REQUIRE(loop.schedule(write_chunks(loop, pair, chunks, true), "writer"));
+    REQUIRE(loop.schedule(reader(), "reader"));
+    loop.run();
+
+    REQUIRE(matched == frames.size());
+    REQUIRE(s.readable() == 0);
+}
+
+TEST_CASE("stream writes buffered output and caller data in order", "[io_stream]")
+{
+    io_loop loop;
+    loop.init();
+    socket_pair pair{16 * 1024};
+    stream s{loop, pair.release(1), 1024, 1024};
+
+    std::string body(1024 * 1024, '\0');
+    for (size_t i = 0; i < body.size(); ++i) { body[i] = static_cast<char>(i * 13 + i / 509); }
+
+    io_result result = io_result::waiting;
+    size_t written   = 0;
+    std::string received;
+
+    auto writer = [&]() -> io_task
+    {
+        REQUIRE(s.write("HEAD ") == 5);
+        REQUIRE(s.write(std::to_string(body.size()) + "\n") > 0);
+        result = co_await s.write_all(body.data(), body.size(), written);
+        s.write("tail");
+        co_await s.flush();
+        s.close();
+    };
+
+    auto reader = [&]() -> io_task
+    {
+        std::array<char, 8192> buf;
+        while (true)
+        {
+            ssize_t n = 0;
+            if (co_await recv(loop, pair.fds[0], buf.data(), buf.size(), n) != io_result::done) { co_return; }
+            received.append(buf.data(), n);
+        }
+    };
+
+    REQUIRE(loop.schedule(writer(), "writer"));
+    REQUIRE(loop.schedule(reader(), "reader"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(written == body.size());
+    REQUIRE(received == "HEAD 1048576\n" + body + "tail");
+}
+
+TEST_CASE("stream read errors", "[io_stream]")
+{
+    io_loop loop;
+    loop.init();
+
+    SECTION("no delimiter within the buffer")
+    {
+        socket_pair pair{16 * 1024};
+        stream s{loop, pair.release(1), 1024};
+        io_result result = io_result::waiting;
+
+        auto reader = [&]() -> io_task
+        {
+            size_t len = 0;
+            result     = co_await s.read_until("\n", len);
+        };
+
+        REQUIRE(loop.schedule(write_chunks(loop, pair, {std::string(3000, 'x')}, false), "writer"));
+        REQUIRE(loop.schedule(reader(), "reader"));
+        loop.run();
+
+        REQUIRE(result == io_result::error);
+        REQUIRE(s.error() == std::errc::no_buffer_space);
+        REQUIRE(s.readable() == 1024);
+    }
+
+    SECTION("deadline")
+    {
+        socket_pair pair{16 * 1024};
+        stream s{loop, pair.release(1)};
+        io_result result = io_result::waiting;
+
+        auto reader = [&]() -> io_task
+        {
+            result = co_await s.read_exact(10, loop.now() + std::chrono::milliseconds(20));
+        };
+
+        REQUIRE(loop.schedule(write_chunks(loop, pair, {"12345"}, false), "writer"));
+        REQUIRE(loop.schedule(reader(), "reader"));
+        loop.run();
+
+        REQUIRE(result == io_result::timeout);
+        REQUIRE(s.view() == "12345");
+    }
+}
@@ -1,4 +1,4 @@
-#include <io/iotask.hpp>
+#include <io/io.hpp>
 #include <common/catch.hpp>
 #include <chrono>
 #include <thread>
@@ -0,0 +1,336 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/tls.hpp>
+
+#include "test_sockets.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+using namespace io;
+using namespace io::test;
+
+namespace
+{
+
+/**
+ * @brief A self-signed P-256 certificate for "localhost", as PEM certificate and key.
+ */
+std::pair<std::string, std::string> self_signed(const char *name = "localhost")
+{
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    REQUIRE(key);
+
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+
+    X509_NAME *subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>(name), -1, -1, 0);
+    X509_set_issuer_name(cert, subject);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+    std::string alt_name = std::string("DNS:") + name;
+    X509_EXTENSION *ext  = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, alt_name.c_str());
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+    REQUIRE(X509_sign(cert, key, EVP_sha256()) > 0);
+
+    auto pem = [](auto write)
+    {
+        BIO *bio = BIO_new(BIO_s_mem());
+        write(bio);
+        char *data = nullptr;
+        long len   = BIO_get_mem_data(bio, &data);
+        std::string out(data, static_cast<size_t>(len));
+        BIO_free(bio);
+        return out;
+    };
+
+    auto cert_pem = pem([&](BIO *bio) { PEM_write_bio_X509(bio, cert); });
+    auto key_pem  = pem([&](BIO *bio) { PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr); });
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return {cert_pem, key_pem};
+}
+
+struct tls_setup
+{
+    explicit tls_setup(size_t max_sessions = tls_context::DEFAULT_MAX_SESSIONS)
+    : client{tls_role::client, max_sessions}
+    {
+        auto [cert, key] = self_signed();
+        REQUIRE_FALSE(server.use_certificate(cert, key));
+        REQUIRE_FALSE(client.trust(cert));
+    }
+
+    tls_context server{tls_role::server};
+    tls_context client{tls_role::client};
+};
+
+/**
+ * @brief Echoes what it reads until the client closes.
+ */
+io_task echo(tls_stream &tls, io_result &handshake)
+{
+    handshake = co_await tls.handshake();
+    if (handshake != io_result::done) { co_return; }
+
+    char buf[16 * 1024];
+    size_t len = 0, written = 0;
+    while (co_await tls.read(buf, sizeof(buf), len) == io_result::done)
+    {
+        if (co_await tls.write(buf, len, written) != io_result::done) { break; }
+    }
+    (void)co_await tls.shutdown();
+}
+
+/**
+ * @brief Handshake, sends @p message and reads the echo back into @p reply.
+ */
+io_task exchange(tls_stream &tls, const std::string &message, std::string &reply, io_result &handshake)
+{
+    handshake = co_await tls.handshake();
+    if (handshake != io_result::done) { co_return; }
+
+    size_t written = 0;
+    if (co_await tls.write(message.data(), message.size(), written) != io_result::done) { co_return; }
+
+    char buf[16 * 1024];
+    while (reply.size() < message.size())
+    {
+        size_t len = 0;
+        if (co_await tls.read(buf, sizeof(buf), len) != io_result::done) { break; }
+        reply.append(buf, len);
+    }
+    (void)co_await tls.shutdown();
+}
+
+/**
+ * @brief One connection with the session key @p key that pings the echo server.
+ * @return Whether the client resumed a cached session.
+ */
+bool ping(io_loop &loop, tls_setup &setup, const std::string &key)
+{
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, setup.client, pair.release(0), "localhost", key};
+
+    std::string reply;
+    io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+    REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+    REQUIRE(loop.schedule(exchange(client, "ping", reply, client_handshake), "client"));
+    loop.run();
+
+    REQUIRE(client_handshake == io_result::done);
+    REQUIRE(reply == "ping");
+    return client.resumed();
+}
+
+} // namespace
+
+TEST_CASE("tls_error maps system errors to the system category", "[io_tls]")
+{
+    ERR_raise(ERR_LIB_SYS, ECONNRESET);
+    auto error = tls_error();
+    REQUIRE(error == std::error_code(ECONNRESET, std::system_category()));
+    REQUIRE(error == std::errc::connection_reset);
+
+    // the full packed code survives the round trip through the category
+    ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_VERSION_NUMBER);
+    unsigned long packed = ERR_peek_last_error();
+    error                = tls_error();
+    REQUIRE(&error.category() == &tls_error_category::instance());
+    REQUIRE(static_cast<uint32_t>(error.value()) == packed);
+    char code[16];
+    snprintf(code, sizeof(code), "%08lX", packed);
+    REQUIRE(error.message().find(code) != std::string::npos);
+}
+
+TEST_CASE("tls_stream handshake and echo over loopback", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, setup.client, pair.release(0), "localhost"};
+
+    // bigger than the BIO buffers and the socket buffers, the writes have to wait for the echo to be read
+    std::string message(1024 * 1024, 'x');
+    for (size_t i = 0; i < message.size(); ++i) { message[i] = static_cast<char>('a' + i % 26); }
+
+    std::string reply;
+    io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+    REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+    REQUIRE(loop.schedule(exchange(client, message, reply, client_handshake), "client"));
+    loop.run();
+
+    REQUIRE(server_handshake == io_result::done);
+    REQUIRE(client_handshake == io_result::done);
+    REQUIRE(reply == message);
+    REQUIRE_FALSE(client.resumed());
+    REQUIRE(server.eof());
+}
+
+TEST_CASE("tls_stream resumes cached sessions", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+
+    for (int round = 0; round < 2; ++round)
+    {
+        tcp_pair pair;
+        tls_stream server{loop, setup.server, pair.release(1)};
+        tls_stream client{loop, setup.client, pair.release(0), "localhost"};
+
+        std::string reply;
+        io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+        REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+        // the TLS 1.3 session ticket arrives after the handshake, with the echo
+        REQUIRE(loop.schedule(exchange(client, "ping", reply, client_handshake), "client"));
+        loop.run();
+
+        REQUIRE(client_handshake == io_result::done);
+        REQUIRE(reply == "ping");
+        REQUIRE(setup.client.cached_sessions() == 1);
+        REQUIRE(client.resumed() == (round == 1));
+        REQUIRE(server.resumed() == (round == 1));
+    }
+}
+
+TEST_CASE("tls_context evicts the least recently used session", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup{2};
+
+    REQUIRE_FALSE(ping(loop, setup, "a"));
+    REQUIRE_FALSE(ping(loop, setup, "b"));
+    // using a makes b the oldest, c takes its place
+    REQUIRE(ping(loop, setup, "a"));
+    REQUIRE_FALSE(ping(loop, setup, "c"));
+    REQUIRE(setup.client.cached_sessions() == 2);
+
+    REQUIRE(ping(loop, setup, "a"));
+    REQUIRE(ping(loop, setup, "c"));
+    REQUIRE_FALSE(ping(loop, setup, "b"));
+}
+
+TEST_CASE("tls_stream fails the handshake on a certificate it doesn't trust", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+
+    // a client that trusts another certificate
+    tls_context other{tls_role::client};
+    REQUIRE_FALSE(other.trust(self_signed().first));
+
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, other, pair.release(0), "localhost"};
+
+    std::string reply;
+    io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+    REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+    REQUIRE(loop.schedule(exchange(client, "ping", reply, client_handshake), "client"));
+    loop.run();
+
+    REQUIRE(client_handshake == io_result::error);
+    REQUIRE(client.error().category() == tls_error_category::instance());
+    REQUIRE(server_handshake != io_result::done);
+}
+
+TEST_CASE("tls_stream checks the server name", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, setup.client, pair.release(0), "example.com"};
+
+    std::string reply;
+    io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+    REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+    REQUIRE(loop.schedule(exchange(client, "ping", reply, client_handshake), "client"));
+    loop.run();
+
+    REQUIRE(client_handshake == io_result::error);
+    REQUIRE(SSL_get_verify_result(client.native()) == X509_V_ERR_HOSTNAME_MISMATCH);
+}
+
+TEST_CASE("tls_stream with kTLS enabled", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+    setup.server.enable_ktls();
+    setup.client.enable_ktls();
+
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, setup.client, pair.release(0), "localhost"};
+
+    std::string message(256 * 1024, 'k');
+    std::string reply;
+    io_result server_handshake = io_result::waiting, client_handshake = io_result::waiting;
+    REQUIRE(loop.schedule(echo(server, server_handshake), "server"));
+    REQUIRE(loop.schedule(exchange(client, message, reply, client_handshake), "client"));
+    loop.run();
+
+    // without the kernel's tls module OpenSSL keeps the record layer, either way the data has to arrive
+    REQUIRE(client_handshake == io_result::done);
+    REQUIRE(reply == message);
+    LOG(info) << "kTLS send " << client.ktls_send() << " recv " << client.ktls_recv();
+}
+
+TEST_CASE("tls_stream read reports the peer closing", "[io_tls]")
+{
+    io_loop loop;
+    loop.init();
+    tls_setup setup;
+
+    tcp_pair pair;
+    tls_stream server{loop, setup.server, pair.release(1)};
+    tls_stream client{loop, setup.client, pair.release(0), "localhost"};
+
+    io_result read_result = io_result::waiting;
+    auto server_task      = [&]() -> io_task
+    {
+        if (co_await server.handshake() != io_result::done) { co_return; }
+        (void)co_await server.shutdown();
+    };
+    auto client_task = [&]() -> io_task
+    {
+        if (co_await client.handshake() != io_result::done) { co_return; }
+        char buf[64];
+        size_t len  = 0;
+        read_result = co_await client.read(buf, sizeof(buf), len);
+    };
+
+    REQUIRE(loop.schedule(server_task(), "server"));
+    REQUIRE(loop.schedule(client_task(), "client"));
+    loop.run();
+
+    REQUIRE(read_result == io_result::closed);
+    REQUIRE(client.eof());
+}
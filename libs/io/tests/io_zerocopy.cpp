@@ -0,0 +1,156 @@
+#include <common/log.hpp>
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/zerocopy.hpp>
+
+#include "test_sockets.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+using namespace io;
+using namespace io::test;
+
+namespace
+{
+
+std::string pattern(size_t size)
+{
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) { data[i] = static_cast<char>(i * 7 + i / 4096); }
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("zero-copy sends arrive intact and release their buffers", "[io_zerocopy]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    zerocopy_sender sender{loop, pair.fds[0]};
+    if (!sender.enabled()) { SKIP("SO_ZEROCOPY is not supported here"); }
+
+    // each send in a buffer of its own, the first is released by the sender once the caller dropped it
+    auto expected = pattern(3 * 1024 * 1024);
+    std::string received;
+    size_t sent_total = 0;
+
+    auto send_task = [&]() -> io_task
+    {
+        for (size_t offset = 0; offset < expected.size(); offset += 1024 * 1024)
+        {
+            io_buf buf{1024 * 1024};
+            buf.write(std::string_view{expected}.substr(offset, 1024 * 1024));
+
+            size_t sent = 0;
+            if (co_await sender.send(buf, sent) != io_result::done) { co_return; }
+            REQUIRE(buf.readable() == 0);
+            sent_total += sent;
+        }
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size()), "receiver"));
+    REQUIRE(loop.schedule(send_task(), "sender"));
+    loop.run();
+
+    REQUIRE(sent_total == expected.size());
+    REQUIRE(received == expected);
+
+    // the loop ran until the reaper had every completion
+    REQUIRE(sender.pending() == 0);
+    REQUIRE(sender.stats().zerocopy_sends > 0);
+    REQUIRE(sender.stats().completed == sender.stats().zerocopy_sends);
+}
+
+TEST_CASE("sends below the threshold copy", "[io_zerocopy]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    zerocopy_sender sender{loop, pair.fds[0], 64 * 1024};
+
+    auto expected = pattern(4000);
+    std::string received;
+    io_result result = io_result::waiting;
+
+    auto send_task = [&]() -> io_task
+    {
+        io_buf buf{expected.size()};
+        buf.write(expected);
+        size_t sent = 0;
+        result      = co_await sender.send(buf, sent);
+    };
+
+    REQUIRE(loop.schedule(receive_all(loop, pair.fds[1], received, expected.size()), "receiver"));
+    REQUIRE(loop.schedule(send_task(), "sender"));
+    loop.run();
+
+    REQUIRE(result == io_result::done);
+    REQUIRE(received == expected);
+    REQUIRE(sender.stats().zerocopy_sends == 0);
+    REQUIRE(sender.stats().copy_sends == 1);
+    REQUIRE(sender.pending() == 0);
+}
+
+TEST_CASE("a recv on the sending socket waits through zero-copy completions", "[io_zerocopy]")
+{
+    io_loop loop;
+    loop.init();
+    tcp_pair pair;
+
+    zerocopy_sender sender{loop, pair.fds[0]};
+    if (!sender.enabled()) { SKIP("SO_ZEROCOPY is not supported here"); }
+
+    // the completions land on the error queue while the recv waits for the peer's reply
+    auto expected = pattern(2 * 1024 * 1024);
+    std::string received;
+    io_result reply_result = io_result::waiting;
+    std::string reply;
+
+    auto reply_task = [&]() -> io_task
+    {
+        char buf[16];
+        ssize_t n   = 0;
+        auto op     = recv(loop, pair.fds[0], buf, sizeof(buf), n, 0, loop.now() + std::chrono::seconds(5));
+        reply_result = co_await op;
+        if (n > 0) { reply.assign(buf, static_cast<size_t>(n)); }
+    };
+
+    auto send_task = [&]() -> io_task
+    {
+        for (size_t offset = 0; offset < expected.size(); offset += 256 * 1024)
+        {
+            io_buf buf{256 * 1024};
+            buf.write(std::string_view{expected}.substr(offset, 256 * 1024));
+
+            size_t sent = 0;
+            if (co_await sender.send(buf, sent) != io_result::done) { co_return; }
+        }
+    };
+
+    auto peer_task = [&]() -> io_task
+    {
+        // reading the last bytes completes the last sends, the reply comes after their report was queued
+        co_await receive_all(loop, pair.fds[1], received, expected.size());
+        co_await io::sleep(loop, std::chrono::milliseconds(20));
+        REQUIRE(::send(pair.fds[1], "ok", 2, 0) == 2);
+    };
+
+    REQUIRE(loop.schedule(reply_task(), "reply"));
+    REQUIRE(loop.schedule(peer_task(), "peer"));
+    REQUIRE(loop.schedule(send_task(), "sender"));
+    loop.run();
+
+    REQUIRE(received == expected);
+    REQUIRE(sender.stats().completed > 0);
+    REQUIRE(reply_result == io_result::done);
+    REQUIRE(reply == "ok");
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <common/catch.hpp>
+
+#include <io/io.hpp>
+#include <net/ops.hpp>
+#include <net/sockaddr.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+/**
+ * Connected socket pairs and a receiver for the tests of the socket operations.
+ */
+
+namespace io::test
+{
+
+/// @brief Closes the ends a test didn't hand over or close itself.
+struct fd_pair
+{
+    int fds[2] = {-1, -1};
+
+    fd_pair() = default;
+
+    fd_pair(const fd_pair &)            = delete;
+    fd_pair &operator=(const fd_pair &) = delete;
+
+    ~fd_pair()
+    {
+        for (int fd : fds)
+        {
+            if (fd != -1) { close(fd); }
+        }
+    }
+
+    /// @brief Hands end @p i over to whoever closes it from then on, a stream for example.
+    int release(int i) { return std::exchange(fds[i], -1); }
+
+    void close_end(int i) { close(release(i)); }
+};
+
+/// @brief Both ends of a loopback TCP connection, non-blocking, the connecting end first.
+struct tcp_pair : fd_pair
+{
+    tcp_pair()
+    {
+        struct sock_addr addr{"127.0.0.1:0", AF_INET, SOCK_STREAM};
+        int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(listener != -1);
+        REQUIRE(bind(listener, addr.sockaddr(), addr.len()) == 0);
+        REQUIRE(getsockname(listener, addr.sockaddr(), &addr.len_ref()) == 0);
+        REQUIRE(listen(listener, 1) == 0);
+
+        fds[0] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(connect(fds[0], addr.sockaddr(), addr.len()) == 0);
+        fds[1] = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        REQUIRE(fds[1] != -1);
+        close(listener);
+
+        for (int fd : fds) { REQUIRE(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0); }
+    }
+};
+
+/**
+ * @brief A non-blocking AF_UNIX stream socketpair.
+ *
+ * With @p buffer_size the send and receive buffers are made that small, so transfers larger than it run into
+ * partial writes and EAGAIN.
+ */
+struct socket_pair : fd_pair
+{
+    explicit socket_pair(int buffer_size = 0)
+    {
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0);
+        if (buffer_size == 0) { return; }
+
+        for (int fd : fds)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        }
+    }
+};
+
+/**
+ * @brief Receives into @p received, a std::string or std::vector<char>, until @p want bytes arrived.
+ *
+ * Waits @p pause before each read to play a slow peer. Gives up when the peer closes or stays quiet for five seconds.
+ */
+template <typename Buffer>
+io_task receive_all(io_loop &loop, int fd, Buffer &received, size_t want,
+                    std::chrono::milliseconds pause = std::chrono::milliseconds(0))
+{
+    std::vector<char> buf(64 * 1024);
+    while (received.size() < want)
+    {
+        if (pause.count() > 0) { co_await io::sleep(loop, pause); }
+
+        ssize_t n = 0;
+        auto op   = recv(loop, fd, buf.data(), buf.size(), n, 0, loop.now() + std::chrono::seconds(5));
+        if (co_await op != io_result::done || n <= 0) { co_return; }
+        received.insert(received.end(), buf.data(), buf.data() + n);
+    }
+}
+
+} // namespace io::test